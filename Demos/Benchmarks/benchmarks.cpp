@@ -0,0 +1,24 @@
+/**
+\file   benchmarks.cpp
+\author Andrew Baxter
+\date   March 28, 2016
+
+Runs each engine micro-benchmark in turn and prints the results to the console
+
+*/
+
+#include "benchmarks.h"
+#pragma comment(lib, "Basilisk.lib")
+
+int main(int argc, char *argv[])
+{
+	BenchTaskGraph();
+	BenchScene();
+	BenchSceneLoad();
+	BenchTransformHierarchy();
+	BenchCulling();
+	BenchMeshOptimizer();
+	BenchMeshSimplifier();
+	BenchMeshlets();
+	return 0;
+}
@@ -0,0 +1,38 @@
+/**
+\file   benchmarks.h
+\author Andrew Baxter
+\date   March 28, 2016
+
+Shared helpers for the engine micro-benchmarks
+
+*/
+
+#ifndef BASILISK_BENCHMARKS_H
+#define BASILISK_BENCHMARKS_H
+
+#include <chrono>
+#include <cstdio>
+
+/**
+Runs `func` `iterations` times and returns the average wall time of one run, in seconds
+*/
+template<typename Func>
+double TimeAverage(unsigned iterations, Func func)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < iterations; ++i)
+		func();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+void BenchTaskGraph();
+void BenchScene();
+void BenchSceneLoad();
+void BenchTransformHierarchy();
+void BenchCulling();
+void BenchMeshOptimizer();
+void BenchMeshSimplifier();
+void BenchMeshlets();
+
+#endif
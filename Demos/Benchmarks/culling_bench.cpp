@@ -0,0 +1,110 @@
+/**
+\file   culling_bench.cpp
+\author Andrew Baxter
+\date   April 4, 2016
+
+Measures `Basilisk::CullingBVH` against testing every box with glm, for a camera and four shadow cascades
+
+*/
+
+#include "benchmarks.h"
+#include <core/culling.h>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t numIterations = 10;
+	constexpr float worldSize = 2000.0f;
+
+	uint32_t seed = 12345;
+	float Random()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / float(1 << 24);
+	}
+
+	//The baseline: every box against every plane, one at a time
+	void CullNaive(const Frustum &frustum, const std::vector<glm::vec3> &mins, const std::vector<glm::vec3> &maxs, std::vector<uint32_t> &visible)
+	{
+		visible.clear();
+		for (uint32_t i = 0; i < mins.size(); ++i)
+		{
+			bool outside = false;
+			for (int p = 0; p < 6 && !outside; ++p)
+			{
+				const glm::vec4 &plane = frustum.planes[p];
+				glm::vec3 corner(plane.x >= 0.0f ? maxs[i].x : mins[i].x, plane.y >= 0.0f ? maxs[i].y : mins[i].y, plane.z >= 0.0f ? maxs[i].z : mins[i].z);
+				outside = glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f;
+			}
+			if (!outside)
+				visible.push_back(i);
+		}
+	}
+
+	//A camera in the middle of the world, and four orthographic cascades of increasing size along its view
+	std::vector<Frustum> MakeViews()
+	{
+		glm::vec3 eye(0.0f, 20.0f, 0.0f), forward(1.0f, 0.0f, 0.0f), sun = glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
+		std::vector<Frustum> out;
+		out.push_back(Frustum::FromMatrix(glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f) * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f))));
+
+		float extent = 25.0f;
+		for (int i = 0; i < 4; ++i, extent *= 4.0f)
+		{
+			glm::vec3 center = eye + forward * extent;
+			glm::mat4 view = glm::lookAt(center - sun * 1000.0f, center, glm::vec3(1.0f, 0.0f, 0.0f));
+			out.push_back(Frustum::FromMatrix(glm::ortho(-extent, extent, -extent, extent, 0.0f, 2000.0f) * view));
+		}
+		return out;
+	}
+
+	void Run(uint32_t count)
+	{
+		std::vector<glm::vec3> mins(count), maxs(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			glm::vec3 center((Random() - 0.5f) * worldSize, Random() * 50.0f, (Random() - 0.5f) * worldSize);
+			glm::vec3 extent(0.5f + Random() * 4.0f);
+			mins[i] = center - extent;
+			maxs[i] = center + extent;
+		}
+
+		CullingBVH bvh;
+		double build = TimeAverage(1, [&] { bvh.Build(mins.data(), maxs.data(), count); });
+		double refit = TimeAverage(numIterations, [&] { bvh.Refit(mins.data(), maxs.data()); });
+
+		std::vector<Frustum> views = MakeViews();
+		std::vector< std::vector<uint32_t> > visible(views.size());
+		size_t numVisible = 0;
+
+		double naive = TimeAverage(numIterations, [&] {
+			for (size_t i = 0; i < views.size(); ++i)
+				CullNaive(views[i], mins, maxs, visible[i]);
+		});
+		double serial = TimeAverage(numIterations, [&] {
+			for (size_t i = 0; i < views.size(); ++i)
+				bvh.Cull(views[i], visible[i]);
+		});
+		for (auto &iter : visible)
+			numVisible += iter.size();
+
+		TaskGraph graph;
+		bvh.Cull(graph, views, visible);
+		graph.Execute();
+		double parallel = TimeAverage(numIterations, [&] { graph.Execute(); });
+
+		printf("Culling: %u boxes, %zu views, %zu visible in total (build %.2f ms, refit %.2f ms)\n",
+			count, views.size(), numVisible, build * 1e3, refit * 1e3);
+		printf("  Every box with glm: %8.3f ms\n", naive * 1e3);
+		printf("  BVH, serial:        %8.3f ms  %6.2fx\n", serial * 1e3, naive / serial);
+		printf("  BVH, %2zu threads:     %8.3f ms  %6.2fx\n", graph.NumThreads(), parallel * 1e3, naive / parallel);
+	}
+}
+
+void BenchCulling()
+{
+	Run(100000);
+	Run(1000000);
+}
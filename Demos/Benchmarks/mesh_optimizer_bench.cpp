@@ -0,0 +1,130 @@
+/**
+\file   mesh_optimizer_bench.cpp
+\author Andrew Baxter
+\date   April 8, 2016
+
+Measures each mesh optimisation pass on large, badly ordered meshes, and optimising several meshes in parallel
+
+*/
+
+#include "benchmarks.h"
+#include <resources/mesh_optimizer.h>
+#include <core/task_graph.h>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t vertexStride = 20; //A cooked vertex with a normal, tangent and texture coordinates
+
+	uint32_t seed = 12345;
+	uint32_t Random()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	}
+
+	//A sphere made of a `size` by `size` grid, with its triangles shuffled as a badly exported mesh might be
+	void MakeMesh(uint32_t size, std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices)
+	{
+		positions.clear();
+		indices.clear();
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				float u = x * 6.2831853f / size, v = y * 3.1415927f / (size - 1);
+				positions.push_back(glm::vec3(sinf(v) * cosf(u), sinf(v) * sinf(u), cosf(v)));
+			}
+		}
+		for (uint32_t y = 0; y + 1 < size; ++y)
+		{
+			for (uint32_t x = 0; x + 1 < size; ++x)
+			{
+				uint32_t i = y * size + x;
+				uint32_t quad[6] = { i, i + 1, i + size, i + 1, i + size + 1, i + size };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		size_t numTriangles = indices.size() / 3;
+		for (size_t i = numTriangles - 1; i > 0; --i)
+		{
+			size_t j = Random() % (i + 1);
+			for (int k = 0; k < 3; ++k)
+				std::swap(indices[i * 3 + k], indices[j * 3 + k]);
+		}
+	}
+
+	void PrintPass(const char *name, size_t numTriangles, double seconds, const VertexCacheStats &stats)
+	{
+		printf("  %-13s %8.1f ms  %6.2f Mtri/s  ACMR %.3f  ATVR %.3f\n", name, seconds * 1e3, numTriangles / seconds / 1e6, stats.acmr, stats.atvr);
+	}
+
+	void RunPasses(uint32_t size)
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		MakeMesh(size, positions, indices);
+		uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+		size_t numTriangles = indices.size() / 3;
+
+		VertexCacheStats original = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+		VertexFetchStats fetchOriginal = AnalyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexStride);
+
+		double cache = TimeAverage(1, [&] { OptimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount); });
+		VertexCacheStats afterCache = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+		double overdraw = TimeAverage(1, [&] { OptimizeOverdraw(indices.data(), indices.data(), indices.size(), positions.data(), vertexCount); });
+		VertexCacheStats afterOverdraw = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+		std::vector<uint32_t> remap(vertexCount);
+		double fetch = TimeAverage(1, [&] { OptimizeVertexFetch(indices.data(), indices.size(), vertexCount, remap.data()); });
+		VertexFetchStats fetchOptimized = AnalyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexStride);
+
+		printf("Mesh optimisation: %zu triangles, %u vertices, shuffled (ACMR %.3f, ATVR %.3f)\n", numTriangles, vertexCount, original.acmr, original.atvr);
+		PrintPass("Vertex cache:", numTriangles, cache, afterCache);
+		PrintPass("Overdraw:", numTriangles, overdraw, afterOverdraw);
+		printf("  %-13s %8.1f ms  %6.2f Mtri/s  overfetch %.2f -> %.2f\n", "Vertex fetch:", fetch * 1e3, numTriangles / fetch / 1e6,
+			fetchOriginal.overfetch, fetchOptimized.overfetch);
+	}
+
+	void RunParallel(uint32_t numMeshes, uint32_t size)
+	{
+		std::vector< std::vector<glm::vec3> > positions(numMeshes);
+		std::vector< std::vector<uint32_t> > source(numMeshes);
+		for (uint32_t i = 0; i < numMeshes; ++i)
+			MakeMesh(size, positions[i], source[i]);
+
+		std::vector< std::vector<uint32_t> > indices(numMeshes), remaps(numMeshes);
+		double serial = TimeAverage(1, [&] {
+			for (uint32_t i = 0; i < numMeshes; ++i)
+			{
+				indices[i] = source[i];
+				OptimizeMesh(indices[i], positions[i].data(), static_cast<uint32_t>(positions[i].size()), vertexStride, remaps[i]);
+			}
+		});
+
+		TaskGraph graph;
+		for (uint32_t i = 0; i < numMeshes; ++i)
+		{
+			graph.Add([&, i] {
+				indices[i] = source[i];
+				OptimizeMesh(indices[i], positions[i].data(), static_cast<uint32_t>(positions[i].size()), vertexStride, remaps[i]);
+			});
+		}
+		double parallel = TimeAverage(1, [&] { graph.Execute(); });
+
+		size_t numTriangles = numMeshes * source[0].size() / 3;
+		printf("Mesh optimisation: %u meshes, %zu triangles in total, all three passes\n", numMeshes, numTriangles);
+		printf("  Serial:       %8.1f ms  %6.2f Mtri/s\n", serial * 1e3, numTriangles / serial / 1e6);
+		printf("  %2zu threads:   %8.1f ms  %6.2f Mtri/s  %6.2fx\n", graph.NumThreads(), parallel * 1e3, numTriangles / parallel / 1e6, serial / parallel);
+	}
+}
+
+void BenchMeshOptimizer()
+{
+	RunPasses(708); //Just over a million triangles
+	RunPasses(1415); //Four million
+	RunParallel(8, 500);
+}
@@ -0,0 +1,106 @@
+/**
+\file   mesh_simplifier_bench.cpp
+\author Andrew Baxter
+\date   April 9, 2016
+
+Measures how quickly meshes are simplified into levels of detail, with and without attributes
+
+*/
+
+#include "benchmarks.h"
+#include <resources/mesh_simplifier.h>
+#include <cfloat>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t numAttributes = 5; //A normal and one set of texture coordinates
+	const float attributeWeights[numAttributes] = { 0.5f, 0.5f, 0.5f, 1.0f, 1.0f };
+
+	//A UV sphere, with a seam where the texture coordinates wrap and a ring of vertices at each pole
+	void MakeSphere(uint32_t segments, std::vector<glm::vec3> &positions, std::vector<float> &attributes, std::vector<uint32_t> &indices)
+	{
+		uint32_t rows = segments / 2, columns = segments + 1;
+		positions.clear();
+		attributes.clear();
+		indices.clear();
+		for (uint32_t y = 0; y <= rows; ++y)
+		{
+			for (uint32_t x = 0; x < columns; ++x)
+			{
+				float u = float(x) / segments, v = float(y) / rows;
+				float theta = (x == segments) ? 0.0f : u * 6.2831853f, phi = v * 3.1415927f;
+				glm::vec3 p(sinf(phi) * cosf(theta), sinf(phi) * sinf(theta), cosf(phi));
+				if (y == 0 || y == rows)
+					p = glm::vec3(0.0f, 0.0f, (y == 0) ? 1.0f : -1.0f);
+				positions.push_back(p);
+				float vertex[numAttributes] = { p.x, p.y, p.z, u, v };
+				attributes.insert(attributes.end(), vertex, vertex + numAttributes);
+			}
+		}
+		for (uint32_t y = 0; y < rows; ++y)
+		{
+			for (uint32_t x = 0; x < segments; ++x)
+			{
+				uint32_t i = y * columns + x;
+				if (y != 0)
+				{
+					uint32_t top[3] = { i, i + columns, i + 1 };
+					indices.insert(indices.end(), top, top + 3);
+				}
+				if (y + 1 != rows)
+				{
+					uint32_t bottom[3] = { i + 1, i + columns, i + columns + 1 };
+					indices.insert(indices.end(), bottom, bottom + 3);
+				}
+			}
+		}
+	}
+
+	void Run(uint32_t segments)
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<float> attributes;
+		std::vector<uint32_t> indices;
+		MakeSphere(segments, positions, attributes, indices);
+		uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+		size_t numTriangles = indices.size() / 3;
+
+		printf("Mesh simplification: %zu triangles, %u vertices\n", numTriangles, vertexCount);
+		printf("  Target       Attributes   Triangles      Error       Time    Mtri/s\n");
+		std::vector<uint32_t> out(indices.size());
+		for (float ratio : { 0.5f, 0.25f, 0.1f, 0.05f })
+		{
+			for (bool withAttributes : { false, true })
+			{
+				size_t count = 0;
+				float error = 0.0f;
+				double seconds = TimeAverage(1, [&] {
+					count = SimplifyMesh(out.data(), indices.data(), indices.size(), positions.data(), vertexCount,
+						withAttributes ? attributes.data() : nullptr, numAttributes, attributeWeights, numAttributes,
+						static_cast<size_t>(numTriangles * ratio) * 3, FLT_MAX, &error);
+				});
+				printf("  %5.1f%%       %-10s %10zu  %9.5f  %7.1f ms  %8.2f\n", ratio * 100.0f, withAttributes ? "yes" : "no",
+					count / 3, error, seconds * 1e3, numTriangles / seconds / 1e6);
+			}
+		}
+
+		//A whole chain, simplifying each level from the last, as cooking does
+		double chain = TimeAverage(1, [&] {
+			std::vector<uint32_t> lod = indices;
+			for (int level = 0; level < 4; ++level)
+			{
+				lod.resize(SimplifyMesh(lod.data(), lod.data(), lod.size(), positions.data(), vertexCount, attributes.data(), numAttributes,
+					attributeWeights, numAttributes, lod.size() / 6 * 3, FLT_MAX));
+			}
+		});
+		printf("  Four level chain, with attributes: %.1f ms, %.2f Mtri/s\n", chain * 1e3, numTriangles / chain / 1e6);
+	}
+}
+
+void BenchMeshSimplifier()
+{
+	Run(200); //About 40 thousand triangles
+	Run(1416); //Just over two million
+}
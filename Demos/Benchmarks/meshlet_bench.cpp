@@ -0,0 +1,104 @@
+/**
+\file   meshlet_bench.cpp
+\author Andrew Baxter
+\date   April 10, 2016
+
+Measures building meshlets, and culling them with SSE against testing each one with glm, from a far and a close view
+
+*/
+
+#include "benchmarks.h"
+#include <resources/meshlets.h>
+#include <resources/mesh_optimizer.h>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+using namespace Basilisk;
+
+namespace
+{
+	//A sphere made of a `size` by `size` grid, in the order the cooker would leave it
+	void MakeMesh(uint32_t size, std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices)
+	{
+		positions.clear();
+		indices.clear();
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				float u = x * 6.2831853f / (size - 1), v = y * 3.1415927f / (size - 1);
+				positions.push_back(glm::vec3(sinf(v) * cosf(u), sinf(v) * sinf(u), cosf(v)));
+			}
+		}
+		for (uint32_t y = 0; y + 1 < size; ++y)
+		{
+			for (uint32_t x = 0; x + 1 < size; ++x)
+			{
+				uint32_t i = y * size + x;
+				uint32_t quad[6] = { i, i + size, i + 1, i + 1, i + size, i + size + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		OptimizeVertexCache(indices.data(), indices.data(), indices.size(), static_cast<uint32_t>(positions.size()));
+	}
+
+	void CullNaive(const Frustum &frustum, const glm::vec3 &eye, const std::vector<MeshFile::Meshlet> &meshlets, std::vector<uint32_t> &visible)
+	{
+		visible.clear();
+		for (uint32_t i = 0; i < meshlets.size(); ++i)
+		{
+			const MeshFile::Meshlet &iter = meshlets[i];
+			glm::vec3 center(iter.center[0], iter.center[1], iter.center[2]);
+			bool outside = false;
+			for (int p = 0; p < 6 && !outside; ++p)
+				outside = glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w < -iter.radius;
+
+			glm::vec3 apex(iter.coneApex[0], iter.coneApex[1], iter.coneApex[2]), axis(iter.coneAxis[0], iter.coneAxis[1], iter.coneAxis[2]);
+			if (!outside && glm::dot(apex - eye, axis) <= iter.coneCutoff * glm::length(apex - eye))
+				visible.push_back(i);
+		}
+	}
+
+	void RunView(const char *name, const glm::vec3 &eye, float fovY, const std::vector<MeshFile::Meshlet> &meshlets)
+	{
+		Frustum frustum = Frustum::FromMatrix(glm::perspective(fovY, 16.0f / 9.0f, 0.01f, 100.0f) * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+		uint32_t count = static_cast<uint32_t>(meshlets.size());
+		std::vector<uint32_t> naive, simd;
+		MeshletCullStats stats = {};
+		double naiveTime = TimeAverage(200, [&] { CullNaive(frustum, eye, meshlets, naive); });
+		double simdTime = TimeAverage(200, [&] { simd.clear(); CullMeshlets(frustum, eye, meshlets.data(), count, simd); });
+		simd.clear();
+		CullMeshlets(frustum, eye, meshlets.data(), count, simd, &stats);
+
+		printf("  %-6s %5.1f%% outside, %5.1f%% backfacing, %6zu visible  glm %7.3f ms (%5.1f ns each)  SSE %7.3f ms (%5.1f ns each)  %5.2fx%s\n", name,
+			100.0f * stats.outside / count, 100.0f * stats.backfacing / count, naive.size(), naiveTime * 1e3, naiveTime * 1e9 / count,
+			simdTime * 1e3, simdTime * 1e9 / count, naiveTime / simdTime, naive == simd ? "" : "  MISMATCH");
+	}
+
+	void Run(uint32_t size)
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		MakeMesh(size, positions, indices);
+		uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+		size_t numTriangles = indices.size() / 3;
+
+		std::vector<MeshFile::Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		double build = TimeAverage(1, [&] {
+			BuildMeshlets(meshlets, meshletVertices, meshletTriangles, indices.data(), indices.size(), positions.data(), vertexCount);
+		});
+
+		size_t numCones = std::count_if(meshlets.begin(), meshlets.end(), [](const MeshFile::Meshlet &m) { return m.coneCutoff < 1.0f; });
+		printf("Meshlets: %zu triangles into %zu meshlets in %.1f ms (%.2f Mtri/s), %.1f vertices and %.1f triangles each, %.1f%% with a cone\n",
+			numTriangles, meshlets.size(), build * 1e3, numTriangles / build / 1e6, double(meshletVertices.size()) / meshlets.size(),
+			double(numTriangles) / meshlets.size(), 100.0 * numCones / meshlets.size());
+		RunView("Far:", glm::vec3(4.0f, 1.0f, 0.5f), 1.0f, meshlets); //The whole sphere on screen, so only cones reject anything
+		RunView("Close:", glm::vec3(1.3f, 0.2f, 0.1f), 1.0f, meshlets); //Most of the sphere off screen
+	}
+}
+
+void BenchMeshlets()
+{
+	Run(708); //Just over a million triangles
+}
@@ -0,0 +1,116 @@
+/**
+\file   scene_bench.cpp
+\author Andrew Baxter
+\date   March 28, 2016
+
+Measures `Basilisk::Scene` iteration over transforms and bounds at 10k, 100k and 1M entities,
+serially and in chunks spread across a `TaskGraph`
+
+*/
+
+#include "benchmarks.h"
+#include <scene.h>
+#include <glm/glm/gtc/quaternion.hpp>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t numIterations = 10;
+
+	struct Transform
+	{
+		glm::vec3 position;
+		float scale;
+		glm::quat rotation;
+	};
+
+	struct LocalBounds
+	{
+		glm::vec3 center;
+		glm::vec3 extents;
+	};
+
+	struct WorldBounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	//Transforms a local box into a world-space axis-aligned box
+	inline void UpdateBounds(const Transform &transform, const LocalBounds &local, WorldBounds &world)
+	{
+		glm::mat3 rotation = glm::mat3_cast(transform.rotation);
+		glm::mat3 absolute(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2]));
+
+		glm::vec3 center = transform.position + rotation * (local.center * transform.scale);
+		glm::vec3 extents = absolute * (local.extents * transform.scale);
+		world.min = center - extents;
+		world.max = center + extents;
+	}
+
+	void Populate(Scene &scene, uint32_t count)
+	{
+		uint32_t seed = 12345;
+		auto random = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return (seed >> 8) / float(1 << 24);
+		};
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Transform transform = { glm::vec3(random(), random(), random()) * 1000.0f, 0.5f + random(),
+				glm::normalize(glm::quat(random(), random(), random(), random())) };
+			LocalBounds local = { glm::vec3(0.0f), glm::vec3(random(), random(), random()) };
+
+			//A quarter of the entities have no world bounds, so queries have to skip an archetype
+			if (i % 4 == 0)
+				scene.Create(transform, local);
+			else
+				scene.Create(transform, local, WorldBounds());
+		}
+	}
+
+	void Run(uint32_t count)
+	{
+		Scene scene;
+		auto start = std::chrono::steady_clock::now();
+		Populate(scene, count);
+		std::chrono::duration<double> created = std::chrono::steady_clock::now() - start;
+
+		uint32_t matched = 0;
+		scene.ForEachChunk<WorldBounds>([&](const Entity*, uint32_t n, WorldBounds*) { matched += n; });
+
+		double perEntity = 1e9 / matched;
+		printf("Scene: %u entities, %u with world bounds (create %.2f ms)\n", count, matched, created.count() * 1e3);
+
+		double seconds = TimeAverage(numIterations, [&] {
+			scene.ForEach<Transform, LocalBounds, WorldBounds>([](Entity, Transform &t, LocalBounds &l, WorldBounds &w) {
+				UpdateBounds(t, l, w);
+			});
+		});
+		printf("  ForEach:              %8.3f ms  %6.2f ns/entity\n", seconds * 1e3, seconds * perEntity);
+
+		auto chunk = [](const Entity*, uint32_t n, Transform *t, LocalBounds *l, WorldBounds *w) {
+			for (uint32_t i = 0; i < n; ++i)
+				UpdateBounds(t[i], l[i], w[i]);
+		};
+
+		seconds = TimeAverage(numIterations, [&] { scene.ForEachChunk<Transform, LocalBounds, WorldBounds>(chunk); });
+		printf("  ForEachChunk:         %8.3f ms  %6.2f ns/entity\n", seconds * 1e3, seconds * perEntity);
+
+		TaskGraph graph;
+		std::vector<TaskId> tasks = scene.ParallelForEachChunk<Transform, LocalBounds, WorldBounds>(graph, chunk);
+		graph.Execute(); //Warm up
+		seconds = TimeAverage(numIterations, [&] { graph.Execute(); });
+		printf("  ParallelForEachChunk: %8.3f ms  %6.2f ns/entity  (%zu tasks on %zu threads)\n",
+			seconds * 1e3, seconds * perEntity, tasks.size(), graph.NumThreads());
+	}
+}
+
+void BenchScene()
+{
+	Run(10000);
+	Run(100000);
+	Run(1000000);
+}
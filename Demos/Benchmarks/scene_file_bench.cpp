@@ -0,0 +1,198 @@
+/**
+\file   scene_file_bench.cpp
+\author Andrew Baxter
+\date   March 30, 2016
+
+Compares loading a scene from the mapped binary format against parsing the same scene from JSON text
+
+*/
+
+#include "benchmarks.h"
+#include <scene.h>
+#include <glm/glm/gtc/quaternion.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t numIterations = 5;
+	const char *binaryFile = "scene_bench.bscn";
+	const char *textFile = "scene_bench.json";
+
+	struct Transform
+	{
+		glm::vec3 position;
+		float scale;
+		glm::quat rotation;
+	};
+
+	struct LocalBounds
+	{
+		glm::vec3 center;
+		glm::vec3 extents;
+	};
+
+	void Populate(Scene &scene, uint32_t count)
+	{
+		uint32_t seed = 12345;
+		auto random = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return (seed >> 8) / float(1 << 24);
+		};
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Transform transform = { glm::vec3(random(), random(), random()) * 1000.0f, 0.5f + random(),
+				glm::normalize(glm::quat(random(), random(), random(), random())) };
+			scene.Create(transform, LocalBounds{ glm::vec3(0.0f), glm::vec3(random(), random(), random()) });
+		}
+	}
+
+	void WriteText(Scene &scene)
+	{
+		FILE *file = fopen(textFile, "w");
+		fprintf(file, "[\n");
+		scene.ForEach<Transform, LocalBounds>([&](Entity, Transform &t, LocalBounds &b) {
+			fprintf(file, "{\"position\":[%.9g,%.9g,%.9g],\"scale\":%.9g,\"rotation\":[%.9g,%.9g,%.9g,%.9g],"
+				"\"center\":[%.9g,%.9g,%.9g],\"extents\":[%.9g,%.9g,%.9g]},\n",
+				t.position.x, t.position.y, t.position.z, t.scale, t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w,
+				b.center.x, b.center.y, b.center.z, b.extents.x, b.extents.y, b.extents.z);
+		});
+		fprintf(file, "{}]\n");
+		fclose(file);
+	}
+
+	//The baseline: read the whole file, then pull out each entity's 14 numbers in order
+	void LoadText(Scene &scene)
+	{
+		scene.Clear();
+		FILE *file = fopen(textFile, "rb");
+		fseek(file, 0, SEEK_END);
+		std::string text(static_cast<size_t>(ftell(file)), '\0');
+		fseek(file, 0, SEEK_SET);
+		fread(&text[0], 1, text.size(), file);
+		fclose(file);
+
+		const char *cursor = text.c_str();
+		float values[14];
+		for (;;)
+		{
+			cursor = strchr(cursor, '{');
+			if (!cursor || cursor[1] == '}')
+				break;
+
+			for (auto &iter : values)
+			{
+				cursor += strcspn(cursor, "-0123456789"); //Keys never contain digits
+				char *end;
+				iter = strtof(cursor, &end);
+				cursor = end;
+			}
+			Transform transform = { glm::vec3(values[0], values[1], values[2]), values[3], glm::quat(values[7], values[4], values[5], values[6]) };
+			scene.Create(transform, LocalBounds{ glm::vec3(values[8], values[9], values[10]), glm::vec3(values[11], values[12], values[13]) });
+		}
+	}
+
+	//Touches every component, so lazily mapped pages are paid for
+	float Sum(Scene &scene)
+	{
+		float out = 0.0f;
+		scene.ForEach<Transform, LocalBounds>([&](Entity, Transform &t, LocalBounds &b) {
+			out += t.scale + b.extents.x;
+		});
+		return out;
+	}
+
+	void Run(uint32_t count)
+	{
+		{
+			Scene scene;
+			Populate(scene, count);
+			scene.Save(binaryFile);
+			WriteText(scene);
+		}
+
+		Scene scene;
+		float sink = 0.0f;
+		double text = TimeAverage(numIterations, [&] { LoadText(scene); sink += Sum(scene); });
+		double binary = TimeAverage(numIterations, [&] { scene.Load(binaryFile); });
+		double binaryTouched = TimeAverage(numIterations, [&] { scene.Load(binaryFile); sink += Sum(scene); });
+
+		printf("Scene load: %u entities\n", count);
+		printf("  JSON text:               %9.3f ms\n", text * 1e3);
+		printf("  Binary, mapped:          %9.3f ms  %7.1fx\n", binary * 1e3, text / binary);
+		printf("  Binary, every page read: %9.3f ms  %7.1fx  (%g)\n", binaryTouched * 1e3, text / binaryTouched, sink);
+
+		remove(binaryFile);
+		remove(textFile);
+	}
+
+	//Saves a scene with a few destroyed entities, then checks that Load refuses each damaged copy of it
+	void CheckCorruption()
+	{
+		std::vector<uint8_t> original;
+		{
+			Scene scene;
+			Populate(scene, 64);
+			std::vector<Entity> entities;
+			scene.ForEach<Transform>([&](Entity entity, Transform&) { entities.push_back(entity); });
+			for (size_t i = 0; i < entities.size(); i += 8)
+				scene.Destroy(entities[i]);
+			scene.Save(binaryFile);
+
+			FILE *file = fopen(binaryFile, "rb");
+			fseek(file, 0, SEEK_END);
+			original.resize(static_cast<size_t>(ftell(file)));
+			fseek(file, 0, SEEK_SET);
+			fread(original.data(), 1, original.size(), file);
+			fclose(file);
+		}
+
+		using namespace SceneFile;
+		const Section *freeRecords = FindSection(original.data(), SectionType::FreeRecords);
+		const Section *entityTable = FindSection(original.data(), SectionType::Entities, 0);
+		auto freeList = [&](std::vector<uint8_t> &data) { return reinterpret_cast<uint32_t*>(data.data() + freeRecords->offset); };
+		auto entities = [&](std::vector<uint8_t> &data) { return reinterpret_cast<uint32_t*>(data.data() + entityTable->offset); };
+
+		struct Case
+		{
+			const char *name;
+			void(*corrupt)(uint32_t *freeList, uint32_t *entities);
+		};
+		const Case cases[] = {
+			{ "free list entry past the records", [](uint32_t *freeList, uint32_t*) { freeList[0] = 0xFFFFFF; } },
+			{ "free list entry in use", [](uint32_t *freeList, uint32_t *entities) { freeList[0] = entities[0] & 0xFFFFFF; } },
+			{ "free list entry repeated", [](uint32_t *freeList, uint32_t*) { freeList[1] = freeList[0]; } },
+			{ "entities swapped", [](uint32_t*, uint32_t *entities) { std::swap(entities[0], entities[1]); } },
+			{ "entity generation changed", [](uint32_t*, uint32_t *entities) { entities[0] += 1u << 24; } }
+		};
+
+		for (const auto &iter : cases)
+		{
+			std::vector<uint8_t> data = original;
+			iter.corrupt(freeList(data), entities(data));
+			FILE *file = fopen(binaryFile, "wb");
+			fwrite(data.data(), 1, data.size(), file);
+			fclose(file);
+
+			Scene scene;
+			bool loaded = scene.Load(binaryFile, true);
+			printf("Corrupt scene, %-32s %s\n", iter.name, loaded ? "loaded  MISMATCH" : "refused");
+		}
+		remove(binaryFile);
+	}
+}
+
+void BenchSceneLoad()
+{
+	NameComponent<Transform>("Transform");
+	NameComponent<LocalBounds>("LocalBounds");
+
+	CheckCorruption();
+	Run(10000);
+	Run(100000);
+	Run(1000000);
+}
@@ -0,0 +1,96 @@
+/**
+\file   task_graph_bench.cpp
+\author Andrew Baxter
+\date   March 28, 2016
+
+Measures `Basilisk::TaskGraph` throughput in tasks per second, scaling from one thread to every hardware thread
+
+*/
+
+#include "benchmarks.h"
+#include <core/task_graph.h>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t numIterations = 10;
+	constexpr uint32_t taskCost = 256; //Loop iterations of busywork per task
+
+	std::vector<uint32_t> sinks; //One slot per task so nothing is shared between threads
+
+	void Busywork(TaskId id)
+	{
+		uint32_t x = id;
+		for (uint32_t i = 0; i < taskCost; ++i)
+			x = x * 1664525u + 1013904223u;
+		sinks[id] = x;
+	}
+
+	//Every task is a root
+	void BuildIndependent(TaskGraph &graph, uint32_t count)
+	{
+		for (TaskId i = 0; i < count; ++i)
+			graph.Add([=] { Busywork(i); });
+	}
+
+	//Each task waits on two neighbours in the layer above
+	void BuildLayered(TaskGraph &graph, uint32_t width, uint32_t depth)
+	{
+		for (uint32_t i = 0; i < width; ++i)
+			graph.Add([=] { Busywork(i); });
+
+		for (uint32_t layer = 1; layer < depth; ++layer)
+		{
+			TaskId above = (layer - 1) * width;
+			for (uint32_t i = 0; i < width; ++i)
+			{
+				TaskId id = layer * width + i;
+				graph.Add([=] { Busywork(id); }, { above + i, above + (i + 1) % width });
+			}
+		}
+	}
+
+	//Long chains, which only ever run as continuations
+	void BuildChains(TaskGraph &graph, uint32_t numChains, uint32_t length)
+	{
+		for (uint32_t chain = 0; chain < numChains; ++chain)
+		{
+			TaskId prev = graph.Add([=] { Busywork(chain * length); });
+			for (uint32_t i = 1; i < length; ++i)
+			{
+				TaskId id = chain * length + i;
+				prev = graph.Continue(prev, [=] { Busywork(id); });
+			}
+		}
+	}
+
+	void Run(const char *name, const std::function<void(TaskGraph&)> &build)
+	{
+		unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		double baseline = 0.0;
+
+		printf("%s\n", name);
+		for (unsigned threads = 1; threads <= maxThreads; ++threads)
+		{
+			TaskGraph graph(threads);
+			build(graph);
+			sinks.assign(graph.NumTasks(), 0);
+
+			graph.Execute(); //Warm up caches and wake every worker once
+			double seconds = TimeAverage(numIterations, [&] { graph.Execute(); });
+			double tasksPerSec = graph.NumTasks() / seconds;
+			if (threads == 1)
+				baseline = tasksPerSec;
+
+			printf("  %2u threads: %8.2f Mtasks/s  %5.2fx\n", threads, tasksPerSec / 1e6, tasksPerSec / baseline);
+		}
+	}
+}
+
+void BenchTaskGraph()
+{
+	Run("TaskGraph: 65536 independent tasks", [](TaskGraph &graph) { BuildIndependent(graph, 65536); });
+	Run("TaskGraph: 64 layers of 1024 tasks", [](TaskGraph &graph) { BuildLayered(graph, 1024, 64); });
+	Run("TaskGraph: 1024 chains of 64 continuations", [](TaskGraph &graph) { BuildChains(graph, 1024, 64); });
+}
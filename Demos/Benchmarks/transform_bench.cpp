@@ -0,0 +1,129 @@
+/**
+\file   transform_bench.cpp
+\author Andrew Baxter
+\date   April 2, 2016
+
+Measures `Basilisk::TransformHierarchy::Update()` against a plain glm loop, with every transform, a few, or none moving
+
+*/
+
+#include "benchmarks.h"
+#include <core/transform_hierarchy.h>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t numIterations = 10;
+	constexpr uint32_t nodesPerRoot = 1000;
+
+	uint32_t seed = 12345;
+	float Random()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / float(1 << 24);
+	}
+
+	//The baseline: array-of-structures transforms, recomputed every frame with glm
+	struct Node
+	{
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+		uint32_t parent;
+	};
+
+	void UpdateNaive(const std::vector<Node> &nodes, std::vector<glm::mat4> &world)
+	{
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			const Node &node = nodes[i];
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), node.position) * glm::mat4_cast(node.rotation) * glm::scale(glm::mat4(1.0f), node.scale);
+			world[i] = node.parent == invalidTransform ? local : world[node.parent] * local;
+		}
+	}
+
+	void Run(uint32_t count)
+	{
+		TransformHierarchy hierarchy;
+		std::vector<Node> nodes;
+		std::vector<TransformId> ids, roots;
+
+		//A forest of random trees, each with a shallow expected depth
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t parent = invalidTransform;
+			uint32_t root = i - i % nodesPerRoot;
+			if (i != root)
+				parent = root + static_cast<uint32_t>(Random() * (i - root));
+
+			Node node = { glm::vec3(Random(), Random(), Random()), glm::normalize(glm::quat(Random(), Random(), Random(), Random())),
+				glm::vec3(0.9f + Random() * 0.2f), parent };
+			nodes.push_back(node);
+			ids.push_back(hierarchy.Add(parent == invalidTransform ? invalidTransform : ids[parent], node.position, node.rotation, node.scale));
+			if (parent == invalidTransform)
+				roots.push_back(ids.back());
+		}
+		hierarchy.Update();
+
+		std::vector<glm::mat4> world(count);
+		double naive = TimeAverage(numIterations, [&] { UpdateNaive(nodes, world); });
+
+		double full = TimeAverage(numIterations, [&] {
+			for (TransformId root : roots)
+				hierarchy.SetPosition(root, hierarchy.GetPosition(root));
+			hierarchy.Update();
+		});
+
+		std::vector<TransformId> moving;
+		for (uint32_t i = 0; i < count / 100; ++i)
+			moving.push_back(ids[static_cast<uint32_t>(Random() * count)]);
+		double some = TimeAverage(numIterations, [&] {
+			for (TransformId id : moving)
+				hierarchy.SetPosition(id, hierarchy.GetPosition(id));
+			hierarchy.Update();
+		});
+
+		double none = TimeAverage(numIterations, [&] { hierarchy.Update(); });
+
+		printf("TransformHierarchy: %u transforms\n", count);
+		printf("  glm, every frame:      %8.3f ms  %6.2f ns/transform\n", naive * 1e3, naive * 1e9 / count);
+		printf("  SSE, all moving:       %8.3f ms  %6.2f ns/transform  %5.2fx\n", full * 1e3, full * 1e9 / count, naive / full);
+		printf("  SSE, 1%% moving:        %8.3f ms\n", some * 1e3);
+		printf("  SSE, static:           %8.3f ms\n", none * 1e3);
+	}
+
+	//Removing a transform reorders any pending reparenting, which must carry the world matrices along with everything else
+	void CheckRemoveAfterReparent()
+	{
+		TransformHierarchy hierarchy;
+		TransformId a = hierarchy.Add(invalidTransform, glm::vec3(1.0f, 0.0f, 0.0f));
+		TransformId child = hierarchy.Add(a, glm::vec3(0.0f, 2.0f, 0.0f));
+		TransformId b = hierarchy.Add(invalidTransform, glm::vec3(0.0f, 0.0f, 3.0f));
+		TransformId c = hierarchy.Add(invalidTransform, glm::vec3(4.0f, 0.0f, 0.0f));
+		hierarchy.Update();
+
+		const TransformId kept[] = { a, child, c };
+		glm::mat4 before[3];
+		for (int i = 0; i < 3; ++i)
+			before[i] = hierarchy.GetWorld(kept[i]);
+
+		hierarchy.SetParent(a, c);
+		hierarchy.Remove(b);
+		bool match = true;
+		for (int i = 0; i < 3; ++i)
+			match = match && hierarchy.GetWorld(kept[i]) == before[i] && hierarchy.Worlds()[hierarchy.IndexOf(kept[i])] == before[i];
+
+		hierarchy.Update();
+		match = match && hierarchy.GetWorld(child) == glm::translate(glm::mat4(1.0f), glm::vec3(5.0f, 2.0f, 0.0f));
+		printf("TransformHierarchy: world matrices after reparenting and removing%s\n", match ? "" : "  MISMATCH");
+	}
+}
+
+void BenchTransformHierarchy()
+{
+	CheckRemoveAfterReparent();
+	Run(100000);
+	Run(1000000);
+}
@@ -23,23 +23,20 @@ constexpr bool fullScreen = true;
 
 int Dump()
 {
-	OutputDebugString("Errors:\n");
-	if (Basilisk::errors.size() == 0)
-		OutputDebugString("None\n");
-	while (Basilisk::errors.size() > 0)
+	OutputDebugString("Log:\n");
+	Basilisk::LogRecord record;
+	bool empty = true;
+	while (Basilisk::PopLog(record))
 	{
-		OutputDebugString((Basilisk::errors.front() + "\n").c_str());
-		Basilisk::errors.pop();
+		OutputDebugString((Basilisk::FormatLog(record) + "\n").c_str());
+		empty = false;
 	}
-
-	OutputDebugString("Warnings:\n");
-	if (Basilisk::warnings.size() == 0)
+	if (empty)
 		OutputDebugString("None\n");
-	while (Basilisk::warnings.size() > 0)
-	{
-		OutputDebugString((Basilisk::warnings.front() + "\n").c_str());
-		Basilisk::warnings.pop();
-	}
+
+	uint32_t dropped = Basilisk::TakeDroppedLogCount();
+	if (dropped)
+		OutputDebugString((std::to_string(dropped) + " messages were dropped because the log was full\n").c_str());
 
 	return 1;
 }
@@ -0,0 +1,77 @@
+/**
+\file   meshcooker.cpp
+\author Andrew Baxter
+\date   April 6, 2016
+
+Imports a model with assimp and writes it out as a cooked mesh
+
+Usage: MeshCooker <input model> <output mesh>
+
+*/
+
+#include "resources/mesh_cooker.h"
+#include "resources/mesh.h"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <cstdio>
+#pragma comment(lib, "Basilisk.lib")
+#pragma comment(lib, "assimp.lib")
+
+using namespace Basilisk;
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3)
+	{
+		printf("Usage: MeshCooker <input model> <output mesh>\n");
+		return 1;
+	}
+
+	//Everything the cooker expects: one flat list of triangle meshes, with the attributes a lit, textured mesh needs
+	Assimp::Importer importer;
+	const aiScene *scene = importer.ReadFile(argv[1],
+		aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_PreTransformVertices | aiProcess_JoinIdenticalVertices |
+		aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_ValidateDataStructure);
+	if (!scene)
+	{
+		printf("Could not import %s: %s\n", argv[1], importer.GetErrorString());
+		return 1;
+	}
+
+	std::vector<MeshOptimizeStats> stats;
+	if (!CookMesh(*scene, std::string(argv[2]), MeshCookOptions(), &stats))
+	{
+		LogRecord record;
+		while (PopLog(record))
+			printf("%s\n", FormatLog(record).c_str());
+		return 1;
+	}
+
+	printf("Cooked %s into %s\n", argv[1], argv[2]);
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		const MeshOptimizeStats &iter = stats[i];
+		printf("  Submesh %u: ACMR %.3f -> %.3f -> %.3f, ATVR %.3f -> %.3f -> %.3f, overfetch %.2f -> %.2f\n", static_cast<unsigned>(i),
+			iter.original.acmr, iter.vertexCache.acmr, iter.overdraw.acmr, iter.original.atvr, iter.vertexCache.atvr, iter.overdraw.atvr,
+			iter.fetchOriginal.overfetch, iter.fetchOptimized.overfetch);
+	}
+
+	//Read the result back, which also checks it
+	Mesh mesh;
+	if (!mesh.Load(argv[2], true))
+	{
+		printf("Could not load the cooked mesh back\n");
+		return 1;
+	}
+	for (uint32_t i = 0; i < mesh.NumSubmeshes(); ++i)
+	{
+		printf("  Submesh %u: %u triangles", i, mesh.Submeshes()[i].indexCount / 3);
+		for (uint32_t j = 0; j < mesh.NumLods(i); ++j)
+			printf(", LOD %u %u (error %g)", j + 1, mesh.Lods(i)[j].indexCount / 3, mesh.Lods(i)[j].error);
+		if (mesh.NumMeshlets(i) > 0)
+			printf(", %u meshlets", mesh.NumMeshlets(i));
+		printf("\n");
+	}
+	return 0;
+}
@@ -376,6 +376,19 @@ FI_STRUCT (FIICCPROFILE) {
 	void   *data;	//! points to a block of contiguous memory containing the profile
 };
 
+// Bitmap memory support ----------------------------------------------------
+
+/**
+Memory held for bitmap pixels, see FreeImage_GetBitmapMemoryStats
+*/
+FI_STRUCT (FIPOOLSTATS) {
+	size_t	live_bytes;		//! bytes held by bitmaps that haven't been unloaded yet
+	size_t	peak_bytes;		//! highest live_bytes since the start, or since the peak was last reset
+	size_t	pooled_bytes;	//! bytes kept from unloaded bitmaps, for reuse by the next ones
+	size_t	allocations;	//! number of bitmaps allocated
+	size_t	pool_hits;		//! number of those that reused pooled memory
+};
+
 // Important enums ----------------------------------------------------------
 
 /** I/O image format identifiers.
@@ -671,7 +684,15 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define BMP_DEFAULT         0
 #define BMP_SAVE_RLE        1
 #define CUT_DEFAULT         0
-#define DDS_DEFAULT			0
+#define DDS_DEFAULT			0		//! save as DXT1 (BC1), or as DXT5 (BC3) if the image has transparency
+#define DDS_BC1				0x0001	//! save RGB with 1-bit alpha (DXT1)
+#define DDS_BC3				0x0002	//! save RGB with interpolated alpha (DXT5)
+#define DDS_BC4				0x0004	//! save the red channel only
+#define DDS_BC5				0x0008	//! save the red and green channels (e.g. normal maps)
+#define DDS_BC7				0x0010	//! save RGBA in BC7 (much slower, far fewer artifacts)
+#define DDS_MIPMAPS			0x0100	//! save a full mip chain from FreeImage_GenerateMipmaps: filtered in linear light (as stored for BC4/BC5), with a 3-tap filter along odd dimensions
+#define DDS_QUALITY_FAST	0x1000	//! save with the fastest endpoint search
+#define DDS_QUALITY_SLOW	0x2000	//! save with the most thorough endpoint search
 #define EXR_DEFAULT			0		//! save data as half with piz-based wavelet compression
 #define EXR_FLOAT			0x0001	//! save data as float instead of as half (not recommended)
 #define EXR_NONE			0x0002	//! save with no compression
@@ -725,6 +746,7 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define PNG_Z_BEST_COMPRESSION		0x0009	//! save using ZLib level 9 compression flag (default value is 6)
 #define PNG_Z_NO_COMPRESSION		0x0100	//! save without ZLib compression
 #define PNG_INTERLACED				0x0200	//! save using Adam7 interlacing (use | to combine with other save flags)
+#define PNG_Z_PARALLEL				0x0400	//! save non-interlaced images by filtering and compressing bands of rows on every thread (use | to combine with other save flags)
 #define PNM_DEFAULT         0
 #define PNM_SAVE_RAW        0       //! if set the writer saves in RAW format (i.e. P4, P5 or P6)
 #define PNM_SAVE_ASCII      1       //! if set the writer saves in ASCII format (i.e. P1, P2 or P3)
@@ -776,6 +798,15 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define FI_RESCALE_DEFAULT			0x00    //! default options; none of the following other options apply
 #define FI_RESCALE_TRUE_COLOR		0x01	//! for non-transparent greyscale images, convert to 24-bit if src bitdepth <= 8 (default is a 8-bit greyscale image). 
 #define FI_RESCALE_OMIT_METADATA	0x02	//! do not copy metadata to the rescaled image
+#define FI_RESCALE_NO_SIMD			0x04	//! use the portable scalar filters, even where SIMD ones exist
+
+// GenerateMipmaps options ---------------------------------------------------
+// Constants used in FreeImage_GenerateMipmaps
+
+#define FI_MIPMAP_DEFAULT			0x00	//! RGB is sRGB encoded, and filtered in linear light
+#define FI_MIPMAP_LINEAR			0x01	//! RGB is data rather than color (masks, heights, ...), and filtered as stored
+#define FI_MIPMAP_ALPHA_COVERAGE	0x02	//! scale each level's alpha so as many pixels pass the alpha test as at full size
+#define FI_MIPMAP_NORMAL_MAP		0x04	//! RGB is a tangent space normal, renormalized after filtering (implies FI_MIPMAP_LINEAR)
 
 
 #ifdef __cplusplus
@@ -808,6 +839,16 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateT(FREE_IMAGE_TYPE type, int wid
 DLL_API FIBITMAP * DLL_CALLCONV FreeImage_Clone(FIBITMAP *dib);
 DLL_API void DLL_CALLCONV FreeImage_Unload(FIBITMAP *dib);
 
+// Bitmap memory routines ---------------------------------------------------
+
+typedef void *(DLL_CALLCONV *FI_AllocateProc)(size_t size, void *user);
+typedef void (DLL_CALLCONV *FI_DeallocateProc)(void *data, size_t size, void *user);
+
+DLL_API void DLL_CALLCONV FreeImage_SetBitmapAllocator(FI_AllocateProc allocate_proc, FI_DeallocateProc deallocate_proc, void *user FI_DEFAULT(0));
+DLL_API void DLL_CALLCONV FreeImage_SetBitmapPoolSize(size_t max_bytes);
+DLL_API void DLL_CALLCONV FreeImage_ReleaseBitmapPool(void);
+DLL_API void DLL_CALLCONV FreeImage_GetBitmapMemoryStats(FIPOOLSTATS *stats, BOOL reset_peak FI_DEFAULT(FALSE));
+
 // Header loading routines
 DLL_API BOOL DLL_CALLCONV FreeImage_HasPixels(FIBITMAP *dib);
 
@@ -823,6 +864,7 @@ DLL_API BOOL DLL_CALLCONV FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITMAP
 // Memory I/O stream routines -----------------------------------------------
 
 DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMemory(BYTE *data FI_DEFAULT(0), DWORD size_in_bytes FI_DEFAULT(0));
+DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMapped(const char *filename);
 DLL_API void DLL_CALLCONV FreeImage_CloseMemory(FIMEMORY *stream);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags FI_DEFAULT(0));
 DLL_API BOOL DLL_CALLCONV FreeImage_SaveToMemory(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, int flags FI_DEFAULT(0));
@@ -872,6 +914,8 @@ DLL_API FIBITMAP * DLL_CALLCONV FreeImage_LockPage(FIMULTIBITMAP *bitmap, int pa
 DLL_API void DLL_CALLCONV FreeImage_UnlockPage(FIMULTIBITMAP *bitmap, FIBITMAP *data, BOOL changed);
 DLL_API BOOL DLL_CALLCONV FreeImage_MovePage(FIMULTIBITMAP *bitmap, int target, int source);
 DLL_API BOOL DLL_CALLCONV FreeImage_GetLockedPageNumbers(FIMULTIBITMAP *bitmap, int *pages, int *count);
+DLL_API void DLL_CALLCONV FreeImage_SetMultiBitmapCacheSize(size_t max_bytes);
+DLL_API void DLL_CALLCONV FreeImage_SetMultiBitmapPrefetch(unsigned pages);
 
 // Filetype request routines ------------------------------------------------
 
@@ -1103,6 +1147,8 @@ DLL_API BOOL DLL_CALLCONV FreeImage_FlipVertical(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rescale(FIBITMAP *dib, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert FI_DEFAULT(TRUE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleRect(FIBITMAP *dib, int dst_width, int dst_height, int left, int top, int right, int bottom, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+DLL_API unsigned DLL_CALLCONV FreeImage_GetMipmapCount(unsigned width, unsigned height);
+DLL_API DWORD DLL_CALLCONV FreeImage_GenerateMipmaps(FIBITMAP *dib, BYTE *bits, unsigned levels FI_DEFAULT(0), unsigned flags FI_DEFAULT(FI_MIPMAP_DEFAULT), BYTE alpha_ref FI_DEFAULT(128), DWORD *offsets FI_DEFAULT(NULL));
 
 // color manipulation routines (point operations)
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustCurve(FIBITMAP *dib, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
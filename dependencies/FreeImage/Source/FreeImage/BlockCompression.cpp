@@ -0,0 +1,1389 @@
+// ==========================================================
+// BCn block compression
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "BlockCompression.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//   Block representation
+// ----------------------------------------------------------
+
+/**
+A 4x4 block as floats, one array of 16 pixels per channel (R, G, B, A),
+so that four pixels of one channel can be loaded into an SSE register at a time
+*/
+typedef float BlockChannels[4][16];
+
+/**
+Endpoints and palettes hold up to four channels
+*/
+typedef float Color4[4];
+
+static void
+LoadBlock(const BYTE *rgba, BlockChannels block) {
+	for(int i = 0; i < 16; i++) {
+		for(int c = 0; c < 4; c++) {
+			block[c][i] = (float)rgba[i * 4 + c];
+		}
+	}
+}
+
+static inline int
+RoundToInt(float value, int max_value) {
+	return CLAMP((int)(value + 0.5F), 0, max_value);
+}
+
+// ----------------------------------------------------------
+//   Index selection
+// ----------------------------------------------------------
+
+/**
+Picks the nearest palette entry for each pixel, comparing the first CHANNELS channels.
+This is where the encoder spends most of its time, so the SSE2 version tests four pixels at once.
+@param block The pixels
+@param channel The first channel to compare
+@param palette entries colors
+@param indices Receives one index per pixel
+@return The summed squared error over the block
+*/
+template <int CHANNELS> static float
+FitIndices(const BlockChannels block, int channel, const Color4 *palette, int entries, BYTE *indices) {
+#ifdef FREEIMAGE_SSE2
+	__m128 total = _mm_setzero_ps();
+	for(int i = 0; i < 16; i += 4) {
+		__m128 pixels[CHANNELS];
+		for(int c = 0; c < CHANNELS; c++) {
+			pixels[c] = _mm_loadu_ps(&block[channel + c][i]);
+		}
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i best_index = _mm_setzero_si128();
+		for(int e = 0; e < entries; e++) {
+			__m128 distance = _mm_setzero_ps();
+			for(int c = 0; c < CHANNELS; c++) {
+				__m128 delta = _mm_sub_ps(pixels[c], _mm_set1_ps(palette[e][c]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(e)), _mm_andnot_si128(closer, best_index));
+		}
+		total = _mm_add_ps(total, best);
+
+		// pack the four 32-bit indices into bytes
+		best_index = _mm_packs_epi32(best_index, best_index);
+		best_index = _mm_packus_epi16(best_index, best_index);
+		const int packed = _mm_cvtsi128_si32(best_index);
+		memcpy(indices + i, &packed, 4);
+	}
+	float sums[4];
+	_mm_storeu_ps(sums, total);
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+	float total = 0;
+	for(int i = 0; i < 16; i++) {
+		float best = FLT_MAX;
+		for(int e = 0; e < entries; e++) {
+			float distance = 0;
+			for(int c = 0; c < CHANNELS; c++) {
+				const float delta = block[channel + c][i] - palette[e][c];
+				distance += delta * delta;
+			}
+			if(distance < best) {
+				best = distance;
+				indices[i] = (BYTE)e;
+			}
+		}
+		total += best;
+	}
+	return total;
+#endif
+}
+
+// ----------------------------------------------------------
+//   Endpoint selection
+// ----------------------------------------------------------
+
+/**
+Takes the corners of the block's bounding box, flipping channels which fall as the widest channel rises
+so the endpoints lie along the diagonal the pixels actually follow
+*/
+template <int CHANNELS> static void
+BoxEndpoints(const BlockChannels block, int channel, Color4 lo, Color4 hi) {
+	float mean[CHANNELS];
+	int widest = 0;
+	for(int c = 0; c < CHANNELS; c++) {
+		const float *values = block[channel + c];
+		lo[c] = hi[c] = mean[c] = values[0];
+		for(int i = 1; i < 16; i++) {
+			lo[c] = MIN(lo[c], values[i]);
+			hi[c] = MAX(hi[c], values[i]);
+			mean[c] += values[i];
+		}
+		mean[c] /= 16;
+		if(hi[c] - lo[c] > hi[widest] - lo[widest]) {
+			widest = c;
+		}
+	}
+	for(int c = 0; c < CHANNELS; c++) {
+		float covariance = 0;
+		for(int i = 0; i < 16; i++) {
+			covariance += (block[channel + c][i] - mean[c]) * (block[channel + widest][i] - mean[widest]);
+		}
+		if(covariance < 0) {
+			const float swap = lo[c];
+			lo[c] = hi[c];
+			hi[c] = swap;
+		}
+		// inset by 1/16 of the range, since the extremes are rarely worth an exact match
+		const float inset = (hi[c] - lo[c]) / 16;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+}
+
+/**
+Fits a line through the pixels with a few rounds of power iteration on their covariance,
+and takes the endpoints where the outermost pixels project onto it
+*/
+template <int CHANNELS> static void
+AxisEndpoints(const BlockChannels block, int channel, Color4 lo, Color4 hi) {
+	float mean[CHANNELS];
+	float covariance[CHANNELS][CHANNELS];
+	float axis[CHANNELS];
+
+	for(int c = 0; c < CHANNELS; c++) {
+		const float *values = block[channel + c];
+		float low = values[0], high = values[0], sum = 0;
+		for(int i = 0; i < 16; i++) {
+			low = MIN(low, values[i]);
+			high = MAX(high, values[i]);
+			sum += values[i];
+		}
+		mean[c] = sum / 16;
+		axis[c] = high - low;
+	}
+	for(int a = 0; a < CHANNELS; a++) {
+		for(int b = a; b < CHANNELS; b++) {
+			float sum = 0;
+			for(int i = 0; i < 16; i++) {
+				sum += (block[channel + a][i] - mean[a]) * (block[channel + b][i] - mean[b]);
+			}
+			covariance[a][b] = covariance[b][a] = sum;
+		}
+	}
+
+	for(int iteration = 0; iteration < 4; iteration++) {
+		float next[CHANNELS];
+		float length = 0;
+		for(int a = 0; a < CHANNELS; a++) {
+			next[a] = 0;
+			for(int b = 0; b < CHANNELS; b++) {
+				next[a] += covariance[a][b] * axis[b];
+			}
+			length = MAX(length, fabsf(next[a]));
+		}
+		if(length == 0) {
+			break;
+		}
+		for(int c = 0; c < CHANNELS; c++) {
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float length = 0;
+	for(int c = 0; c < CHANNELS; c++) {
+		length += axis[c] * axis[c];
+	}
+	if(length == 0) {
+		// a flat block
+		for(int c = 0; c < CHANNELS; c++) {
+			lo[c] = hi[c] = mean[c];
+		}
+		return;
+	}
+	length = sqrtf(length);
+	for(int c = 0; c < CHANNELS; c++) {
+		axis[c] /= length;
+	}
+
+	float t_min = FLT_MAX, t_max = -FLT_MAX;
+	for(int i = 0; i < 16; i++) {
+		float t = 0;
+		for(int c = 0; c < CHANNELS; c++) {
+			t += (block[channel + c][i] - mean[c]) * axis[c];
+		}
+		t_min = MIN(t_min, t);
+		t_max = MAX(t_max, t);
+	}
+	for(int c = 0; c < CHANNELS; c++) {
+		lo[c] = CLAMP(mean[c] + axis[c] * t_min, 0.0F, 255.0F);
+		hi[c] = CLAMP(mean[c] + axis[c] * t_max, 0.0F, 255.0F);
+	}
+}
+
+/**
+Solves for the endpoints which best reproduce the pixels in the least squares sense,
+given how far along from lo to hi each pixel's index puts it
+@param weights Per palette entry, the fraction of hi in that entry
+@return FALSE if every pixel uses the same weight, leaving the system singular
+*/
+template <int CHANNELS> static BOOL
+SolveEndpoints(const BlockChannels block, int channel, const BYTE *indices, const float *weights, Color4 lo, Color4 hi) {
+	float aa = 0, ab = 0, bb = 0;
+	float ax[CHANNELS], bx[CHANNELS];
+	for(int c = 0; c < CHANNELS; c++) {
+		ax[c] = bx[c] = 0;
+	}
+	for(int i = 0; i < 16; i++) {
+		const float b = weights[indices[i]];
+		const float a = 1 - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for(int c = 0; c < CHANNELS; c++) {
+			ax[c] += a * block[channel + c][i];
+			bx[c] += b * block[channel + c][i];
+		}
+	}
+	const float determinant = aa * bb - ab * ab;
+	if(fabsf(determinant) < 1e-6F) {
+		return FALSE;
+	}
+	for(int c = 0; c < CHANNELS; c++) {
+		lo[c] = CLAMP((ax[c] * bb - bx[c] * ab) / determinant, 0.0F, 255.0F);
+		hi[c] = CLAMP((bx[c] * aa - ax[c] * ab) / determinant, 0.0F, 255.0F);
+	}
+	return TRUE;
+}
+
+template <int CHANNELS> static void
+FindEndpoints(const BlockChannels block, int channel, BC_QUALITY quality, Color4 lo, Color4 hi) {
+	// with alpha in the mix, the box's diagonal rarely follows the pixels, so RGBA always takes the principal axis
+	if(quality == BC_QUALITY_FAST && CHANNELS < 4) {
+		BoxEndpoints<CHANNELS>(block, channel, lo, hi);
+	} else {
+		AxisEndpoints<CHANNELS>(block, channel, lo, hi);
+	}
+}
+
+static int
+RefinementPasses(BC_QUALITY quality) {
+	return (quality == BC_QUALITY_FAST) ? 0 : (quality == BC_QUALITY_NORMAL) ? 1 : 2;
+}
+
+// ----------------------------------------------------------
+//   BC1
+// ----------------------------------------------------------
+
+// Fraction of color1 in each palette entry, in 4-color and 3-color mode
+static const float BC1_WEIGHTS_4[4] = { 0.0F, 1.0F, 1.0F / 3, 2.0F / 3 };
+static const float BC1_WEIGHTS_3[3] = { 0.0F, 1.0F, 0.5F };
+
+static inline WORD
+Quantize565(const Color4 color) {
+	return (WORD)((RoundToInt(color[0] * 31 / 255, 31) << 11) | (RoundToInt(color[1] * 63 / 255, 63) << 5) | RoundToInt(color[2] * 31 / 255, 31));
+}
+
+static inline void
+Expand565(WORD color, Color4 out) {
+	const int r = (color >> 11) & 0x1F, g = (color >> 5) & 0x3F, b = color & 0x1F;
+	out[0] = (float)((r << 3) | (r >> 2));
+	out[1] = (float)((g << 2) | (g >> 4));
+	out[2] = (float)((b << 3) | (b >> 2));
+	out[3] = 255;
+}
+
+/**
+Builds the palette decoders produce from two 565 endpoints
+*/
+static void
+BC1Palette(WORD c0, WORD c1, BOOL four_colors, Color4 *palette) {
+	Expand565(c0, palette[0]);
+	Expand565(c1, palette[1]);
+	for(int c = 0; c < 3; c++) {
+		const int a = (int)palette[0][c], b = (int)palette[1][c];
+		if(four_colors) {
+			palette[2][c] = (float)((2 * a + b) / 3);
+			palette[3][c] = (float)((a + 2 * b) / 3);
+		} else {
+			palette[2][c] = (float)((a + b) / 2);
+			palette[3][c] = 0;
+		}
+	}
+}
+
+/**
+Encodes the color half of a block in one mode, keeping the best of each refinement pass
+@return The squared error of the encoding
+*/
+static float
+EncodeBC1Mode(const BlockChannels block, BC_QUALITY quality, BOOL four_colors, WORD *endpoints, BYTE *indices) {
+	const float *weights = four_colors ? BC1_WEIGHTS_4 : BC1_WEIGHTS_3;
+	const int entries = four_colors ? 4 : 3;
+
+	Color4 lo, hi;
+	FindEndpoints<3>(block, 0, quality, lo, hi);
+
+	float best = FLT_MAX;
+	for(int pass = 0; pass <= RefinementPasses(quality); pass++) {
+		const WORD c0 = Quantize565(lo), c1 = Quantize565(hi);
+		Color4 palette[4];
+		BC1Palette(c0, c1, four_colors, palette);
+		BYTE fitted[16];
+		const float error = FitIndices<3>(block, 0, palette, entries, fitted);
+		if(error < best) {
+			best = error;
+			endpoints[0] = c0;
+			endpoints[1] = c1;
+			memcpy(indices, fitted, 16);
+		}
+		if(!SolveEndpoints<3>(block, 0, fitted, weights, lo, hi)) {
+			break;
+		}
+	}
+	return best;
+}
+
+/**
+Writes endpoints and 2-bit indices, swapping the endpoints if needed so that the decoder picks the intended mode
+*/
+static void
+WriteBC1(WORD c0, WORD c1, BOOL four_colors, BYTE *indices, BYTE *dst) {
+	if(four_colors ? (c0 < c1) : (c0 > c1)) {
+		const WORD swap = c0;
+		c0 = c1;
+		c1 = swap;
+		for(int i = 0; i < 16; i++) {
+			// 0 <-> 1, and in 4-color mode 2 <-> 3; index 3 in 3-color mode is transparent and stays put
+			if(indices[i] < 2 || four_colors) {
+				indices[i] ^= 1;
+			}
+		}
+	} else if(four_colors && c0 == c1) {
+		// decoders see a 3-color block, in which index 3 would be transparent
+		memset(indices, 0, 16);
+	}
+
+	dst[0] = (BYTE)c0;
+	dst[1] = (BYTE)(c0 >> 8);
+	dst[2] = (BYTE)c1;
+	dst[3] = (BYTE)(c1 >> 8);
+	for(int row = 0; row < 4; row++) {
+		const BYTE *index = indices + row * 4;
+		dst[4 + row] = (BYTE)(index[0] | (index[1] << 2) | (index[2] << 4) | (index[3] << 6));
+	}
+}
+
+/**
+Encodes RGB, with pixels whose alpha is below 128 made transparent if allow_transparency is set
+*/
+static void
+EncodeBC1(const BlockChannels source, BYTE *dst, BC_QUALITY quality, BOOL allow_transparency) {
+	BlockChannels block;
+	memcpy(block, source, sizeof(block));
+
+	// transparent pixels are replaced by the mean opaque color, which leaves the principal axis unchanged
+	int transparent = 0;
+	float mean[3] = { 0, 0, 0 };
+	for(int i = 0; i < 16; i++) {
+		if(allow_transparency && block[3][i] < 128) {
+			transparent |= 1 << i;
+		} else {
+			for(int c = 0; c < 3; c++) {
+				mean[c] += block[c][i];
+			}
+		}
+	}
+	if(transparent == 0xFFFF) {
+		static const BYTE clear[8] = { 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+		memcpy(dst, clear, 8);
+		return;
+	}
+	if(transparent) {
+		int opaque = 0;
+		for(int i = 0; i < 16; i++) {
+			opaque += (transparent & (1 << i)) ? 0 : 1;
+		}
+		for(int i = 0; i < 16; i++) {
+			for(int c = 0; c < 3; c++) {
+				block[c][i] = (transparent & (1 << i)) ? mean[c] / (float)opaque : block[c][i];
+			}
+		}
+	}
+
+	WORD endpoints[2];
+	BYTE indices[16];
+	BOOL four_colors = !transparent;
+	float error = EncodeBC1Mode(block, quality, four_colors, endpoints, indices);
+	if(four_colors && quality == BC_QUALITY_SLOW) {
+		// the midpoint of 3-color mode sometimes fits better than either third
+		WORD endpoints3[2];
+		BYTE indices3[16];
+		if(EncodeBC1Mode(block, quality, FALSE, endpoints3, indices3) < error) {
+			four_colors = FALSE;
+			memcpy(endpoints, endpoints3, sizeof(endpoints));
+			memcpy(indices, indices3, sizeof(indices));
+		}
+	}
+	for(int i = 0; i < 16; i++) {
+		if(transparent & (1 << i)) {
+			indices[i] = 3;
+		}
+	}
+	WriteBC1(endpoints[0], endpoints[1], four_colors, indices, dst);
+}
+
+/**
+The color half of BC3, which decoders always read in 4-color mode
+*/
+static void
+EncodeBC3Color(const BlockChannels block, BYTE *dst, BC_QUALITY quality) {
+	WORD endpoints[2];
+	BYTE indices[16];
+	EncodeBC1Mode(block, quality, TRUE, endpoints, indices);
+	WriteBC1(endpoints[0], endpoints[1], TRUE, indices, dst);
+}
+
+// ----------------------------------------------------------
+//   BC4 (also the alpha half of BC3, and each half of BC5)
+// ----------------------------------------------------------
+
+/**
+Builds the palette decoders produce from two endpoints.
+If a0 > a1, six values are interpolated between them; otherwise four are, and the last two entries are 0 and 255.
+*/
+static void
+BC4Palette(int a0, int a1, Color4 *palette) {
+	palette[0][0] = (float)a0;
+	palette[1][0] = (float)a1;
+	if(a0 > a1) {
+		for(int i = 0; i < 6; i++) {
+			palette[i + 2][0] = (float)(((6 - i) * a0 + (1 + i) * a1 + 3) / 7);
+		}
+	} else {
+		for(int i = 0; i < 4; i++) {
+			palette[i + 2][0] = (float)(((4 - i) * a0 + (1 + i) * a1 + 2) / 5);
+		}
+		palette[6][0] = 0;
+		palette[7][0] = 255;
+	}
+}
+
+static float
+TryBC4(const BlockChannels block, int channel, int a0, int a1, int *best_a0, int *best_a1, BYTE *best_indices, float best) {
+	Color4 palette[8];
+	BC4Palette(a0, a1, palette);
+	BYTE indices[16];
+	const float error = FitIndices<1>(block, channel, palette, 8, indices);
+	if(error < best) {
+		*best_a0 = a0;
+		*best_a1 = a1;
+		memcpy(best_indices, indices, 16);
+		return error;
+	}
+	return best;
+}
+
+static void
+EncodeBC4(const BlockChannels block, int channel, BYTE *dst, BC_QUALITY quality) {
+	// fraction of a1 in each palette entry of the 8-value mode
+	static const float weights[8] = { 0.0F, 1.0F, 1.0F / 7, 2.0F / 7, 3.0F / 7, 4.0F / 7, 5.0F / 7, 6.0F / 7 };
+
+	const float *values = block[channel];
+	float low = values[0], high = values[0];
+	float inner_low = 255, inner_high = 0;	// ignoring exact 0 and 255, which the 6-value mode has for free
+	for(int i = 0; i < 16; i++) {
+		low = MIN(low, values[i]);
+		high = MAX(high, values[i]);
+		if(values[i] > 0 && values[i] < 255) {
+			inner_low = MIN(inner_low, values[i]);
+			inner_high = MAX(inner_high, values[i]);
+		}
+	}
+
+	int a0 = (int)high, a1 = (int)low;
+	BYTE indices[16];
+	memset(indices, 0, sizeof(indices));
+	if(a0 != a1) {
+		float error = TryBC4(block, channel, (int)high, (int)low, &a0, &a1, indices, FLT_MAX);
+		if(quality != BC_QUALITY_FAST) {
+			if(inner_low <= inner_high && (low == 0 || high == 255)) {
+				error = TryBC4(block, channel, (int)inner_low, (int)inner_high, &a0, &a1, indices, error);
+			}
+			for(int pass = 0; pass < RefinementPasses(quality) && a0 > a1; pass++) {
+				Color4 lo, hi;
+				if(!SolveEndpoints<1>(block, channel, indices, weights, lo, hi)) {
+					break;
+				}
+				const int r0 = RoundToInt(lo[0], 255), r1 = RoundToInt(hi[0], 255);
+				if(r0 > r1) {
+					error = TryBC4(block, channel, r0, r1, &a0, &a1, indices, error);
+				}
+			}
+		}
+		if(quality == BC_QUALITY_SLOW && a0 > a1) {
+			// nudge each endpoint, since rounding the palette can favour a neighbour
+			const int base0 = a0, base1 = a1;
+			for(int d0 = -1; d0 <= 1; d0++) {
+				for(int d1 = -1; d1 <= 1; d1++) {
+					const int n0 = CLAMP(base0 + d0, 0, 255), n1 = CLAMP(base1 + d1, 0, 255);
+					if(n0 > n1 && (d0 || d1)) {
+						error = TryBC4(block, channel, n0, n1, &a0, &a1, indices, error);
+					}
+				}
+			}
+		}
+	}
+
+	dst[0] = (BYTE)a0;
+	dst[1] = (BYTE)a1;
+	for(int half = 0; half < 2; half++) {
+		DWORD bits = 0;
+		for(int i = 0; i < 8; i++) {
+			bits |= (DWORD)indices[half * 8 + i] << (i * 3);
+		}
+		dst[2 + half * 3] = (BYTE)bits;
+		dst[3 + half * 3] = (BYTE)(bits >> 8);
+		dst[4 + half * 3] = (BYTE)(bits >> 16);
+	}
+}
+
+// ----------------------------------------------------------
+//   BC7
+// ----------------------------------------------------------
+
+// Interpolation weights, out of 64, for 2-bit and 4-bit indices
+static const int BC7_WEIGHTS_2[4] = { 0, 21, 43, 64 };
+static const int BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/**
+Writes fields least significant bit first, as BC7 blocks are laid out
+*/
+class BC7Writer {
+public:
+	BC7Writer(BYTE *dst) : m_dst(dst), m_position(0) {
+		memset(m_dst, 0, 16);
+	}
+
+	void Put(unsigned value, unsigned bits) {
+		for(unsigned i = 0; i < bits; i++, m_position++) {
+			m_dst[m_position >> 3] |= (BYTE)(((value >> i) & 1) << (m_position & 7));
+		}
+	}
+
+private:
+	BYTE *m_dst;
+	unsigned m_position;
+};
+
+static void
+BC7Palette(const int *e0, const int *e1, int channels, const int *weights, int entries, Color4 *palette) {
+	for(int i = 0; i < entries; i++) {
+		for(int c = 0; c < channels; c++) {
+			palette[i][c] = (float)(((64 - weights[i]) * e0[c] + weights[i] * e1[c] + 32) >> 6);
+		}
+	}
+}
+
+/**
+Mode 6: one RGBA line with 7-bit endpoints plus a shared-per-endpoint low bit, and 4-bit indices
+*/
+struct BC7Mode6 {
+	int endpoints[2][4];	// 7 bits each
+	int pbits[2];
+	BYTE indices[16];
+	float error;
+};
+
+/**
+Picks the 7-bit values and low bit which land closest to an ideal 8-bit endpoint
+*/
+static void
+QuantizeMode6(const Color4 color, int *quantized, int *pbit) {
+	float best = FLT_MAX;
+	for(int p = 0; p < 2; p++) {
+		int candidate[4];
+		float error = 0;
+		for(int c = 0; c < 4; c++) {
+			candidate[c] = RoundToInt((color[c] - p) / 2, 127);
+			const float delta = (float)((candidate[c] << 1) | p) - color[c];
+			error += delta * delta;
+		}
+		if(error < best) {
+			best = error;
+			*pbit = p;
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+static float
+FitMode6(const BlockChannels block, const int (*endpoints)[4], const int *pbits, BYTE *indices) {
+	int e0[4], e1[4];
+	for(int c = 0; c < 4; c++) {
+		e0[c] = (endpoints[0][c] << 1) | pbits[0];
+		e1[c] = (endpoints[1][c] << 1) | pbits[1];
+	}
+	Color4 palette[16];
+	BC7Palette(e0, e1, 4, BC7_WEIGHTS_4, 16, palette);
+	return FitIndices<4>(block, 0, palette, 16, indices);
+}
+
+static void
+EncodeMode6(const BlockChannels block, BC_QUALITY quality, BC7Mode6 &out) {
+	float weights[16];
+	for(int i = 0; i < 16; i++) {
+		weights[i] = BC7_WEIGHTS_4[i] / 64.0F;
+	}
+
+	Color4 lo, hi;
+	FindEndpoints<4>(block, 0, quality, lo, hi);
+	out.error = FLT_MAX;
+	for(int pass = 0; pass <= RefinementPasses(quality); pass++) {
+		BC7Mode6 candidate;
+		QuantizeMode6(lo, candidate.endpoints[0], &candidate.pbits[0]);
+		QuantizeMode6(hi, candidate.endpoints[1], &candidate.pbits[1]);
+		candidate.error = FitMode6(block, candidate.endpoints, candidate.pbits, candidate.indices);
+		if(candidate.error < out.error) {
+			out = candidate;
+		}
+		if(!SolveEndpoints<4>(block, 0, candidate.indices, weights, lo, hi)) {
+			break;
+		}
+	}
+
+	if(quality == BC_QUALITY_SLOW) {
+		// the low bits were chosen per endpoint; the other combinations sometimes fit the whole block better
+		for(int p = 0; p < 4; p++) {
+			BC7Mode6 candidate = out;
+			candidate.pbits[0] = p & 1;
+			candidate.pbits[1] = p >> 1;
+			if(candidate.pbits[0] == out.pbits[0] && candidate.pbits[1] == out.pbits[1]) {
+				continue;
+			}
+			candidate.error = FitMode6(block, candidate.endpoints, candidate.pbits, candidate.indices);
+			if(candidate.error < out.error) {
+				out = candidate;
+			}
+		}
+	}
+}
+
+static void
+WriteMode6(BC7Mode6 &mode, BYTE *dst) {
+	// the first index is stored with its top bit implied to be 0
+	if(mode.indices[0] & 8) {
+		for(int c = 0; c < 4; c++) {
+			const int swap = mode.endpoints[0][c];
+			mode.endpoints[0][c] = mode.endpoints[1][c];
+			mode.endpoints[1][c] = swap;
+		}
+		const int swap = mode.pbits[0];
+		mode.pbits[0] = mode.pbits[1];
+		mode.pbits[1] = swap;
+		for(int i = 0; i < 16; i++) {
+			mode.indices[i] = (BYTE)(15 - mode.indices[i]);
+		}
+	}
+
+	BC7Writer writer(dst);
+	writer.Put(1 << 6, 7);
+	for(int c = 0; c < 4; c++) {
+		writer.Put(mode.endpoints[0][c], 7);
+		writer.Put(mode.endpoints[1][c], 7);
+	}
+	writer.Put(mode.pbits[0], 1);
+	writer.Put(mode.pbits[1], 1);
+	writer.Put(mode.indices[0], 3);
+	for(int i = 1; i < 16; i++) {
+		writer.Put(mode.indices[i], 4);
+	}
+}
+
+/**
+Mode 5: an RGB line with 7-bit endpoints and a separate 8-bit line for the fourth channel, each with 2-bit indices.
+The rotation swaps alpha with one color channel first, so that channel gets its own line instead.
+*/
+struct BC7Mode5 {
+	int rotation;
+	int color[2][3];	// 7 bits each
+	int alpha[2];		// 8 bits each
+	BYTE color_indices[16];
+	BYTE alpha_indices[16];
+	float error;
+};
+
+static void
+EncodeMode5(const BlockChannels source, int rotation, BC_QUALITY quality, BC7Mode5 &out) {
+	float weights[4];
+	for(int i = 0; i < 4; i++) {
+		weights[i] = BC7_WEIGHTS_2[i] / 64.0F;
+	}
+
+	BlockChannels block;
+	memcpy(block, source, sizeof(block));
+	if(rotation) {
+		for(int i = 0; i < 16; i++) {
+			const float swap = block[3][i];
+			block[3][i] = block[rotation - 1][i];
+			block[rotation - 1][i] = swap;
+		}
+	}
+	out.rotation = rotation;
+
+	// the color line
+	Color4 lo, hi;
+	FindEndpoints<3>(block, 0, quality, lo, hi);
+	float color_error = FLT_MAX;
+	for(int pass = 0; pass <= RefinementPasses(quality); pass++) {
+		int quantized[2][3], e0[3], e1[3];
+		for(int c = 0; c < 3; c++) {
+			quantized[0][c] = RoundToInt(lo[c] * 127 / 255, 127);
+			quantized[1][c] = RoundToInt(hi[c] * 127 / 255, 127);
+			e0[c] = (quantized[0][c] << 1) | (quantized[0][c] >> 6);
+			e1[c] = (quantized[1][c] << 1) | (quantized[1][c] >> 6);
+		}
+		Color4 palette[4];
+		BC7Palette(e0, e1, 3, BC7_WEIGHTS_2, 4, palette);
+		BYTE indices[16];
+		const float error = FitIndices<3>(block, 0, palette, 4, indices);
+		if(error < color_error) {
+			color_error = error;
+			memcpy(out.color, quantized, sizeof(quantized));
+			memcpy(out.color_indices, indices, 16);
+		}
+		if(!SolveEndpoints<3>(block, 0, indices, weights, lo, hi)) {
+			break;
+		}
+	}
+
+	// the scalar line
+	float alpha_error = FLT_MAX;
+	lo[0] = hi[0] = block[3][0];
+	for(int i = 1; i < 16; i++) {
+		lo[0] = MIN(lo[0], block[3][i]);
+		hi[0] = MAX(hi[0], block[3][i]);
+	}
+	for(int pass = 0; pass <= RefinementPasses(quality); pass++) {
+		int e0 = RoundToInt(lo[0], 255), e1 = RoundToInt(hi[0], 255);
+		Color4 palette[4];
+		BC7Palette(&e0, &e1, 1, BC7_WEIGHTS_2, 4, palette);
+		BYTE indices[16];
+		const float error = FitIndices<1>(block, 3, palette, 4, indices);
+		if(error < alpha_error) {
+			alpha_error = error;
+			out.alpha[0] = e0;
+			out.alpha[1] = e1;
+			memcpy(out.alpha_indices, indices, 16);
+		}
+		if(!SolveEndpoints<1>(block, 3, indices, weights, lo, hi)) {
+			break;
+		}
+	}
+	out.error = color_error + alpha_error;
+}
+
+static void
+WriteMode5(BC7Mode5 &mode, BYTE *dst) {
+	if(mode.color_indices[0] & 2) {
+		for(int c = 0; c < 3; c++) {
+			const int swap = mode.color[0][c];
+			mode.color[0][c] = mode.color[1][c];
+			mode.color[1][c] = swap;
+		}
+		for(int i = 0; i < 16; i++) {
+			mode.color_indices[i] = (BYTE)(3 - mode.color_indices[i]);
+		}
+	}
+	if(mode.alpha_indices[0] & 2) {
+		const int swap = mode.alpha[0];
+		mode.alpha[0] = mode.alpha[1];
+		mode.alpha[1] = swap;
+		for(int i = 0; i < 16; i++) {
+			mode.alpha_indices[i] = (BYTE)(3 - mode.alpha_indices[i]);
+		}
+	}
+
+	BC7Writer writer(dst);
+	writer.Put(1 << 5, 6);
+	writer.Put(mode.rotation, 2);
+	for(int c = 0; c < 3; c++) {
+		writer.Put(mode.color[0][c], 7);
+		writer.Put(mode.color[1][c], 7);
+	}
+	writer.Put(mode.alpha[0], 8);
+	writer.Put(mode.alpha[1], 8);
+	writer.Put(mode.color_indices[0], 1);
+	for(int i = 1; i < 16; i++) {
+		writer.Put(mode.color_indices[i], 2);
+	}
+	writer.Put(mode.alpha_indices[0], 1);
+	for(int i = 1; i < 16; i++) {
+		writer.Put(mode.alpha_indices[i], 2);
+	}
+}
+
+/**
+Uses mode 6 for every block, and at the slow setting also tries each rotation of mode 5,
+which keeps alpha (or one color channel) from fighting the others for index precision
+*/
+static void
+EncodeBC7(const BlockChannels block, BYTE *dst, BC_QUALITY quality) {
+	BC7Mode6 mode6;
+	EncodeMode6(block, quality, mode6);
+
+	if(quality == BC_QUALITY_SLOW && mode6.error > 0) {
+		BC7Mode5 best = {};
+		best.error = FLT_MAX;
+		for(int rotation = 0; rotation < 4; rotation++) {
+			BC7Mode5 candidate;
+			EncodeMode5(block, rotation, quality, candidate);
+			if(candidate.error < best.error) {
+				best = candidate;
+			}
+		}
+		if(best.error < mode6.error) {
+			WriteMode5(best, dst);
+			return;
+		}
+	}
+	WriteMode6(mode6, dst);
+}
+
+
+// ----------------------------------------------------------
+//   Decoding helpers
+// ----------------------------------------------------------
+
+static inline DWORD
+PackPixel(int r, int g, int b, int a) {
+	return ((DWORD)r << FI_RGBA_RED_SHIFT) | ((DWORD)g << FI_RGBA_GREEN_SHIFT) | ((DWORD)b << FI_RGBA_BLUE_SHIFT) | ((DWORD)a << FI_RGBA_ALPHA_SHIFT);
+}
+
+/**
+Looks up 16 pixels in a palette of up to four colors.
+The SSE2 version compares a whole row of indices against each entry, and keeps the matching color.
+*/
+static void
+SelectPixels(const BYTE *indices, const DWORD *palette, int entries, DWORD *pixels) {
+#ifdef FREEIMAGE_SSE2
+	for(int row = 0; row < 4; row++) {
+		const __m128i index = _mm_set_epi32(indices[row * 4 + 3], indices[row * 4 + 2], indices[row * 4 + 1], indices[row * 4]);
+		__m128i result = _mm_setzero_si128();
+		for(int e = 0; e < entries; e++) {
+			const __m128i match = _mm_cmpeq_epi32(index, _mm_set1_epi32(e));
+			result = _mm_or_si128(result, _mm_and_si128(match, _mm_set1_epi32((int)palette[e])));
+		}
+		_mm_storeu_si128((__m128i*)(pixels + row * 4), result);
+	}
+#else
+	for(int i = 0; i < 16; i++) {
+		pixels[i] = palette[indices[i]];
+	}
+#endif
+}
+
+/**
+Looks up 16 single-channel values in a palette, and replaces that channel of the pixels with them.
+The SSE2 version matches all 16 indices against each entry at once.
+@param shift The channel, as FI_RGBA_*_SHIFT
+*/
+static void
+SelectChannel(const BYTE *indices, const BYTE *palette, int entries, int shift, DWORD *pixels) {
+#ifdef FREEIMAGE_SSE2
+	const __m128i index = _mm_loadu_si128((const __m128i*)indices);
+	__m128i values = _mm_setzero_si128();
+	for(int e = 0; e < entries; e++) {
+		const __m128i match = _mm_cmpeq_epi8(index, _mm_set1_epi8((char)e));
+		values = _mm_or_si128(values, _mm_and_si128(match, _mm_set1_epi8((char)palette[e])));
+	}
+
+	// widen the 16 bytes to 16 dwords, and move them into place
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i keep = _mm_set1_epi32((int)~((DWORD)0xFF << shift));
+	const __m128i low = _mm_unpacklo_epi8(values, zero);
+	const __m128i high = _mm_unpackhi_epi8(values, zero);
+	const __m128i widened[4] = {
+		_mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+		_mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)
+	};
+	for(int row = 0; row < 4; row++) {
+		__m128i *dst = (__m128i*)(pixels + row * 4);
+		const __m128i channel = _mm_sll_epi32(widened[row], _mm_cvtsi32_si128(shift));
+		_mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(dst), keep), channel));
+	}
+#else
+	for(int i = 0; i < 16; i++) {
+		pixels[i] = (pixels[i] & ~((DWORD)0xFF << shift)) | ((DWORD)palette[indices[i]] << shift);
+	}
+#endif
+}
+
+// ----------------------------------------------------------
+//   BC1 to BC5 decoding
+// ----------------------------------------------------------
+
+/**
+Decodes the color half of BC1, BC2 and BC3 blocks.
+As FreeImage always has, BC2 and BC3 blocks with c0 <= c1 get the 3-color palette too.
+*/
+static void
+DecodeBC1(const BYTE *src, DWORD *pixels) {
+	const WORD c0 = (WORD)(src[0] | (src[1] << 8));
+	const WORD c1 = (WORD)(src[2] | (src[3] << 8));
+
+	Color4 endpoints[2];
+	Expand565(c0, endpoints[0]);
+	Expand565(c1, endpoints[1]);
+	const int r0 = (int)endpoints[0][0], g0 = (int)endpoints[0][1], b0 = (int)endpoints[0][2];
+	const int r1 = (int)endpoints[1][0], g1 = (int)endpoints[1][1], b1 = (int)endpoints[1][2];
+
+	DWORD palette[4];
+	palette[0] = PackPixel(r0, g0, b0, 0xFF);
+	palette[1] = PackPixel(r1, g1, b1, 0xFF);
+	if(c0 > c1) {
+		palette[2] = PackPixel((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 0xFF);
+		palette[3] = PackPixel((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 0xFF);
+	} else {
+		palette[2] = PackPixel((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 0xFF);
+		palette[3] = 0;
+	}
+
+	BYTE indices[16];
+	for(int i = 0; i < 16; i++) {
+		indices[i] = (BYTE)((src[4 + (i >> 2)] >> ((i & 3) * 2)) & 3);
+	}
+	SelectPixels(indices, palette, 4, pixels);
+}
+
+/**
+Decodes the explicit 4-bit alpha of a BC2 block
+*/
+static void
+DecodeBC2Alpha(const BYTE *src, DWORD *pixels) {
+	static const BYTE palette[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+	BYTE indices[16];
+	for(int i = 0; i < 16; i++) {
+		indices[i] = (BYTE)((src[i >> 1] >> ((i & 1) * 4)) & 0xF);
+	}
+	SelectChannel(indices, palette, 16, FI_RGBA_ALPHA_SHIFT, pixels);
+}
+
+/**
+Decodes a BC4 block, either half of BC5, or the alpha half of BC3, into one channel of the pixels
+*/
+static void
+DecodeBC4(const BYTE *src, int shift, DWORD *pixels) {
+	Color4 values[8];
+	BC4Palette(src[0], src[1], values);
+	BYTE palette[8];
+	for(int i = 0; i < 8; i++) {
+		palette[i] = (BYTE)values[i][0];
+	}
+
+	BYTE indices[16];
+	for(int half = 0; half < 2; half++) {
+		const DWORD bits = src[2 + half * 3] | (src[3 + half * 3] << 8) | (src[4 + half * 3] << 16);
+		for(int i = 0; i < 8; i++) {
+			indices[half * 8 + i] = (BYTE)((bits >> (i * 3)) & 7);
+		}
+	}
+	SelectChannel(indices, palette, 8, shift, pixels);
+}
+
+// ----------------------------------------------------------
+//   BC7 decoding
+// ----------------------------------------------------------
+
+/**
+How each of the eight BC7 modes lays out its block
+*/
+typedef struct tagBC7ModeInfo {
+	int subsets;
+	int partition_bits;
+	int rotation_bits;
+	int selector_bits;		// mode 4's choice of which index set goes with color
+	int color_bits;
+	int alpha_bits;
+	int endpoint_pbits;		// one low bit per endpoint
+	int shared_pbits;		// one low bit per subset
+	int index_bits;
+	int index2_bits;		// a second, separate set of indices for alpha
+} BC7ModeInfo;
+
+static const BC7ModeInfo BC7_MODES[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+static const int BC7_WEIGHTS_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+// For each 2-subset partition, bit i is set if pixel i is in the second subset
+static const WORD BC7_PARTITIONS_2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+// The subset of each pixel, for each 3-subset partition
+static const BYTE BC7_PARTITIONS_3[64][16] = {
+	{ 0,0,1,1, 0,0,1,1, 0,2,2,1, 2,2,2,2 }, { 0,0,0,1, 0,0,1,1, 2,2,1,1, 2,2,2,1 },
+	{ 0,0,0,0, 2,0,0,1, 2,2,1,1, 2,2,1,1 }, { 0,2,2,2, 0,0,2,2, 0,0,1,1, 0,1,1,1 },
+	{ 0,0,0,0, 0,0,0,0, 1,1,2,2, 1,1,2,2 }, { 0,0,1,1, 0,0,1,1, 0,0,2,2, 0,0,2,2 },
+	{ 0,0,2,2, 0,0,2,2, 1,1,1,1, 1,1,1,1 }, { 0,0,1,1, 0,0,1,1, 2,2,1,1, 2,2,1,1 },
+	{ 0,0,0,0, 0,0,0,0, 1,1,1,1, 2,2,2,2 }, { 0,0,0,0, 1,1,1,1, 1,1,1,1, 2,2,2,2 },
+	{ 0,0,0,0, 1,1,1,1, 2,2,2,2, 2,2,2,2 }, { 0,0,1,2, 0,0,1,2, 0,0,1,2, 0,0,1,2 },
+	{ 0,1,1,2, 0,1,1,2, 0,1,1,2, 0,1,1,2 }, { 0,1,2,2, 0,1,2,2, 0,1,2,2, 0,1,2,2 },
+	{ 0,0,1,1, 0,1,1,2, 1,1,2,2, 1,2,2,2 }, { 0,0,1,1, 2,0,0,1, 2,2,0,0, 2,2,2,0 },
+	{ 0,0,0,1, 0,0,1,1, 0,1,1,2, 1,1,2,2 }, { 0,1,1,1, 0,0,1,1, 2,0,0,1, 2,2,0,0 },
+	{ 0,0,0,0, 1,1,2,2, 1,1,2,2, 1,1,2,2 }, { 0,0,2,2, 0,0,2,2, 0,0,2,2, 1,1,1,1 },
+	{ 0,1,1,1, 0,1,1,1, 0,2,2,2, 0,2,2,2 }, { 0,0,0,1, 0,0,0,1, 2,2,2,1, 2,2,2,1 },
+	{ 0,0,0,0, 0,0,1,1, 0,1,2,2, 0,1,2,2 }, { 0,0,0,0, 1,1,0,0, 2,2,1,0, 2,2,1,0 },
+	{ 0,1,2,2, 0,1,2,2, 0,0,1,1, 0,0,0,0 }, { 0,0,1,2, 0,0,1,2, 1,1,2,2, 2,2,2,2 },
+	{ 0,1,1,0, 1,2,2,1, 1,2,2,1, 0,1,1,0 }, { 0,0,0,0, 0,1,1,0, 1,2,2,1, 1,2,2,1 },
+	{ 0,0,2,2, 1,1,0,2, 1,1,0,2, 0,0,2,2 }, { 0,1,1,0, 0,1,1,0, 2,0,0,2, 2,2,2,2 },
+	{ 0,0,1,1, 0,1,2,2, 0,1,2,2, 0,0,1,1 }, { 0,0,0,0, 2,0,0,0, 2,2,1,1, 2,2,2,1 },
+	{ 0,0,0,0, 0,0,0,2, 1,1,2,2, 1,2,2,2 }, { 0,2,2,2, 0,0,2,2, 0,0,1,2, 0,0,1,1 },
+	{ 0,0,1,1, 0,0,1,2, 0,0,2,2, 0,2,2,2 }, { 0,1,2,0, 0,1,2,0, 0,1,2,0, 0,1,2,0 },
+	{ 0,0,0,0, 1,1,1,1, 2,2,2,2, 0,0,0,0 }, { 0,1,2,0, 1,2,0,1, 2,0,1,2, 0,1,2,0 },
+	{ 0,1,2,0, 2,0,1,2, 1,2,0,1, 0,1,2,0 }, { 0,0,1,1, 2,2,0,0, 1,1,2,2, 0,0,1,1 },
+	{ 0,0,1,1, 1,1,2,2, 2,2,0,0, 0,0,1,1 }, { 0,1,0,1, 0,1,0,1, 2,2,2,2, 2,2,2,2 },
+	{ 0,0,0,0, 0,0,0,0, 2,1,2,1, 2,1,2,1 }, { 0,0,2,2, 1,1,2,2, 0,0,2,2, 1,1,2,2 },
+	{ 0,0,2,2, 0,0,1,1, 0,0,2,2, 0,0,1,1 }, { 0,2,2,0, 1,2,2,1, 0,2,2,0, 1,2,2,1 },
+	{ 0,1,0,1, 2,2,2,2, 2,2,2,2, 0,1,0,1 }, { 0,0,0,0, 2,1,2,1, 2,1,2,1, 2,1,2,1 },
+	{ 0,1,0,1, 0,1,0,1, 0,1,0,1, 2,2,2,2 }, { 0,2,2,2, 0,1,1,1, 0,2,2,2, 0,1,1,1 },
+	{ 0,0,0,2, 1,1,1,2, 0,0,0,2, 1,1,1,2 }, { 0,0,0,0, 2,1,1,2, 2,1,1,2, 2,1,1,2 },
+	{ 0,2,2,2, 0,1,1,1, 0,1,1,1, 0,2,2,2 }, { 0,0,0,2, 1,1,1,2, 1,1,1,2, 0,0,0,2 },
+	{ 0,1,1,0, 0,1,1,0, 0,1,1,0, 2,2,2,2 }, { 0,0,0,0, 0,0,0,0, 2,1,1,2, 2,1,1,2 },
+	{ 0,1,1,0, 0,1,1,0, 2,2,2,2, 2,2,2,2 }, { 0,0,2,2, 0,0,1,1, 0,0,1,1, 0,0,2,2 },
+	{ 0,0,2,2, 1,1,2,2, 1,1,2,2, 0,0,2,2 }, { 0,0,0,0, 0,0,0,0, 0,0,0,0, 2,1,1,2 },
+	{ 0,0,0,2, 0,0,0,1, 0,0,0,2, 0,0,0,1 }, { 0,2,2,2, 1,2,2,2, 0,2,2,2, 1,2,2,2 },
+	{ 0,1,0,1, 2,2,2,2, 2,2,2,2, 2,2,2,2 }, { 0,1,1,1, 2,0,1,1, 2,2,0,1, 2,2,2,0 }
+};
+
+// The pixel whose index has an implied top bit of 0, for the second subset of 2-subset partitions,
+// and for the second and third subsets of 3-subset partitions
+static const BYTE BC7_ANCHORS_2[64] = {
+	15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+	15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+	15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+	 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15
+};
+static const BYTE BC7_ANCHORS_3A[64] = {
+	 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+	 3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+	 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+	 3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3
+};
+static const BYTE BC7_ANCHORS_3B[64] = {
+	15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+	15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+	15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+	15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8
+};
+
+/**
+Reads fields least significant bit first, shifting the whole block down as it goes
+*/
+class BC7Reader {
+public:
+	BC7Reader(const BYTE *src) : m_low(0), m_high(0) {
+		for(int i = 7; i >= 0; i--) {
+			m_low = (m_low << 8) | src[i];
+			m_high = (m_high << 8) | src[i + 8];
+		}
+	}
+
+	unsigned Get(unsigned bits) {
+		if(!bits) {
+			return 0;
+		}
+		const unsigned value = (unsigned)(m_low & ((1ULL << bits) - 1));
+		m_low = (m_low >> bits) | (m_high << (64 - bits));
+		m_high >>= bits;
+		return value;
+	}
+
+private:
+	UINT64 m_low;
+	UINT64 m_high;
+};
+
+static const int*
+BC7Weights(int bits) {
+	return (bits == 2) ? BC7_WEIGHTS_2 : (bits == 3) ? BC7_WEIGHTS_3 : BC7_WEIGHTS_4;
+}
+
+static void
+DecodeBC7(const BYTE *src, DWORD *pixels) {
+	int mode = 0;
+	while(mode < 8 && !(src[0] & (1 << mode))) {
+		mode++;
+	}
+	if(mode == 8) {
+		// reserved, decoded as transparent black
+		memset(pixels, 0, 16 * sizeof(DWORD));
+		return;
+	}
+
+	const BC7ModeInfo &info = BC7_MODES[mode];
+	BC7Reader reader(src);
+	reader.Get(mode + 1);
+	const unsigned partition = reader.Get(info.partition_bits);
+	const unsigned rotation = reader.Get(info.rotation_bits);
+	const unsigned selector = reader.Get(info.selector_bits);
+
+	// endpoints, channel by channel, then the low bits
+	int endpoints[6][4];
+	const int endpoint_count = info.subsets * 2;
+	for(int c = 0; c < 4; c++) {
+		const int bits = (c < 3) ? info.color_bits : info.alpha_bits;
+		for(int e = 0; e < endpoint_count; e++) {
+			endpoints[e][c] = bits ? (int)reader.Get(bits) : 0xFF;
+		}
+	}
+	int pbits[6] = { 0, 0, 0, 0, 0, 0 };
+	if(info.endpoint_pbits) {
+		for(int e = 0; e < endpoint_count; e++) {
+			pbits[e] = (int)reader.Get(1);
+		}
+	} else if(info.shared_pbits) {
+		for(int s = 0; s < info.subsets; s++) {
+			pbits[s * 2] = pbits[s * 2 + 1] = (int)reader.Get(1);
+		}
+	}
+	const int has_pbit = info.endpoint_pbits | info.shared_pbits;
+	for(int e = 0; e < endpoint_count; e++) {
+		for(int c = 0; c < 4; c++) {
+			int bits = (c < 3) ? info.color_bits : info.alpha_bits;
+			if(!bits) {
+				continue;
+			}
+			int value = endpoints[e][c];
+			if(has_pbit) {
+				value = (value << 1) | pbits[e];
+				bits++;
+			}
+			// replicate the top bits into the bottom ones
+			value <<= 8 - bits;
+			endpoints[e][c] = value | (value >> bits);
+		}
+	}
+
+	// which subset each pixel is in, and which pixels have an implied top index bit
+	BYTE subsets[16];
+	int anchors = 1;	// bit i set for each anchor pixel
+	for(int i = 0; i < 16; i++) {
+		if(info.subsets == 2) {
+			subsets[i] = (BYTE)((BC7_PARTITIONS_2[partition] >> i) & 1);
+		} else if(info.subsets == 3) {
+			subsets[i] = BC7_PARTITIONS_3[partition][i];
+		} else {
+			subsets[i] = 0;
+		}
+	}
+	if(info.subsets == 2) {
+		anchors |= 1 << BC7_ANCHORS_2[partition];
+	} else if(info.subsets == 3) {
+		anchors |= (1 << BC7_ANCHORS_3A[partition]) | (1 << BC7_ANCHORS_3B[partition]);
+	}
+
+	BYTE indices[16], indices2[16];
+	for(int i = 0; i < 16; i++) {
+		indices[i] = (BYTE)reader.Get(info.index_bits - ((anchors >> i) & 1));
+	}
+	if(info.index2_bits) {
+		for(int i = 0; i < 16; i++) {
+			indices2[i] = (BYTE)reader.Get(info.index2_bits - (i == 0));
+		}
+	}
+
+	// mode 4's selector swaps which set of indices goes with color
+	const BYTE *color_indices = indices;
+	const BYTE *alpha_indices = info.index2_bits ? indices2 : indices;
+	int color_index_bits = info.index_bits;
+	int alpha_index_bits = info.index2_bits ? info.index2_bits : info.index_bits;
+	if(selector) {
+		color_indices = indices2;
+		alpha_indices = indices;
+		color_index_bits = info.index2_bits;
+		alpha_index_bits = info.index_bits;
+	}
+	const int *color_weights = BC7Weights(color_index_bits);
+	const int *alpha_weights = BC7Weights(alpha_index_bits);
+
+	for(int i = 0; i < 16; i++) {
+		const int *e0 = endpoints[subsets[i] * 2];
+		const int *e1 = endpoints[subsets[i] * 2 + 1];
+		int rgba[4];
+		for(int c = 0; c < 4; c++) {
+			const int w = (c < 3) ? color_weights[color_indices[i]] : alpha_weights[alpha_indices[i]];
+			rgba[c] = ((64 - w) * e0[c] + w * e1[c] + 32) >> 6;
+		}
+		if(rotation) {
+			const int swap = rgba[3];
+			rgba[3] = rgba[rotation - 1];
+			rgba[rotation - 1] = swap;
+		}
+		pixels[i] = PackPixel(rgba[0], rgba[1], rgba[2], rgba[3]);
+	}
+}
+
+// ==========================================================
+//   Public functions
+// ==========================================================
+
+unsigned
+BC_GetBlockSize(BC_FORMAT format) {
+	return (format == BC_FORMAT_BC1 || format == BC_FORMAT_BC4) ? 8 : 16;
+}
+
+void
+BC_EncodeBlock(BC_FORMAT format, const BYTE *rgba, BYTE *dst, BC_QUALITY quality) {
+	BlockChannels block;
+	LoadBlock(rgba, block);
+
+	switch(format) {
+		case BC_FORMAT_BC1:
+			EncodeBC1(block, dst, quality, TRUE);
+			break;
+		case BC_FORMAT_BC3:
+			EncodeBC4(block, 3, dst, quality);
+			EncodeBC3Color(block, dst + 8, quality);
+			break;
+		case BC_FORMAT_BC4:
+			EncodeBC4(block, 0, dst, quality);
+			break;
+		case BC_FORMAT_BC5:
+			EncodeBC4(block, 0, dst, quality);
+			EncodeBC4(block, 1, dst + 8, quality);
+			break;
+		case BC_FORMAT_BC7:
+			EncodeBC7(block, dst, quality);
+			break;
+		default:
+			// BC2 is decoding only: leave a transparent black block rather than whatever dst held
+			assert(FALSE);
+			memset(dst, 0, BC_GetBlockSize(format));
+			break;
+	}
+}
+
+void
+BC_DecodeBlock(BC_FORMAT format, const BYTE *src, DWORD *pixels) {
+	switch(format) {
+		case BC_FORMAT_BC1:
+			DecodeBC1(src, pixels);
+			break;
+		case BC_FORMAT_BC2:
+			DecodeBC1(src + 8, pixels);
+			DecodeBC2Alpha(src, pixels);
+			break;
+		case BC_FORMAT_BC3:
+			DecodeBC1(src + 8, pixels);
+			DecodeBC4(src, FI_RGBA_ALPHA_SHIFT, pixels);
+			break;
+		case BC_FORMAT_BC4:
+			for(int i = 0; i < 16; i++) {
+				pixels[i] = PackPixel(0, 0, 0, 0xFF);
+			}
+			DecodeBC4(src, FI_RGBA_RED_SHIFT, pixels);
+			break;
+		case BC_FORMAT_BC5:
+			for(int i = 0; i < 16; i++) {
+				pixels[i] = PackPixel(0, 0, 0, 0xFF);
+			}
+			DecodeBC4(src, FI_RGBA_RED_SHIFT, pixels);
+			DecodeBC4(src + 8, FI_RGBA_GREEN_SHIFT, pixels);
+			break;
+		case BC_FORMAT_BC7:
+			DecodeBC7(src, pixels);
+			break;
+	}
+}
+
+void
+BC_DecompressImage(BC_FORMAT format, const BYTE *src, unsigned width, unsigned height, BYTE *dst, int pitch) {
+	const unsigned blocks_x = (width + 3) / 4;
+	const unsigned blocks_y = (height + 3) / 4;
+	const unsigned block_size = BC_GetBlockSize(format);
+
+	// decoding is much cheaper than encoding, so each thread takes more of the image
+	const int min_rows = (int)MAX(16384 / blocks_x, 1U);
+
+	FreeImage_ParallelFor(0, (int)blocks_y, min_rows, [=](int first, int last) {
+		DWORD pixels[16];
+		for(unsigned by = (unsigned)first; by < (unsigned)last; by++) {
+			const BYTE *block = src + (size_t)by * blocks_x * block_size;
+			const unsigned rows = MIN(height - by * 4, 4U);
+			for(unsigned bx = 0; bx < blocks_x; bx++, block += block_size) {
+				BC_DecodeBlock(format, block, pixels);
+				const unsigned columns = MIN(width - bx * 4, 4U);
+				for(unsigned y = 0; y < rows; y++) {
+					BYTE *row = dst + ((ptrdiff_t)by * 4 + y) * pitch + bx * 16;
+					memcpy(row, pixels + y * 4, columns * sizeof(DWORD));
+				}
+			}
+		}
+	});
+}
+
+void
+BC_CompressImage(BC_FORMAT format, const BYTE *rgba, unsigned width, unsigned height, unsigned pitch, BYTE *dst, BC_QUALITY quality) {
+	const unsigned blocks_x = (width + 3) / 4;
+	const unsigned blocks_y = (height + 3) / 4;
+	const unsigned block_size = BC_GetBlockSize(format);
+
+	// about 4096 blocks per thread, so small mipmaps don't pay for starting threads
+	const int min_rows = (int)MAX(4096 / blocks_x, 1U);
+
+	FreeImage_ParallelFor(0, (int)blocks_y, min_rows, [=](int first, int last) {
+		BYTE pixels[64];
+		for(unsigned by = (unsigned)first; by < (unsigned)last; by++) {
+			BYTE *out = dst + (size_t)by * blocks_x * block_size;
+			for(unsigned bx = 0; bx < blocks_x; bx++, out += block_size) {
+				for(unsigned y = 0; y < 4; y++) {
+					const BYTE *row = rgba + (size_t)MIN(by * 4 + y, height - 1) * pitch;
+					for(unsigned x = 0; x < 4; x++) {
+						memcpy(pixels + (y * 4 + x) * 4, row + MIN(bx * 4 + x, width - 1) * 4, 4);
+					}
+				}
+				BC_EncodeBlock(format, pixels, out, quality);
+			}
+		}
+	});
+}
@@ -0,0 +1,87 @@
+// ==========================================================
+// BCn block compression
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+// ==========================================================
+// Helper functions (see BlockCompression.cpp)
+// ==========================================================
+
+/**
+Block compressed formats, numbered as in Direct3D 10
+*/
+typedef enum {
+	BC_FORMAT_BC1 = 1,	//! 8 bytes per block: RGB with 1-bit alpha (DXT1)
+	BC_FORMAT_BC2 = 2,	//! 16 bytes per block: RGB with explicit 4-bit alpha (DXT3), decoding only
+	BC_FORMAT_BC3 = 3,	//! 16 bytes per block: RGB with interpolated alpha (DXT5)
+	BC_FORMAT_BC4 = 4,	//! 8 bytes per block: the red channel only
+	BC_FORMAT_BC5 = 5,	//! 16 bytes per block: the red and green channels
+	BC_FORMAT_BC7 = 7	//! 16 bytes per block: RGBA, with far fewer artifacts than BC1 or BC3
+} BC_FORMAT;
+
+/**
+How hard the encoder searches for good endpoints
+*/
+typedef enum {
+	BC_QUALITY_FAST = 0,	//! endpoints from each block's bounding box
+	BC_QUALITY_NORMAL = 1,	//! endpoints along each block's principal axis, refined once by least squares
+	BC_QUALITY_SLOW = 2		//! refined twice, with more block modes tried
+} BC_QUALITY;
+
+/**
+Size of one 4x4 block, in bytes
+*/
+unsigned BC_GetBlockSize(BC_FORMAT format);
+
+/**
+Compresses one 4x4 block. BC2 isn't supported, and gives a block of zeros.
+@param rgba 16 pixels in row order, as R, G, B, A bytes
+@param dst BC_GetBlockSize(format) bytes
+*/
+void BC_EncodeBlock(BC_FORMAT format, const BYTE *rgba, BYTE *dst, BC_QUALITY quality);
+
+/**
+Decompresses one 4x4 block.
+BC4 is returned in the red channel and BC5 in red and green, with blue 0 and alpha 0xFF.
+@param src BC_GetBlockSize(format) bytes
+@param pixels 16 pixels in row order, in FreeImage's byte order (see FI_RGBA_RED)
+*/
+void BC_DecodeBlock(BC_FORMAT format, const BYTE *src, DWORD *pixels);
+
+/**
+Decompresses a whole image into 32-bit pixels, spreading block rows over every hardware thread
+@param src ((width + 3) / 4) * ((height + 3) / 4) blocks, row by row
+@param dst The first row of the image, in FreeImage's byte order
+@param pitch Bytes from one row of dst to the next; negative to write a FreeImage dib from its top scanline down
+*/
+void BC_DecompressImage(BC_FORMAT format, const BYTE *src, unsigned width, unsigned height, BYTE *dst, int pitch);
+
+/**
+Compresses a whole image, spreading block rows over every hardware thread.
+Partial blocks at the right and bottom edges are padded by repeating the last column and row.
+@param rgba Top-down image, as R, G, B, A bytes
+@param pitch Bytes from one row of rgba to the next
+@param dst Room for ((width + 3) / 4) * ((height + 3) / 4) blocks, written row by row
+*/
+void BC_CompressImage(BC_FORMAT format, const BYTE *rgba, unsigned width, unsigned height, unsigned pitch, BYTE *dst, BC_QUALITY quality);
+
+#endif // BLOCK_COMPRESSION_H
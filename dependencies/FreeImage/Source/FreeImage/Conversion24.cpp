@@ -25,6 +25,43 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//  SIMD line converters
+// ----------------------------------------------------------
+
+#ifdef FREEIMAGE_SSSE3
+
+/**
+Packs 32-bit pixels down to 24-bit, 16 at a time: four shuffles, three stores.
+Every load of a block comes before its stores, so target may be the same line as source.
+@return Returns the number of pixels converted, leaving fewer than 16 for the scalar loop
+*/
+FREEIMAGE_TARGET_SSSE3 static int
+ConvertLine32To24SSSE3(BYTE *target, const BYTE *source, int width_in_pixels) {
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	int cols = 0;
+	for (; cols + 16 <= width_in_pixels; cols += 16) {
+		const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)source), shuffle);
+		const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 16)), shuffle);
+		const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 32)), shuffle);
+		const __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 48)), shuffle);
+
+		_mm_storeu_si128((__m128i*)target, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+		_mm_storeu_si128((__m128i*)(target + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+		_mm_storeu_si128((__m128i*)(target + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+		target += 48;
+		source += 64;
+	}
+	return cols;
+}
+
+#endif // FREEIMAGE_SSSE3
+
 // ----------------------------------------------------------
 //  internal conversions X to 24 bits
 // ----------------------------------------------------------
@@ -81,6 +118,15 @@ void DLL_CALLCONV
 FreeImage_ConvertLine16To24_555(BYTE *target, BYTE *source, int width_in_pixels) {
 	WORD *bits = (WORD *)source;
 
+#ifdef FREEIMAGE_SSE2
+	// expand to 32-bit and pack back down a piece at a time, so both steps run in SIMD
+	DWORD pixels[256];
+	for (int cols = 0; cols < width_in_pixels; cols += 256) {
+		const int count = MIN(width_in_pixels - cols, 256);
+		FreeImage_ConvertLine16To32_555((BYTE *)pixels, (BYTE *)(bits + cols), count);
+		FreeImage_ConvertLine32To24(target + 3 * cols, (BYTE *)pixels, count);
+	}
+#else
 	for (int cols = 0; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F);
@@ -88,12 +134,22 @@ FreeImage_ConvertLine16To24_555(BYTE *target, BYTE *source, int width_in_pixels)
 
 		target += 3;
 	}
+#endif
 }
 
 void DLL_CALLCONV
 FreeImage_ConvertLine16To24_565(BYTE *target, BYTE *source, int width_in_pixels) {
 	WORD *bits = (WORD *)source;
 
+#ifdef FREEIMAGE_SSE2
+	// expand to 32-bit and pack back down a piece at a time, so both steps run in SIMD
+	DWORD pixels[256];
+	for (int cols = 0; cols < width_in_pixels; cols += 256) {
+		const int count = MIN(width_in_pixels - cols, 256);
+		FreeImage_ConvertLine16To32_565((BYTE *)pixels, (BYTE *)(bits + cols), count);
+		FreeImage_ConvertLine32To24(target + 3 * cols, (BYTE *)pixels, count);
+	}
+#else
 	for (int cols = 0; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F);
@@ -101,11 +157,22 @@ FreeImage_ConvertLine16To24_565(BYTE *target, BYTE *source, int width_in_pixels)
 
 		target += 3;
 	}
+#endif
 }
 
 void DLL_CALLCONV
 FreeImage_ConvertLine32To24(BYTE *target, BYTE *source, int width_in_pixels) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+
+#ifdef FREEIMAGE_SSSE3
+	if (FreeImage_HasSSSE3()) {
+		cols = ConvertLine32To24SSSE3(target, source, width_in_pixels);
+		target += 3 * cols;
+		source += 4 * cols;
+	}
+#endif
+
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_BLUE] = source[FI_RGBA_BLUE];
 		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
 		target[FI_RGBA_RED] = source[FI_RGBA_RED];
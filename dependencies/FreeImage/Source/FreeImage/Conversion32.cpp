@@ -25,6 +25,80 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef FREEIMAGE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//  SIMD line converters
+// ----------------------------------------------------------
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Expands 8 16-bit pixels to 32-bit, rounding exactly as the scalar code does: 
+(c * 255) / 31 is (c * 1053) >> 7 for every 5-bit c, and (c * 255) / 63 is (c * 255 * 8323) >> 19 for every 6-bit c
+@param RED_SHIFT Position of the red channel (10 for 555, 11 for 565)
+@param GREEN_MASK Green channel, once shifted down (0x1F for 555, 0x3F for 565)
+*/
+template <int RED_SHIFT, int GREEN_MASK> static inline void
+ConvertBlock16To32(BYTE *target, const BYTE *source) {
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i pixels = _mm_loadu_si128((const __m128i*)source);
+
+	const __m128i red = _mm_and_si128(_mm_srli_epi16(pixels, RED_SHIFT), mask5);
+	const __m128i green = _mm_and_si128(_mm_srli_epi16(pixels, 5), _mm_set1_epi16(GREEN_MASK));
+	const __m128i blue = _mm_and_si128(pixels, mask5);
+
+	const __m128i red8 = _mm_srli_epi16(_mm_mullo_epi16(red, _mm_set1_epi16(1053)), 7);
+	const __m128i blue8 = _mm_srli_epi16(_mm_mullo_epi16(blue, _mm_set1_epi16(1053)), 7);
+	const __m128i green8 = (GREEN_MASK == 0x3F)
+		? _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(green, _mm_set1_epi16(255)), _mm_set1_epi16(8323)), 3)
+		: _mm_srli_epi16(_mm_mullo_epi16(green, _mm_set1_epi16(1053)), 7);
+
+	// pair up the bytes of each pixel as (first, green) and (third, alpha), then interleave the pairs
+	const __m128i first = (FI_RGBA_BLUE == 0) ? blue8 : red8;
+	const __m128i third = (FI_RGBA_BLUE == 0) ? red8 : blue8;
+	const __m128i low = _mm_or_si128(first, _mm_slli_epi16(green8, 8));
+	const __m128i high = _mm_or_si128(third, _mm_set1_epi16((short)0xFF00));
+	_mm_storeu_si128((__m128i*)target, _mm_unpacklo_epi16(low, high));
+	_mm_storeu_si128((__m128i*)(target + 16), _mm_unpackhi_epi16(low, high));
+}
+
+#endif // FREEIMAGE_SSE2
+
+#ifdef FREEIMAGE_SSSE3
+
+/**
+Expands 24-bit pixels to 32-bit, 16 at a time: three loads, four shuffles
+@return Returns the number of pixels converted, leaving fewer than 16 for the scalar loop
+*/
+FREEIMAGE_TARGET_SSSE3 static int
+ConvertLine24To32SSSE3(BYTE *target, const BYTE *source, int width_in_pixels) {
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)FI_RGBA_ALPHA_MASK);
+
+	int cols = 0;
+	for (; cols + 16 <= width_in_pixels; cols += 16) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)source);
+		const __m128i b = _mm_loadu_si128((const __m128i*)(source + 16));
+		const __m128i c = _mm_loadu_si128((const __m128i*)(source + 32));
+
+		_mm_storeu_si128((__m128i*)target, _mm_or_si128(_mm_shuffle_epi8(a, shuffle), alpha));
+		_mm_storeu_si128((__m128i*)(target + 16), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuffle), alpha));
+		_mm_storeu_si128((__m128i*)(target + 32), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuffle), alpha));
+		_mm_storeu_si128((__m128i*)(target + 48), _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), shuffle), alpha));
+		target += 64;
+		source += 48;
+	}
+	return cols;
+}
+
+#endif // FREEIMAGE_SSSE3
+
 // ----------------------------------------------------------
 //  internal conversions X to 32 bits
 // ----------------------------------------------------------
@@ -69,20 +143,28 @@ FreeImage_ConvertLine4To32(BYTE *target, BYTE *source, int width_in_pixels, RGBQ
 
 void DLL_CALLCONV
 FreeImage_ConvertLine8To32(BYTE *target, BYTE *source, int width_in_pixels, RGBQUAD *palette) {
+	// a palette entry is laid out like a 32-bit pixel, whatever the byte order
+	const DWORD *colors = (const DWORD *)palette;
+	DWORD *pixels = (DWORD *)target;
+
 	for (int cols = 0; cols < width_in_pixels; cols++) {
-		target[FI_RGBA_BLUE]	= palette[source[cols]].rgbBlue;
-		target[FI_RGBA_GREEN]	= palette[source[cols]].rgbGreen;
-		target[FI_RGBA_RED]		= palette[source[cols]].rgbRed;
-		target[FI_RGBA_ALPHA]	= 0xFF;
-		target += 4;
+		pixels[cols] = colors[source[cols]] | FI_RGBA_ALPHA_MASK;
 	}
 }
 
 void DLL_CALLCONV
 FreeImage_ConvertLine16To32_555(BYTE *target, BYTE *source, int width_in_pixels) {
 	WORD *bits = (WORD *)source;
+	int cols = 0;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+#ifdef FREEIMAGE_SSE2
+	for (; cols + 8 <= width_in_pixels; cols += 8) {
+		ConvertBlock16To32<10, 0x1F>(target, (const BYTE *)(bits + cols));
+		target += 32;
+	}
+#endif
+
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_BLUE]  = (BYTE)((((bits[cols] & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -94,8 +176,16 @@ FreeImage_ConvertLine16To32_555(BYTE *target, BYTE *source, int width_in_pixels)
 void DLL_CALLCONV
 FreeImage_ConvertLine16To32_565(BYTE *target, BYTE *source, int width_in_pixels) {
 	WORD *bits = (WORD *)source;
+	int cols = 0;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+#ifdef FREEIMAGE_SSE2
+	for (; cols + 8 <= width_in_pixels; cols += 8) {
+		ConvertBlock16To32<11, 0x3F>(target, (const BYTE *)(bits + cols));
+		target += 32;
+	}
+#endif
+
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F);
 		target[FI_RGBA_BLUE]  = (BYTE)((((bits[cols] & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -120,7 +210,17 @@ The bug occurs in release mode only, when the image height is equal to 537
 */
 void DLL_CALLCONV
 FreeImage_ConvertLine24To32(BYTE *target, BYTE *source, int width_in_pixels) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+
+#ifdef FREEIMAGE_SSSE3
+	if (FreeImage_HasSSSE3()) {
+		cols = ConvertLine24To32SSSE3(target, source, width_in_pixels);
+		target += 4 * cols;
+		source += 3 * cols;
+	}
+#endif
+
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = source[FI_RGBA_RED];
 		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
 		target[FI_RGBA_BLUE]  = source[FI_RGBA_BLUE];
@@ -29,6 +29,19 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+
+#ifdef FREEIMAGE_SSSE3
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 //----------------------------------------------------------------------
 
 static const char *s_copyright = "This program uses FreeImage, a free, open source image library supporting all common bitmap formats. See http://freeimage.sourceforge.net for details";
@@ -102,6 +115,139 @@ FreeImage_IsLittleEndian() {
 	return (u.c[0] != 0);
 }
 
+#ifdef FREEIMAGE_SSSE3
+
+/**
+Asks the CPU once whether it has SSSE3, for code that picks between an SSSE3 and an SSE2 or scalar version at run time
+*/
+BOOL 
+FreeImage_HasSSSE3() {
+	static const BOOL s_has_ssse3 = []() -> BOOL {
+		int info[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+		__cpuid(info, 1);
+#else
+		unsigned eax, ebx, ecx, edx;
+		if(__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+			info[2] = (int)ecx;
+		}
+#endif
+		return (info[2] & (1 << 9)) ? TRUE : FALSE;
+	}();
+	return s_has_ssse3;
+}
+
+#endif // FREEIMAGE_SSSE3
+
+//----------------------------------------------------------------------
+
+/**
+One call to FreeImage_RunSlices, living on the caller's stack. 
+Everything but the slice function is guarded by the pool's lock.
+*/
+struct SliceJob {
+	void (*proc)(void *data, int first, int last);
+	void *data;
+	int next;				//! first slice not yet claimed
+	int end;
+	int slice_size;
+	int unfinished;			//! slices claimed or not, which haven't returned yet
+	std::exception_ptr error;
+};
+
+/**
+Worker threads shared by every FreeImage_RunSlices call. 
+Jobs wait in a queue until all their slices are claimed; whoever claims a slice runs it.
+*/
+class SlicePool {
+public:
+	SlicePool() {
+		const int workers = (int)std::thread::hardware_concurrency() - 1;
+		for(int i = 0; i < workers; i++) {
+			try {
+				std::thread(&SlicePool::Work, this).detach();
+			} catch(...) {
+				// no more threads available: callers do the work themselves
+				break;
+			}
+		}
+	}
+
+	void Run(SliceJob &job) {
+		std::unique_lock<std::mutex> lock(_lock);
+		_jobs.push_back(&job);
+		_wake.notify_all();
+
+		// the caller claims slices like any worker, so a job finishes even when every worker is busy (or nested calls wait on it)
+		while(job.next < job.end) {
+			RunSlice(job, lock);
+		}
+		while(job.unfinished) {
+			_done.wait(lock);
+		}
+	}
+
+private:
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+	std::deque<SliceJob *> _jobs;
+
+	void Work() {
+		std::unique_lock<std::mutex> lock(_lock);
+		for(;;) {
+			while(_jobs.empty()) {
+				_wake.wait(lock);
+			}
+			RunSlice(*_jobs.front(), lock);
+		}
+	}
+
+	// claims the next slice of a queued job, and runs it with the lock released
+	void RunSlice(SliceJob &job, std::unique_lock<std::mutex> &lock) {
+		const int first = job.next;
+		const int last = MIN(first + job.slice_size, job.end);
+		job.next = last;
+		if(last == job.end) {
+			_jobs.erase(std::find(_jobs.begin(), _jobs.end(), &job));
+		}
+
+		lock.unlock();
+		std::exception_ptr error;
+		try {
+			job.proc(job.data, first, last);
+		} catch(...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+
+		if(error && !job.error) {
+			job.error = error;
+		}
+		if(--job.unfinished == 0) {
+			_done.notify_all();
+		}
+	}
+};
+
+void 
+FreeImage_RunSlices(int begin, int end, int slice_size, void (*proc)(void *data, int first, int last), void *data) {
+	if(end <= begin) {
+		return;
+	}
+	slice_size = MAX(slice_size, 1);
+
+	// created on first use and never destroyed: when unloading the library, 
+	// the loader lock is held and the workers could not be joined
+	static SlicePool *s_pool = new SlicePool;
+
+	SliceJob job = { proc, data, begin, end, slice_size, (int)((end - begin + (long long)slice_size - 1) / slice_size), std::exception_ptr() };
+	s_pool->Run(job);
+	if(job.error) {
+		std::rethrow_exception(job.error);
+	}
+}
+
 //----------------------------------------------------------------------
 
 static FreeImage_OutputMessageFunction freeimage_outputmessage_proc = NULL;
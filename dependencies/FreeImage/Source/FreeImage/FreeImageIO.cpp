@@ -173,3 +173,22 @@ SetMemoryIO(FreeImageIO *io) {
 	io->tell_proc  = _MemoryTellProc;
 	io->write_proc = _MemoryWriteProc;
 }
+
+unsigned
+GetMemoryIOView(FreeImageIO *io, fi_handle handle, unsigned size, const BYTE **data) {
+	if(!io || (io->read_proc != _MemoryReadProc) || !handle) {
+		return 0;
+	}
+	FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(((FIMEMORY*)handle)->data);
+
+	const long remaining_bytes = mem_header->file_length - mem_header->current_position;
+	if(remaining_bytes <= 0) {
+		return 0;
+	}
+	if((unsigned long)remaining_bytes < size) {
+		size = (unsigned)remaining_bytes;
+	}
+	*data = (const BYTE*)mem_header->data + mem_header->current_position;
+	mem_header->current_position += size;
+	return size;
+}
@@ -36,6 +36,10 @@
 #include "Utilities.h"
 #include "FreeImage.h"
 
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
 // ----------------------------------------------------------
 
 enum BlockType { BLOCK_CONTINUEUS, BLOCK_REFERENCE };
@@ -77,6 +81,157 @@ typedef std::list<BlockTypeS *>::iterator BlockListIterator;
 
 // ----------------------------------------------------------
 
+// memory given to the cache of each multipage bitmap opened from a file
+static size_t s_cache_memory_size = CACHE_MEMORY_SIZE;
+
+// pages read ahead: decoded from the source file after each locked page, and read from the cache while saving
+static const int CACHE_PREFETCH_PAGES = 4;
+static int s_prefetch_pages = CACHE_PREFETCH_PAGES;
+
+// ----------------------------------------------------------
+
+/**
+Decodes the pages that follow the last locked one on a thread of its own, 
+reading the source file through a handle of its own so that it never moves the caller's
+*/
+class PagePrefetcher {
+public:
+	PagePrefetcher(PluginNode *node, const char *filename, int flags) : 
+	m_node(node), m_filename(filename), m_flags(flags), m_busy(-1), m_stop(FALSE) {
+		SetDefaultIO(&m_io);
+	}
+
+	~PagePrefetcher() {
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_stop = TRUE;
+		}
+		m_wake.notify_all();
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+		for (std::map<int, FIBITMAP *>::iterator i = m_ready.begin(); i != m_ready.end(); ++i) {
+			FreeImage_Unload(i->second);
+		}
+	}
+
+	/**
+	Hands over a page if it has been decoded, waiting for it if it is being decoded right now.
+	Returns NULL if the caller has to decode the page itself.
+	*/
+	FIBITMAP *take(int page) {
+		std::unique_lock<std::mutex> lock(m_lock);
+		while (m_busy == page) {
+			m_done.wait(lock);
+		}
+		std::deque<int>::iterator queued = std::find(m_queue.begin(), m_queue.end(), page);
+		if (queued != m_queue.end()) {
+			m_queue.erase(queued);
+		}
+
+		std::map<int, FIBITMAP *>::iterator ready = m_ready.find(page);
+		if (ready == m_ready.end()) {
+			return NULL;
+		}
+		FIBITMAP *dib = ready->second;
+		m_ready.erase(ready);
+		return dib;
+	}
+
+	/**
+	Starts decoding pages [first, last], and drops any decoded page outside of them
+	*/
+	void request(int first, int last) {
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (std::map<int, FIBITMAP *>::iterator i = m_ready.begin(); i != m_ready.end(); ) {
+			if ((i->first < first) || (i->first > last)) {
+				FreeImage_Unload(i->second);
+				m_ready.erase(i++);
+			} else {
+				++i;
+			}
+		}
+		m_queue.clear();
+		for (int page = first; page <= last; page++) {
+			if ((page != m_busy) && (m_ready.find(page) == m_ready.end())) {
+				m_queue.push_back(page);
+			}
+		}
+
+		if (!m_queue.empty() && !m_thread.joinable()) {
+			try {
+				m_thread = std::thread(&PagePrefetcher::work, this);
+			} catch(...) {
+				// no thread: pages are decoded when they are locked
+				m_queue.clear();
+				return;
+			}
+		}
+		m_wake.notify_all();
+	}
+
+private:
+	PluginNode *m_node;
+	std::string m_filename;
+	int m_flags;
+	FreeImageIO m_io;
+
+	std::thread m_thread;
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	std::deque<int> m_queue;				//! pages still to decode, in order
+	std::map<int, FIBITMAP *> m_ready;		//! decoded pages, owned until they are taken
+	int m_busy;								//! page being decoded, or -1
+	BOOL m_stop;
+
+	void work() {
+		FILE *handle = fopen(m_filename.c_str(), "rb");
+
+		std::unique_lock<std::mutex> lock(m_lock);
+		for (;;) {
+			while (!m_stop && m_queue.empty()) {
+				m_wake.wait(lock);
+			}
+			if (m_stop) {
+				break;
+			}
+			const int page = m_busy = m_queue.front();
+			m_queue.pop_front();
+			lock.unlock();
+
+			// the same steps as FreeImage_LockPage
+			FIBITMAP *dib = NULL;
+			if (handle) {
+				try {
+					m_io.seek_proc((fi_handle)handle, 0, SEEK_SET);
+					void *data = FreeImage_Open(m_node, &m_io, (fi_handle)handle, TRUE);
+					if (data != NULL) {
+						dib = (m_node->m_plugin->load_proc != NULL) ? m_node->m_plugin->load_proc(&m_io, (fi_handle)handle, page, m_flags, data) : NULL;
+						FreeImage_Close(m_node, &m_io, (fi_handle)handle, data);
+					}
+				} catch(...) {
+					dib = NULL;
+				}
+			}
+
+			lock.lock();
+			if (dib) {
+				m_ready[page] = dib;
+			}
+			m_busy = -1;
+			m_done.notify_all();
+		}
+		lock.unlock();
+
+		if (handle) {
+			fclose(handle);
+		}
+	}
+};
+
+// ----------------------------------------------------------
+
 FI_STRUCT (MULTIBITMAPHEADER) {
 	PluginNode *node;
 	FREE_IMAGE_FORMAT fif;
@@ -91,6 +246,8 @@ FI_STRUCT (MULTIBITMAPHEADER) {
 	BOOL read_only;
 	FREE_IMAGE_FORMAT cache_fif;
 	int load_flags;
+	int m_prefetch_pages;
+	PagePrefetcher *m_prefetcher;
 };
 
 // =====================================================================
@@ -120,6 +277,19 @@ FreeImage_GetMultiBitmapHeader(FIMULTIBITMAP *bitmap) {
 	return (MULTIBITMAPHEADER *)bitmap->data;
 }
 
+/**
+Lets the cache start reading the next few cached pages from disc, while the current one is saved
+*/
+static void
+FreeImage_PrefetchBlocks(MULTIBITMAPHEADER *header, BlockListIterator i) {
+	for (int count = 0; (i != header->m_blocks.end()) && (count < header->m_prefetch_pages); i++) {
+		if ((*i)->m_type == BLOCK_REFERENCE) {
+			header->m_cachefile->prefetchFile(((BlockReference *)(*i))->m_reference);
+			count++;
+		}
+	}
+}
+
 static BlockListIterator DLL_CALLCONV
 FreeImage_FindBlock(FIMULTIBITMAP *bitmap, int position) {
 	assert(NULL != bitmap);
@@ -275,6 +445,8 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, BOOL crea
 				header->m_cachefile = NULL;
 				header->cache_fif = fif;
 				header->load_flags = flags;
+				header->m_prefetch_pages = s_prefetch_pages;
+				header->m_prefetcher = NULL;
 
 				// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
 
@@ -296,7 +468,7 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, BOOL crea
 					std::string cache_name;
 					ReplaceExtension(cache_name, filename, "ficache");
 
-					std::auto_ptr<CacheFile> cache_file (new CacheFile(cache_name, keep_cache_in_memory));
+					std::auto_ptr<CacheFile> cache_file (new CacheFile(cache_name, keep_cache_in_memory, s_cache_memory_size));
 
 					if (cache_file->open()) {
 						// we can use release() as std::bad_alloc won't be thrown from here on
@@ -307,6 +479,12 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, BOOL crea
 						return NULL;
 					}
 				}
+				// the source file can be opened a second time, so pages can be decoded ahead of FreeImage_LockPage
+
+				if (!create_new && (header->m_prefetch_pages > 0)) {
+					header->m_prefetcher = new PagePrefetcher(node, filename, flags);
+				}
+
 				// return the multibitmap
 				// std::bad_alloc won't be thrown from here on
 				header.release(); // now owned by bitmap
@@ -349,6 +527,8 @@ FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_h
 					header->m_cachefile = NULL;
 					header->cache_fif = fif;
 					header->load_flags = flags;
+					header->m_prefetch_pages = s_prefetch_pages;
+					header->m_prefetcher = NULL;
 							
 					// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
 
@@ -440,6 +620,11 @@ FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 						{
 							BlockReference *ref = (BlockReference *)(*i);
 							
+							// read ahead the pages that follow
+
+							BlockListIterator next = i;
+							FreeImage_PrefetchBlocks(header, ++next);
+
 							// read the compressed data
 							
 							BYTE *compressed_data = (BYTE*)malloc(ref->m_size * sizeof(BYTE));
@@ -493,6 +678,11 @@ FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags) {
 		
 		if (bitmap->data) {
 			MULTIBITMAPHEADER *header = FreeImage_GetMultiBitmapHeader(bitmap);			
+
+			// stop reading ahead, which also closes the second handle on the source file before it is replaced
+
+			delete header->m_prefetcher;
+			header->m_prefetcher = NULL;
 			
 			// saves changes only of images loaded directly from a file
 			if (header->changed && header->m_filename) {
@@ -736,30 +926,39 @@ FreeImage_LockPage(FIMULTIBITMAP *bitmap, int page) {
 			}
 		}
 
-		// open the bitmap
+		// take the page if it was read ahead, and start on the ones after it
 
-		header->io->seek_proc(header->handle, 0, SEEK_SET);
+		FIBITMAP *dib = NULL;
 
-   		void *data = FreeImage_Open(header->node, header->io, header->handle, TRUE);
+		if (header->m_prefetcher) {
+			dib = header->m_prefetcher->take(page);
+			header->m_prefetcher->request(page + 1, page + MIN(header->m_prefetch_pages, header->page_count - 1 - page));
+		}
 
-		// load the bitmap data
+		if (dib == NULL) {
+			// open the bitmap
 
-		if (data != NULL) {
-			FIBITMAP *dib = (header->node->m_plugin->load_proc != NULL) ? header->node->m_plugin->load_proc(header->io, header->handle, page, header->load_flags, data) : NULL;
+			header->io->seek_proc(header->handle, 0, SEEK_SET);
 
-			// close the file
+			void *data = FreeImage_Open(header->node, header->io, header->handle, TRUE);
 
-			FreeImage_Close(header->node, header->io, header->handle, data);
+			// load the bitmap data
 
-			// if there was still another bitmap open, get rid of it
+			if (data != NULL) {
+				dib = (header->node->m_plugin->load_proc != NULL) ? header->node->m_plugin->load_proc(header->io, header->handle, page, header->load_flags, data) : NULL;
 
-			if (dib) {
-				header->locked_pages[dib] = page;
+				// close the file
+
+				FreeImage_Close(header->node, header->io, header->handle, data);
+			}
+		}
 
-				return dib;
-			}	
+		// if there was still another bitmap open, get rid of it
 
-			return NULL;
+		if (dib) {
+			header->locked_pages[dib] = page;
+
+			return dib;
 		}
 	}
 
@@ -888,6 +1087,21 @@ FreeImage_GetLockedPageNumbers(FIMULTIBITMAP *bitmap, int *pages, int *count) {
 	return FALSE;
 }
 
+void DLL_CALLCONV
+FreeImage_SetMultiBitmapCacheSize(size_t max_bytes) {
+	s_cache_memory_size = max_bytes ? max_bytes : CACHE_MEMORY_SIZE;
+}
+
+/**
+Sets how many pages multipage bitmaps opened from now on read ahead (4 by default).
+0 turns read-ahead off, so a bitmap opened read-only from a file never starts a thread 
+and decodes only the pages that are locked.
+*/
+void DLL_CALLCONV
+FreeImage_SetMultiBitmapPrefetch(unsigned pages) {
+	s_prefetch_pages = (int)MIN(pages, (unsigned)INT_MAX);
+}
+
 // =====================================================================
 // Memory IO Multipage functions
 // =====================================================================
@@ -925,6 +1139,8 @@ FreeImage_LoadMultiBitmapFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int
 						header->m_cachefile = NULL;
 						header->cache_fif = fif;
 						header->load_flags = flags;
+						header->m_prefetch_pages = s_prefetch_pages;
+						header->m_prefetcher = NULL;
 
 						// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
 
@@ -349,6 +349,8 @@ FreeImage_DeInitialise() {
 
 	if (s_plugin_reference_count == 0) {
 		delete s_plugins;
+
+		FreeImage_ReleaseBitmapPool();
 	}
 }
 
@@ -22,6 +22,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
+#include "BlockCompression.h"
 
 // ----------------------------------------------------------
 //   Definitions for the DDS format
@@ -117,52 +119,49 @@ typedef struct tagDDSHEADER {
 #define FOURCC_DXT3	MAKEFOURCC('D','X','T','3')
 #define FOURCC_DXT4	MAKEFOURCC('D','X','T','4')
 #define FOURCC_DXT5	MAKEFOURCC('D','X','T','5')
+#define FOURCC_DX10	MAKEFOURCC('D','X','1','0')
+
+// Extended header following DDSHEADER when the FOURCC is 'DX10'
+typedef struct tagDDSHEADER_DXT10 {
+	DWORD dxgiFormat;			// see DXGI_FORMAT_*
+	DWORD resourceDimension;	// see DDS_DIMENSION_*
+	DWORD miscFlag;
+	DWORD arraySize;
+	DWORD miscFlags2;
+} DDSHEADER_DXT10;
+
+// DXGI FORMATS (the block compressed subset)
+enum {
+	DXGI_FORMAT_BC1_TYPELESS	= 70,
+	DXGI_FORMAT_BC1_UNORM		= 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB	= 72,
+	DXGI_FORMAT_BC2_TYPELESS	= 73,
+	DXGI_FORMAT_BC2_UNORM		= 74,
+	DXGI_FORMAT_BC2_UNORM_SRGB	= 75,
+	DXGI_FORMAT_BC3_TYPELESS	= 76,
+	DXGI_FORMAT_BC3_UNORM		= 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB	= 78,
+	DXGI_FORMAT_BC4_TYPELESS	= 79,
+	DXGI_FORMAT_BC4_UNORM		= 80,
+	DXGI_FORMAT_BC5_TYPELESS	= 82,
+	DXGI_FORMAT_BC5_UNORM		= 83,
+	DXGI_FORMAT_BC7_TYPELESS	= 97,
+	DXGI_FORMAT_BC7_UNORM		= 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB	= 99
+};
 
-// ----------------------------------------------------------
-//   Structures used by DXT textures
-// ----------------------------------------------------------
+enum {
+	DDS_DIMENSION_TEXTURE2D	= 3
+};
 
-typedef struct tagColor8888 {
-	BYTE b;
-	BYTE g;
-	BYTE r;
-	BYTE a;
-} Color8888;
-
-typedef struct tagColor565 {
-	WORD b : 5;
-	WORD g : 6;
-	WORD r : 5;
-} Color565;
-
-typedef struct tagDXTColBlock {
-	Color565 colors[2];
-	BYTE row[4];
-} DXTColBlock;
-
-typedef struct tagDXTAlphaBlockExplicit {
-	WORD row[4];
-} DXTAlphaBlockExplicit;
-
-typedef struct tagDXTAlphaBlock3BitLinear {
-	BYTE alpha[2];
-	BYTE data[6];
-} DXTAlphaBlock3BitLinear;
-
-typedef struct tagDXT1Block
-{
-	DXTColBlock color;
-} DXT1Block;
-
-typedef struct tagDXT3Block {		// also used by dxt2
-	DXTAlphaBlockExplicit alpha;
-	DXTColBlock color;
-} DXT3Block;
-
-typedef struct tagDXT5Block {		// also used by dxt4
-	DXTAlphaBlock3BitLinear alpha;
-	DXTColBlock color;
-} DXT5Block;
+enum {
+	DDS_RESOURCE_MISC_TEXTURECUBE = 0x00000004l
+};
+
+#define FOURCC_ATI1	MAKEFOURCC('A','T','I','1')
+#define FOURCC_BC4U	MAKEFOURCC('B','C','4','U')
+#define FOURCC_ATI2	MAKEFOURCC('A','T','I','2')
+#define FOURCC_BC5U	MAKEFOURCC('B','C','5','U')
 
 #ifdef _WIN32
 #	pragma pack(pop)
@@ -201,207 +200,233 @@ SwapHeader(DDSHEADER *header) {
 	SwapLong(&header->surfaceDesc.ddsCaps.dwReserved[1]);
 	SwapLong(&header->surfaceDesc.dwReserved2);
 }
+
+static void
+SwapHeaderDXT10(DDSHEADER_DXT10 *header) {
+	SwapLong(&header->dxgiFormat);
+	SwapLong(&header->resourceDimension);
+	SwapLong(&header->miscFlag);
+	SwapLong(&header->arraySize);
+	SwapLong(&header->miscFlags2);
+}
 #endif
 
+// ==========================================================
+// Plugin Interface
 // ==========================================================
 
-// Get the 4 possible colors for a block
-//
-static void 
-GetBlockColors (const DXTColBlock &block, Color8888 colors[4], bool isDXT1) {
-	int i;
-	// expand from 565 to 888
-	for (i = 0; i < 2; i++)	{
-		colors[i].a = 0xff;
-		/*
-		colors[i].r = (BYTE)(block.colors[i].r * 0xff / 0x1f);
-		colors[i].g = (BYTE)(block.colors[i].g * 0xff / 0x3f);
-		colors[i].b = (BYTE)(block.colors[i].b * 0xff / 0x1f);
-		*/
-		colors[i].r = (BYTE)((block.colors[i].r << 3U) | (block.colors[i].r >> 2U));
-		colors[i].g = (BYTE)((block.colors[i].g << 2U) | (block.colors[i].g >> 4U));
-		colors[i].b = (BYTE)((block.colors[i].b << 3U) | (block.colors[i].b >> 2U));
-	}
+static int s_format_id;
 
-	WORD *wCol = (WORD *)block.colors;
-	if (wCol[0] > wCol[1] || !isDXT1) {
-		// 4 color block
-		for (i = 0; i < 2; i++)	{
-			colors[i + 2].a = 0xff;
-			colors[i + 2].r = (BYTE)((WORD (colors[0].r) * (2 - i) + WORD (colors[1].r) * (1 + i)) / 3);
-			colors[i + 2].g = (BYTE)((WORD (colors[0].g) * (2 - i) + WORD (colors[1].g) * (1 + i)) / 3);
-			colors[i + 2].b = (BYTE)((WORD (colors[0].b) * (2 - i) + WORD (colors[1].b) * (1 + i)) / 3);
-		}
-	}
-	else {
-		// 3 color block, number 4 is transparent
-		colors[2].a = 0xff;
-		colors[2].r = (BYTE)((WORD (colors[0].r) + WORD (colors[1].r)) / 2);
-		colors[2].g = (BYTE)((WORD (colors[0].g) + WORD (colors[1].g)) / 2);
-		colors[2].b = (BYTE)((WORD (colors[0].b) + WORD (colors[1].b)) / 2);
-
-		colors[3].a = 0x00;
-		colors[3].g = 0x00;
-		colors[3].b = 0x00;
-		colors[3].r = 0x00;
-	}
+// ==========================================================
+// Internal functions
+// ==========================================================
+
+/**
+What Open learns from the headers, so that Load can seek straight to any surface.
+Pages are numbered as surfaces are stored: each face or array slice in turn, with all of its mipmaps.
+*/
+typedef struct tagDDSINFO {
+	DDSHEADER header;
+	long data_start;		// offset of the first surface
+	BC_FORMAT format;		// 0 for uncompressed RGB
+	unsigned levels;		// mipmaps per surface, including the full size one
+	unsigned surfaces;		// faces times array slices (volume textures only expose their first slice)
+	unsigned depth;			// slices in a volume texture, otherwise 1
+} DDSINFO;
+
+static unsigned
+GetLevelWidth(const DDSINFO *info, unsigned level) {
+	return MAX(info->header.surfaceDesc.dwWidth >> level, (DWORD)1);
 }
 
-struct DXT_INFO_1 {
-	typedef DXT1Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 8
-	};
-};
+static unsigned
+GetLevelHeight(const DDSINFO *info, unsigned level) {
+	return MAX(info->header.surfaceDesc.dwHeight >> level, (DWORD)1);
+}
 
-struct DXT_INFO_3 {
-	typedef DXT3Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
-};
+/**
+Bytes between one row of an uncompressed level and the next
+*/
+static unsigned
+GetLevelPitch(const DDSINFO *info, unsigned level) {
+	const DDSURFACEDESC2 &desc = info->header.surfaceDesc;
+	if((level == 0) && (desc.dwFlags & DDSD_PITCH)) {
+		return desc.dwPitchOrLinearSize;
+	}
+	return (GetLevelWidth(info, level) * desc.ddpfPixelFormat.dwRGBBitCount + 7) / 8;
+}
 
-struct DXT_INFO_5 {
-	typedef DXT5Block Block;
-	enum
-	{
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
-};
+/**
+Bytes in one slice of one mipmap
+*/
+static size_t
+GetLevelSize(const DDSINFO *info, unsigned level) {
+	const unsigned width = GetLevelWidth(info, level);
+	const unsigned height = GetLevelHeight(info, level);
+	if(info->format) {
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BC_GetBlockSize(info->format);
+	}
+	return (size_t)GetLevelPitch(info, level) * height;
+}
 
-template <class INFO> class DXT_BLOCKDECODER_BASE {
-protected:
-	Color8888 m_colors[4];
-	const typename INFO::Block *m_pBlock;
-	unsigned m_colorRow;
+/**
+Bytes in one mipmap, counting every slice of a volume texture
+*/
+static size_t
+GetLevelSizeAllSlices(const DDSINFO *info, unsigned level) {
+	return GetLevelSize(info, level) * MAX(info->depth >> level, 1U);
+}
 
-public:
-	void Setup (const BYTE *pBlock) {
-		m_pBlock = (const typename INFO::Block *)pBlock;
-		GetBlockColors (m_pBlock->color, m_colors, INFO::isDXT1);
+static BC_FORMAT
+GetFormatFromFourCC(DWORD fourcc) {
+	switch(fourcc) {
+		case FOURCC_DXT1:
+			return BC_FORMAT_BC1;
+		case FOURCC_DXT2:
+		case FOURCC_DXT3:
+			return BC_FORMAT_BC2;
+		case FOURCC_DXT4:
+		case FOURCC_DXT5:
+			return BC_FORMAT_BC3;
+		case FOURCC_ATI1:
+		case FOURCC_BC4U:
+			return BC_FORMAT_BC4;
+		case FOURCC_ATI2:
+		case FOURCC_BC5U:
+			return BC_FORMAT_BC5;
 	}
+	return (BC_FORMAT)0;
+}
 
-	void SetY (int y) {
-		m_colorRow = m_pBlock->color.row[y];
+static BC_FORMAT
+GetFormatFromDXGI(DWORD format) {
+	switch(format) {
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			return BC_FORMAT_BC1;
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			return BC_FORMAT_BC2;
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			return BC_FORMAT_BC3;
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+			return BC_FORMAT_BC4;
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+			return BC_FORMAT_BC5;
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return BC_FORMAT_BC7;
 	}
+	return (BC_FORMAT)0;
+}
 
-	void GetColor (int x, int y, Color8888 &color) {
-		unsigned bits = (m_colorRow >> (x * 2)) & 3;
-		color = m_colors[bits];
+/**
+Reads the headers and works out the layout of the surfaces
+@return FALSE if the file isn't a DDS file, or holds a format the loader can't decode
+*/
+static BOOL
+ReadInfo(FreeImageIO *io, fi_handle handle, DDSINFO *info) {
+	memset(info, 0, sizeof(DDSINFO));
+	DDSHEADER &header = info->header;
+	if(io->read_proc(&header, sizeof(header), 1, handle) != 1) {
+		return FALSE;
 	}
-};
-
-class DXT_BLOCKDECODER_1 : public DXT_BLOCKDECODER_BASE <DXT_INFO_1> {
-public:
-	typedef DXT_INFO_1 INFO;
-};
-
-class DXT_BLOCKDECODER_3 : public DXT_BLOCKDECODER_BASE <DXT_INFO_3> {
-public:
-	typedef DXT_BLOCKDECODER_BASE <DXT_INFO_3> base;
-	typedef DXT_INFO_3 INFO;
-
-protected:
-	unsigned m_alphaRow;
-
-public:
-	void SetY (int y) {
-		base::SetY (y);
-		m_alphaRow = m_pBlock->alpha.row[y];
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapHeader(&header);
+#endif
+	const DDSURFACEDESC2 &desc = header.surfaceDesc;
+	if((header.dwMagic != MAKEFOURCC('D','D','S',' ')) || !desc.dwWidth || !desc.dwHeight) {
+		return FALSE;
 	}
 
-	void GetColor (int x, int y, Color8888 &color) {
-		base::GetColor (x, y, color);
-		const unsigned bits = (m_alphaRow >> (x * 4)) & 0xF;
-		color.a = (BYTE)((bits * 0xFF) / 0xF);
+	info->surfaces = 1;
+	info->depth = ((desc.ddsCaps.dwCaps2 & DDSCAPS2_VOLUME) && desc.dwDepth) ? desc.dwDepth : 1;
+	if(desc.ddsCaps.dwCaps2 & DDSCAPS2_CUBEMAP) {
+		// only the faces present are stored
+		info->surfaces = 0;
+		for(DWORD face = DDSCAPS2_CUBEMAP_POSITIVEX; face <= DDSCAPS2_CUBEMAP_NEGATIVEZ; face <<= 1) {
+			info->surfaces += (desc.ddsCaps.dwCaps2 & face) ? 1 : 0;
+		}
 	}
-};
 
-class DXT_BLOCKDECODER_5 : public DXT_BLOCKDECODER_BASE <DXT_INFO_5> {
-public:
-	typedef DXT_BLOCKDECODER_BASE <DXT_INFO_5> base;
-	typedef DXT_INFO_5 INFO;
-
-protected:
-	unsigned m_alphas[8];
-	unsigned m_alphaBits;
-	int m_offset;
-
-public:
-	void Setup (const BYTE *pBlock) {
-		base::Setup (pBlock);
-
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		m_alphas[0] = block.alpha[0];
-		m_alphas[1] = block.alpha[1];
-		if (m_alphas[0] > m_alphas[1]) {
-			// 8 alpha block
-			for (int i = 0; i < 6; i++) {
-				m_alphas[i + 2] = ((6 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 3) / 7;
-			}
+	if(desc.ddpfPixelFormat.dwFlags & DDPF_RGB) {
+		const DWORD bpp = desc.ddpfPixelFormat.dwRGBBitCount;
+		if((bpp != 16) && (bpp != 24) && (bpp != 32)) {
+			return FALSE;
 		}
-		else {
-			// 6 alpha block
-			for (int i = 0; i < 4; i++) {
-				m_alphas[i + 2] = ((4 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 2) / 5;
+	} else if(desc.ddpfPixelFormat.dwFlags & DDPF_FOURCC) {
+		if(desc.ddpfPixelFormat.dwFourCC == FOURCC_DX10) {
+			DDSHEADER_DXT10 header10;
+			if(io->read_proc(&header10, sizeof(header10), 1, handle) != 1) {
+				return FALSE;
 			}
-			m_alphas[6] = 0;
-			m_alphas[7] = 0xFF;
+#ifdef FREEIMAGE_BIGENDIAN
+			SwapHeaderDXT10(&header10);
+#endif
+			if(header10.resourceDimension != DDS_DIMENSION_TEXTURE2D) {
+				return FALSE;
+			}
+			info->format = GetFormatFromDXGI(header10.dxgiFormat);
+			info->surfaces = MAX(header10.arraySize, (DWORD)1) * ((header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) ? 6 : 1);
+		} else {
+			info->format = GetFormatFromFourCC(desc.ddpfPixelFormat.dwFourCC);
 		}
-
+		if(!info->format) {
+			return FALSE;
+		}
+	} else {
+		return FALSE;
 	}
 
-	void SetY (int y) {
-		base::SetY (y);
-		int i = y / 2;
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		m_alphaBits = unsigned(block.data[0 + i * 3]) | (unsigned(block.data[1 + i * 3]) << 8)
-			| (unsigned(block.data[2 + i * 3]) << 16);
-		m_offset = (y & 1) * 12;
+	// a full chain ends at 1x1, so anything longer is a broken header
+	unsigned max_levels = 1;
+	while((MAX(desc.dwWidth, desc.dwHeight) >> max_levels) > 0) {
+		max_levels++;
 	}
+	info->levels = (desc.dwFlags & DDSD_MIPMAPCOUNT) ? CLAMP((unsigned)desc.dwMipMapCount, 1U, max_levels) : 1;
+	if(!info->surfaces) {
+		return FALSE;
+	}
+
+	info->data_start = io->tell_proc(handle);
+	return TRUE;
+}
 
-	void GetColor (int x, int y, Color8888 &color) {
-		base::GetColor (x, y, color);
-		unsigned bits = (m_alphaBits >> (x * 3 + m_offset)) & 7;
-		color.a = (BYTE)m_alphas[bits];
+/**
+Finds the surface holding a page
+@return The surface's offset from the start of the file, or -1 if there is no such page
+*/
+static long
+GetPageOffset(const DDSINFO *info, int page, unsigned *level) {
+	if((page < 0) || ((unsigned)page >= info->surfaces * info->levels)) {
+		return -1;
 	}
-};
+	const unsigned surface = (unsigned)page / info->levels;
+	*level = (unsigned)page % info->levels;
 
-template <class DECODER> void DecodeDXTBlock (BYTE *dstData, const BYTE *srcBlock, long dstPitch, int bw, int bh) {
-	DECODER decoder;
-	decoder.Setup (srcBlock);
-	for (int y = 0; y < bh; y++) {
-		BYTE *dst = dstData - y * dstPitch;
-		decoder.SetY (y);
-		for (int x = 0; x < bw; x++) {
-			decoder.GetColor (x, y, (Color8888 &)*dst);
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB 
-			INPLACESWAP(dst[FI_RGBA_RED], dst[FI_RGBA_BLUE]);
-#endif 
-			dst += 4;
+	size_t surface_size = 0, level_offset = 0;
+	for(unsigned i = 0; i < info->levels; i++) {
+		if(i == *level) {
+			level_offset = surface_size;
 		}
+		surface_size += GetLevelSizeAllSlices(info, i);
 	}
+	return info->data_start + (long)(surface * surface_size + level_offset);
 }
 
-// ==========================================================
-// Plugin Interface
-// ==========================================================
-
-static int s_format_id;
-
-// ==========================================================
-// Internal functions
-// ==========================================================
-
 static FIBITMAP *
-LoadRGB (DDSURFACEDESC2 &desc, FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	int width = (int)desc.dwWidth & ~3;
-	int height = (int)desc.dwHeight & ~3;
-	int bpp = (int)desc.ddpfPixelFormat.dwRGBBitCount;
+LoadRGB(const DDSINFO *info, unsigned level, FreeImageIO *io, fi_handle handle) {
+	const DDSURFACEDESC2 &desc = info->header.surfaceDesc;
+	const unsigned width = GetLevelWidth(info, level);
+	const unsigned height = GetLevelHeight(info, level);
+	const int bpp = (int)desc.ddpfPixelFormat.dwRGBBitCount;
 	
 	// allocate a new dib
 	FIBITMAP *dib = FreeImage_Allocate (width, height, bpp, desc.ddpfPixelFormat.dwRBitMask,
@@ -415,15 +440,14 @@ LoadRGB (DDSURFACEDESC2 &desc, FreeImageIO *io, fi_handle handle, int page, int
 #endif
 	
 	// read the file
-	int line   = CalculateLine(width, bpp);
-	int filePitch = (desc.dwFlags & DDSD_PITCH) ? (int)desc.dwPitchOrLinearSize : line;
-	long delta = (long)filePitch - (long)line;
-	for (int i = 0; i < height; i++) {
+	const unsigned line = (width * bpp + 7) / 8;
+	const long delta = (long)GetLevelPitch(info, level) - (long)line;
+	for (unsigned i = 0; i < height; i++) {
 		BYTE *pixels = FreeImage_GetScanLine(dib, height - i - 1);
 		io->read_proc (pixels, 1, line, handle);
 		io->seek_proc (handle, delta, SEEK_CUR);
 #if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
- 		for(int x = 0; x < width; x++) {
+ 		for(unsigned x = 0; x < width; x++) {
 			INPLACESWAP(pixels[FI_RGBA_RED],pixels[FI_RGBA_BLUE]);
 			pixels += bytespp;
 		}
@@ -442,89 +466,59 @@ LoadRGB (DDSURFACEDESC2 &desc, FreeImageIO *io, fi_handle handle, int page, int
 	return dib;
 }
 
-template <class DECODER> static void 
-LoadDXT_Helper (FreeImageIO *io, fi_handle handle, int page, int flags, void *data, FIBITMAP *dib, int width, int height, int line) {
-	typedef typename DECODER::INFO INFO;
-	typedef typename INFO::Block Block;
-
-	Block *input_buffer = new(std::nothrow) Block[(width + 3) / 4];
-	if(!input_buffer) return;
-
-	int widthRest = (int) width & 3;
-	int heightRest = (int) height & 3;
-	int inputLine = (width + 3) / 4;
-	int y = 0;
-
-	if (height >= 4) {
-		for (; y < height; y += 4) {
-			io->read_proc (input_buffer, sizeof (typename INFO::Block), inputLine, handle);
-			// TODO: probably need some endian work here
-			BYTE *pbSrc = (BYTE *)input_buffer;
-			BYTE *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
-
-			if (width >= 4) {
-				for (int x = 0; x < width; x += 4) {
-					DecodeDXTBlock <DECODER> (pbDst, pbSrc,	line, 4, 4);
-					pbSrc += INFO::bytesPerBlock;
-					pbDst += 4 * 4;
-				}
-			}
-			if (widthRest) {
-				DecodeDXTBlock <DECODER> (pbDst, pbSrc, line, widthRest, 4);
-			}
-		}
-	}
-	if (heightRest)	{
-		io->read_proc (input_buffer, sizeof (typename INFO::Block), inputLine, handle);
-		// TODO: probably need some endian work here
-		BYTE *pbSrc = (BYTE *)input_buffer;
-		BYTE *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
-
-		if (width >= 4) {
-			for (int x = 0; x < width; x += 4) {
-				DecodeDXTBlock <DECODER> (pbDst, pbSrc,	line, 4, heightRest);
-				pbSrc += INFO::bytesPerBlock;
-				pbDst += 4 * 4;
-			}
+/**
+Reads a whole block compressed surface in one go, and decodes it straight into the dib.
+Surfaces in a memory stream or a mapped file are decoded where they are, without a copy.
+BC4 comes back as an 8-bit greyscale image, BC5 as 24-bit with blue left at 0, and everything else as 32-bit.
+*/
+static FIBITMAP *
+LoadDXT(const DDSINFO *info, unsigned level, FreeImageIO *io, fi_handle handle) {
+	const unsigned width = GetLevelWidth(info, level);
+	const unsigned height = GetLevelHeight(info, level);
+	const size_t size = GetLevelSize(info, level);
+
+	const BYTE *blocks = NULL;
+	BYTE *buffer = NULL;
+	const unsigned mapped = GetMemoryIOView(io, handle, (unsigned)size, &blocks);
+	if(mapped == 0) {
+		buffer = (BYTE*)malloc(size);
+		if(!buffer) {
+			FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+			return NULL;
 		}
-		if (widthRest) {
-			DecodeDXTBlock <DECODER> (pbDst, pbSrc,	line, widthRest, heightRest);
+		if(io->read_proc(buffer, 1, (unsigned)size, handle) != size) {
+			free(buffer);
+			FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_PARSING);
+			return NULL;
 		}
-
+		blocks = buffer;
+	} else if(mapped != size) {
+		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_PARSING);
+		return NULL;
 	}
 
-	delete [] input_buffer;
-}
-
-static FIBITMAP *
-LoadDXT (int type, DDSURFACEDESC2 &desc, FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	int width = (int)desc.dwWidth & ~3;
-	int height = (int)desc.dwHeight & ~3;
-
 	// allocate a 32-bit dib
 	FIBITMAP *dib = FreeImage_Allocate (width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-	if (dib == NULL)
+	if (dib == NULL) {
+		free(buffer);
 		return NULL;
-
-	int bpp = FreeImage_GetBPP (dib);
-	int line = CalculateLine (width, bpp);
-	BYTE *bits = FreeImage_GetBits (dib);
-
-	// select the right decoder
-	switch (type) {
-		case 1:
-			LoadDXT_Helper <DXT_BLOCKDECODER_1> (io, handle, page, flags, data, dib, width, height, line);
-			break;
-		case 3:
-			LoadDXT_Helper <DXT_BLOCKDECODER_3> (io, handle, page, flags, data, dib, width, height, line);
-			break;
-		case 5:
-			LoadDXT_Helper <DXT_BLOCKDECODER_5> (io, handle, page, flags, data, dib, width, height, line);
-			break;
 	}
-	
+	BC_DecompressImage(info->format, blocks, width, height, FreeImage_GetScanLine(dib, height - 1), -(int)FreeImage_GetPitch(dib));
+	free(buffer);
+
+	FIBITMAP *converted = NULL;
+	if(info->format == BC_FORMAT_BC4) {
+		converted = FreeImage_GetChannel(dib, FICC_RED);
+	} else if(info->format == BC_FORMAT_BC5) {
+		converted = FreeImage_ConvertTo24Bits(dib);
+	}
+	if(converted) {
+		FreeImage_Unload(dib);
+		dib = converted;
+	}
 	return dib;
 }
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -572,62 +566,195 @@ Validate(FreeImageIO *io, fi_handle handle) {
 
 static BOOL DLL_CALLCONV
 SupportsExportDepth(int depth) {
-	return FALSE;
+	return (
+		(depth == 8) ||
+		(depth == 24) ||
+		(depth == 32)
+	);
 }
 
 static BOOL DLL_CALLCONV 
 SupportsExportType(FREE_IMAGE_TYPE type) {
-	return FALSE;
+	return (type == FIT_BITMAP) ? TRUE : FALSE;
 }
 
 // ----------------------------------------------------------
 
 static void * DLL_CALLCONV
 Open(FreeImageIO *io, fi_handle handle, BOOL read) {
-	return NULL;
+	if(!read) {
+		return NULL;
+	}
+	DDSINFO *info = (DDSINFO*)malloc(sizeof(DDSINFO));
+	if(info && !ReadInfo(io, handle, info)) {
+		free(info);
+		info = NULL;
+	}
+	return info;
 }
 
 static void DLL_CALLCONV
 Close(FreeImageIO *io, fi_handle handle, void *data) {
+	free(data);
+}
+
+static int DLL_CALLCONV
+PageCount(FreeImageIO *io, fi_handle handle, void *data) {
+	const DDSINFO *info = (const DDSINFO*)data;
+	return info ? (int)(info->surfaces * info->levels) : 0;
 }
 
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	DDSHEADER header;
-	FIBITMAP *dib = NULL;
-
-	memset(&header, 0, sizeof(header));
-	io->read_proc(&header, 1, sizeof(header), handle);
-#ifdef FREEIMAGE_BIGENDIAN
-	SwapHeader(&header);
-#endif
-	if (header.surfaceDesc.ddpfPixelFormat.dwFlags & DDPF_RGB) {
-		dib = LoadRGB (header.surfaceDesc, io, handle, page, flags, data);
+	const DDSINFO *info = (const DDSINFO*)data;
+	if(!info) {
+		return NULL;
 	}
-	else if (header.surfaceDesc.ddpfPixelFormat.dwFlags & DDPF_FOURCC) {
-		switch (header.surfaceDesc.ddpfPixelFormat.dwFourCC) {
-			case FOURCC_DXT1:
-				dib = LoadDXT (1, header.surfaceDesc, io, handle, page, flags, data);
-				break;
-			case FOURCC_DXT3:
-				dib = LoadDXT (3, header.surfaceDesc, io, handle, page, flags, data);
-				break;
-			case FOURCC_DXT5:
-				dib = LoadDXT (5, header.surfaceDesc, io, handle, page, flags, data);
-				break;
+
+	if(page < 0) {
+		// like the JPEG loader, take a size hint from the upper 16 bits of flags, 
+		// and load the smallest mipmap which still covers it
+		page = 0;
+		const unsigned requested_size = (unsigned)flags >> 16;
+		while(requested_size && (page + 1 < (int)info->levels) && (MAX(GetLevelWidth(info, page + 1), GetLevelHeight(info, page + 1)) >= requested_size)) {
+			page++;
 		}
 	}
-	return dib;
+
+	unsigned level = 0;
+	const long offset = GetPageOffset(info, page, &level);
+	if(offset < 0) {
+		return NULL;
+	}
+	io->seek_proc(handle, offset, SEEK_SET);
+
+	return info->format ? LoadDXT(info, level, io, handle) : LoadRGB(info, level, io, handle);
 }
 
-/*
 static BOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
-	return FALSE;
+	if(!dib || !handle || !FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+		return FALSE;
+	}
+
+	BYTE *pixels = NULL;
+	BYTE *blocks = NULL;
+
+	try {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+
+		// the compressor works on top-down R, G, B, A bytes, which is how the mipmap chain comes out;
+		// BC4 and BC5 usually hold data rather than colors, so those aren't filtered in linear light
+		const unsigned levels = (flags & DDS_MIPMAPS) ? FreeImage_GetMipmapCount(width, height) : 1;
+		const unsigned mipmap_flags = (flags & (DDS_BC4 | DDS_BC5)) ? FI_MIPMAP_LINEAR : FI_MIPMAP_DEFAULT;
+		DWORD offsets[32];
+		pixels = (BYTE*)malloc(FreeImage_GenerateMipmaps(dib, NULL, levels, mipmap_flags, 0, offsets));
+		if(!pixels) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		if(!FreeImage_GenerateMipmaps(dib, pixels, levels, mipmap_flags, 0, offsets)) {
+			throw FI_MSG_ERROR_DIB_MEMORY;
+		}
+
+		BOOL transparent = FALSE;
+		for(size_t i = 0; i < (size_t)width * height; i++) {
+			transparent |= (pixels[i * 4 + 3] != 0xFF);
+		}
+
+		BC_FORMAT format = transparent ? BC_FORMAT_BC3 : BC_FORMAT_BC1;
+		if(flags & DDS_BC1) {
+			format = BC_FORMAT_BC1;
+		} else if(flags & DDS_BC3) {
+			format = BC_FORMAT_BC3;
+		} else if(flags & DDS_BC4) {
+			format = BC_FORMAT_BC4;
+		} else if(flags & DDS_BC5) {
+			format = BC_FORMAT_BC5;
+		} else if(flags & DDS_BC7) {
+			format = BC_FORMAT_BC7;
+		}
+		const BC_QUALITY quality = (flags & DDS_QUALITY_FAST) ? BC_QUALITY_FAST : (flags & DDS_QUALITY_SLOW) ? BC_QUALITY_SLOW : BC_QUALITY_NORMAL;
+		const unsigned block_size = BC_GetBlockSize(format);
+
+		// write the header
+
+		DDSHEADER header;
+		memset(&header, 0, sizeof(header));
+		header.dwMagic = MAKEFOURCC('D','D','S',' ');
+		header.surfaceDesc.dwSize = sizeof(header.surfaceDesc);
+		header.surfaceDesc.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WITH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+		header.surfaceDesc.dwHeight = height;
+		header.surfaceDesc.dwWidth = width;
+		header.surfaceDesc.dwPitchOrLinearSize = ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+		header.surfaceDesc.ddpfPixelFormat.dwSize = sizeof(header.surfaceDesc.ddpfPixelFormat);
+		header.surfaceDesc.ddpfPixelFormat.dwFlags = DDPF_FOURCC;
+		header.surfaceDesc.ddsCaps.dwCaps1 = DDSCAPS_TEXTURE;
+		if(levels > 1) {
+			header.surfaceDesc.dwFlags |= DDSD_MIPMAPCOUNT;
+			header.surfaceDesc.dwMipMapCount = levels;
+			header.surfaceDesc.ddsCaps.dwCaps1 |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+		}
+
+		// DXT1 and DXT5 are understood everywhere; the rest need the DX10 extension
+		DDSHEADER_DXT10 header10;
+		memset(&header10, 0, sizeof(header10));
+		switch(format) {
+			case BC_FORMAT_BC1:
+				header.surfaceDesc.ddpfPixelFormat.dwFourCC = FOURCC_DXT1;
+				break;
+			case BC_FORMAT_BC3:
+				header.surfaceDesc.ddpfPixelFormat.dwFourCC = FOURCC_DXT5;
+				break;
+			default:
+				header.surfaceDesc.ddpfPixelFormat.dwFourCC = FOURCC_DX10;
+				header10.dxgiFormat = (format == BC_FORMAT_BC4) ? DXGI_FORMAT_BC4_UNORM : (format == BC_FORMAT_BC5) ? DXGI_FORMAT_BC5_UNORM : DXGI_FORMAT_BC7_UNORM;
+				header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+				header10.arraySize = 1;
+				break;
+		}
+		const BOOL extended = (header.surfaceDesc.ddpfPixelFormat.dwFourCC == FOURCC_DX10);
+
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapHeader(&header);
+		SwapHeaderDXT10(&header10);
+#endif
+		if(io->write_proc(&header, sizeof(header), 1, handle) != 1) {
+			throw "Failed to write the DDS header";
+		}
+		if(extended && (io->write_proc(&header10, sizeof(header10), 1, handle) != 1)) {
+			throw "Failed to write the DDS header";
+		}
+
+		// write each level
+
+		blocks = (BYTE*)malloc(((width + 3) / 4) * ((height + 3) / 4) * block_size);
+		if(!blocks) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		for(unsigned level = 0; level < levels; level++) {
+			const unsigned level_width = MAX(width >> level, 1U);
+			const unsigned level_height = MAX(height >> level, 1U);
+			const unsigned size = ((level_width + 3) / 4) * ((level_height + 3) / 4) * block_size;
+			BC_CompressImage(format, pixels + offsets[level], level_width, level_height, level_width * 4, blocks, quality);
+			if(io->write_proc(blocks, size, 1, handle) != 1) {
+				throw "Failed to write the DDS data";
+			}
+		}
+
+		free(blocks);
+		free(pixels);
+		return TRUE;
+
+	} catch(const char *message) {
+		free(pixels);
+		free(blocks);
+		FreeImage_OutputMessageProc(s_format_id, message);
+		return FALSE;
+	}
 }
-*/
 
 // ==========================================================
 //   Init
@@ -643,10 +770,10 @@ InitDDS(Plugin *plugin, int format_id) {
 	plugin->regexpr_proc = RegExpr;
 	plugin->open_proc = Open;
 	plugin->close_proc = Close;
-	plugin->pagecount_proc = NULL;
+	plugin->pagecount_proc = PageCount;
 	plugin->pagecapability_proc = NULL;
 	plugin->load_proc = Load;
-	plugin->save_proc = NULL;	//Save;	// not implemented (yet?)
+	plugin->save_proc = Save;
 	plugin->validate_proc = Validate;
 	plugin->mime_proc = MimeType;
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
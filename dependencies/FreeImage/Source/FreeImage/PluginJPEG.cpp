@@ -42,6 +42,7 @@ extern "C" {
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -280,6 +281,17 @@ METHODDEF(boolean)
 fill_input_buffer (j_decompress_ptr cinfo) {
 	freeimage_src_ptr src = (freeimage_src_ptr) cinfo->src;
 
+	// memory streams and mapped files hand over the rest of their bytes in one go, without a copy
+	const BYTE *view = NULL;
+	const unsigned viewed = GetMemoryIOView(src->m_io, src->infile, 0x7FFFFFFF, &view);
+	if (viewed > 0) {
+		src->pub.next_input_byte = (const JOCTET*)view;
+		src->pub.bytes_in_buffer = viewed;
+		src->start_of_file = FALSE;
+
+		return TRUE;
+	}
+
 	size_t nbytes = src->m_io->read_proc(src->buffer, 1, INPUT_BUF_SIZE, src->infile);
 
 	if (nbytes <= 0) {
@@ -43,6 +43,10 @@
 #include "../ZLib/zlib.h"
 #include "../LibPNG/png.h"
 
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
 // ----------------------------------------------------------
 
 typedef struct {
@@ -234,6 +238,374 @@ WriteMetadata(png_structp png_ptr, png_infop info_ptr, FIBITMAP *dib) {
 	return bResult;
 }
 
+// ==========================================================
+// Parallel encoding
+// ==========================================================
+
+#define PNG_BAND_SIZE	262144	// filtered bytes in each independently deflated band of rows
+
+/**
+How the scanlines of a dib become the rows of a non-interlaced PNG, 
+doing the same transformations Save asks of libpng on the serial path
+*/
+typedef struct {
+	FIBITMAP *dib;
+	unsigned width;
+	unsigned height;
+	size_t rowbytes;	// bytes in one PNG row, without its filter type byte
+	unsigned bpp;		// bytes per pixel as the filters see them (at least 1)
+	int filters;		// PNG_FILTER_xxx flags to choose from on each row
+	BOOL to_24;			// 32-bit RGB saved as 24-bit
+	BOOL swap_rb;		// BGR(A) pixels saved as RGB(A)
+	BOOL swap_16;		// 16-bit samples saved big endian
+	BOOL invert;		// min-is-white greyscale saved as min-is-black
+	int level;			// ZLib compression level, 0 to 9
+	int strategy;		// ZLib compression strategy
+} PNGRowFormat;
+
+/**
+One band of rows, filtered and deflated on its own
+*/
+typedef struct {
+	BYTE *data;			// raw deflate blocks, ending on a byte boundary
+	size_t size;
+	size_t capacity;
+	uLong adler;		// Adler-32 of the filtered rows
+	uLong length;		// bytes of filtered rows
+	BOOL ok;
+} PNGBand;
+
+/**
+Predicts a byte from the one bpp bytes to its left (a), the one above (b) and the one above that (c)
+*/
+template <int TYPE> static inline int
+Predict(int a, int b, int c) {
+	switch(TYPE) {
+		case PNG_FILTER_VALUE_SUB:
+			return a;
+		case PNG_FILTER_VALUE_UP:
+			return b;
+		case PNG_FILTER_VALUE_AVG:
+			return (a + b) >> 1;
+		case PNG_FILTER_VALUE_PAETH:
+		{
+			const int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+			return ((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : c;
+		}
+		default:
+			return 0;
+	}
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Paeth predictor of 8 bytes widened to 16 bits, breaking ties in the order a, b, c
+*/
+static inline __m128i
+PaethPredict8(__m128i a, __m128i b, __m128i c) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i p = _mm_sub_epi16(b, c);
+	const __m128i q = _mm_sub_epi16(a, c);
+	const __m128i r = _mm_add_epi16(p, q);
+	const __m128i pa = _mm_max_epi16(p, _mm_sub_epi16(zero, p));
+	const __m128i pb = _mm_max_epi16(q, _mm_sub_epi16(zero, q));
+	const __m128i pc = _mm_max_epi16(r, _mm_sub_epi16(zero, r));
+
+	const __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	const __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+	const __m128i b_or_c = _mm_or_si128(_mm_and_si128(not_b, c), _mm_andnot_si128(not_b, b));
+	return _mm_or_si128(_mm_and_si128(not_a, b_or_c), _mm_andnot_si128(not_a, a));
+}
+
+#endif // FREEIMAGE_SSE2
+
+/**
+Filters one row. Every byte of a filtered row depends only on unfiltered bytes, so the whole row is done 16 bytes at a time.
+@param row Unfiltered row, preceded by at least bpp zero bytes
+@param prev Unfiltered row above it (all zero for the first row), preceded by at least bpp zero bytes
+*/
+template <int TYPE> static void
+FilterRow(BYTE *dst, const BYTE *row, const BYTE *prev, size_t rowbytes, unsigned bpp) {
+	size_t x = 0;
+
+#ifdef FREEIMAGE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+
+	for(; x + 16 <= rowbytes; x += 16) {
+		const __m128i raw = _mm_loadu_si128((const __m128i*)(row + x));
+		const __m128i a = _mm_loadu_si128((const __m128i*)(row + x - bpp));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(prev + x));
+		const __m128i c = _mm_loadu_si128((const __m128i*)(prev + x - bpp));
+		__m128i predicted = zero;
+
+		switch(TYPE) {
+			case PNG_FILTER_VALUE_SUB:
+				predicted = a;
+				break;
+			case PNG_FILTER_VALUE_UP:
+				predicted = b;
+				break;
+			case PNG_FILTER_VALUE_AVG:
+				// pavgb rounds up: take the carry back off where a + b is odd
+				predicted = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+				break;
+			case PNG_FILTER_VALUE_PAETH:
+				predicted = _mm_packus_epi16(
+					PaethPredict8(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero)),
+					PaethPredict8(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero)));
+				break;
+		}
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_sub_epi8(raw, predicted));
+	}
+#endif // FREEIMAGE_SSE2
+
+	for(; x < rowbytes; x++) {
+		dst[x] = (BYTE)(row[x] - Predict<TYPE>(row[x - bpp], prev[x], prev[x - bpp]));
+	}
+}
+
+/**
+libpng's measure of how well a filtered row will compress: the sum of its bytes taken as signed magnitudes
+*/
+static size_t
+FilterCost(const BYTE *row, size_t rowbytes) {
+	size_t x = 0, sum = 0;
+
+#ifdef FREEIMAGE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+
+	for(; x + 16 <= rowbytes; x += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+		// min(v, 256 - v) is the magnitude of v as a signed byte
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_min_epu8(v, _mm_sub_epi8(zero, v)), zero));
+	}
+	sum = (size_t)_mm_cvtsi128_si32(acc) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif // FREEIMAGE_SSE2
+
+	for(; x < rowbytes; x++) {
+		sum += (row[x] < 128) ? row[x] : 256 - row[x];
+	}
+	return sum;
+}
+
+/**
+Copies row y of the PNG (counted from the top) out of the dib, in PNG byte order
+*/
+static void
+PrepareRow(BYTE *dst, const PNGRowFormat &format, unsigned y) {
+	const BYTE *bits = FreeImage_GetScanLine(format.dib, format.height - y - 1);
+
+	if(format.to_24) {
+		FreeImage_ConvertLine32To24(dst, (BYTE*)bits, format.width);
+	} else {
+		memcpy(dst, bits, format.rowbytes);
+	}
+	if(format.swap_rb) {
+		for(size_t x = 0; x < format.rowbytes; x += format.bpp) {
+			const BYTE tmp = dst[x];
+			dst[x] = dst[x + 2];
+			dst[x + 2] = tmp;
+		}
+	}
+	if(format.swap_16) {
+		for(size_t x = 0; x + 1 < format.rowbytes; x += 2) {
+			const BYTE tmp = dst[x];
+			dst[x] = dst[x + 1];
+			dst[x + 1] = tmp;
+		}
+	}
+	if(format.invert) {
+		for(size_t x = 0; x < format.rowbytes; x++) {
+			dst[x] = (BYTE)~dst[x];
+		}
+	}
+}
+
+/**
+Runs deflate until the input is used up (and the flush, if any, is done), growing the band's buffer as needed
+*/
+static BOOL
+DeflateBand(z_stream &stream, PNGBand &band, int flush) {
+	for(;;) {
+		if(stream.avail_out == 0) {
+			const size_t size = band.capacity;
+			BYTE *data = (BYTE*)realloc(band.data, 2 * size);
+			if(!data) {
+				return FALSE;
+			}
+			band.data = data;
+			band.capacity = 2 * size;
+			stream.next_out = data + size;
+			stream.avail_out = (uInt)(band.capacity - size);
+		}
+		const int result = deflate(&stream, flush);
+		if(result == Z_STREAM_ERROR) {
+			return FALSE;
+		}
+		if((flush == Z_FINISH) ? (result == Z_STREAM_END) : ((stream.avail_in == 0) && (stream.avail_out != 0))) {
+			return TRUE;
+		}
+	}
+}
+
+/**
+Filters rows [first, last) with the cheapest allowed filter on each row, and deflates them as one raw stream. 
+The stream of the last band is finished; the others end with a sync flush, so that the streams of all bands 
+can be joined back to back (the approach of pigz).
+*/
+static void
+EncodeBand(const PNGRowFormat &format, unsigned first, unsigned last, BOOL final, PNGBand &band) {
+	typedef void (*FilterProc)(BYTE *dst, const BYTE *row, const BYTE *prev, size_t rowbytes, unsigned bpp);
+	static const FilterProc filter_proc[] = { 
+		FilterRow<PNG_FILTER_VALUE_NONE>, FilterRow<PNG_FILTER_VALUE_SUB>, FilterRow<PNG_FILTER_VALUE_UP>, 
+		FilterRow<PNG_FILTER_VALUE_AVG>, FilterRow<PNG_FILTER_VALUE_PAETH> 
+	};
+	static const int filter_flag[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH };
+
+	const size_t rowbytes = format.rowbytes;
+	const BOOL adaptive = (format.filters & (format.filters - 1)) ? TRUE : FALSE;
+
+	memset(&band, 0, sizeof(PNGBand));
+	band.adler = adler32(0L, Z_NULL, 0);
+	band.length = (uLong)((last - first) * (rowbytes + 1));
+
+	// two unfiltered rows, each after 16 zero bytes, then two filtered rows
+	BYTE *buffer = (BYTE*)calloc(2 * (16 + rowbytes) + 2 * (1 + rowbytes), 1);
+
+	z_stream stream;
+	memset(&stream, 0, sizeof(z_stream));
+	if(!buffer || (deflateInit2(&stream, format.level, Z_DEFLATED, -15, 8, format.strategy) != Z_OK)) {
+		free(buffer);
+		return;
+	}
+	BYTE *prev = buffer + 16;
+	BYTE *row = prev + rowbytes + 16;
+	BYTE *best = row + rowbytes;
+	BYTE *trial = best + rowbytes + 1;
+
+	band.capacity = deflateBound(&stream, band.length) + 16;
+	band.data = (BYTE*)malloc(band.capacity);
+	stream.next_out = band.data;
+	stream.avail_out = (uInt)band.capacity;
+
+	BOOL ok = band.data ? TRUE : FALSE;
+
+	if(ok && (first > 0)) {
+		PrepareRow(prev, format, first - 1);
+	}
+	for(unsigned y = first; ok && (y < last); y++) {
+		PrepareRow(row, format, y);
+
+		size_t best_cost = 0;
+		BOOL chosen = FALSE;
+		for(int type = PNG_FILTER_VALUE_NONE; type < PNG_FILTER_VALUE_LAST; type++) {
+			if(format.filters & filter_flag[type]) {
+				trial[0] = (BYTE)type;
+				filter_proc[type](trial + 1, row, prev, rowbytes, format.bpp);
+
+				// like libpng, the first filter wins a tie
+				const size_t cost = adaptive ? FilterCost(trial + 1, rowbytes) : 0;
+				if(!chosen || (cost < best_cost)) {
+					BYTE *tmp = best;
+					best = trial;
+					trial = tmp;
+					best_cost = cost;
+					chosen = TRUE;
+				}
+			}
+		}
+
+		band.adler = adler32(band.adler, best, (uInt)(rowbytes + 1));
+		stream.next_in = best;
+		stream.avail_in = (uInt)(rowbytes + 1);
+		ok = DeflateBand(stream, band, Z_NO_FLUSH);
+
+		BYTE *tmp = prev;
+		prev = row;
+		row = tmp;
+	}
+	if(ok) {
+		ok = DeflateBand(stream, band, final ? Z_FINISH : Z_SYNC_FLUSH);
+	}
+
+	band.size = band.capacity - stream.avail_out;
+	band.ok = ok;
+
+	deflateEnd(&stream);
+	free(buffer);
+}
+
+/**
+Writes the image data of a non-interlaced PNG: bands of rows are filtered and deflated on every hardware thread, 
+then joined into one ZLib stream, one IDAT chunk per band. 
+Bands are a fixed number of rows, so the file doesn't depend on how many threads wrote it.
+*/
+static void
+WriteParallelIDAT(png_structp png_ptr, const PNGRowFormat &format) {
+	const unsigned band_rows = (unsigned)MAX((size_t)1, PNG_BAND_SIZE / (format.rowbytes + 1));
+	const int band_count = (int)((format.height + band_rows - 1) / band_rows);
+
+	std::vector<PNGBand> bands(band_count);
+	PNGBand *band = &bands[0];
+
+	FreeImage_ParallelFor(0, band_count, 1, [&](int first, int last) {
+		for(int i = first; i < last; i++) {
+			EncodeBand(format, i * band_rows, MIN(format.height, (i + 1) * band_rows), (i == band_count - 1) ? TRUE : FALSE, band[i]);
+		}
+	});
+
+	BOOL ok = TRUE;
+	for(int i = 0; i < band_count; i++) {
+		ok = ok && band[i].ok;
+	}
+
+	if(ok) {
+		// ZLib header (32K window, no dictionary) and trailer (Adler-32 of all the filtered rows)
+		const unsigned level_flags = (format.level < 2) ? 0 : (format.level < 6) ? 1 : (format.level == 6) ? 2 : 3;
+		unsigned header = (0x78 << 8) | (level_flags << 6);
+		header += 31 - (header % 31);
+
+		uLong adler = band[0].adler;
+		for(int i = 1; i < band_count; i++) {
+			adler = adler32_combine(adler, band[i].adler, (z_off_t)band[i].length);
+		}
+
+		const BYTE zlib_header[2] = { (BYTE)(header >> 8), (BYTE)(header & 0xFF) };
+		const BYTE zlib_trailer[4] = { (BYTE)(adler >> 24), (BYTE)(adler >> 16), (BYTE)(adler >> 8), (BYTE)adler };
+
+		try {
+			for(int i = 0; i < band_count; i++) {
+				const BOOL first = (i == 0) ? TRUE : FALSE;
+				const BOOL last = (i == band_count - 1) ? TRUE : FALSE;
+
+				png_write_chunk_start(png_ptr, (png_const_bytep)"IDAT", (png_uint_32)((first ? 2 : 0) + band[i].size + (last ? 4 : 0)));
+				if(first) {
+					png_write_chunk_data(png_ptr, zlib_header, 2);
+				}
+				png_write_chunk_data(png_ptr, band[i].data, band[i].size);
+				if(last) {
+					png_write_chunk_data(png_ptr, zlib_trailer, 4);
+				}
+				png_write_chunk_end(png_ptr);
+			}
+		} catch(...) {
+			for(int i = 0; i < band_count; i++) {
+				free(band[i].data);
+			}
+			throw;
+		}
+	}
+
+	for(int i = 0; i < band_count; i++) {
+		free(band[i].data);
+	}
+	if(!ok) {
+		throw FI_MSG_ERROR_MEMORY;
+	}
+}
+
 // ==========================================================
 // Plugin Interface
 // ==========================================================
@@ -808,6 +1180,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	png_colorp palette = NULL;
 	png_uint_32 width, height;
 	BOOL has_alpha_channel = FALSE;
+	BOOL invert_mono = FALSE;
 
 	RGBQUAD *pal;					// pointer to dib palette
 	int bit_depth, pixel_depth;		// pixel_depth = bit_depth * channels
@@ -883,19 +1256,14 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 			// set the ZLIB compression level or default to PNG default compression level (ZLIB level = 6)
 			int zlib_level = flags & 0x0F;
-			if((zlib_level >= 1) && (zlib_level <= 9)) {
-				png_set_compression_level(png_ptr, zlib_level);
-			} else if((flags & PNG_Z_NO_COMPRESSION) == PNG_Z_NO_COMPRESSION) {
-				png_set_compression_level(png_ptr, Z_NO_COMPRESSION);
+			if((zlib_level < 1) || (zlib_level > 9)) {
+				zlib_level = ((flags & PNG_Z_NO_COMPRESSION) == PNG_Z_NO_COMPRESSION) ? Z_NO_COMPRESSION : 6;
 			}
+			png_set_compression_level(png_ptr, zlib_level);
 
 			// filtered strategy works better for high color images
-			if(pixel_depth >= 16){
-				png_set_compression_strategy(png_ptr, Z_FILTERED);
-				png_set_filter(png_ptr, 0, PNG_FILTER_NONE|PNG_FILTER_SUB|PNG_FILTER_PAETH);
-			} else {
-				png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
-			}
+			const int zlib_strategy = (pixel_depth >= 16) ? Z_FILTERED : Z_DEFAULT_STRATEGY;
+			png_set_compression_strategy(png_ptr, zlib_strategy);
 
 			FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 			if(image_type == FIT_BITMAP) {
@@ -915,6 +1283,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 					if(!bIsTransparent) {
 						// Invert monochrome files to have 0 as black and 1 as white (no break here)
 						png_set_invert_mono(png_ptr);
+						invert_mono = TRUE;
 					}
 					// (fall through)
 
@@ -987,6 +1356,16 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 					break;
 			}
 
+			// row filters: None, Sub and Paeth for high color images, otherwise what libpng would choose
+			const int color_type = png_get_color_type(png_ptr, info_ptr);
+			int row_filters = PNG_ALL_FILTERS;
+			if(pixel_depth >= 16) {
+				row_filters = PNG_FILTER_NONE | PNG_FILTER_SUB | PNG_FILTER_PAETH;
+			} else if((color_type == PNG_COLOR_TYPE_PALETTE) || (bit_depth < 8)) {
+				row_filters = PNG_FILTER_NONE;
+			}
+			png_set_filter(png_ptr, 0, row_filters);
+
 			// write possible ICC profile
 
 			FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
@@ -1030,43 +1409,78 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 			// write out the image data
 
+			if(((flags & PNG_Z_PARALLEL) == PNG_Z_PARALLEL) && !bInterlaced) {
+				// filter and compress bands of rows on every thread, doing by hand 
+				// the transformations libpng is asked for on the serial path
+
+				PNGRowFormat format;
+				format.dib = dib;
+				format.width = width;
+				format.height = height;
+				format.rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+				format.bpp = MAX(1, (png_get_channels(png_ptr, info_ptr) * bit_depth) / 8);
+				format.to_24 = ((pixel_depth == 32) && !has_alpha_channel) ? TRUE : FALSE;
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+				format.swap_rb = (image_type == FIT_BITMAP) && ((color_type == PNG_COLOR_TYPE_RGB) || (color_type == PNG_COLOR_TYPE_RGBA)) ? TRUE : FALSE;
+#else
+				format.swap_rb = FALSE;
+#endif
 #ifndef FREEIMAGE_BIGENDIAN
-			if (bit_depth == 16) {
-				// turn on 16 bit byte swapping
-				png_set_swap(png_ptr);
-			}
+				format.swap_16 = (bit_depth == 16) ? TRUE : FALSE;
+#else
+				format.swap_16 = FALSE;
 #endif
+				format.invert = invert_mono;
+				format.filters = row_filters;
+				format.strategy = zlib_strategy;
+				format.level = zlib_level;
 
-			int number_passes = 1;
-			if (bInterlaced) {
-				number_passes = png_set_interlace_handling(png_ptr);
-			}
+				WriteParallelIDAT(png_ptr, format);
 
-			if ((pixel_depth == 32) && (!has_alpha_channel)) {
-				BYTE *buffer = (BYTE *)malloc(width * 3);
+				// png_write_end refuses to run without seeing libpng write the IDAT chunks itself, 
+				// and everything it would add has already been written by png_write_info
+
+				png_write_chunk(png_ptr, (png_const_bytep)"IEND", NULL, 0);
 
-				// transparent conversion to 24-bit
-				// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
-				for (int pass = 0; pass < number_passes; pass++) {
-					for (png_uint_32 k = 0; k < height; k++) {
-						FreeImage_ConvertLine32To24(buffer, FreeImage_GetScanLine(dib, height - k - 1), width);
-						png_write_row(png_ptr, buffer);
-					}
-				}
-				free(buffer);
 			} else {
-				// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
-				for (int pass = 0; pass < number_passes; pass++) {
-					for (png_uint_32 k = 0; k < height; k++) {
-						png_write_row(png_ptr, FreeImage_GetScanLine(dib, height - k - 1));
+#ifndef FREEIMAGE_BIGENDIAN
+				if (bit_depth == 16) {
+					// turn on 16 bit byte swapping
+					png_set_swap(png_ptr);
+				}
+#endif
+
+				int number_passes = 1;
+				if (bInterlaced) {
+					number_passes = png_set_interlace_handling(png_ptr);
+				}
+
+				if ((pixel_depth == 32) && (!has_alpha_channel)) {
+					BYTE *buffer = (BYTE *)malloc(width * 3);
+
+					// transparent conversion to 24-bit
+					// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
+					for (int pass = 0; pass < number_passes; pass++) {
+						for (png_uint_32 k = 0; k < height; k++) {
+							FreeImage_ConvertLine32To24(buffer, FreeImage_GetScanLine(dib, height - k - 1), width);
+							png_write_row(png_ptr, buffer);
+						}
+					}
+					free(buffer);
+				} else {
+					// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
+					for (int pass = 0; pass < number_passes; pass++) {
+						for (png_uint_32 k = 0; k < height; k++) {
+							png_write_row(png_ptr, FreeImage_GetScanLine(dib, height - k - 1));
+						}
 					}
 				}
-			}
 
-			// It is REQUIRED to call this to finish writing the rest of the file
-			// Bug with png_flush
+				// It is REQUIRED to call this to finish writing the rest of the file
+				// Bug with png_flush
 
-			png_write_end(png_ptr, info_ptr);
+				png_write_end(png_ptr, info_ptr);
+			}
 
 			// clean up after the write, and free any memory allocated
 			if (palette) {
@@ -34,6 +34,8 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <mutex>
+
 ///////////////////////////////////////////////////////////////////////
 
 // Size of a 3D array : 33 x 33 x 33
@@ -97,55 +99,91 @@ WuQuantizer::~WuQuantizer() {
 // element 0 is for base or marginal value
 // NB: these must start out 0!
 
+// Build 3-D color histogram of counts, r/g/b, c^2 for rows [first, last)
+static void
+HistRows(FIBITMAP *dib, unsigned first, unsigned last, unsigned width, unsigned bytespp, WORD *Qadd,
+		 LONG *vwt, LONG *vmr, LONG *vmg, LONG *vmb, UINT64 *m2) {
+	for(unsigned y = first; y < last; y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dib, y);
+		WORD *qadd = Qadd + (size_t)y * width;
+
+		for(unsigned x = 0; x < width; x++) {
+			const int red = bits[FI_RGBA_RED];
+			const int green = bits[FI_RGBA_GREEN];
+			const int blue = bits[FI_RGBA_BLUE];
+			const int inr = (red >> 3) + 1;
+			const int ing = (green >> 3) + 1;
+			const int inb = (blue >> 3) + 1;
+			const int ind = INDEX(inr, ing, inb);
+			qadd[x] = (WORD)ind;
+			// [inr][ing][inb]
+			vwt[ind]++;
+			vmr[ind] += red;
+			vmg[ind] += green;
+			vmb[ind] += blue;
+			m2[ind] += (UINT64)(red * red + green * green + blue * blue);
+			bits += bytespp;
+		}
+	}
+}
+
 // Build 3-D color histogram of counts, r/g/b, c^2
 void 
 WuQuantizer::Hist3D(LONG *vwt, LONG *vmr, LONG *vmg, LONG *vmb, float *m2, int ReserveSize, RGBQUAD *ReservePalette) {
 	int ind = 0;
 	int inr, ing, inb, table[256];
 	int i;
-	unsigned y, x;
 
 	for(i = 0; i < 256; i++)
 		table[i] = i * i;
 
-	if (FreeImage_GetBPP(m_dib) == 24) {
-		for(y = 0; y < height; y++) {
-			BYTE *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for(x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[y*width + x] = (WORD)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 3;
-			}
+	// Each thread builds a histogram of its own rows, then adds it to the whole one.
+	// c^2 is summed as an integer, so the result doesn't depend on how the rows were split.
+
+	UINT64 *vm2 = (UINT64*)calloc(SIZE_3D, sizeof(UINT64));
+	if(!vm2) {
+		throw FI_MSG_ERROR_MEMORY;
+	}
+
+	const unsigned bytespp = (FreeImage_GetBPP(m_dib) == 24) ? 3 : 4;
+	std::mutex merge_lock;
+	BOOL out_of_memory = FALSE;
+
+	FreeImage_ParallelFor(0, (int)height, MAX(1, 65536 / (int)MAX(width, 1U)), [&](int first, int last) {
+		UINT64 *part_m2 = (UINT64*)calloc(SIZE_3D, sizeof(UINT64) + 4 * sizeof(LONG));
+		if(!part_m2) {
+			std::lock_guard<std::mutex> lock(merge_lock);
+			out_of_memory = TRUE;
+			return;
 		}
-	} else {
-		for(y = 0; y < height; y++) {
-			BYTE *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for(x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[y*width + x] = (WORD)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 4;
+		LONG *part_wt = (LONG*)(part_m2 + SIZE_3D);
+		LONG *part_mr = part_wt + SIZE_3D;
+		LONG *part_mg = part_mr + SIZE_3D;
+		LONG *part_mb = part_mg + SIZE_3D;
+
+		HistRows(m_dib, (unsigned)first, (unsigned)last, width, bytespp, Qadd, part_wt, part_mr, part_mg, part_mb, part_m2);
+
+		{
+			std::lock_guard<std::mutex> lock(merge_lock);
+			for(int k = 0; k < SIZE_3D; k++) {
+				vwt[k] += part_wt[k];
+				vmr[k] += part_mr[k];
+				vmg[k] += part_mg[k];
+				vmb[k] += part_mb[k];
+				vm2[k] += part_m2[k];
 			}
 		}
+
+		free(part_m2);
+	});
+
+	for(i = 0; i < SIZE_3D; i++) {
+		m2[i] = (float)vm2[i];
+	}
+	free(vm2);
+
+	if(out_of_memory) {
+		throw FI_MSG_ERROR_MEMORY;
 	}
 
 	if( ReserveSize > 0 ) {
@@ -535,15 +573,18 @@ WuQuantizer::Quantize(int PaletteSize, int ReserveSize, RGBQUAD *ReservePalette)
 			}
 		}
 
-		int npitch = FreeImage_GetPitch(new_dib);
+		const BYTE *Qtag = tag;
 
-		for (unsigned y = 0; y < height; y++) {
-			BYTE *new_bits = FreeImage_GetBits(new_dib) + (y * npitch);
+		FreeImage_ParallelFor(0, (int)height, MAX(1, 65536 / (int)MAX(width, 1U)), [&](int first, int last) {
+			for (unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				BYTE *new_bits = FreeImage_GetScanLine(new_dib, y);
+				const WORD *qadd = Qadd + (size_t)y * width;
 
-			for (unsigned x = 0; x < width; x++) {
-				new_bits[x] = tag[Qadd[y*width + x]];
+				for (unsigned x = 0; x < width; x++) {
+					new_bits[x] = Qtag[qadd[x]];
+				}
 			}
-		}
+		});
 
 		// output 'new_pal' as color look-up table contents,
 		// 'new_bits' as the quantized image (array of table addresses).
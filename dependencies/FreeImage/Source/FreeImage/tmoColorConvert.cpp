@@ -130,8 +130,6 @@ On output, pixel->red == Y, pixel->green == x, pixel->blue == y
 */
 BOOL 
 ConvertInPlaceRGBFToYxy(FIBITMAP *dib) {
-	float result[3];
-
 	if(FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
 
@@ -140,28 +138,45 @@ ConvertInPlaceRGBFToYxy(FIBITMAP *dib) {
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 	
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(unsigned y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += RGB2XYZ[i][0] * pixel[x].red;
-				result[i] += RGB2XYZ[i][1] * pixel[x].green;
-				result[i] += RGB2XYZ[i][2] * pixel[x].blue;
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			FIRGBF *pixel = (FIRGBF*)(bits + (size_t)y * pitch);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			for(; x + 4 <= width; x += 4) {
+				__m128 red, green, blue;
+				TMO_LoadRGB((float*)&pixel[x], red, green, blue);
+				const __m128 X = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(RGB2XYZ[0][0]), red), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[0][1]), green)), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[0][2]), blue));
+				const __m128 Y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(RGB2XYZ[1][0]), red), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[1][1]), green)), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[1][2]), blue));
+				const __m128 Z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(RGB2XYZ[2][0]), red), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[2][1]), green)), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[2][2]), blue));
+				const __m128 W = _mm_add_ps(_mm_add_ps(X, Y), Z);
+				const __m128 positive = _mm_cmpgt_ps(W, zero);
+				// black where W <= 0; the division by a non positive W is masked out
+				const __m128 inv_W = _mm_div_ps(_mm_set1_ps(1.0F), _mm_or_ps(_mm_and_ps(positive, W), _mm_andnot_ps(positive, _mm_set1_ps(1.0F))));
+				TMO_StoreRGB((float*)&pixel[x], _mm_and_ps(positive, Y), _mm_and_ps(positive, _mm_mul_ps(X, inv_W)), _mm_and_ps(positive, _mm_mul_ps(Y, inv_W)));
 			}
-			const float W = result[0] + result[1] + result[2];
-			const float Y = result[1];
-			if(W > 0) { 
-				pixel[x].red   = Y;			    // Y 
-				pixel[x].green = result[0] / W;	// x 
-				pixel[x].blue  = result[1] / W;	// y 	
-			} else {
-				pixel[x].red = pixel[x].green = pixel[x].blue = 0;
+#endif
+			for(; x < width; x++) {
+				float result[3];
+				result[0] = result[1] = result[2] = 0;
+				for (int i = 0; i < 3; i++) {
+					result[i] += RGB2XYZ[i][0] * pixel[x].red;
+					result[i] += RGB2XYZ[i][1] * pixel[x].green;
+					result[i] += RGB2XYZ[i][2] * pixel[x].blue;
+				}
+				const float W = result[0] + result[1] + result[2];
+				const float Y = result[1];
+				if(W > 0) { 
+					pixel[x].red   = Y;			    // Y 
+					pixel[x].green = result[0] / W;	// x 
+					pixel[x].blue  = result[1] / W;	// y 	
+				} else {
+					pixel[x].red = pixel[x].green = pixel[x].blue = 0;
+				}
 			}
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
@@ -174,9 +189,6 @@ On input, pixel->red == Y, pixel->green == x, pixel->blue == y
 */
 BOOL 
 ConvertInPlaceYxyToRGBF(FIBITMAP *dib) {
-	float result[3];
-	float X, Y, Z;
-
 	if(FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
 
@@ -185,34 +197,56 @@ ConvertInPlaceYxyToRGBF(FIBITMAP *dib) {
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(unsigned y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			Y = pixel[x].red;	        // Y 
-			result[1] = pixel[x].green;	// x 
-			result[2] = pixel[x].blue;	// y 
-			if ((Y > EPSILON) && (result[1] > EPSILON) && (result[2] > EPSILON)) {
-				X = (result[1] * Y) / result[2];
-				Z = (X / result[1]) - X - Y;
-			} else {
-				X = Z = EPSILON;
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			FIRGBF *pixel = (FIRGBF*)(bits + (size_t)y * pitch);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			const __m128 epsilon = _mm_set1_ps(EPSILON);
+			for(; x + 4 <= width; x += 4) {
+				__m128 Y, cx, cy;
+				TMO_LoadRGB((float*)&pixel[x], Y, cx, cy);
+				const __m128 valid = _mm_and_ps(_mm_cmpgt_ps(Y, epsilon), _mm_and_ps(_mm_cmpgt_ps(cx, epsilon), _mm_cmpgt_ps(cy, epsilon)));
+				// EPSILON where the chromaticity is undefined; the divisions by such x and y are masked out
+				const __m128 safe_cx = _mm_or_ps(_mm_and_ps(valid, cx), _mm_andnot_ps(valid, epsilon));
+				const __m128 safe_cy = _mm_or_ps(_mm_and_ps(valid, cy), _mm_andnot_ps(valid, epsilon));
+				__m128 X = _mm_div_ps(_mm_mul_ps(safe_cx, Y), safe_cy);
+				__m128 Z = _mm_sub_ps(_mm_sub_ps(_mm_div_ps(X, safe_cx), X), Y);
+				X = _mm_or_ps(_mm_and_ps(valid, X), _mm_andnot_ps(valid, epsilon));
+				Z = _mm_or_ps(_mm_and_ps(valid, Z), _mm_andnot_ps(valid, epsilon));
+				const __m128 red   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(XYZ2RGB[0][0]), X), _mm_mul_ps(_mm_set1_ps(XYZ2RGB[0][1]), Y)), _mm_mul_ps(_mm_set1_ps(XYZ2RGB[0][2]), Z));
+				const __m128 green = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(XYZ2RGB[1][0]), X), _mm_mul_ps(_mm_set1_ps(XYZ2RGB[1][1]), Y)), _mm_mul_ps(_mm_set1_ps(XYZ2RGB[1][2]), Z));
+				const __m128 blue  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(XYZ2RGB[2][0]), X), _mm_mul_ps(_mm_set1_ps(XYZ2RGB[2][1]), Y)), _mm_mul_ps(_mm_set1_ps(XYZ2RGB[2][2]), Z));
+				TMO_StoreRGB((float*)&pixel[x], red, green, blue);
 			}
-			pixel[x].red   = X;
-			pixel[x].green = Y;
-			pixel[x].blue  = Z;
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += XYZ2RGB[i][0] * pixel[x].red;
-				result[i] += XYZ2RGB[i][1] * pixel[x].green;
-				result[i] += XYZ2RGB[i][2] * pixel[x].blue;
+#endif
+			for(; x < width; x++) {
+				float result[3];
+				float X, Y, Z;
+				Y = pixel[x].red;	        // Y 
+				result[1] = pixel[x].green;	// x 
+				result[2] = pixel[x].blue;	// y 
+				if ((Y > EPSILON) && (result[1] > EPSILON) && (result[2] > EPSILON)) {
+					X = (result[1] * Y) / result[2];
+					Z = (X / result[1]) - X - Y;
+				} else {
+					X = Z = EPSILON;
+				}
+				pixel[x].red   = X;
+				pixel[x].green = Y;
+				pixel[x].blue  = Z;
+				result[0] = result[1] = result[2] = 0;
+				for (int i = 0; i < 3; i++) {
+					result[i] += XYZ2RGB[i][0] * pixel[x].red;
+					result[i] += XYZ2RGB[i][1] * pixel[x].green;
+					result[i] += XYZ2RGB[i][2] * pixel[x].blue;
+				}
+				pixel[x].red   = result[0];	// R
+				pixel[x].green = result[1];	// G
+				pixel[x].blue  = result[2];	// B
 			}
-			pixel[x].red   = result[0];	// R
-			pixel[x].green = result[1];	// G
-			pixel[x].blue  = result[2];	// B
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
@@ -235,21 +269,53 @@ LuminanceFromYxy(FIBITMAP *Yxy, float *maxLum, float *minLum, float *worldLum) {
 	const unsigned height = FreeImage_GetHeight(Yxy);
 	const unsigned pitch  = FreeImage_GetPitch(Yxy);
 
+	// statistics of each row, added up in order afterwards so that the result doesn't depend on the threads
+	std::vector<float> row_max(height), row_min(height);
+	std::vector<double> row_sum(height);
+
+	const BYTE *bits = (BYTE*)FreeImage_GetBits(Yxy);
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [&](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			const FIRGBF *pixel = (FIRGBF*)(bits + (size_t)y * pitch);
+			float max_lum = 0, min_lum = 0;
+			double sum = 0;
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			__m128 max4 = _mm_setzero_ps(), min4 = _mm_setzero_ps();
+			for(; x + 4 <= width; x += 4) {
+				__m128 Y, cx, cy;
+				TMO_LoadRGB((float*)&pixel[x], Y, cx, cy);
+				Y = _mm_max_ps(_mm_setzero_ps(), Y);
+				max4 = _mm_max_ps(max4, Y);
+				min4 = _mm_min_ps(min4, Y);
+				sum += TMO_SumToDouble(TMO_Log(_mm_add_ps(_mm_set1_ps(2.3e-5F), Y)));
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, max4);
+			max_lum = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+			_mm_storeu_ps(lanes, min4);
+			min_lum = MIN(MIN(lanes[0], lanes[1]), MIN(lanes[2], lanes[3]));
+#endif
+			for(; x < width; x++) {
+				const float Y = MAX(0.0F, pixel[x].red);// avoid negative values
+				max_lum = (max_lum < Y) ? Y : max_lum;	// max Luminance in the scene
+				min_lum = (min_lum < Y) ? min_lum : Y;	// min Luminance in the scene
+				sum += log(2.3e-5F + Y);				// contrast constant in Tumblin paper
+			}
+			row_max[y] = max_lum;
+			row_min[y] = min_lum;
+			row_sum[y] = sum;
+		}
+	});
+
 	float max_lum = 0, min_lum = 0;
 	double sum = 0;
-
-	BYTE *bits = (BYTE*)FreeImage_GetBits(Yxy);
 	for(unsigned y = 0; y < height; y++) {
-		const FIRGBF *pixel = (FIRGBF*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float Y = MAX(0.0F, pixel[x].red);// avoid negative values
-			max_lum = (max_lum < Y) ? Y : max_lum;	// max Luminance in the scene
-			min_lum = (min_lum < Y) ? min_lum : Y;	// min Luminance in the scene
-			sum += log(2.3e-5F + Y);				// contrast constant in Tumblin paper
-		}
-		// next line
-		bits += pitch;
+		max_lum = MAX(max_lum, row_max[y]);
+		min_lum = MIN(min_lum, row_min[y]);
+		sum += row_sum[y];
 	}
+
 	// maximum luminance
 	*maxLum = max_lum;
 	// minimum luminance
@@ -280,25 +346,25 @@ ClampConvertRGBFTo24(FIBITMAP *src) {
 	const unsigned src_pitch  = FreeImage_GetPitch(src);
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
 
-	BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+	const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
 	BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
 
-	for(unsigned y = 0; y < height; y++) {
-		const FIRGBF *src_pixel = (FIRGBF*)src_bits;
-		BYTE *dst_pixel = (BYTE*)dst_bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float red   = (src_pixel[x].red > 1)   ? 1 : src_pixel[x].red;
-			const float green = (src_pixel[x].green > 1) ? 1 : src_pixel[x].green;
-			const float blue  = (src_pixel[x].blue > 1)  ? 1 : src_pixel[x].blue;
-			
-			dst_pixel[FI_RGBA_RED]   = (BYTE)(255.0F * red   + 0.5F);
-			dst_pixel[FI_RGBA_GREEN] = (BYTE)(255.0F * green + 0.5F);
-			dst_pixel[FI_RGBA_BLUE]  = (BYTE)(255.0F * blue  + 0.5F);
-			dst_pixel += 3;
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			const FIRGBF *src_pixel = (FIRGBF*)(src_bits + (size_t)y * src_pitch);
+			BYTE *dst_pixel = dst_bits + (size_t)y * dst_pitch;
+			for(unsigned x = 0; x < width; x++) {
+				const float red   = (src_pixel[x].red > 1)   ? 1 : src_pixel[x].red;
+				const float green = (src_pixel[x].green > 1) ? 1 : src_pixel[x].green;
+				const float blue  = (src_pixel[x].blue > 1)  ? 1 : src_pixel[x].blue;
+				
+				dst_pixel[FI_RGBA_RED]   = (BYTE)(255.0F * red   + 0.5F);
+				dst_pixel[FI_RGBA_GREEN] = (BYTE)(255.0F * green + 0.5F);
+				dst_pixel[FI_RGBA_BLUE]  = (BYTE)(255.0F * blue  + 0.5F);
+				dst_pixel += 3;
+			}
 		}
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	});
 
 	return dst;
 }
@@ -326,21 +392,28 @@ ConvertRGBFToY(FIBITMAP *src) {
 	const unsigned src_pitch  = FreeImage_GetPitch(src);
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
 
-	
-	BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+	const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
 	BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
 
-	for(unsigned y = 0; y < height; y++) {
-		const FIRGBF *src_pixel = (FIRGBF*)src_bits;
-		float  *dst_pixel = (float*)dst_bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float L = LUMA_REC709(src_pixel[x].red, src_pixel[x].green, src_pixel[x].blue);
-			dst_pixel[x] = (L > 0) ? L : 0;
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			const FIRGBF *src_pixel = (FIRGBF*)(src_bits + (size_t)y * src_pitch);
+			float *dst_pixel = (float*)(dst_bits + (size_t)y * dst_pitch);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			for(; x + 4 <= width; x += 4) {
+				__m128 red, green, blue;
+				TMO_LoadRGB((float*)&src_pixel[x], red, green, blue);
+				const __m128 L = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.2126F), red), _mm_mul_ps(_mm_set1_ps(0.7152F), green)), _mm_mul_ps(_mm_set1_ps(0.0722F), blue));
+				_mm_storeu_ps(&dst_pixel[x], _mm_max_ps(L, _mm_setzero_ps()));
+			}
+#endif
+			for(; x < width; x++) {
+				const float L = LUMA_REC709(src_pixel[x].red, src_pixel[x].green, src_pixel[x].blue);
+				dst_pixel[x] = (L > 0) ? L : 0;
+			}
 		}
-		// next line
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	});
 
 	return dst;
 }
@@ -364,21 +437,53 @@ LuminanceFromY(FIBITMAP *dib, float *maxLum, float *minLum, float *Lav, float *L
 	unsigned height = FreeImage_GetHeight(dib);
 	unsigned pitch  = FreeImage_GetPitch(dib);
 
+	// statistics of each row, added up in order afterwards so that the result doesn't depend on the threads
+	std::vector<float> row_max(height), row_min(height);
+	std::vector<double> row_sum(height), row_log_sum(height);
+
+	const BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [&](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			const float *pixel = (float*)(bits + (size_t)y * pitch);
+			float max_lum = -1e20F, min_lum = 1e20F;
+			double sumLum = 0, sumLogLum = 0;
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			__m128 max4 = _mm_set1_ps(max_lum), min4 = _mm_set1_ps(min_lum);
+			for(; x + 4 <= width; x += 4) {
+				const __m128 Y = _mm_loadu_ps(&pixel[x]);
+				max4 = _mm_max_ps(max4, Y);
+				min4 = _mm_min_ps(min4, Y);
+				sumLum += TMO_SumToDouble(Y);
+				sumLogLum += TMO_SumToDouble(TMO_Log(_mm_add_ps(_mm_set1_ps(2.3e-5F), Y)));
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, max4);
+			max_lum = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+			_mm_storeu_ps(lanes, min4);
+			min_lum = MIN(MIN(lanes[0], lanes[1]), MIN(lanes[2], lanes[3]));
+#endif
+			for(; x < width; x++) {
+				const float Y = pixel[x];
+				max_lum = (max_lum < Y) ? Y : max_lum;	// max Luminance in the scene
+				min_lum = (min_lum < Y) ? min_lum : Y;	// min Luminance in the scene (Y is never negative)
+				sumLum += Y;							// average luminance
+				sumLogLum += log(2.3e-5F + Y);			// contrast constant in Tumblin paper
+			}
+			row_max[y] = max_lum;
+			row_min[y] = min_lum;
+			row_sum[y] = sumLum;
+			row_log_sum[y] = sumLogLum;
+		}
+	});
+
 	float max_lum = -1e20F, min_lum = 1e20F;
 	double sumLum = 0, sumLogLum = 0;
-
-	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
 	for(unsigned y = 0; y < height; y++) {
-		const float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float Y = pixel[x];
-			max_lum = (max_lum < Y) ? Y : max_lum;				// max Luminance in the scene
-			min_lum = ((Y > 0) && (min_lum < Y)) ? min_lum : Y;	// min Luminance in the scene
-			sumLum += Y;										// average luminance
-			sumLogLum += log(2.3e-5F + Y);						// contrast constant in Tumblin paper
-		}
-		// next line
-		bits += pitch;
+		max_lum = MAX(max_lum, row_max[y]);
+		min_lum = MIN(min_lum, row_min[y]);
+		sumLum += row_sum[y];
+		sumLogLum += row_log_sum[y];
 	}
 
 	// maximum luminance
@@ -429,7 +534,7 @@ and normalize between 0 and 1.
 */
 void 
 NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct) {
-	int x, y;
+	int y;
 	float maxLum, minLum;
 
 	if(minPrct > maxPrct) {
@@ -448,17 +553,25 @@ NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct) {
 		maxLum = 0, minLum = 0;
 		findMaxMinPercentile(Y, minPrct, &minLum, maxPrct, &maxLum);
 	} else {
+		std::vector<float> row_max(height), row_min(height);
+		const BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
+		FreeImage_ParallelFor(0, height, ToneMappingMinRows(width), [&](int first, int last) {
+			for(int y = first; y < last; y++) {
+				const float *pixel = (float*)(bits + (size_t)y * pitch);
+				float max_row = -1e20F, min_row = 1e20F;
+				for(int x = 0; x < width; x++) {
+					const float value = pixel[x];
+					max_row = (max_row < value) ? value : max_row;	// max Luminance in the scene
+					min_row = (min_row < value) ? min_row : value;	// min Luminance in the scene
+				}
+				row_max[y] = max_row;
+				row_min[y] = min_row;
+			}
+		});
 		maxLum = -1e20F, minLum = 1e20F;
-		BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
 		for(y = 0; y < height; y++) {
-			const float *pixel = (float*)bits;
-			for(x = 0; x < width; x++) {
-				const float value = pixel[x];
-				maxLum = (maxLum < value) ? value : maxLum;	// max Luminance in the scene
-				minLum = (minLum < value) ? minLum : value;	// min Luminance in the scene
-			}
-			// next line
-			bits += pitch;
+			maxLum = MAX(maxLum, row_max[y]);
+			minLum = MIN(minLum, row_min[y]);
 		}
 	}
 	if(maxLum == minLum) return;
@@ -466,14 +579,14 @@ NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct) {
 	// normalize to range 0..1 
 	const float divider = maxLum - minLum;
 	BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
-	for(y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(x = 0; x < width; x++) {
-			pixel[x] = (pixel[x] - minLum) / divider;
-			if(pixel[x] <= 0) pixel[x] = EPSILON;
-			if(pixel[x] > 1) pixel[x] = 1;
+	FreeImage_ParallelFor(0, height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(int y = first; y < last; y++) {
+			float *pixel = (float*)(bits + (size_t)y * pitch);
+			for(int x = 0; x < width; x++) {
+				pixel[x] = (pixel[x] - minLum) / divider;
+				if(pixel[x] <= 0) pixel[x] = EPSILON;
+				if(pixel[x] > 1) pixel[x] = 1;
+			}
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 }
@@ -68,9 +68,7 @@ static BOOL
 ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float biasParam, const float exposure) {
 	const float LOG05 = -0.693147F;	// log(0.5) 
 
-	double Lmax, divider, interpol, biasP;
-	unsigned x, y;
-	double L;
+	double Lmax, divider, biasP;
 
 	if(FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
@@ -97,22 +95,44 @@ ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float
 	further acceleration is obtained by a Pad approximation of log(x + 1)
 	*/
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(x = 0; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			FIRGBF *pixel = (FIRGBF*)(bits + (size_t)y * pitch);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			// single precision, four pixels at a time
+			const __m128 one = _mm_set1_ps(1), two = _mm_set1_ps(2);
+			for(; x + 4 <= width; x += 4) {
+				__m128 Yw, x1, y1;
+				TMO_LoadRGB((float*)&pixel[x], Yw, x1, y1);
+				Yw = _mm_mul_ps(_mm_div_ps(Yw, _mm_set1_ps(avgLum)), _mm_set1_ps(exposure));
+				const __m128 interpol4 = TMO_Log(_mm_add_ps(two, _mm_mul_ps(TMO_Pow(_mm_div_ps(Yw, _mm_set1_ps((float)Lmax)), _mm_set1_ps((float)biasP)), _mm_set1_ps(8))));
+				// pade_log(Yw), the three ranges blended by mask
+				const __m128 pade1 = _mm_div_ps(_mm_mul_ps(Yw, _mm_add_ps(_mm_set1_ps(6), Yw)), _mm_add_ps(_mm_set1_ps(6), _mm_mul_ps(_mm_set1_ps(4), Yw)));
+				const __m128 pade2 = _mm_div_ps(_mm_mul_ps(Yw, _mm_add_ps(_mm_set1_ps(6), _mm_mul_ps(_mm_set1_ps(0.7662F), Yw))), _mm_add_ps(_mm_set1_ps(5.9897F), _mm_mul_ps(_mm_set1_ps(3.7658F), Yw)));
+				const __m128 below1 = _mm_cmplt_ps(Yw, one);
+				const __m128 below2 = _mm_cmplt_ps(Yw, two);
+				__m128 L4 = TMO_Log(_mm_add_ps(Yw, one));
+				L4 = _mm_or_ps(_mm_and_ps(below2, pade2), _mm_andnot_ps(below2, L4));
+				L4 = _mm_or_ps(_mm_and_ps(below1, pade1), _mm_andnot_ps(below1, L4));
+				TMO_StoreRGB((float*)&pixel[x], _mm_div_ps(_mm_div_ps(L4, interpol4), _mm_set1_ps((float)divider)), x1, y1);
+			}
+#endif
+			for(; x < width; x++) {
+				double Yw = pixel[x].red / avgLum;
+				Yw *= exposure;
+				const double interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
+				const double L = pade_log(Yw);// log(Yw + 1)
+				pixel[x].red = (float)((L / interpol) / divider);
+			}
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 
 #else
+	unsigned x, y;
 	unsigned index;
 	int i, j;
+	double interpol, L;
 
 	unsigned max_width  = width - (width % 3);
 	unsigned max_height = height - (height % 3); 
@@ -229,16 +249,24 @@ REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(unsigned y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			for(int i = 0; i < 3; i++) {
-				*pixel = (*pixel <= start) ? *pixel * slope : (1.099F * pow(*pixel, fgamma) - 0.099F);
-				pixel++;
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			float *pixel = (float*)(bits + (size_t)y * pitch);
+			// the three channels are corrected alike, so work on the row as a flat array
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			for(; x + 4 <= 3 * width; x += 4) {
+				const __m128 value = _mm_loadu_ps(&pixel[x]);
+				const __m128 linear = _mm_cmple_ps(value, _mm_set1_ps(start));
+				const __m128 curve = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(1.099F), TMO_Pow(value, _mm_set1_ps(fgamma))), _mm_set1_ps(0.099F));
+				_mm_storeu_ps(&pixel[x], _mm_or_ps(_mm_and_ps(linear, _mm_mul_ps(value, _mm_set1_ps(slope))), _mm_andnot_ps(linear, curve)));
+			}
+#endif
+			for(; x < 3 * width; x++) {
+				pixel[x] = (pixel[x] <= start) ? pixel[x] * slope : (1.099F * pow(pixel[x], fgamma) - 0.099F);
 			}
 		}
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
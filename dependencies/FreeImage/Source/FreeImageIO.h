@@ -54,10 +54,25 @@ FI_STRUCT (FIMEMORYHEADER) {
 	Current position into the memory stream
 	*/
 	long current_position;
+	/**
+	TRUE when 'data' is a read-only view of a file (see FreeImage_OpenMapped), to be unmapped rather than freed
+	*/
+	BOOL mapped;
 };
 
 void SetDefaultIO(FreeImageIO *io);
 
 void SetMemoryIO(FreeImageIO *io);
 
+/**
+Lets a plugin decode straight from the bytes of a memory stream (including a mapped file) instead of copying them out.
+@param io The IO functions the plugin was given
+@param handle The handle the plugin was given
+@param size The number of bytes wanted
+@param data Receives the address of the bytes at the current position
+@return Returns the number of bytes available, up to size, and moves the stream past them; 
+returns 0 and leaves the stream alone if handle isn't a memory stream, in which case the plugin should use io->read_proc
+*/
+unsigned GetMemoryIOView(FreeImageIO *io, fi_handle handle, unsigned size, const BYTE **data);
+
 #endif // !FREEIMAGEIO_H
@@ -26,10 +26,63 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
 // ----------------------------------------------------------
 //   Helpers
 // ----------------------------------------------------------
 
+/**
+Alpha blends a line of samples: dst = (src * alpha + dst * (256 - alpha)) / 256, 
+which is the same as ((src - dst) * alpha + (dst << 8)) >> 8 and always fits in 16 bits.
+*/
+static void 
+BlendLine(BYTE *dst_bits, const BYTE *src_bits, unsigned count, unsigned alpha) {
+	unsigned i = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i src_weight = _mm_set1_epi16((short)alpha);
+	const __m128i dst_weight = _mm_set1_epi16((short)(256 - alpha));
+	for(; i + 16 <= count; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src_bits + i));
+		const __m128i d = _mm_loadu_si128((const __m128i*)(dst_bits + i));
+		const __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), src_weight), _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), dst_weight));
+		const __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), src_weight), _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), dst_weight));
+		_mm_storeu_si128((__m128i*)(dst_bits + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+	}
+#endif
+	for(; i < count; i++) {
+		dst_bits[i] = (BYTE)(((src_bits[i] - dst_bits[i]) * alpha + (dst_bits[i] << 8)) >> 8);
+	}
+}
+
+/**
+Copies (alpha > 255) or alpha blends the lines of src_dib into dst_dib at (x, y), a band of lines per thread. 
+The caller has checked that src_dib fits.
+*/
+static void 
+CombineLines(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned bytespp, unsigned alpha) {
+	const unsigned src_height = FreeImage_GetHeight(src_dib);
+	const unsigned src_line   = FreeImage_GetLine(src_dib);
+	const unsigned src_pitch  = FreeImage_GetPitch(src_dib);
+	const unsigned dst_pitch  = FreeImage_GetPitch(dst_dib);
+
+	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - src_height - y) * dst_pitch) + (x * bytespp);
+	const BYTE *src_bits = FreeImage_GetBits(src_dib);
+
+	FreeImage_ParallelFor(0, (int)src_height, MAX(1, 65536 / (int)src_line), [=](int first, int last) {
+		for(int rows = first; rows < last; rows++) {
+			if(alpha > 255) {
+				memcpy(dst_bits + rows * dst_pitch, src_bits + rows * src_pitch, src_line);
+			} else {
+				BlendLine(dst_bits + rows * dst_pitch, src_bits + rows * src_pitch, src_line, alpha);
+			}
+		}
+	});
+}
+
 /////////////////////////////////////////////////////////////
 // Alpha blending / combine functions
 
@@ -205,28 +258,8 @@ Combine8(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		return FALSE;
 	}
 
-	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x);
-	BYTE *src_bits = FreeImage_GetBits(src_dib);	
-
-	if(alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// copy or alpha blend images
+	CombineLines(dst_dib, src_dib, x, y, 1, alpha);
 
 	return TRUE;
 }
@@ -371,28 +404,8 @@ Combine24(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		return FALSE;
 	}
 
-	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 3);
-	BYTE *src_bits = FreeImage_GetBits(src_dib);	
-
-	if(alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// copy or alpha blend images
+	CombineLines(dst_dib, src_dib, x, y, 3, alpha);
 
 	return TRUE;
 }
@@ -413,28 +426,8 @@ Combine32(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		return FALSE;
 	}
 
-	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 4);
-	BYTE *src_bits = FreeImage_GetBits(src_dib);	
-
-	if (alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for(unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// copy or alpha blend images
+	CombineLines(dst_dib, src_dib, x, y, 4, alpha);
 
 	return TRUE;
 }
@@ -452,27 +445,17 @@ CombineSameType(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y) {
 
 	unsigned src_width  = FreeImage_GetWidth(src_dib);
 	unsigned src_height = FreeImage_GetHeight(src_dib);
-	unsigned src_pitch  = FreeImage_GetPitch(src_dib);
 	unsigned src_line   = FreeImage_GetLine(src_dib);
 	unsigned dst_width  = FreeImage_GetWidth(dst_dib);
 	unsigned dst_height = FreeImage_GetHeight(dst_dib);
-	unsigned dst_pitch  = FreeImage_GetPitch(dst_dib);
 	
 	// check the size of src image
 	if((x + src_width > dst_width) || (y + src_height > dst_height)) {
 		return FALSE;
 	}	
 
-	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((dst_height - src_height - y) * dst_pitch) + (x * (src_line / src_width));
-	BYTE *src_bits = FreeImage_GetBits(src_dib);	
-
 	// combine images	
-	for(unsigned rows = 0; rows < src_height; rows++) {
-		memcpy(dst_bits, src_bits, src_line);
-
-		dst_bits += dst_pitch;
-		src_bits += src_pitch;
-	}
+	CombineLines(dst_dib, src_dib, x, y, src_line / src_width, 256);
 
 	return TRUE;
 }
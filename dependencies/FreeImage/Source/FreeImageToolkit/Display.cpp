@@ -22,6 +22,119 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//   Line helpers
+// ----------------------------------------------------------
+
+//! number of pixels composited at a time, through line buffers on the stack
+#define COMPOSITE_CHUNK	256
+
+/**
+Composites a line of BGRA foreground pixels against a line of BGR[A] background pixels, 
+into BGR[A] pixels whose alpha is left undefined: 
+output = background if alpha = 0, foreground if alpha = 255, (alpha * foreground + (255 - alpha) * background) / 256 otherwise
+*/
+static void 
+CompositeLine(BYTE *cp_bits, const BYTE *fg_bits, const BYTE *bk_bits, unsigned width) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i opaque = _mm_set1_epi16(255);
+	for(; x + 4 <= width; x += 4) {
+		const __m128i fg = _mm_loadu_si128((const __m128i*)(fg_bits + 4 * x));
+		const __m128i bk = _mm_loadu_si128((const __m128i*)(bk_bits + 4 * x));
+		__m128i result[2];
+		for(int k = 0; k < 2; k++) {
+			// two pixels as 16-bit samples, with each pixel's alpha spread over its samples
+			const __m128i f = k ? _mm_unpackhi_epi8(fg, zero) : _mm_unpacklo_epi8(fg, zero);
+			const __m128i b = k ? _mm_unpackhi_epi8(bk, zero) : _mm_unpacklo_epi8(bk, zero);
+			const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f, _MM_SHUFFLE(FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA)), _MM_SHUFFLE(FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA));
+			// at most 255 * 255: fits in 16 bits
+			const __m128i blend = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, f), _mm_mullo_epi16(_mm_sub_epi16(opaque, a), b)), 8);
+			const __m128i is_bk = _mm_cmpeq_epi16(a, zero);
+			const __m128i is_fg = _mm_cmpeq_epi16(a, opaque);
+			result[k] = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(is_bk, is_fg), blend), _mm_or_si128(_mm_and_si128(is_bk, b), _mm_and_si128(is_fg, f)));
+		}
+		_mm_storeu_si128((__m128i*)(cp_bits + 4 * x), _mm_packus_epi16(result[0], result[1]));
+	}
+#endif
+	for(; x < width; x++) {
+		const BYTE *fg = fg_bits + 4 * x;
+		const BYTE *bk = bk_bits + 4 * x;
+		BYTE *cp = cp_bits + 4 * x;
+		const BYTE alpha = fg[FI_RGBA_ALPHA];
+		if(alpha == 0) {
+			// output = background
+			AssignPixel(cp, bk, 4);
+		}
+		else if(alpha == 255) {
+			// output = foreground
+			AssignPixel(cp, fg, 4);
+		}
+		else {
+			// output = alpha * foreground + (1-alpha) * background
+			const BYTE not_alpha = (BYTE)~alpha;
+			cp[FI_RGBA_BLUE] = (BYTE)((alpha * (WORD)fg[FI_RGBA_BLUE]  + not_alpha * (WORD)bk[FI_RGBA_BLUE]) >> 8);
+			cp[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)fg[FI_RGBA_GREEN] + not_alpha * (WORD)bk[FI_RGBA_GREEN]) >> 8);
+			cp[FI_RGBA_RED] = (BYTE)((alpha * (WORD)fg[FI_RGBA_RED]   + not_alpha * (WORD)bk[FI_RGBA_RED]) >> 8);
+		}
+	}
+}
+
+/**
+Pre-multiplies a line of 32-bit pixels with their alpha: 
+channel = (channel * alpha + 127) / 255, where x / 255 = (x + 1 + (x >> 8)) >> 8 for all the x involved
+*/
+static void 
+PreMultiplyLine(BYTE *bits, unsigned width) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(127);
+	const __m128i one = _mm_set1_epi16(1);
+	// 0xFFFF for the alpha samples of two pixels, which are kept as they are
+	const __m128i alpha_mask = _mm_slli_epi64(_mm_set_epi32(0, 0xFFFF, 0, 0xFFFF), 16 * FI_RGBA_ALPHA);
+	for(; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(bits + 4 * x));
+		__m128i result[2];
+		for(int k = 0; k < 2; k++) {
+			const __m128i c = k ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+			const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA)), _MM_SHUFFLE(FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA, FI_RGBA_ALPHA));
+			const __m128i p = _mm_add_epi16(_mm_mullo_epi16(c, a), bias);
+			const __m128i q = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(p, one), _mm_srli_epi16(p, 8)), 8);
+			result[k] = _mm_or_si128(_mm_andnot_si128(alpha_mask, q), _mm_and_si128(alpha_mask, c));
+		}
+		_mm_storeu_si128((__m128i*)(bits + 4 * x), _mm_packus_epi16(result[0], result[1]));
+	}
+#endif
+	for(; x < width; x++) {
+		BYTE *pixel = bits + 4 * x;
+		const BYTE alpha = pixel[FI_RGBA_ALPHA];
+		// slightly faster: care for two special cases
+		if(alpha == 0x00) {
+			// special case for alpha == 0x00
+			// color * 0x00 / 0xFF = 0x00
+			pixel[FI_RGBA_BLUE] = 0x00;
+			pixel[FI_RGBA_GREEN] = 0x00;
+			pixel[FI_RGBA_RED] = 0x00;
+		} else if(alpha == 0xFF) {
+			// nothing to do for alpha == 0xFF
+			// color * 0xFF / 0xFF = color
+			continue;
+		} else {
+			pixel[FI_RGBA_BLUE] = (BYTE)( (alpha * (WORD)pixel[FI_RGBA_BLUE] + 127) / 255 );
+			pixel[FI_RGBA_GREEN] = (BYTE)( (alpha * (WORD)pixel[FI_RGBA_GREEN] + 127) / 255 );
+			pixel[FI_RGBA_RED] = (BYTE)( (alpha * (WORD)pixel[FI_RGBA_RED] + 127) / 255 );
+		}
+	}
+}
+
+// ----------------------------------------------------------
+
 
 /**
 @brief Composite a foreground image against a background color or a background image.
@@ -57,29 +170,14 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 			return NULL;
 	}
 
-	int bytespp = (bpp == 8) ? 1 : 4;
-
-	
-	int x, y, c;
-	BYTE alpha = 0, not_alpha;
-	BYTE index;
-	RGBQUAD fgc;	// foreground color
 	RGBQUAD bkc;	// background color
 
-	memset(&fgc, 0, sizeof(RGBQUAD));
 	memset(&bkc, 0, sizeof(RGBQUAD));
 
 	// allocate the composite image
 	FIBITMAP *composite = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 	if(!composite) return NULL;
 
-	// get the palette
-	RGBQUAD *pal = FreeImage_GetPalette(fg);
-
-	// retrieve the alpha table from the foreground image
-	BOOL bIsTransparent = FreeImage_IsTransparent(fg);
-	BYTE *trns = FreeImage_GetTransparencyTable(fg);
-
 	// retrieve the background color from the foreground image
 	BOOL bHasBkColor = FALSE;
 
@@ -99,84 +197,87 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 		}
 	}
 
-	for(y = 0; y < height; y++) {
-		// foreground
-		BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
-		// background
-		BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
-		// composite image
-		BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
-
-		for(x = 0; x < width; x++) {
-
-			// foreground color + alpha
-
-			if(bpp == 8) {
-				// get the foreground color
-				index = fg_bits[0];
-				memcpy(&fgc, &pal[index], sizeof(RGBQUAD));
-				// get the alpha
-				if(bIsTransparent) {
-					alpha = trns[index];
-				} else {
-					alpha = 255;
-				}
-			}
-			else if(bpp == 32) {
-				// get the foreground color
-				fgc.rgbBlue  = fg_bits[FI_RGBA_BLUE];
-				fgc.rgbGreen = fg_bits[FI_RGBA_GREEN];
-				fgc.rgbRed   = fg_bits[FI_RGBA_RED];
-				// get the alpha
-				alpha = fg_bits[FI_RGBA_ALPHA];
+	// foreground color + alpha of each palette entry
+	DWORD fg_colors[256];
+	if(bpp == 8) {
+		// get the palette
+		RGBQUAD *pal = FreeImage_GetPalette(fg);
+
+		// retrieve the alpha table from the foreground image
+		BOOL bIsTransparent = FreeImage_IsTransparent(fg);
+		BYTE *trns = FreeImage_GetTransparencyTable(fg);
+
+		for(int i = 0; i < 256; i++) {
+			BYTE *color = (BYTE*)&fg_colors[i];
+			color[FI_RGBA_BLUE]  = pal[i].rgbBlue;
+			color[FI_RGBA_GREEN] = pal[i].rgbGreen;
+			color[FI_RGBA_RED]   = pal[i].rgbRed;
+			color[FI_RGBA_ALPHA] = bIsTransparent ? trns[i] : 0xFF;
+		}
+	}
+
+	// composite a band of lines per thread, a chunk of each line at a time
+	FreeImage_ParallelFor(0, height, MAX(1, 65536 / width), [&](int first, int last) {
+		DWORD fg_line[COMPOSITE_CHUNK], bk_line[COMPOSITE_CHUNK], cp_line[COMPOSITE_CHUNK];
+
+		if(bHasBkColor) {
+			BYTE *color = (BYTE*)&bk_line[0];
+			color[FI_RGBA_BLUE]  = bkc.rgbBlue;
+			color[FI_RGBA_GREEN] = bkc.rgbGreen;
+			color[FI_RGBA_RED]   = bkc.rgbRed;
+			color[FI_RGBA_ALPHA] = 0xFF;
+			for(int i = 1; i < COMPOSITE_CHUNK; i++) {
+				bk_line[i] = bk_line[0];
 			}
+		}
 
-			// background color
+		for(int y = first; y < last; y++) {
+			// foreground
+			BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
+			// composite image
+			BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
 
-			if(!bHasBkColor) {
-				if(bg) {
-					// get the background color from the background image
-					bkc.rgbBlue  = bg_bits[FI_RGBA_BLUE];
-					bkc.rgbGreen = bg_bits[FI_RGBA_GREEN];
-					bkc.rgbRed   = bg_bits[FI_RGBA_RED];
+			for(int x = 0; x < width; x += COMPOSITE_CHUNK) {
+				const int count = MIN(COMPOSITE_CHUNK, width - x);
+
+				// foreground color + alpha
+
+				const BYTE *fg_pixels = (const BYTE*)fg_line;
+				if(bpp == 8) {
+					for(int i = 0; i < count; i++) {
+						fg_line[i] = fg_colors[fg_bits[x + i]];
+					}
+				} else {
+					fg_pixels = fg_bits + 4 * x;
 				}
-				else {
-					// use a checkerboard pattern
-					c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
-					c = c ? c : 255;
-					bkc.rgbBlue  = (BYTE)c;
-					bkc.rgbGreen = (BYTE)c;
-					bkc.rgbRed   = (BYTE)c;
+
+				// background color
+
+				if(!bHasBkColor) {
+					if(bg) {
+						// get the background color from the background image
+						FreeImage_ConvertLine24To32((BYTE*)bk_line, FreeImage_GetScanLine(bg, y) + 3 * x, count);
+					}
+					else {
+						// use a checkerboard pattern
+						for(int i = 0; i < count; i++) {
+							int c = (((y & 0x8) == 0) ^ (((x + i) & 0x8) == 0)) * 192;
+							c = c ? c : 255;
+							BYTE *color = (BYTE*)&bk_line[i];
+							color[FI_RGBA_BLUE]  = (BYTE)c;
+							color[FI_RGBA_GREEN] = (BYTE)c;
+							color[FI_RGBA_RED]   = (BYTE)c;
+						}
+					}
 				}
-			}
 
-			// composition
+				// composition
 
-			if(alpha == 0) {
-				// output = background
-				cp_bits[FI_RGBA_BLUE] = bkc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = bkc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = bkc.rgbRed;
+				CompositeLine((BYTE*)cp_line, fg_pixels, (const BYTE*)bk_line, count);
+				FreeImage_ConvertLine32To24(cp_bits + 3 * x, (BYTE*)cp_line, count);
 			}
-			else if(alpha == 255) {
-				// output = foreground
-				cp_bits[FI_RGBA_BLUE] = fgc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = fgc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = fgc.rgbRed;
-			}
-			else {
-				// output = alpha * foreground + (1-alpha) * background
-				not_alpha = (BYTE)~alpha;
-				cp_bits[FI_RGBA_BLUE] = (BYTE)((alpha * (WORD)fgc.rgbBlue  + not_alpha * (WORD)bkc.rgbBlue) >> 8);
-				cp_bits[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)fgc.rgbGreen + not_alpha * (WORD)bkc.rgbGreen) >> 8);
-				cp_bits[FI_RGBA_RED] = (BYTE)((alpha * (WORD)fgc.rgbRed   + not_alpha * (WORD)bkc.rgbRed) >> 8);
-			}
-
-			fg_bits += bytespp;
-			bg_bits += 3;
-			cp_bits += 3;
 		}
-	}
+	});
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(composite, fg);
@@ -203,28 +304,11 @@ FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
 	int width = FreeImage_GetWidth(dib);
 	int height = FreeImage_GetHeight(dib);
 
-	for(int y = 0; y < height; y++) {
-		BYTE *bits = FreeImage_GetScanLine(dib, y);
-		for (int x = 0; x < width; x++, bits += 4) {
-			const BYTE alpha = bits[FI_RGBA_ALPHA];
-			// slightly faster: care for two special cases
-			if(alpha == 0x00) {
-				// special case for alpha == 0x00
-				// color * 0x00 / 0xFF = 0x00
-				bits[FI_RGBA_BLUE] = 0x00;
-				bits[FI_RGBA_GREEN] = 0x00;
-				bits[FI_RGBA_RED] = 0x00;
-			} else if(alpha == 0xFF) {
-				// nothing to do for alpha == 0xFF
-				// color * 0xFF / 0xFF = color
-				continue;
-			} else {
-				bits[FI_RGBA_BLUE] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_BLUE] + 127) / 255 );
-				bits[FI_RGBA_GREEN] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_GREEN] + 127) / 255 );
-				bits[FI_RGBA_RED] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_RED] + 127) / 255 );
-			}
+	FreeImage_ParallelFor(0, height, MAX(1, 65536 / width), [=](int first, int last) {
+		for(int y = first; y < last; y++) {
+			PreMultiplyLine(FreeImage_GetScanLine(dib, y), width);
 		}
-	}
+	});
 	return TRUE;
 }
 
@@ -29,6 +29,7 @@
 static const int NPRE	= 1;		// Number of relaxation sweeps before ...
 static const int NPOST	= 1;		// ... and after the coarse-grid correction is computed
 static const int NGMAX	= 15;		// Maximum number of grids
+static const int NCOARSE = 8;		// Minimum number of cells along the short side of the coarsest grid
 
 /**
 Copy src into dst
@@ -44,145 +45,178 @@ static inline void fmg_fillArrayWithZeros(FIBITMAP *src) {
 	memset(FreeImage_GetBits(src), 0, FreeImage_GetHeight(src) * FreeImage_GetPitch(src));
 }
 
+#ifdef FREEIMAGE_SSE2
+
 /**
-Half-weighting restriction. nc is the coarse-grid dimension. The fine-grid solution is input in
-uf[0..2*nc-2][0..2*nc-2], the coarse-grid solution is returned in uc[0..nc-1][0..nc-1].
+Even-numbered elements of v[0..7]
 */
-static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int nc) {
-	int row_uc, row_uf, col_uc, col_uf;
+static inline __m128 fmg_loadEven(const float *v) {
+	return _mm_shuffle_ps(_mm_loadu_ps(v), _mm_loadu_ps(v + 4), _MM_SHUFFLE(2, 0, 2, 0));
+}
 
+/**
+Odd-numbered elements of v[0..7]
+*/
+static inline __m128 fmg_loadOdd(const float *v) {
+	return _mm_shuffle_ps(_mm_loadu_ps(v), _mm_loadu_ps(v + 4), _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+#endif // FREEIMAGE_SSE2
+
+/**
+Half-weighting restriction. ncx x ncy is the coarse-grid dimension. The fine-grid solution is input in
+uf[0..2*ncy-2][0..2*ncx-2], the coarse-grid solution is returned in uc[0..ncy-1][0..ncx-1].
+*/
+static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int ncx, int ncy) {
 	const int uc_pitch  = FreeImage_GetPitch(UC) / sizeof(float);
 	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
 	
 	float *uc_bits = (float*)FreeImage_GetBits(UC);
 	const float *uf_bits = (float*)FreeImage_GetBits(UF);
 
-	// interior points
-	{
-		float *uc_scan = uc_bits + uc_pitch;
-		for (row_uc = 1, row_uf = 2; row_uc < nc-1; row_uc++, row_uf += 2) {
-			const float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uc = 1, col_uf = 2; col_uc < nc-1; col_uc++, col_uf += 2) { 
+	FreeImage_ParallelFor(0, ncy, ToneMappingMinRows(ncx), [=](int first, int last) {
+		for (int row_uc = first; row_uc < last; row_uc++) {
+			float *uc_scan = uc_bits + row_uc * uc_pitch;
+			const float *uf_scan = uf_bits + 2 * row_uc * uf_pitch;
+			if (row_uc == 0 || row_uc == ncy-1) {
+				// boundary points
+				for (int col_uc = 0; col_uc < ncx; col_uc++) {
+					uc_scan[col_uc] = uf_scan[2 * col_uc];
+				}
+				continue;
+			}
+			uc_scan[0] = uf_scan[0];
+			uc_scan[ncx-1] = uf_scan[2 * (ncx-1)];
+			// interior points
+			int col_uc = 1;
+#ifdef FREEIMAGE_SSE2
+			for (; col_uc + 3 < ncx-1; col_uc += 4) {
+				const float *uf_center = uf_scan + 2 * col_uc;
+				const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(fmg_loadEven(uf_center + uf_pitch), fmg_loadEven(uf_center - uf_pitch)), fmg_loadOdd(uf_center)), fmg_loadEven(uf_center - 1));
+				_mm_storeu_ps(uc_scan + col_uc, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.5F), fmg_loadEven(uf_center)), _mm_mul_ps(_mm_set1_ps(0.125F), sum)));
+			}
+#endif
+			for (; col_uc < ncx-1; col_uc++) { 
 				// calculate 
 				// UC(row_uc, col_uc) = 
 				// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
-				float *uc_pixel = uc_scan + col_uc;
-				const float *uf_center = uf_scan + col_uf;
-				*uc_pixel = 0.5F * *uf_center + 0.125F * ( *(uf_center + uf_pitch) + *(uf_center - uf_pitch) + *(uf_center + 1) + *(uf_center - 1) );
+				const float *uf_center = uf_scan + 2 * col_uc;
+				uc_scan[col_uc] = 0.5F * *uf_center + 0.125F * ( *(uf_center + uf_pitch) + *(uf_center - uf_pitch) + *(uf_center + 1) + *(uf_center - 1) );
 			}
-			uc_scan += uc_pitch;
 		}
-	}
-	// boundary points
-	const int ncc = 2*nc-1;
-	{
-		/*
-		calculate the following: 
-		for (row_uc = 0, row_uf = 0; row_uc < nc; row_uc++, row_uf += 2) { 
-			UC(row_uc, 0) = UF(row_uf, 0);		
-			UC(row_uc, nc-1) = UF(row_uf, ncc-1);
-		}
-		*/
-		float *uc_scan = uc_bits;
-		for (row_uc = 0, row_uf = 0; row_uc < nc; row_uc++, row_uf += 2) { 
-			const float *uf_scan = uf_bits + row_uf * uf_pitch;
-			uc_scan[0] = uf_scan[0];
-			uc_scan[nc-1] = uf_scan[ncc-1];
-			uc_scan += uc_pitch;
+	});
+}
+
+/**
+Solution of the model problem on the coarsest grid, by conjugate gradients in double precision. 
+The right-hand side is input in rhs[0..ny-1][0..nx-1] and the solution is returned in u[0..ny-1][0..nx-1].
+*/
+static void fmg_solve(FIBITMAP *U, FIBITMAP *RHS, int nx, int ny) {
+	const double h = 1.0 / (nx - 1);
+	const double h2 = h*h;
+
+	// interior points only, the boundary is zero
+	const int mx = nx - 2;
+	const int my = ny - 2;
+	const int count = mx * my;
+
+	std::vector<double> x(count, 0), r(count), p(count), Ap(count);
+
+	// solve A.x = b, where A.x = 4 * U(row, col) - [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) ]
+	// is positive definite and b = -h2 * RHS(row, col)
+	double rr = 0, bb = 0;
+	for (int row = 0; row < my; row++) {
+		const float *rhs_scan = (float*)FreeImage_GetScanLine(RHS, row + 1) + 1;
+		for (int col = 0; col < mx; col++) {
+			const int k = row * mx + col;
+			r[k] = p[k] = -h2 * rhs_scan[col];
+			rr += r[k] * r[k];
 		}
 	}
-	{
-		/*
-		calculate the following: 
-		for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-			UC(0, col_uc) = UF(0, col_uf);
-			UC(nc-1, col_uc) = UF(ncc-1, col_uf);
+	bb = rr;
+
+	for (int iter = 0; iter < count && rr > 1e-12 * bb; iter++) {
+		double pAp = 0;
+		for (int row = 0; row < my; row++) {
+			for (int col = 0; col < mx; col++) {
+				const int k = row * mx + col;
+				double value = 4 * p[k];
+				if (row > 0) value -= p[k - mx];
+				if (row < my-1) value -= p[k + mx];
+				if (col > 0) value -= p[k - 1];
+				if (col < mx-1) value -= p[k + 1];
+				Ap[k] = value;
+				pAp += p[k] * value;
+			}
+		}
+		const double alpha = rr / pAp;
+		double rr_next = 0;
+		for (int k = 0; k < count; k++) {
+			x[k] += alpha * p[k];
+			r[k] -= alpha * Ap[k];
+			rr_next += r[k] * r[k];
 		}
-		*/
-		float *uc_scan_top = uc_bits;
-		float *uc_scan_bottom = uc_bits + (nc-1)*uc_pitch;
-		const float *uf_scan_top = uf_bits + (ncc-1)*uf_pitch;
-		const float *uf_scan_bottom = uf_bits;
-		for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-			uc_scan_top[col_uc] = uf_scan_top[col_uf];
-			uc_scan_bottom[col_uc] = uf_scan_bottom[col_uf];
+		const double beta = rr_next / rr;
+		for (int k = 0; k < count; k++) {
+			p[k] = r[k] + beta * p[k];
 		}
+		rr = rr_next;
 	}
-}
 
-/**
-Solution of the model problem on the coarsest grid, where h = 1/2 . 
-The right-hand side is input
-in rhs[0..2][0..2] and the solution is returned in u[0..2][0..2].
-*/
-static void fmg_solve(FIBITMAP *U, FIBITMAP *RHS) {
-	// fill U with zeros
 	fmg_fillArrayWithZeros(U);
-	// calculate U(1, 1) = -h*h*RHS(1, 1)/4.0 where h = 1/2
-	float *u_scan = (float*)FreeImage_GetScanLine(U, 1);
-	const float *rhs_scan = (float*)FreeImage_GetScanLine(RHS, 1);
-	u_scan[1] = -rhs_scan[1] / 16;
+	for (int row = 0; row < my; row++) {
+		float *u_scan = (float*)FreeImage_GetScanLine(U, row + 1) + 1;
+		for (int col = 0; col < mx; col++) {
+			u_scan[col] = (float)x[row * mx + col];
+		}
+	}
 }
 
 /**
-Coarse-to-fine prolongation by bilinear interpolation. nf is the fine-grid dimension. The coarsegrid
-solution is input as uc[0..nc-1][0..nc-1], where nc = nf/2 + 1. The fine-grid solution is
-returned in uf[0..nf-1][0..nf-1].
+Coarse-to-fine prolongation by bilinear interpolation. nfx x nfy is the fine-grid dimension. The coarse-grid
+solution is input as uc[0..ncy-1][0..ncx-1], where nc = nf/2 + 1. The fine-grid solution is
+returned in uf[0..nfy-1][0..nfx-1].
 */
-static void fmg_prolongate(FIBITMAP *UF, FIBITMAP *UC, int nf) {
-	int row_uc, row_uf, col_uc, col_uf;
-
+static void fmg_prolongate(FIBITMAP *UF, FIBITMAP *UC, int nfx, int nfy) {
 	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
 	const int uc_pitch  = FreeImage_GetPitch(UC) / sizeof(float);
 	
 	float *uf_bits = (float*)FreeImage_GetBits(UF);
 	const float *uc_bits = (float*)FreeImage_GetBits(UC);
-	
-	// do elements that are copies
-	{
-		const int nc = nf/2 + 1;
-
-		float *uf_scan = uf_bits;
-		const float *uc_scan = uc_bits;		
-		for (row_uc = 0; row_uc < nc; row_uc++) {
-			for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-				// calculate UF(2*row_uc, col_uf) = UC(row_uc, col_uc);
-				uf_scan[col_uf] = uc_scan[col_uc];
-			}
-			uc_scan += uc_pitch;
-			uf_scan += 2 * uf_pitch;
-		}
-	}
-	// do odd-numbered columns, interpolating vertically
-	{		
-		for(row_uf = 1; row_uf < nf-1; row_uf += 2) {
+
+	FreeImage_ParallelFor(0, nfy, ToneMappingMinRows(nfx), [=](int first, int last) {
+		for (int row_uf = first; row_uf < last; row_uf++) {
 			float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uf = 0; col_uf < nf; col_uf += 2) {
-				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
-				uf_scan[col_uf] = 0.5F * ( *(uf_scan + uf_pitch + col_uf) + *(uf_scan - uf_pitch + col_uf) );
+			const float *uc_scan = uc_bits + (row_uf / 2) * uc_pitch;
+			if ((row_uf & 1) == 0) {
+				// do elements that are copies
+				for (int col_uf = 0; col_uf < nfx; col_uf += 2) {
+					// calculate UF(2*row_uc, col_uf) = UC(row_uc, col_uc);
+					uf_scan[col_uf] = uc_scan[col_uf / 2];
+				}
+			} else {
+				// do odd-numbered rows, interpolating vertically
+				for (int col_uf = 0; col_uf < nfx; col_uf += 2) {
+					// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
+					uf_scan[col_uf] = 0.5F * ( uc_scan[uc_pitch + col_uf / 2] + uc_scan[col_uf / 2] );
+				}
 			}
-		}
-	}
-	// do even-numbered columns, interpolating horizontally
-	{
-		float *uf_scan = uf_bits;
-		for(row_uf = 0; row_uf < nf; row_uf++) {
-			for (col_uf = 1; col_uf < nf-1; col_uf += 2) {
+			// do odd-numbered columns, interpolating horizontally
+			for (int col_uf = 1; col_uf < nfx-1; col_uf += 2) {
 				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) )
 				uf_scan[col_uf] = 0.5F * ( uf_scan[col_uf + 1] + uf_scan[col_uf - 1] );
 			}
-			uf_scan += uf_pitch;
 		}
-	}
+	});
 }
 
 /**
 Red-black Gauss-Seidel relaxation for model problem. Updates the current value of the solution
-u[0..n-1][0..n-1], using the right-hand side function rhs[0..n-1][0..n-1].
+u[0..ny-1][0..nx-1], using the right-hand side function rhs[0..ny-1][0..nx-1].
+Each sweep only reads points of the other colour, so the rows of a sweep are independent.
 */
-static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col, ipass, isw, jsw;
-	const float h = 1.0F / (n - 1);
+static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int nx, int ny) {
+	const float h = 1.0F / (nx - 1);
 	const float h2 = h*h;
 
 	const int u_pitch  = FreeImage_GetPitch(U) / sizeof(float);
@@ -191,34 +225,50 @@ static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
 	float *u_bits = (float*)FreeImage_GetBits(U);
 	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
 
-	for (ipass = 0, jsw = 1; ipass < 2; ipass++, jsw = 3-jsw) { // Red and black sweeps
-		float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1, isw = jsw; row < n-1; row++, isw = 3-isw) {
-			for (col = isw; col < n-1; col += 2) { 
-				// Gauss-Seidel formula
-				// calculate U(row, col) = 
-				// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
-				float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*u_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
-				*u_center -= h2 * *rhs_center;
-				*u_center *= 0.25F;
+	for (int ipass = 0, jsw = 1; ipass < 2; ipass++, jsw = 3-jsw) { // Red and black sweeps
+		FreeImage_ParallelFor(1, ny-1, ToneMappingMinRows(nx), [=](int first, int last) {
+			for (int row = first; row < last; row++) {
+				float *u_scan = u_bits + row * u_pitch;
+				const float *rhs_scan = rhs_bits + row * rhs_pitch;
+				int col = (row & 1) ? jsw : 3-jsw;
+#ifdef FREEIMAGE_SSE2
+				// four points of one colour from eight neighbouring columns
+				for (; col + 7 <= nx-1; col += 8) {
+					float *u_center = u_scan + col;
+					const __m128 east = fmg_loadOdd(u_center);
+					__m128 value = _mm_add_ps(_mm_add_ps(_mm_add_ps(fmg_loadEven(u_center + u_pitch), fmg_loadEven(u_center - u_pitch)), east), fmg_loadEven(u_center - 1));
+					value = _mm_sub_ps(value, _mm_mul_ps(_mm_set1_ps(h2), fmg_loadEven(rhs_scan + col)));
+					value = _mm_mul_ps(value, _mm_set1_ps(0.25F));
+					// points of the other colour are being read by the neighbouring rows, so leave them alone
+					float result[4];
+					_mm_storeu_ps(result, value);
+					u_center[0] = result[0];
+					u_center[2] = result[1];
+					u_center[4] = result[2];
+					u_center[6] = result[3];
+				}
+#endif
+				for (; col < nx-1; col += 2) { 
+					// Gauss-Seidel formula
+					// calculate U(row, col) = 
+					// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
+					float *u_center = u_scan + col;
+					const float *rhs_center = rhs_scan + col;
+					*u_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
+					*u_center -= h2 * *rhs_center;
+					*u_center *= 0.25F;
+				}
 			}
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
-		}
+		});
 	}
 }
 
 /**
-Returns minus the residual for the model problem. Input quantities are u[0..n-1][0..n-1] and
-rhs[0..n-1][0..n-1], while res[0..n-1][0..n-1] is returned.
+Returns minus the residual for the model problem. Input quantities are u[0..ny-1][0..nx-1] and
+rhs[0..ny-1][0..nx-1], while res[0..ny-1][0..nx-1] is returned.
 */
-static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col;
-
-	const float h = 1.0F / (n-1);	
+static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int nx, int ny) {
+	const float h = 1.0F / (nx-1);	
 	const float h2i = 1.0F / (h*h);
 
 	const int res_pitch  = FreeImage_GetPitch(RES) / sizeof(float);
@@ -229,13 +279,30 @@ static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
 	const float *u_bits = (float*)FreeImage_GetBits(U);
 	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
 
-	// interior points
-	{
-		float *res_scan = res_bits + res_pitch;
-		const float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1; row < n-1; row++) {
-			for (col = 1; col < n-1; col++) {
+	FreeImage_ParallelFor(0, ny, ToneMappingMinRows(nx), [=](int first, int last) {
+		for (int row = first; row < last; row++) {
+			float *res_scan = res_bits + row * res_pitch;
+			if (row == 0 || row == ny-1) {
+				// boundary points
+				memset(res_scan, 0, nx * sizeof(float));
+				continue;
+			}
+			const float *u_scan = u_bits + row * u_pitch;
+			const float *rhs_scan = rhs_bits + row * rhs_pitch;
+			res_scan[0] = 0;
+			res_scan[nx-1] = 0;
+			// interior points
+			int col = 1;
+#ifdef FREEIMAGE_SSE2
+			for (; col + 4 <= nx-1; col += 4) {
+				const float *u_center = u_scan + col;
+				__m128 value = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(u_center + u_pitch), _mm_loadu_ps(u_center - u_pitch)), _mm_loadu_ps(u_center + 1)), _mm_loadu_ps(u_center - 1));
+				value = _mm_sub_ps(value, _mm_mul_ps(_mm_set1_ps(4), _mm_loadu_ps(u_center)));
+				value = _mm_mul_ps(value, _mm_set1_ps(-h2i));
+				_mm_storeu_ps(res_scan + col, _mm_add_ps(value, _mm_loadu_ps(rhs_scan + col)));
+			}
+#endif
+			for (; col < nx-1; col++) {
 				// calculate RES(row, col) = 
 				// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
 				float *res_center = res_scan + col;
@@ -245,34 +312,17 @@ static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
 				*res_center *= -h2i;
 				*res_center += *rhs_center;
 			}
-			res_scan += res_pitch;
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
-		}
-	}
-
-	// boundary points
-	{
-		memset(FreeImage_GetScanLine(RES, 0), 0, FreeImage_GetPitch(RES));
-		memset(FreeImage_GetScanLine(RES, n-1), 0, FreeImage_GetPitch(RES));
-		float *left = res_bits;
-		float *right = res_bits + (n-1);
-		for(int k = 0; k < n; k++) {
-			*left = 0;
-			*right = 0;
-			left += res_pitch;
-			right += res_pitch;
 		}
-	}
+	});
 }
 
 /**
-Does coarse-to-fine interpolation and adds result to uf. nf is the fine-grid dimension. The
-coarse-grid solution is input as uc[0..nc-1][0..nc-1], where nc = nf/2+1. The fine-grid solution
-is returned in uf[0..nf-1][0..nf-1]. res[0..nf-1][0..nf-1] is used for temporary storage.
+Does coarse-to-fine interpolation and adds result to uf. nfx x nfy is the fine-grid dimension. The
+coarse-grid solution is input as uc[0..ncy-1][0..ncx-1], where nc = nf/2+1. The fine-grid solution
+is returned in uf[0..nfy-1][0..nfx-1]. res[0..nfy-1][0..nfx-1] is used for temporary storage.
 */
-static void fmg_addint(FIBITMAP *UF, FIBITMAP *UC, FIBITMAP *RES, int nf) {
-	fmg_prolongate(RES, UC, nf);
+static void fmg_addint(FIBITMAP *UF, FIBITMAP *UC, FIBITMAP *RES, int nfx, int nfy) {
+	fmg_prolongate(RES, UC, nfx, nfy);
 
 	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
 	const int res_pitch  = FreeImage_GetPitch(RES) / sizeof(float);	
@@ -280,32 +330,41 @@ static void fmg_addint(FIBITMAP *UF, FIBITMAP *UC, FIBITMAP *RES, int nf) {
 	float *uf_bits = (float*)FreeImage_GetBits(UF);
 	const float *res_bits = (float*)FreeImage_GetBits(RES);
 
-	for(int row = 0; row < nf; row++) {
-		for(int col = 0; col < nf; col++) {
-			// calculate UF(row, col) = UF(row, col) + RES(row, col);
-			uf_bits[col] += res_bits[col];
+	FreeImage_ParallelFor(0, nfy, ToneMappingMinRows(nfx), [=](int first, int last) {
+		for (int row = first; row < last; row++) {
+			float *uf_scan = uf_bits + row * uf_pitch;
+			const float *res_scan = res_bits + row * res_pitch;
+			int col = 0;
+#ifdef FREEIMAGE_SSE2
+			for (; col + 4 <= nfx; col += 4) {
+				_mm_storeu_ps(uf_scan + col, _mm_add_ps(_mm_loadu_ps(uf_scan + col), _mm_loadu_ps(res_scan + col)));
+			}
+#endif
+			for (; col < nfx; col++) {
+				// calculate UF(row, col) = UF(row, col) + RES(row, col);
+				uf_scan[col] += res_scan[col];
+			}
 		}
-		uf_bits += uf_pitch;
-		res_bits += res_pitch;
-	}
+	});
 }
 
 /**
 Full Multigrid Algorithm for solution of linear elliptic equation, here the model problem (19.0.6).
-On input u[0..n-1][0..n-1] contains the right-hand side , while on output it returns the solution.
-The dimension n must be of the form 2^j + 1 for some integer j. (j is actually the number of
-grid levels used in the solution, called ng below.) ncycle is the number of V-cycles to be
-used at each level.
+On input u[0..ny-1][0..nx-1] contains the right-hand side rho, while on output it returns the solution.
+The dimensions must be of the form mx * 2^(ng-1) + 1 and my * 2^(ng-1) + 1, where ng is the number 
+of grid levels used in the solution, so that the coarsest grid is (mx + 1) x (my + 1). 
+ncycle is the number of V-cycles to be used at each level.
 */
-static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
-	int j, jcycle, jj, jpost, jpre, nf, ngrid;
+static BOOL fmg_mglin(FIBITMAP *U, int ng, int ncycle) {
+	int j, jcycle, jj, jpost, jpre, ngrid;
 
 	FIBITMAP **IRHO = NULL;
 	FIBITMAP **IU   = NULL;
 	FIBITMAP **IRHS = NULL;
 	FIBITMAP **IRES = NULL;
-	
-	int ng = 0;		// number of allocated grids
+
+	// grid dimensions, from the coarsest grid (0) to the finest one (ng-1)
+	int NX[NGMAX], NY[NGMAX];
 
 // --------------------------------------------------------------------------
 
@@ -327,17 +386,22 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 // --------------------------------------------------------------------------
 
 	try {
-		int nn = n;
 		// check grid size and grid levels
-		while (nn >>= 1) ng++;
-		if (n != 1 + (1L << ng)) {
-			FreeImage_OutputMessageProc(FIF_UNKNOWN, "Multigrid algorithm: n = %d, while n-1 must be a power of 2.", n);
-			throw(1);
-		}
-		if (ng > NGMAX) {
+		if (ng < 2 || ng > NGMAX) {
 			FreeImage_OutputMessageProc(FIF_UNKNOWN, "Multigrid algorithm: ng = %d while NGMAX = %d, increase NGMAX.", ng, NGMAX);
 			throw(1);
 		}
+		NX[ng-1] = FreeImage_GetWidth(U);
+		NY[ng-1] = FreeImage_GetHeight(U);
+		for (j = ng-1; j > 0; j--) {
+			if (((NX[j] - 1) & 1) || ((NY[j] - 1) & 1) || NX[j] < 5 || NY[j] < 5) {
+				FreeImage_OutputMessageProc(FIF_UNKNOWN, "Multigrid algorithm: %d x %d cannot be coarsened %d times.", NX[ng-1], NY[ng-1], ng-1);
+				throw(1);
+			}
+			NX[j-1] = NX[j]/2 + 1;
+			NY[j-1] = NY[j]/2 + 1;
+		}
+
 		// allocate grid arrays
 		{
 			_CREATE_ARRAY_GRID_(IRHO, ng);
@@ -346,34 +410,21 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 			_CREATE_ARRAY_GRID_(IRES, ng);
 		}
 
-		nn = n/2 + 1;
-		ngrid = ng - 2;
-
-		// allocate storage for r.h.s. on grid (ng - 2) ...
-		IRHO[ngrid] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-		if(!IRHO[ngrid]) throw(1);
-
-		// ... and fill it by restricting from the fine grid
-		fmg_restrict(IRHO[ngrid], U, nn);	
-
+		// allocate storage for r.h.s. on grid (ng - 2) and fill it by restricting from the fine grid, 
 		// similarly allocate storage and fill r.h.s. on all coarse grids.
-		while (nn > 3) {
-			nn = nn/2 + 1; 
-			ngrid--;
-			IRHO[ngrid] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
+		for (ngrid = ng - 2; ngrid >= 0; ngrid--) {
+			IRHO[ngrid] = FreeImage_AllocateT(FIT_FLOAT, NX[ngrid], NY[ngrid]);
 			if(!IRHO[ngrid]) throw(1);
-			fmg_restrict(IRHO[ngrid], IRHO[ngrid+1], nn);
+			fmg_restrict(IRHO[ngrid], (ngrid == ng - 2) ? U : IRHO[ngrid+1], NX[ngrid], NY[ngrid]);
 		}
 
-		nn = 3;
-
-		IU[0] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
+		IU[0] = FreeImage_AllocateT(FIT_FLOAT, NX[0], NY[0]);
 		if(!IU[0]) throw(1);
-		IRHS[0] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
+		IRHS[0] = FreeImage_AllocateT(FIT_FLOAT, NX[0], NY[0]);
 		if(!IRHS[0]) throw(1);
 
 		// initial solution on coarsest grid
-		fmg_solve(IU[0], IRHO[0]);
+		fmg_solve(IU[0], IRHO[0], NX[0], NY[0]);
 		// irho[0] no longer needed ...
 		FreeImage_Unload(IRHO[0]); IRHO[0] = NULL;
 
@@ -381,49 +432,42 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 
 		// nested iteration loop
 		for (j = 1; j < ngrid; j++) {
-			nn = 2*nn - 1;
-
-			IU[j] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
+			IU[j] = FreeImage_AllocateT(FIT_FLOAT, NX[j], NY[j]);
 			if(!IU[j]) throw(1);
-			IRHS[j] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
+			IRHS[j] = FreeImage_AllocateT(FIT_FLOAT, NX[j], NY[j]);
 			if(!IRHS[j]) throw(1);
-			IRES[j] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
+			IRES[j] = FreeImage_AllocateT(FIT_FLOAT, NX[j], NY[j]);
 			if(!IRES[j]) throw(1);
 
-			fmg_prolongate(IU[j], IU[j-1], nn);
-			
 			// interpolate from coarse grid to next finer grid
+			fmg_prolongate(IU[j], IU[j-1], NX[j], NY[j]);
 
 			// set up r.h.s.
 			fmg_copyArray(IRHS[j], j != (ngrid - 1) ? IRHO[j] : U);
 			
 			// V-cycle loop
 			for (jcycle = 0; jcycle < ncycle; jcycle++) {
-				nf = nn;
 				// downward stoke of the V
 				for (jj = j; jj >= 1; jj--) {
 					// pre-smoothing
 					for (jpre = 0; jpre < NPRE; jpre++) {
-						fmg_relaxation(IU[jj], IRHS[jj], nf);
+						fmg_relaxation(IU[jj], IRHS[jj], NX[jj], NY[jj]);
 					}
-					fmg_residual(IRES[jj], IU[jj], IRHS[jj], nf);
-					nf = nf/2 + 1;
+					fmg_residual(IRES[jj], IU[jj], IRHS[jj], NX[jj], NY[jj]);
 					// restriction of the residual is the next r.h.s.
-					fmg_restrict(IRHS[jj-1], IRES[jj], nf);				
+					fmg_restrict(IRHS[jj-1], IRES[jj], NX[jj-1], NY[jj-1]);
 					// zero for initial guess in next relaxation
 					fmg_fillArrayWithZeros(IU[jj-1]);
 				}
 				// bottom of V: solve on coarsest grid
-				fmg_solve(IU[0], IRHS[0]); 
-				nf = 3; 
+				fmg_solve(IU[0], IRHS[0], NX[0], NY[0]); 
 				// upward stroke of V.
 				for (jj = 1; jj <= j; jj++) { 
-					nf = 2*nf - 1;
 					// use res for temporary storage inside addint
-					fmg_addint(IU[jj], IU[jj-1], IRES[jj], nf);				
+					fmg_addint(IU[jj], IU[jj-1], IRES[jj], NX[jj], NY[jj]);
 					// post-smoothing
 					for (jpost = 0; jpost < NPOST; jpost++) {
-						fmg_relaxation(IU[jj], IRHS[jj], nf);
+						fmg_relaxation(IU[jj], IRHS[jj], NX[jj], NY[jj]);
 					}
 				}
 			}
@@ -456,8 +500,10 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 /**
 Poisson solver based on a multigrid algorithm. 
 This routine solves a Poisson equation, remap result pixels to [0..1] and returns the solution. 
-NB: The input image is first stored inside a square image whose size is (2^j + 1)x(2^j + 1) for some integer j, 
-where j is such that 2^j is the nearest larger dimension corresponding to MAX(image width, image height). 
+NB: The input image is first stored inside an image whose size is (mx * 2^j + 1)x(my * 2^j + 1), 
+the smallest one of this form that leaves a one pixel boundary around the image. 
+j is chosen to pad the least while the short side of the coarsest grid keeps NCOARSE to 4*NCOARSE cells, 
+so that the padding stays a small fraction of the image instead of squaring it. 
 @param Laplacian Laplacian image
 @param ncycle Number of cycles in the multigrid algorithm (usually 2 or 3)
 @return Returns the solved PDE equations if successful, returns NULL otherwise
@@ -469,25 +515,34 @@ FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle) {
 	int width = FreeImage_GetWidth(Laplacian);
 	int height = FreeImage_GetHeight(Laplacian);
 
-	// get nearest larger dimension length that is acceptable by the algorithm
-	int n = MAX(width, height);
-	int size = 0;
-	while((n >>= 1) > 0) size++;
-	if((1 << size) < MAX(width, height)) {
-		size++;
+	// get the number of grid levels (at least one coarsening) that pads the image the least, 
+	// keeping between NCOARSE and 4*NCOARSE cells along the short side of the coarsest grid
+	const int cells = MIN(width, height) + 1;
+	int levels = 1;
+	double best_area = 0;
+	for(int j = 1; j + 1 <= NGMAX; j++) {
+		const int m = (cells + (1 << j) - 1) >> j;
+		if((m < NCOARSE) && (j > 1)) break;
+		if((m > 4 * NCOARSE) && (j + 1 < NGMAX)) continue;
+		const double area = (double)(((width + 1 + (1 << j) - 1) >> j) << j) * (((height + 1 + (1 << j) - 1) >> j) << j);
+		if((best_area == 0) || (area <= best_area)) {
+			best_area = area;
+			levels = j;
+		}
 	}
-	// size must be of the form 2^j + 1 for some integer j
-	size = 1 + (1 << size);
+	// sizes must be of the form m * 2^levels + 1, with m >= 2
+	const int size_x = 1 + (MAX(2, (width + 1 + (1 << levels) - 1) >> levels) << levels);
+	const int size_y = 1 + (MAX(2, (height + 1 + (1 << levels) - 1) >> levels) << levels);
 
-	// allocate a temporary square image I
-	FIBITMAP *I = FreeImage_AllocateT(FIT_FLOAT, size, size);
+	// allocate a temporary image I
+	FIBITMAP *I = FreeImage_AllocateT(FIT_FLOAT, size_x, size_y);
 	if(!I) return NULL;
 
 	// copy Laplacian into I and shift pixels to create a boundary
 	FreeImage_Paste(I, Laplacian, 1, 1, 255);
 
 	// solve the PDE equation
-	fmg_mglin(I, size, ncycle);
+	fmg_mglin(I, levels + 1, ncycle);
 
 	// shift pixels back
 	FIBITMAP *U = FreeImage_Copy(I, 1, 1, width + 1, height + 1);
@@ -502,4 +557,3 @@ FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle) {
 	// return the integrated image
 	return U;
 }
-
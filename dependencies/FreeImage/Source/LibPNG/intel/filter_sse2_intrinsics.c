@@ -0,0 +1,288 @@
+/* filter_sse2_intrinsics.c - SSE2 optimized filter functions
+ *
+ * Written by Andrew Baxter, 2016.
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_SUPPORTED
+#if PNG_INTEL_SSE_OPT > 0
+
+#include <emmintrin.h>
+#if PNG_INTEL_SSE_IMPLEMENTATION >= 2
+#  include <tmmintrin.h>
+#endif
+
+/* The row loops below are written once for every pixel size; inlining them
+ * into each entry point makes the pixel size a constant again.
+ */
+#if defined(_MSC_VER)
+#  define SSE2_INLINE static __forceinline
+#elif defined(__GNUC__)
+#  define SSE2_INLINE static __inline__ __attribute__((always_inline))
+#else
+#  define SSE2_INLINE static
+#endif
+
+/* Pixels are moved between memory and the low bytes of a register through
+ * integers, since a 3 or 6 byte load of the last pixel in the row must not read
+ * past its end.  Going through a buffer in memory instead (or letting memcpy
+ * do so) stalls every load on the stores before it.  'size' is a constant in
+ * every caller.
+ */
+SSE2_INLINE __m128i
+load_pixel(png_const_bytep p, unsigned int size)
+{
+   png_uint_32 low = 0;
+   png_uint_16 high;
+
+   switch (size)
+   {
+      case 8:
+         return _mm_loadl_epi64((const __m128i*)p);
+
+      case 6:
+         memcpy(&low, p, 4);
+         memcpy(&high, p + 4, 2);
+         return _mm_insert_epi16(_mm_cvtsi32_si128((int)low), high, 2);
+
+      case 4:
+         memcpy(&low, p, 4);
+         return _mm_cvtsi32_si128((int)low);
+
+      default:
+         low = p[0] | ((png_uint_32)p[1] << 8) | ((png_uint_32)p[2] << 16);
+         return _mm_cvtsi32_si128((int)low);
+   }
+}
+
+SSE2_INLINE void
+store_pixel(png_bytep p, __m128i v, unsigned int size)
+{
+   png_uint_32 low;
+   png_uint_16 high;
+
+   switch (size)
+   {
+      case 8:
+         _mm_storel_epi64((__m128i*)p, v);
+         break;
+
+      case 6:
+         low = (png_uint_32)_mm_cvtsi128_si32(v);
+         high = (png_uint_16)_mm_extract_epi16(v, 2);
+         memcpy(p, &low, 4);
+         memcpy(p + 4, &high, 2);
+         break;
+
+      case 4:
+         low = (png_uint_32)_mm_cvtsi128_si32(v);
+         memcpy(p, &low, 4);
+         break;
+
+      default:
+         low = (png_uint_32)_mm_cvtsi128_si32(v);
+         p[0] = (png_byte)low;
+         p[1] = (png_byte)(low >> 8);
+         p[2] = (png_byte)(low >> 16);
+         break;
+   }
+}
+
+SSE2_INLINE __m128i
+abs_i16(__m128i x)
+{
+#if PNG_INTEL_SSE_IMPLEMENTATION >= 2
+   return _mm_abs_epi16(x);
+#else
+   return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+#endif
+}
+
+SSE2_INLINE __m128i
+if_then_else(__m128i c, __m128i t, __m128i e)
+{
+   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+}
+
+void
+png_read_filter_row_up_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t i, rowbytes = row_info->rowbytes;
+
+   for (i = 0; i + 16 <= rowbytes; i += 16)
+   {
+      __m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(prev_row + i));
+      _mm_storeu_si128((__m128i*)(row + i), _mm_add_epi8(x, b));
+   }
+
+   for (; i < rowbytes; i++)
+      row[i] = (png_byte)(row[i] + prev_row[i]);
+}
+
+/* Raw(x) = Sub(x) + Raw(x-bpp), with Raw(x-bpp) = 0 for the first pixel */
+SSE2_INLINE void
+filter_row_sub(png_row_infop row_info, png_bytep row, unsigned int bpp)
+{
+   png_bytep rp_end = row + row_info->rowbytes;
+   __m128i a = _mm_setzero_si128();
+
+   for (; row < rp_end; row += bpp)
+   {
+      a = _mm_add_epi8(load_pixel(row, bpp), a);
+      store_pixel(row, a, bpp);
+   }
+}
+
+/* Raw(x) = Average(x) + floor((Raw(x-bpp) + Prior(x)) / 2).  pavgb rounds up,
+ * so take the carry back off where the sum is odd.
+ */
+SSE2_INLINE void
+filter_row_avg(png_row_infop row_info, png_bytep row, png_const_bytep prev_row,
+   unsigned int bpp)
+{
+   png_bytep rp_end = row + row_info->rowbytes;
+   const __m128i one = _mm_set1_epi8(1);
+   __m128i a = _mm_setzero_si128();
+
+   for (; row < rp_end; row += bpp, prev_row += bpp)
+   {
+      __m128i b = load_pixel(prev_row, bpp);
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+         _mm_and_si128(_mm_xor_si128(a, b), one));
+
+      a = _mm_add_epi8(load_pixel(row, bpp), avg);
+      store_pixel(row, a, bpp);
+   }
+}
+
+/* Raw(x) = Paeth(x) + PaethPredictor(Raw(x-bpp), Prior(x), Prior(x-bpp)),
+ * worked out in 16-bit lanes so that the differences cannot overflow.  Ties
+ * are broken in the order a, b, c as the specification requires.
+ */
+SSE2_INLINE void
+filter_row_paeth(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row, unsigned int bpp)
+{
+   png_bytep rp_end = row + row_info->rowbytes;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i a = zero, c = zero;
+
+   for (; row < rp_end; row += bpp, prev_row += bpp)
+   {
+      __m128i b = _mm_unpacklo_epi8(load_pixel(prev_row, bpp), zero);
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = abs_i16(_mm_add_epi16(pa, pb));
+      __m128i smallest, nearest;
+
+      pa = abs_i16(pa);
+      pb = abs_i16(pb);
+      smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      nearest = if_then_else(_mm_cmpeq_epi16(smallest, pa), a,
+         if_then_else(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+      a = _mm_add_epi8(load_pixel(row, bpp), _mm_packus_epi16(nearest, zero));
+      store_pixel(row, a, bpp);
+
+      a = _mm_unpacklo_epi8(a, zero);
+      c = b;
+   }
+}
+
+void
+png_read_filter_row_sub3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   PNG_UNUSED(prev_row)
+   filter_row_sub(row_info, row, 3);
+}
+
+void
+png_read_filter_row_sub4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   PNG_UNUSED(prev_row)
+   filter_row_sub(row_info, row, 4);
+}
+
+void
+png_read_filter_row_sub6_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   PNG_UNUSED(prev_row)
+   filter_row_sub(row_info, row, 6);
+}
+
+void
+png_read_filter_row_sub8_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   PNG_UNUSED(prev_row)
+   filter_row_sub(row_info, row, 8);
+}
+
+void
+png_read_filter_row_avg3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_avg(row_info, row, prev_row, 3);
+}
+
+void
+png_read_filter_row_avg4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_avg(row_info, row, prev_row, 4);
+}
+
+void
+png_read_filter_row_avg6_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_avg(row_info, row, prev_row, 6);
+}
+
+void
+png_read_filter_row_avg8_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_avg(row_info, row, prev_row, 8);
+}
+
+void
+png_read_filter_row_paeth3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_paeth(row_info, row, prev_row, 3);
+}
+
+void
+png_read_filter_row_paeth4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_paeth(row_info, row, prev_row, 4);
+}
+
+void
+png_read_filter_row_paeth6_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_paeth(row_info, row, prev_row, 6);
+}
+
+void
+png_read_filter_row_paeth8_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   filter_row_paeth(row_info, row, prev_row, 8);
+}
+
+#endif /* PNG_INTEL_SSE_OPT > 0 */
+#endif /* PNG_READ_SUPPORTED */
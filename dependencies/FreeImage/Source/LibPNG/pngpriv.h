@@ -180,6 +180,38 @@
 #  endif
 #endif /* PNG_ARM_NEON_OPT > 0 */
 
+#ifndef PNG_INTEL_SSE_OPT
+   /* Intel SSE2 optimizations follow the compiler settings in the same way: x64
+    * builds always have SSE2, 32-bit builds have it with -msse2 (GCC) or
+    * /arch:SSE2 (MSVC).  SSSE3 is only used when the compiler is told it may
+    * (-mssse3), because libpng does no run time detection of the CPU.  Set
+    * PNG_INTEL_SSE_OPT to 0 in CPPFLAGS to use the generic code instead.
+    */
+#  if PNG_ARM_NEON_OPT == 0 && (defined(__SSE2__) || defined(_M_X64) || \
+   defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#     define PNG_INTEL_SSE_OPT 1
+#  else
+#     define PNG_INTEL_SSE_OPT 0
+#  endif
+#endif
+
+#if PNG_INTEL_SSE_OPT > 0
+#  ifndef PNG_INTEL_SSE_IMPLEMENTATION
+      /* PNG_INTEL_SSE_IMPLEMENTATION can be:
+       *
+       *    1  SSE2 only
+       *    2  SSE2 with the SSSE3 absolute value instructions in 'paeth'
+       */
+#     if defined(__SSSE3__) || defined(__AVX__)
+#        define PNG_INTEL_SSE_IMPLEMENTATION 2
+#     else
+#        define PNG_INTEL_SSE_IMPLEMENTATION 1
+#     endif
+#  endif
+
+#  define PNG_FILTER_OPTIMIZATIONS png_init_filter_functions_sse2
+#endif /* PNG_INTEL_SSE_OPT > 0 */
+
 /* Is this a build of a DLL where compilation of the object modules requires
  * different preprocessor settings to those required for a simple library?  If
  * so PNG_BUILD_DLL must be set.
@@ -1930,6 +1962,37 @@ PNG_INTERNAL_FUNCTION(void, PNG_FILTER_OPTIMIZATIONS, (png_structp png_ptr,
     */
 PNG_INTERNAL_FUNCTION(void, png_init_filter_functions_neon,
    (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_init_filter_functions_sse2,
+   (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+#endif
+
+#if PNG_INTEL_SSE_OPT > 0
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_up_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_sub3_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_sub4_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_sub6_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_sub8_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_avg3_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_avg4_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_avg6_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_avg8_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_paeth3_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_paeth4_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_paeth6_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_read_filter_row_paeth8_sse2, (png_row_infop
+   row_info, png_bytep row, png_const_bytep prev_row), PNG_EMPTY);
 #endif
 
 /* Maintainer: Put new private prototypes here ^ */
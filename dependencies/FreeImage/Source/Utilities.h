@@ -51,6 +51,7 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <thread>
 
 // ==========================================================
 //   Bitmap palette and pixels alignment
@@ -64,6 +65,12 @@
 void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment);
 void FreeImage_Aligned_Free(void* mem);
 
+// Memory for bitmaps, recycled through a pool
+// defined in BitmapPool.cpp
+
+void* FreeImage_AllocateBitmapData(size_t size);
+void FreeImage_FreeBitmapData(void *data);
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -216,6 +223,61 @@ MAXMIN(const T* L, long n, T& max, T& min) {
 	}
 }
 
+// ==========================================================
+//   SIMD and multi-threading
+// ==========================================================
+
+// SSE2 is part of every x64 target, and of x86 targets built with /arch:SSE2 or -msse2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FREEIMAGE_SSE2
+#endif
+
+// SSSE3 isn't: functions using it are compiled for it alone, 
+// and only called once FreeImage_HasSSSE3 (see FreeImage.cpp) has found it on the running CPU
+#ifdef FREEIMAGE_SSE2
+#define FREEIMAGE_SSSE3
+#if defined(__GNUC__) && !defined(__SSSE3__)
+#define FREEIMAGE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define FREEIMAGE_TARGET_SSSE3
+#endif
+
+BOOL FreeImage_HasSSSE3();
+#endif
+
+/**
+Runs proc(data, first, last) over consecutive slices of [begin, end), slice_size items each.
+The calling thread works through the slices along with a pool of worker threads, created once per process, 
+so nested calls share the same threads. The call returns once every slice is done; 
+the first exception thrown by proc is then rethrown on the calling thread.
+*/
+void FreeImage_RunSlices(int begin, int end, int slice_size, void (*proc)(void *data, int first, int last), void *data);
+
+template <class FUNC> void 
+FreeImage_RunSlice(void *data, int first, int last) {
+	(*(FUNC *)data)(first, last);
+}
+
+/**
+Runs func(first, last) over consecutive slices of [begin, end), one slice per hardware thread.
+Each slice gets at least min_size items, so that small jobs stay on the calling thread.
+The slices must be safe to process concurrently; the call returns once all of them are done.
+*/
+template <class FUNC> void 
+FreeImage_ParallelFor(int begin, int end, int min_size, FUNC func) {
+	const int count = end - begin;
+	if(count <= 0) {
+		return;
+	}
+	const int max_threads = MAX((int)std::thread::hardware_concurrency(), 1);
+	const int threads = CLAMP(count / MAX(min_size, 1), 1, max_threads);
+	if(threads == 1) {
+		func(begin, end);
+		return;
+	}
+	FreeImage_RunSlices(begin, end, (count + threads - 1) / threads, &FreeImage_RunSlice<FUNC>, &func);
+}
+
 // ==========================================================
 //   Utility functions
 // ==========================================================
@@ -391,6 +453,12 @@ Rotate a dib according to Exif info
 */
 void RotateExif(FIBITMAP **dib);
 
+/**
+Reverses the order of the pixels of a line, in place
+@see Flip.cpp, ClassicRotate.cpp
+*/
+void MirrorLine(BYTE *bits, unsigned width, unsigned bytespp);
+
 
 // ==========================================================
 //   Big Endian / Little Endian utility functions
@@ -65,6 +65,9 @@ int main(int argc, char *argv[]) {
 	// test the clone function
 	testAllocateCloneUnload("exif.jpg");
 
+	// test recycling bitmap memory
+	testBitmapPool(width, height);
+
 	// test internal image types
 	testImageType(width, height);
 
@@ -74,6 +77,7 @@ int main(int argc, char *argv[]) {
 	// test memory IO
 	testMemIO("sample.png");
 	testMemIO("exif.jxr");
+	testMappedIO("sample.png");
 
 	// test multipage functions
 	testMultiPage("sample.png");
@@ -90,6 +94,30 @@ int main(int argc, char *argv[]) {
 	// test get/set channel
 	testImageChannels(width, height);
 
+	// test SIMD line converters
+	testConvertLine(width, height);
+
+	// test DDS block compression
+	testDDS(width, height);
+
+	// test rescaling filters
+	testRescale(width, height);
+
+	// test colour quantizers
+	testQuantize(width, height);
+
+	// test tone mapping operators
+	testToneMapping(width, height);
+
+	// test exact rotations and flips
+	testRotate(width, height);
+
+	// test alpha blending and compositing
+	testComposite(width, height);
+
+	// test PNG filtering and parallel compression
+	testPNG(width, height);
+
 	// test loading header only
 	testHeaderOnly();
 	
@@ -40,6 +40,7 @@
 // Some useful tools
 // ==========================================================
 FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale);
+FIBITMAP* createNoiseImage(FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height, unsigned seed);
 
 // Test plugins capabilities
 // ==========================================================
@@ -52,6 +53,10 @@ BOOL testAllocateCloneUnloadType(FREE_IMAGE_TYPE image_type, unsigned width, uns
 void testImageType(unsigned width, unsigned height);
 void testImageTypeTIFF(unsigned width, unsigned height);
 
+// Bitmap memory pool test suite
+// ==========================================================
+void testBitmapPool(unsigned width, unsigned height);
+
 // Header loading test suite
 // ==========================================================
 void testHeaderOnly();
@@ -64,6 +69,7 @@ void testExifRaw();
 // ==========================================================
 
 void testMemIO(const char *lpszPathName);
+void testMappedIO(const char *lpszPathName);
 
 // Multipage test suite
 // ==========================================================
@@ -83,6 +89,46 @@ void testJPEG();
 void testImageChannels(unsigned width, unsigned height);
 
 
+// Line conversion test suite
+// ==========================================================
+
+void testConvertLine(unsigned width, unsigned height);
+
+// DDS test suite
+// ==========================================================
+
+void testDDS(unsigned width, unsigned height);
+
+// Rescale test suite
+// ==========================================================
+
+void testRescale(unsigned width, unsigned height);
+
+// Quantizer test suite
+// ==========================================================
+
+void testQuantize(unsigned width, unsigned height);
+
+// Tone mapping test suite
+// ==========================================================
+
+void testToneMapping(unsigned width, unsigned height);
+
+// Rotation test suite
+// ==========================================================
+
+void testRotate(unsigned width, unsigned height);
+
+// Compositing test suite
+// ==========================================================
+
+void testComposite(unsigned width, unsigned height);
+
+// PNG test suite
+// ==========================================================
+
+void testPNG(unsigned width, unsigned height);
+
 // Thumbnails test suite
 // ==========================================================
 void testThumbnail(const char *lpszPathName, int flags);
@@ -0,0 +1,134 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+// counts what goes through a custom bitmap allocator
+static size_t s_allocated_bytes = 0;
+
+static void * DLL_CALLCONV countingAllocate(size_t size, void *user) {
+	s_allocated_bytes += size;
+	(*(int*)user)++;
+	return malloc(size);
+}
+
+static void DLL_CALLCONV countingDeallocate(void *data, size_t size, void *user) {
+	s_allocated_bytes -= size;
+	(*(int*)user)--;
+	free(data);
+}
+
+/**
+Times several threads each converting and rescaling a stream of images, as a batch pipeline would
+*/
+static double timeBitmapChurn(unsigned width, unsigned height) {
+	const int threads = 4;
+	const int images = 16;
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for(int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([width, height]() {
+			for(int i = 0; i < images; i++) {
+				FIBITMAP *dib = FreeImage_Allocate(width, height, 24);
+				FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib);
+				FIBITMAP *half = FreeImage_Rescale(dib32, width / 2, height / 2, FILTER_BOX);
+				FIBITMAP *dib8 = FreeImage_ConvertToGreyscale(half);
+				FreeImage_Unload(dib8);
+				FreeImage_Unload(half);
+				FreeImage_Unload(dib32);
+				FreeImage_Unload(dib);
+			}
+		}));
+	}
+	for(int t = 0; t < threads; t++) {
+		workers[t].join();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void testBitmapPool(unsigned width, unsigned height) {
+	FIPOOLSTATS stats, before;
+
+	printf("testBitmapPool ...\n");
+
+	FreeImage_ReleaseBitmapPool();
+	FreeImage_GetBitmapMemoryStats(&before, TRUE);
+	assert(before.pooled_bytes == 0);
+
+	// an unloaded bitmap's memory goes to the next bitmap of the same size, cleared
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 32);
+	BYTE *bits = FreeImage_GetBits(dib);
+	memset(bits, 0xAB, FreeImage_GetPitch(dib) * height);
+	FreeImage_GetBitmapMemoryStats(&stats);
+	const size_t dib_bytes = stats.live_bytes - before.live_bytes;
+	assert(dib_bytes >= FreeImage_GetPitch(dib) * height);
+	FreeImage_Unload(dib);
+
+	FreeImage_GetBitmapMemoryStats(&stats);
+	assert(stats.live_bytes == before.live_bytes);
+	assert(stats.pooled_bytes == dib_bytes);
+
+	dib = FreeImage_Allocate(width, height, 32);
+	assert(FreeImage_GetBits(dib) == bits);
+	assert(FreeImage_GetBits(dib)[0] == 0 && FreeImage_GetBits(dib)[FreeImage_GetPitch(dib) * height - 1] == 0);
+	FIBITMAP *dib2 = FreeImage_Allocate(width, height, 32);
+	FreeImage_GetBitmapMemoryStats(&stats);
+	assert(stats.pool_hits == before.pool_hits + 1);
+	assert(stats.allocations == before.allocations + 3);
+	assert(stats.peak_bytes == before.live_bytes + 2 * dib_bytes);
+	FreeImage_Unload(dib2);
+	FreeImage_Unload(dib);
+
+	// without a pool, memory goes straight back
+	FreeImage_SetBitmapPoolSize(0);
+	FreeImage_GetBitmapMemoryStats(&stats);
+	assert(stats.pooled_bytes == 0);
+	FreeImage_Unload(FreeImage_Allocate(width, height, 32));
+	FreeImage_GetBitmapMemoryStats(&stats);
+	assert(stats.pooled_bytes == 0);
+	const double unpooled_seconds = timeBitmapChurn(width, height);
+	FreeImage_SetBitmapPoolSize(128 << 20);
+	const double pooled_seconds = timeBitmapChurn(width, height);
+	printf("  4 threads converting %ux%u images: malloc %.1f ms, pooled %.1f ms\n", width, height, unpooled_seconds * 1e3, pooled_seconds * 1e3);
+
+	// a custom allocator sees every block, and gets all of them back
+	int blocks = 0;
+	FreeImage_SetBitmapAllocator(countingAllocate, countingDeallocate, &blocks);
+	dib = FreeImage_Allocate(width, height, 24);
+	dib2 = FreeImage_ConvertTo32Bits(dib);
+	assert(blocks == 2);
+	FreeImage_Unload(dib);
+	FreeImage_Unload(dib2);
+	FreeImage_Unload(FreeImage_Allocate(width, height, 24));
+	assert(blocks == 2);
+	FreeImage_SetBitmapAllocator(NULL, NULL);
+	assert((blocks == 0) && (s_allocated_bytes == 0));
+}
@@ -22,6 +22,8 @@
 
 #include "TestSuite.h"
 
+#include <string.h>
+
 // Local test functions
 // ----------------------------------------------------------
 
@@ -109,6 +111,48 @@ void testRGBAChannels(FREE_IMAGE_TYPE image_type, unsigned width, unsigned heigh
 	FreeImage_Unload(src);
 }
 
+/**
+Checks every sample of an extracted channel, then that inserting it into a blank image 
+puts it back in place and leaves the other channels alone
+@param c Index of the channel's sample in a pixel
+*/
+static void testChannelSamples(FREE_IMAGE_TYPE image_type, unsigned bpp, FREE_IMAGE_COLOR_CHANNEL channel, unsigned c, unsigned width, unsigned height) {
+	FIBITMAP *src = createNoiseImage(image_type, bpp, width, height, 1);
+	assert(src != NULL);
+
+	FIBITMAP *plane = FreeImage_GetChannel(src, channel);
+	assert(plane != NULL);
+	const unsigned sample_size = FreeImage_GetBPP(plane) / 8;
+	const unsigned samples = bpp / 8 / sample_size;
+
+	FIBITMAP *dst = FreeImage_AllocateT(image_type, width, height, bpp);
+	assert(dst != NULL);
+	BOOL bResult = FreeImage_SetChannel(dst, plane, channel);
+	assert(bResult);
+
+	const BYTE zero[16] = { 0 };
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		const BYTE *plane_bits = FreeImage_GetScanLine(plane, y);
+		const BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++) {
+			for(unsigned k = 0; k < samples; k++) {
+				const unsigned offset = (x * samples + k) * sample_size;
+				if(k == c) {
+					assert(memcmp(plane_bits + x * sample_size, src_bits + offset, sample_size) == 0);
+					assert(memcmp(dst_bits + offset, src_bits + offset, sample_size) == 0);
+				} else {
+					assert(memcmp(dst_bits + offset, zero, sample_size) == 0);
+				}
+			}
+		}
+	}
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(plane);
+	FreeImage_Unload(src);
+}
+
 // Main test functions
 // ----------------------------------------------------------
 
@@ -124,4 +168,12 @@ void testImageChannels(unsigned width, unsigned height) {
 
 	testRGBAChannels(FIT_RGBF, width, height, FALSE);
 	testRGBAChannels(FIT_RGBAF, width, height, TRUE);
+
+	// odd widths leave a few pixels past the last whole SIMD block
+	testChannelSamples(FIT_BITMAP, 24, FICC_GREEN, FI_RGBA_GREEN, width + 5, height / 4);
+	testChannelSamples(FIT_BITMAP, 32, FICC_ALPHA, FI_RGBA_ALPHA, width + 5, height / 4);
+	testChannelSamples(FIT_RGB16, 48, FICC_BLUE, 2, width + 3, height / 4);
+	testChannelSamples(FIT_RGBA16, 64, FICC_RED, 0, width + 3, height / 4);
+	testChannelSamples(FIT_RGBF, 96, FICC_GREEN, 1, width + 1, height / 4);
+	testChannelSamples(FIT_RGBAF, 128, FICC_ALPHA, 3, width + 1, height / 4);
 }
@@ -0,0 +1,171 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Builds an image of random bytes, with plenty of 0 and 255 so that fully transparent and opaque pixels show up
+*/
+static FIBITMAP* createRandomImage(unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *dib = createNoiseImage(FIT_BITMAP, bpp, width, height, width * 17 + bpp);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			const BYTE r = bits[x];
+			bits[x] = (r < 32) ? 0 : (r < 64) ? 255 : r;
+		}
+	}
+	return dib;
+}
+
+/**
+Checks an alpha blended paste against the documented formula, including the margins left alone
+*/
+static void testPasteBlend(unsigned bpp, unsigned width, unsigned height, int alpha) {
+	FIBITMAP *dst = createRandomImage(width + 7, height + 3, bpp);
+	FIBITMAP *src = createRandomImage(width, height, bpp);
+	FIBITMAP *ref = FreeImage_Clone(dst);
+	assert(ref != NULL);
+
+	const unsigned left = 5, top = 2;
+	BOOL bResult = FreeImage_Paste(dst, src, left, top, alpha);
+	assert(bResult);
+
+	const unsigned bytespp = bpp / 8;
+	for(unsigned y = 0; y < height; y++) {
+		// scanlines are upside down
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		BYTE *ref_bits = FreeImage_GetScanLine(ref, FreeImage_GetHeight(ref) - height - top + y) + left * bytespp;
+		for(unsigned i = 0; i < width * bytespp; i++) {
+			ref_bits[i] = (BYTE)(((src_bits[i] - ref_bits[i]) * alpha + (ref_bits[i] << 8)) >> 8);
+		}
+	}
+	for(unsigned y = 0; y < FreeImage_GetHeight(dst); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dst, y), FreeImage_GetScanLine(ref, y), FreeImage_GetLine(dst)) == 0);
+	}
+
+	FreeImage_Unload(ref);
+	FreeImage_Unload(src);
+	FreeImage_Unload(dst);
+}
+
+/**
+Checks the composition of a 32-bit image against a background image, and its pre-multiplication
+*/
+static void testCompositeAlpha(unsigned width, unsigned height) {
+	FIBITMAP *fg = createRandomImage(width, height, 32);
+	FIBITMAP *bg = createRandomImage(width, height, 24);
+
+	FIBITMAP *composite = FreeImage_Composite(fg, FALSE, NULL, bg);
+	assert(composite != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
+		const BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
+		const BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
+		for(unsigned x = 0; x < width; x++, fg_bits += 4, bg_bits += 3, cp_bits += 3) {
+			const unsigned alpha = fg_bits[FI_RGBA_ALPHA];
+			for(unsigned c = 0; c < 3; c++) {
+				const unsigned expected = (alpha == 0) ? bg_bits[c] : (alpha == 255) ? fg_bits[c] : (alpha * fg_bits[c] + (255 - alpha) * bg_bits[c]) >> 8;
+				assert(cp_bits[c] == expected);
+			}
+		}
+	}
+	FreeImage_Unload(composite);
+
+	FIBITMAP *premultiplied = FreeImage_Clone(fg);
+	assert(premultiplied != NULL);
+	BOOL bResult = FreeImage_PreMultiplyWithAlpha(premultiplied);
+	assert(bResult);
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
+		const BYTE *pm_bits = FreeImage_GetScanLine(premultiplied, y);
+		for(unsigned x = 0; x < width; x++, fg_bits += 4, pm_bits += 4) {
+			const unsigned alpha = fg_bits[FI_RGBA_ALPHA];
+			assert(pm_bits[FI_RGBA_ALPHA] == alpha);
+			assert(pm_bits[FI_RGBA_RED] == (alpha * fg_bits[FI_RGBA_RED] + 127) / 255);
+			assert(pm_bits[FI_RGBA_GREEN] == (alpha * fg_bits[FI_RGBA_GREEN] + 127) / 255);
+			assert(pm_bits[FI_RGBA_BLUE] == (alpha * fg_bits[FI_RGBA_BLUE] + 127) / 255);
+		}
+	}
+	FreeImage_Unload(premultiplied);
+
+	FreeImage_Unload(bg);
+	FreeImage_Unload(fg);
+}
+
+/**
+Prints how fast blended pastes, compositions and pre-multiplications go through a 32-bit image
+*/
+static void benchmarkComposite(unsigned width, unsigned height) {
+	FIBITMAP *fg = createRandomImage(width, height, 32);
+	FIBITMAP *bg = createRandomImage(width, height, 24);
+	FIBITMAP *dst = createRandomImage(width, height, 32);
+	const double megapixels = width * height / 1e6;
+
+	printf(" ");
+	for(int k = 0; k < 3; k++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if(k == 0) {
+			FreeImage_Paste(dst, fg, 0, 0, 128);
+		} else if(k == 1) {
+			FIBITMAP *composite = FreeImage_Composite(fg, FALSE, NULL, bg);
+			assert(composite != NULL);
+			FreeImage_Unload(composite);
+		} else {
+			FreeImage_PreMultiplyWithAlpha(fg);
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const char *names[3] = { "paste", "composite", "premultiply" };
+		printf(" %s %.1f MP/s", names[k], megapixels / seconds);
+	}
+	printf("\n");
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(bg);
+	FreeImage_Unload(fg);
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testComposite(unsigned width, unsigned height) {
+	printf("testComposite ...\n");
+
+	// odd widths leave a few pixels past the last whole SIMD block
+	const unsigned bpps[3] = { 8, 24, 32 };
+	for(int k = 0; k < 3; k++) {
+		testPasteBlend(bpps[k], width / 2 + 3, height / 2, 0);
+		testPasteBlend(bpps[k], width / 2 + 3, height / 2, 100);
+		testPasteBlend(bpps[k], width / 2 + 3, height / 2, 255);
+	}
+	testCompositeAlpha(width + 3, height);
+
+	benchmarkComposite(width * 4, height * 4);
+}
@@ -0,0 +1,229 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+// Scalar converters, as FreeImage had them before its SIMD versions, to check those against
+
+static void refConvertLine8To32(BYTE *target, BYTE *source, int width_in_pixels, RGBQUAD *palette) {
+	for (int cols = 0; cols < width_in_pixels; cols++) {
+		target[FI_RGBA_BLUE]	= palette[source[cols]].rgbBlue;
+		target[FI_RGBA_GREEN]	= palette[source[cols]].rgbGreen;
+		target[FI_RGBA_RED]		= palette[source[cols]].rgbRed;
+		target[FI_RGBA_ALPHA]	= 0xFF;
+		target += 4;
+	}
+}
+
+static void refConvertLine16To32_555(BYTE *target, BYTE *source, int width_in_pixels) {
+	WORD *bits = (WORD *)source;
+	for (int cols = 0; cols < width_in_pixels; cols++) {
+		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_BLUE]  = (BYTE)((((bits[cols] & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_ALPHA] = 0xFF;
+		target += 4;
+	}
+}
+
+static void refConvertLine16To32_565(BYTE *target, BYTE *source, int width_in_pixels) {
+	WORD *bits = (WORD *)source;
+	for (int cols = 0; cols < width_in_pixels; cols++) {
+		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F);
+		target[FI_RGBA_BLUE]  = (BYTE)((((bits[cols] & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_ALPHA] = 0xFF;
+		target += 4;
+	}
+}
+
+static void refConvertLine24To32(BYTE *target, BYTE *source, int width_in_pixels) {
+	for (int cols = 0; cols < width_in_pixels; cols++) {
+		target[FI_RGBA_RED]   = source[FI_RGBA_RED];
+		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
+		target[FI_RGBA_BLUE]  = source[FI_RGBA_BLUE];
+		target[FI_RGBA_ALPHA] = 0xFF;
+		target += 4;
+		source += 3;
+	}
+}
+
+static void refConvertLine16To24_555(BYTE *target, BYTE *source, int width_in_pixels) {
+	WORD *bits = (WORD *)source;
+	for (int cols = 0; cols < width_in_pixels; cols++) {
+		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_BLUE]  = (BYTE)((((bits[cols] & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT) * 0xFF) / 0x1F);
+		target += 3;
+	}
+}
+
+static void refConvertLine16To24_565(BYTE *target, BYTE *source, int width_in_pixels) {
+	WORD *bits = (WORD *)source;
+	for (int cols = 0; cols < width_in_pixels; cols++) {
+		target[FI_RGBA_RED]   = (BYTE)((((bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
+		target[FI_RGBA_GREEN] = (BYTE)((((bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F);
+		target[FI_RGBA_BLUE]  = (BYTE)((((bits[cols] & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT) * 0xFF) / 0x1F);
+		target += 3;
+	}
+}
+
+static void refConvertLine32To24(BYTE *target, BYTE *source, int width_in_pixels) {
+	for (int cols = 0; cols < width_in_pixels; cols++) {
+		target[FI_RGBA_BLUE] = source[FI_RGBA_BLUE];
+		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
+		target[FI_RGBA_RED] = source[FI_RGBA_RED];
+		target += 3;
+		source += 4;
+	}
+}
+
+typedef void (*LineConverter)(BYTE *target, BYTE *source, int width_in_pixels);
+
+/**
+A converter under test, next to its scalar reference. 
+Palette converters go through a wrapper holding the palette, since the pair is compared with the same signature.
+*/
+struct ConverterPair {
+	const char *name;
+	unsigned source_bytes;
+	unsigned target_bytes;
+	LineConverter converter;
+	LineConverter reference;
+};
+
+static RGBQUAD s_palette[256];
+
+static void paletteConvertLine8To32(BYTE *target, BYTE *source, int width_in_pixels) {
+	FreeImage_ConvertLine8To32(target, source, width_in_pixels, s_palette);
+}
+
+static void paletteRefConvertLine8To32(BYTE *target, BYTE *source, int width_in_pixels) {
+	refConvertLine8To32(target, source, width_in_pixels, s_palette);
+}
+
+static const ConverterPair s_converters[] = {
+	{ "8 -> 32",       1, 4, paletteConvertLine8To32,         paletteRefConvertLine8To32 },
+	{ "16/555 -> 32",  2, 4, FreeImage_ConvertLine16To32_555, refConvertLine16To32_555 },
+	{ "16/565 -> 32",  2, 4, FreeImage_ConvertLine16To32_565, refConvertLine16To32_565 },
+	{ "24 -> 32",      3, 4, FreeImage_ConvertLine24To32,     refConvertLine24To32 },
+	{ "16/555 -> 24",  2, 3, FreeImage_ConvertLine16To24_555, refConvertLine16To24_555 },
+	{ "16/565 -> 24",  2, 3, FreeImage_ConvertLine16To24_565, refConvertLine16To24_565 },
+	{ "32 -> 24",      4, 3, FreeImage_ConvertLine32To24,     refConvertLine32To24 }
+};
+static const int s_converter_count = sizeof(s_converters) / sizeof(s_converters[0]);
+
+/**
+Checks a converter against its reference over every width up to 70 and a long line, 
+and over every 16-bit value for the 16-bit converters
+*/
+static void testConverter(const ConverterPair &pair) {
+	const int max_width = 65536;
+	std::vector<BYTE> source(max_width * pair.source_bytes);
+	for(size_t i = 0; i < source.size(); i++) {
+		source[i] = (BYTE)rand();
+	}
+	if(pair.source_bytes == 2) {
+		for(int i = 0; i < max_width; i++) {
+			((WORD*)&source[0])[i] = (WORD)i;
+		}
+	}
+
+	// one extra pixel past the end of the line, which mustn't be touched
+	std::vector<BYTE> target((max_width + 1) * pair.target_bytes);
+	std::vector<BYTE> expected((max_width + 1) * pair.target_bytes);
+	for(int width = 0; width <= 71; width++) {
+		const int line = (width == 71) ? max_width : width;
+		memset(&target[0], 0xCD, target.size());
+		memset(&expected[0], 0xCD, expected.size());
+		pair.converter(&target[0], &source[0], line);
+		pair.reference(&expected[0], &source[0], line);
+		assert(memcmp(&target[0], &expected[0], (line + 1) * pair.target_bytes) == 0);
+	}
+}
+
+/**
+Prints the speed of each converter against its scalar reference, over lines of a 'width' by 'height' image
+*/
+static void benchmarkConverter(const ConverterPair &pair, unsigned width, unsigned height) {
+	std::vector<BYTE> source(width * height * pair.source_bytes);
+	std::vector<BYTE> target(width * height * pair.target_bytes);
+	for(size_t i = 0; i < source.size(); i++) {
+		source[i] = (BYTE)rand();
+	}
+
+	double seconds[2];
+	for(int k = 0; k < 2; k++) {
+		LineConverter converter = (k == 0) ? pair.reference : pair.converter;
+		const int runs = 10;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < runs; i++) {
+			for(unsigned y = 0; y < height; y++) {
+				converter(&target[y * width * pair.target_bytes], &source[y * width * pair.source_bytes], width);
+			}
+		}
+		seconds[k] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / runs;
+	}
+	const double megapixels = (double)width * height / 1e6;
+	printf("  %-13s scalar %7.1f MP/s  SIMD %7.1f MP/s  %5.2fx\n", pair.name, megapixels / seconds[0], megapixels / seconds[1], seconds[0] / seconds[1]);
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testConvertLine(unsigned width, unsigned height) {
+	printf("testConvertLine ...\n");
+
+	for(int i = 0; i < 256; i++) {
+		s_palette[i].rgbRed = (BYTE)rand();
+		s_palette[i].rgbGreen = (BYTE)rand();
+		s_palette[i].rgbBlue = (BYTE)rand();
+		s_palette[i].rgbReserved = (BYTE)rand();
+	}
+
+	for(int i = 0; i < s_converter_count; i++) {
+		testConverter(s_converters[i]);
+	}
+
+	// 32 to 24 also works in place, which PNG relies on
+	{
+		const int line = 1003;
+		std::vector<BYTE> pixels(line * 4), expected(line * 3);
+		for(size_t i = 0; i < pixels.size(); i++) {
+			pixels[i] = (BYTE)rand();
+		}
+		refConvertLine32To24(&expected[0], &pixels[0], line);
+		FreeImage_ConvertLine32To24(&pixels[0], &pixels[0], line);
+		assert(memcmp(&pixels[0], &expected[0], expected.size()) == 0);
+	}
+
+	for(int i = 0; i < s_converter_count; i++) {
+		benchmarkConverter(s_converters[i], width, height);
+	}
+}
@@ -0,0 +1,250 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <chrono>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Builds a 32-bit test image: a zone plate in red, gradients in green and blue, 
+and an alpha channel with a hard-edged hole over a soft ramp
+*/
+static FIBITMAP* createColorImage(unsigned width, unsigned height) {
+	FIBITMAP *zone = createZonePlateImage(width, height, 16);
+	if(!zone) {
+		return NULL;
+	}
+	FIBITMAP *dst = FreeImage_ConvertTo32Bits(zone);
+	FreeImage_Unload(zone);
+	if(!dst) {
+		return NULL;
+	}
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++, bits += 4) {
+			bits[FI_RGBA_GREEN] = (BYTE)(x * 255 / width);
+			bits[FI_RGBA_BLUE] = (BYTE)(y * 255 / height);
+			const int dx = (int)x - (int)width / 2, dy = (int)y - (int)height / 2;
+			bits[FI_RGBA_ALPHA] = (dx * dx + dy * dy < (int)(width * width / 16)) ? 0 : (BYTE)((x + y) * 255 / (width + height));
+		}
+	}
+	return dst;
+}
+
+/**
+Peak signal to noise ratio between two 32-bit images of the same size, over the first channels (in R, G, B, A order)
+*/
+static double computePSNR(FIBITMAP *src, FIBITMAP *dst, int channels) {
+	static const int order[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	double error = 0;
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		const BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++, src_bits += 4, dst_bits += 4) {
+			for(int c = 0; c < channels; c++) {
+				const double delta = (double)src_bits[order[c]] - (double)dst_bits[order[c]];
+				error += delta * delta;
+			}
+		}
+	}
+	error /= (double)width * height * channels;
+	return (error > 0) ? 10 * log10(255.0 * 255.0 / error) : 100;
+}
+
+static long getFileSize(const char *lpszPathName) {
+	struct stat info;
+	return (stat(lpszPathName, &info) == 0) ? (long)info.st_size : -1;
+}
+
+/**
+Saves, reloads, and checks the image came back close to the original
+*/
+static void testDDSRoundTrip(FIBITMAP *src, int flags, int channels, unsigned bpp, double min_psnr) {
+	BOOL bResult = FreeImage_Save(FIF_DDS, src, "test.dds", flags);
+	assert(bResult);
+
+	FIBITMAP *dst = FreeImage_Load(FIF_DDS, "test.dds", DDS_DEFAULT);
+	assert(dst != NULL);
+	assert(FreeImage_GetWidth(dst) == FreeImage_GetWidth(src));
+	assert(FreeImage_GetHeight(dst) == FreeImage_GetHeight(src));
+	assert(FreeImage_GetBPP(dst) == bpp);
+
+	FIBITMAP *dst32 = FreeImage_ConvertTo32Bits(dst);
+	assert(dst32 != NULL);
+	const double psnr = computePSNR(src, dst32, channels);
+	assert(psnr >= min_psnr);
+	FreeImage_Unload(dst32);
+	FreeImage_Unload(dst);
+}
+
+/**
+Checks each mipmap can be loaded on its own, as a page or through the size hint
+*/
+static void testDDSMipmaps(FIBITMAP *src) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	BOOL bResult = FreeImage_Save(FIF_DDS, src, "test.dds", DDS_BC1 | DDS_MIPMAPS | DDS_QUALITY_FAST);
+	assert(bResult);
+
+	FIMULTIBITMAP *mdib = FreeImage_OpenMultiBitmap(FIF_DDS, "test.dds", FALSE, TRUE, FALSE, DDS_DEFAULT);
+	assert(mdib != NULL);
+	const int count = FreeImage_GetPageCount(mdib);
+	int levels = 1;
+	for(unsigned size = (width > height) ? width : height; size > 1; size >>= 1) {
+		levels++;
+	}
+	assert(count == levels);
+	for(int page = 0; page < count; page++) {
+		FIBITMAP *dib = FreeImage_LockPage(mdib, page);
+		assert(dib != NULL);
+		assert(FreeImage_GetWidth(dib) == ((width >> page) ? (width >> page) : 1));
+		assert(FreeImage_GetHeight(dib) == ((height >> page) ? (height >> page) : 1));
+		FreeImage_UnlockPage(mdib, dib, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(mdib, 0);
+
+	// the smallest level at least 100 pixels across
+	FIBITMAP *dib = FreeImage_Load(FIF_DDS, "test.dds", 100 << 16);
+	assert(dib != NULL);
+	unsigned expected = width;
+	while((expected / 2 >= 100) || (height * expected / width / 2 >= 100)) {
+		expected /= 2;
+	}
+	assert(FreeImage_GetWidth(dib) == expected);
+	FreeImage_Unload(dib);
+}
+
+/**
+Checks the size of a saved file against its header, block size and number of mipmaps
+*/
+static void testDDSFileSize(FIBITMAP *src, int flags, unsigned header_size, unsigned block_size) {
+	BOOL bResult = FreeImage_Save(FIF_DDS, src, "test.dds", flags);
+	assert(bResult);
+
+	unsigned width = FreeImage_GetWidth(src);
+	unsigned height = FreeImage_GetHeight(src);
+	long expected = header_size;
+	for(;;) {
+		expected += ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+		if(!(flags & DDS_MIPMAPS) || (width == 1 && height == 1)) {
+			break;
+		}
+		width = (width > 1) ? width / 2 : 1;
+		height = (height > 1) ? height / 2 : 1;
+	}
+	assert(getFileSize("test.dds") == expected);
+}
+
+/**
+Prints the compression speed of each format and quality level, and the decompression speed of each format
+*/
+static void benchmarkDDS(FIBITMAP *src) {
+	static const struct { int flags; const char *name; } formats[] = {
+		{ DDS_BC1, "BC1" }, { DDS_BC3, "BC3" }, { DDS_BC4, "BC4" }, { DDS_BC5, "BC5" }, { DDS_BC7, "BC7" }
+	};
+	static const struct { int flags; const char *name; } qualities[] = {
+		{ DDS_QUALITY_FAST, "fast" }, { DDS_DEFAULT, "normal" }, { DDS_QUALITY_SLOW, "slow" }
+	};
+	const double megapixels = FreeImage_GetWidth(src) * FreeImage_GetHeight(src) / 1e6;
+
+	for(int f = 0; f < 5; f++) {
+		printf("  %s:", formats[f].name);
+		for(int q = 0; q < 3; q++) {
+			FIMEMORY *hmem = FreeImage_OpenMemory();
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			BOOL bResult = FreeImage_SaveToMemory(FIF_DDS, src, hmem, formats[f].flags | qualities[q].flags);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			assert(bResult);
+
+			if(q == 0) {
+				// decoding doesn't depend on the quality, so time it once
+				const int runs = 10;
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for(int i = 0; i < runs; i++) {
+					FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+					FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, DDS_DEFAULT);
+					assert(dib != NULL);
+					FreeImage_Unload(dib);
+				}
+				const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				printf("  decode %.1f MP/s ", runs * megapixels / seconds);
+			}
+			FreeImage_CloseMemory(hmem);
+			printf("  %s %.1f MP/s", qualities[q].name, megapixels / seconds);
+		}
+		printf("\n");
+	}
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testDDS(unsigned width, unsigned height) {
+	// DDSHEADER, and the DX10 extension that follows it
+	const unsigned header_size = 128;
+	const unsigned header_dx10_size = 148;
+
+	printf("testDDS ...\n");
+
+	FIBITMAP *src = createColorImage(width, height);
+	assert(src != NULL);
+	FIBITMAP *opaque = FreeImage_ConvertTo24Bits(src);
+	assert(opaque != NULL);
+	FIBITMAP *rgb = FreeImage_ConvertTo32Bits(opaque);
+	assert(rgb != NULL);
+
+	// the zone plate's corners are close to the worst case for 4x4 blocks
+	testDDSRoundTrip(rgb, DDS_DEFAULT, 3, 32, 29);
+	testDDSRoundTrip(rgb, DDS_BC1 | DDS_QUALITY_FAST, 3, 32, 28);
+	testDDSRoundTrip(rgb, DDS_BC1 | DDS_QUALITY_SLOW, 3, 32, 29);
+	testDDSRoundTrip(src, DDS_DEFAULT, 4, 32, 29);
+	testDDSRoundTrip(src, DDS_BC3 | DDS_MIPMAPS, 4, 32, 29);
+	testDDSRoundTrip(src, DDS_BC4, 1, 8, 30);
+	testDDSRoundTrip(src, DDS_BC5, 2, 24, 30);
+	testDDSRoundTrip(src, DDS_BC7, 4, 32, 29);
+	testDDSMipmaps(rgb);
+
+	// BC4, BC5 and BC7 need the DX10 header
+	testDDSFileSize(opaque, DDS_DEFAULT, header_size, 8);
+	testDDSFileSize(src, DDS_BC3 | DDS_MIPMAPS, header_size, 16);
+	testDDSFileSize(src, DDS_BC4, header_dx10_size, 8);
+	testDDSFileSize(src, DDS_BC5 | DDS_MIPMAPS, header_dx10_size, 16);
+	testDDSFileSize(src, DDS_BC7 | DDS_QUALITY_FAST | DDS_MIPMAPS, header_dx10_size, 16);
+
+	// partial blocks along the edges
+	FIBITMAP *odd = FreeImage_Rescale(src, 37, 21, FILTER_BOX);
+	assert(odd != NULL);
+	testDDSFileSize(odd, DDS_BC1 | DDS_MIPMAPS, header_size, 8);
+	FreeImage_Unload(odd);
+
+	benchmarkDDS(src);
+
+	FreeImage_Unload(rgb);
+	FreeImage_Unload(opaque);
+	FreeImage_Unload(src);
+}
@@ -22,6 +22,8 @@
 
 #include "TestSuite.h"
 
+#include <string.h>
+
 void  
 testBuildMPage(const char *src_filename, const char *dst_filename, FREE_IMAGE_FORMAT dst_fif, unsigned bpp) {
 	// get the file type
@@ -93,6 +95,102 @@ void testMPageCache(const char *src_filename, const char *dst_filename) {
 
 // --------------------------------------------------------------------------
 
+void testMPageCacheSpill(const char *dst_filename) {
+	const unsigned width = 256;
+	const unsigned height = 256;
+	const int page_count = 24;
+
+	// a cache of 4 blocks, so that most pages are spilled to the cache file
+	// (noise doesn't compress, so each page takes several cache blocks)
+	FreeImage_SetMultiBitmapCacheSize(4 * 64 * 1024);
+
+	FIMULTIBITMAP *out = FreeImage_OpenMultiBitmap(FIF_TIFF, dst_filename, TRUE, FALSE, FALSE);
+	assert(out != NULL);
+	for(int i = 0; i < page_count; i++) {
+		FIBITMAP *page = createNoiseImage(FIT_BITMAP, 24, width, height, i);
+		assert(page != NULL);
+		FreeImage_AppendPage(out, page);
+		FreeImage_Unload(page);
+	}
+	// replace a page, so that freed blocks get reused
+	FreeImage_DeletePage(out, 3);
+	{
+		FIBITMAP *page = createNoiseImage(FIT_BITMAP, 24, width, height, 3);
+		assert(page != NULL);
+		FreeImage_InsertPage(out, 3, page);
+		FreeImage_Unload(page);
+	}
+	assert(FreeImage_GetPageCount(out) == page_count);
+	BOOL bSuccess = FreeImage_CloseMultiBitmap(out, 0);
+	assert(bSuccess);
+
+	FreeImage_SetMultiBitmapCacheSize(0);
+
+	// every page must come back as it went in
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_TIFF, dst_filename, FALSE, TRUE, TRUE);
+	assert(src != NULL);
+	assert(FreeImage_GetPageCount(src) == page_count);
+	for(int i = 0; i < page_count; i++) {
+		FIBITMAP *expected = createNoiseImage(FIT_BITMAP, 24, width, height, i);
+		assert(expected != NULL);
+		FIBITMAP *dib = FreeImage_LockPage(src, i);
+		assert(dib != NULL);
+		for(unsigned y = 0; y < height; y++) {
+			assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(expected, y), width * 3) == 0);
+		}
+		FreeImage_UnlockPage(src, dib, FALSE);
+		FreeImage_Unload(expected);
+	}
+	FreeImage_CloseMultiBitmap(src, 0);
+}
+
+/**
+Locks the pages of a file written by testMPageCacheSpill out of order and while read ahead pages are waiting, 
+so that pages are both taken from the prefetcher and dropped by it
+@param prefetch Pages to read ahead, or 0 to lock every page without a prefetcher
+*/
+void testMPagePrefetch(const char *src_filename, unsigned prefetch) {
+	const unsigned width = 256;
+	const unsigned height = 256;
+	const int order[] = { 0, 1, 2, 3, 10, 11, 6, 7, 23, 22, 12, 13, 14, 15, 16 };
+
+	FreeImage_SetMultiBitmapPrefetch(prefetch);
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_TIFF, src_filename, FALSE, TRUE, TRUE);
+	assert(src != NULL);
+
+	FIBITMAP *previous = NULL;
+	for(size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+		FIBITMAP *expected = createNoiseImage(FIT_BITMAP, 24, width, height, order[i]);
+		assert(expected != NULL);
+		FIBITMAP *dib = FreeImage_LockPage(src, order[i]);
+		assert(dib != NULL);
+		for(unsigned y = 0; y < height; y++) {
+			assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(expected, y), width * 3) == 0);
+		}
+		FreeImage_Unload(expected);
+
+		// a locked page can't be locked twice
+		assert(FreeImage_LockPage(src, order[i]) == NULL);
+
+		// keep two pages locked at a time
+		if(previous) {
+			FreeImage_UnlockPage(src, previous, FALSE);
+		}
+		previous = dib;
+	}
+	FreeImage_UnlockPage(src, previous, FALSE);
+
+	// pages still read ahead are let go of here
+	FIBITMAP *dib = FreeImage_LockPage(src, 17);
+	assert(dib != NULL);
+	FreeImage_UnlockPage(src, dib, FALSE);
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	FreeImage_SetMultiBitmapPrefetch(4);
+}
+
+// --------------------------------------------------------------------------
+
 BOOL testCloneMultiPage(FREE_IMAGE_FORMAT fif, const char *input, const char *output, int output_flag) {
 
 	BOOL bMemoryCache = TRUE;
@@ -190,4 +288,12 @@ void testMultiPage(const char *lpszPathName) {
 
 	// test multipage cache
 	testMPageCache(lpszPathName, "mpages.tif");
+
+	// test a multipage cache that spills to file
+	testMPageCacheSpill("spill.tif");
+
+	// test pages read ahead of FreeImage_LockPage, and with read-ahead turned off
+	testMPagePrefetch("spill.tif", 4);
+	testMPagePrefetch("spill.tif", 1);
+	testMPagePrefetch("spill.tif", 0);
 }
@@ -22,6 +22,9 @@
 
 #include "TestSuite.h"
 
+#include <string.h>
+#include <chrono>
+
 void testSaveMemIO(const char *lpszPathName) {
 	FIMEMORY *hmem = NULL; 
 
@@ -139,6 +142,91 @@ void testAcquireMemIO(const char *lpszPathName) {
 
 }
 
+static BOOL isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if(!dib1 || !dib2 || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return FALSE;
+	}
+	const unsigned width = FreeImage_GetWidth(dib1);
+	const unsigned height = FreeImage_GetHeight(dib1);
+	if((width != FreeImage_GetWidth(dib2)) || (height != FreeImage_GetHeight(dib2))) {
+		return FALSE;
+	}
+	const unsigned line = FreeImage_GetLine(dib1);
+	for(unsigned y = 0; y < height; y++) {
+		if(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), line) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Loads a file through FreeImage_OpenMapped, checks it against FreeImage_Load, 
+and times both
+*/
+static void testLoadMappedIO(FREE_IMAGE_FORMAT fif, const char *lpszPathName) {
+	FIBITMAP *loaded = FreeImage_Load(fif, lpszPathName, 0);
+	assert(loaded != NULL);
+
+	FIMEMORY *hmem = FreeImage_OpenMapped(lpszPathName);
+	assert(hmem != NULL);
+	assert(FreeImage_GetFileTypeFromMemory(hmem, 0) == fif);
+	FIBITMAP *mapped = FreeImage_LoadFromMemory(fif, hmem, 0);
+	assert(isSameImage(loaded, mapped));
+
+	// a mapped file is read-only
+	assert(FreeImage_SaveToMemory(fif, mapped, hmem, 0) == FALSE);
+
+	FreeImage_Unload(mapped);
+	FreeImage_CloseMemory(hmem);
+
+	const int repeat = 20;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i = 0; i < repeat; i++) {
+		FreeImage_Unload(FreeImage_Load(fif, lpszPathName, 0));
+	}
+	const double file_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for(int i = 0; i < repeat; i++) {
+		hmem = FreeImage_OpenMapped(lpszPathName);
+		FreeImage_Unload(FreeImage_LoadFromMemory(fif, hmem, 0));
+		FreeImage_CloseMemory(hmem);
+	}
+	const double mapped_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const double megapixels = (double)FreeImage_GetWidth(loaded) * FreeImage_GetHeight(loaded) * repeat / 1e6;
+	printf("  %-5s file %.1f MP/s  mapped %.1f MP/s\n", FreeImage_GetFormatFromFIF(fif), megapixels / file_seconds, megapixels / mapped_seconds);
+
+	FreeImage_Unload(loaded);
+}
+
+void testMappedIO(const char *lpszPathName) {
+	// files that aren't there or are empty can't be mapped
+	assert(FreeImage_OpenMapped("missing.png") == NULL);
+	FILE *stream = fopen("empty.png", "wb");
+	if(stream) {
+		fclose(stream);
+		assert(FreeImage_OpenMapped("empty.png") == NULL);
+		remove("empty.png");
+	}
+
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib);
+
+	// JPEG and DDS decode straight from the mapped bytes, PNG goes through read_proc
+	FreeImage_Save(FIF_JPEG, dib24, "mapped.jpg", JPEG_DEFAULT);
+	FreeImage_Save(FIF_DDS, dib24, "mapped.dds", DDS_BC1);
+	FreeImage_Save(FIF_PNG, dib24, "mapped.png", PNG_DEFAULT);
+	testLoadMappedIO(FIF_JPEG, "mapped.jpg");
+	testLoadMappedIO(FIF_DDS, "mapped.dds");
+	testLoadMappedIO(FIF_PNG, "mapped.png");
+
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib);
+}
+
 void testMemIO(const char *lpszPathName) {
 	printf("testMemIO ...\n");
 	testSaveMemIO(lpszPathName);
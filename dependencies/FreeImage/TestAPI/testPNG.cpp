@@ -0,0 +1,157 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <chrono>
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Builds an image of smooth gradients with a little noise, so that every PNG filter gets picked somewhere
+*/
+static FIBITMAP* createGradientImage(FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *dib = createNoiseImage(type, bpp, width, height, width * 17 + bpp);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			bits[x] = (BYTE)((x * 3 + y * 2) / 5 + (bits[x] >> 5));
+		}
+	}
+	if((type == FIT_BITMAP) && (bpp <= 8)) {
+		RGBQUAD *pal = FreeImage_GetPalette(dib);
+		for(unsigned i = 0; i < FreeImage_GetColorsUsed(dib); i++) {
+			pal[i].rgbRed = (BYTE)(i * 5);
+			pal[i].rgbGreen = (BYTE)(255 - i);
+			pal[i].rgbBlue = (BYTE)(i * 11);
+		}
+	}
+	return dib;
+}
+
+/**
+Saves an image to PNG in memory and loads it back, checking that every pixel survives
+*/
+static void testRoundTrip(FIBITMAP *dib, int flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(hmem != NULL);
+	BOOL bResult = FreeImage_SaveToMemory(FIF_PNG, dib, hmem, flags);
+	assert(bResult);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_PNG, hmem);
+	assert(loaded != NULL);
+	assert(FreeImage_GetImageType(loaded) == FreeImage_GetImageType(dib));
+	assert(FreeImage_GetWidth(loaded) == FreeImage_GetWidth(dib));
+	assert(FreeImage_GetHeight(loaded) == FreeImage_GetHeight(dib));
+
+	// 32-bit images without alpha come back as 24-bit
+	const unsigned bpp = FreeImage_GetBPP(loaded);
+	const unsigned bytespp = bpp / 8;
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(dib, y);
+		const BYTE *dst_bits = FreeImage_GetScanLine(loaded, y);
+		if(bpp == FreeImage_GetBPP(dib)) {
+			assert(memcmp(src_bits, dst_bits, (FreeImage_GetWidth(dib) * bpp) / 8) == 0);
+		} else {
+			for(unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
+				assert(memcmp(src_bits + x * 4, dst_bits + x * bytespp, bytespp) == 0);
+			}
+		}
+	}
+
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+}
+
+/**
+Round-trips every exported pixel format, serially and in parallel bands
+*/
+static void testPNGFormats(unsigned width, unsigned height) {
+	const FREE_IMAGE_TYPE types[8] = { FIT_BITMAP, FIT_BITMAP, FIT_BITMAP, FIT_BITMAP, FIT_BITMAP, FIT_UINT16, FIT_RGB16, FIT_RGBA16 };
+	const unsigned bpps[8] = { 1, 4, 8, 24, 32, 16, 48, 64 };
+
+	for(int k = 0; k < 8; k++) {
+		FIBITMAP *dib = createGradientImage(types[k], width, height, bpps[k]);
+		testRoundTrip(dib, PNG_DEFAULT);
+		testRoundTrip(dib, PNG_Z_PARALLEL);
+		testRoundTrip(dib, PNG_Z_PARALLEL | PNG_Z_BEST_SPEED);
+		testRoundTrip(dib, PNG_Z_PARALLEL | PNG_Z_NO_COMPRESSION);
+		testRoundTrip(dib, PNG_Z_PARALLEL | PNG_INTERLACED);
+		FreeImage_Unload(dib);
+	}
+
+	// a single row and a single column
+	FIBITMAP *dib = createGradientImage(FIT_BITMAP, width, 1, 24);
+	testRoundTrip(dib, PNG_Z_PARALLEL);
+	FreeImage_Unload(dib);
+	dib = createGradientImage(FIT_BITMAP, 1, height, 32);
+	testRoundTrip(dib, PNG_Z_PARALLEL);
+	FreeImage_Unload(dib);
+}
+
+/**
+Prints how fast a 24-bit image is saved serially and in parallel bands, and loaded back
+*/
+static void benchmarkPNG(unsigned width, unsigned height) {
+	FIBITMAP *dib = createGradientImage(FIT_BITMAP, width, height, 24);
+	const double megapixels = width * height / 1e6;
+
+	printf(" ");
+	for(int k = 0; k < 2; k++) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		assert(hmem != NULL);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FreeImage_SaveToMemory(FIF_PNG, dib, hmem, (k == 0) ? PNG_DEFAULT : PNG_Z_PARALLEL);
+		const double save_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		start = std::chrono::steady_clock::now();
+		FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_PNG, hmem);
+		const double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		assert(loaded != NULL);
+
+		printf(" %s save %.1f MP/s load %.1f MP/s", (k == 0) ? "serial" : "parallel", megapixels / save_seconds, megapixels / load_seconds);
+
+		FreeImage_Unload(loaded);
+		FreeImage_CloseMemory(hmem);
+	}
+	printf("\n");
+
+	FreeImage_Unload(dib);
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testPNG(unsigned width, unsigned height) {
+	printf("testPNG ...\n");
+
+	// odd widths leave a few bytes past the last whole SIMD block
+	testPNGFormats(width / 2 + 3, height / 2);
+
+	benchmarkPNG(width * 2, height * 2);
+}
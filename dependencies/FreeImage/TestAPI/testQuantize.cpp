@@ -0,0 +1,142 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Builds a 24-bit image of smooth gradients with a little noise, so that it has many more colours than a palette
+*/
+static FIBITMAP* createGradientImage(unsigned width, unsigned height) {
+	FIBITMAP *dib = createNoiseImage(FIT_BITMAP, 24, width, height, 1);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++, bits += 3) {
+			bits[FI_RGBA_RED] = (BYTE)(x * 255 / width);
+			bits[FI_RGBA_GREEN] = (BYTE)(y * 255 / height);
+			bits[FI_RGBA_BLUE] = (BYTE)(((x + y) * 127 / (width + height)) + (bits[FI_RGBA_BLUE] >> 5));
+		}
+	}
+	return dib;
+}
+
+static int getDistance(const BYTE *bits, const RGBQUAD &color) {
+	return abs(bits[FI_RGBA_RED] - color.rgbRed) + abs(bits[FI_RGBA_GREEN] - color.rgbGreen) + abs(bits[FI_RGBA_BLUE] - color.rgbBlue);
+}
+
+/**
+Checks that NeuQuant maps every pixel to a palette entry at the smallest distance from it
+*/
+static void testNearestColor(FIBITMAP *src) {
+	FIBITMAP *dst = FreeImage_ColorQuantize(src, FIQ_NNQUANT);
+	assert(dst != NULL);
+	assert(FreeImage_GetBPP(dst) == 8);
+	const RGBQUAD *pal = FreeImage_GetPalette(dst);
+
+	for(unsigned y = 0; y < FreeImage_GetHeight(src); y++) {
+		const BYTE *bits = FreeImage_GetScanLine(src, y);
+		const BYTE *index = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(src); x++, bits += 3) {
+			int nearest = 1000;
+			for(int i = 0; i < 256; i++) {
+				const int distance = getDistance(bits, pal[i]);
+				if(distance < nearest) {
+					nearest = distance;
+				}
+			}
+			assert(getDistance(bits, pal[index[x]]) == nearest);
+		}
+	}
+
+	FreeImage_Unload(dst);
+}
+
+/**
+Checks that quantizing twice gives the same image, and that it stays close to the original
+*/
+static void testQuantizeStable(FIBITMAP *src, FREE_IMAGE_QUANTIZE quantize) {
+	FIBITMAP *first = FreeImage_ColorQuantize(src, quantize);
+	assert(first != NULL);
+	FIBITMAP *second = FreeImage_ColorQuantize(src, quantize);
+	assert(second != NULL);
+
+	assert(memcmp(FreeImage_GetPalette(first), FreeImage_GetPalette(second), 256 * sizeof(RGBQUAD)) == 0);
+	const RGBQUAD *pal = FreeImage_GetPalette(first);
+	double error = 0;
+	for(unsigned y = 0; y < FreeImage_GetHeight(src); y++) {
+		assert(memcmp(FreeImage_GetScanLine(first, y), FreeImage_GetScanLine(second, y), FreeImage_GetWidth(src)) == 0);
+		const BYTE *bits = FreeImage_GetScanLine(src, y);
+		const BYTE *index = FreeImage_GetScanLine(first, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(src); x++, bits += 3) {
+			error += getDistance(bits, pal[index[x]]);
+		}
+	}
+	// on average, within a few levels of each channel
+	assert(error / (FreeImage_GetWidth(src) * FreeImage_GetHeight(src)) < 16.0);
+
+	FreeImage_Unload(second);
+	FreeImage_Unload(first);
+}
+
+/**
+Prints how fast each quantizer goes through an image
+*/
+static void benchmarkQuantize(FIBITMAP *src) {
+	const double megapixels = FreeImage_GetWidth(src) * FreeImage_GetHeight(src) / 1e6;
+
+	printf(" ");
+	for(int q = 0; q < 2; q++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FIBITMAP *dst = FreeImage_ColorQuantize(src, q ? FIQ_NNQUANT : FIQ_WUQUANT);
+		assert(dst != NULL);
+		FreeImage_Unload(dst);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf(" %s %.1f MP/s", q ? "NeuQuant" : "Wu", megapixels / seconds);
+	}
+	printf("\n");
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testQuantize(unsigned width, unsigned height) {
+	printf("testQuantize ...\n");
+
+	FIBITMAP *src = createGradientImage(width, height);
+
+	testNearestColor(src);
+	testQuantizeStable(src, FIQ_WUQUANT);
+	testQuantizeStable(src, FIQ_NNQUANT);
+
+	FreeImage_Unload(src);
+
+	src = createGradientImage(width * 2, height * 2);
+	benchmarkQuantize(src);
+	FreeImage_Unload(src);
+}
@@ -0,0 +1,352 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <chrono>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Checks that scaling part of an image gives the same pixels as scaling a copy of that part
+*/
+static void testRescaleRect(FIBITMAP *src, FREE_IMAGE_FILTER filter, unsigned flags) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const int left = width / 5, top = height / 7, right = width - width / 9, bottom = height - height / 3;
+
+	FIBITMAP *copy = FreeImage_Copy(src, left, top, right, bottom);
+	assert(copy != NULL);
+	FIBITMAP *expected = FreeImage_RescaleRect(copy, width / 3, height / 2, 0, 0, right - left, bottom - top, filter, flags);
+	assert(expected != NULL);
+	FIBITMAP *actual = FreeImage_RescaleRect(src, width / 3, height / 2, left, top, right, bottom, filter, flags);
+	assert(actual != NULL);
+
+	const unsigned line = FreeImage_GetLine(actual);
+	assert(line == FreeImage_GetLine(expected));
+	for(unsigned y = 0; y < FreeImage_GetHeight(actual); y++) {
+		assert(memcmp(FreeImage_GetScanLine(actual, y), FreeImage_GetScanLine(expected, y), line) == 0);
+	}
+
+	FreeImage_Unload(actual);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(copy);
+}
+
+/**
+Checks that the SIMD filters give the same pixels as the scalar ones, to within rounding
+*/
+static void testRescaleSIMD(FIBITMAP *src, FREE_IMAGE_FILTER filter) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const int left = width / 5, top = height / 7, right = width - width / 9, bottom = height - height / 3;
+
+	FIBITMAP *simd = FreeImage_RescaleRect(src, width / 3, height / 2, left, top, right, bottom, filter, FI_RESCALE_DEFAULT);
+	assert(simd != NULL);
+	FIBITMAP *scalar = FreeImage_RescaleRect(src, width / 3, height / 2, left, top, right, bottom, filter, FI_RESCALE_NO_SIMD);
+	assert(scalar != NULL);
+
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType(src);
+	const BOOL is_float = (type == FIT_FLOAT) || (type == FIT_RGBF) || (type == FIT_RGBAF);
+	const unsigned line = FreeImage_GetLine(simd);
+	assert(line == FreeImage_GetLine(scalar));
+	for(unsigned y = 0; y < FreeImage_GetHeight(simd); y++) {
+		const BYTE *a = FreeImage_GetScanLine(simd, y);
+		const BYTE *b = FreeImage_GetScanLine(scalar, y);
+		if(is_float) {
+			for(unsigned x = 0; x < line / sizeof(float); x++) {
+				assert(fabs(((const float*)a)[x] - ((const float*)b)[x]) < 1e-4f);
+			}
+		} else {
+			for(unsigned x = 0; x < line; x++) {
+				assert(abs(a[x] - b[x]) <= 1);
+			}
+		}
+	}
+
+	FreeImage_Unload(scalar);
+	FreeImage_Unload(simd);
+}
+
+/**
+Checks that a flat image stays flat, whether it shrinks or grows
+*/
+static void testRescaleFlat(FREE_IMAGE_TYPE type, unsigned bpp, FREE_IMAGE_FILTER filter) {
+	FIBITMAP *src = FreeImage_AllocateT(type, 61, 43, bpp);
+	assert(src != NULL);
+	const unsigned line = FreeImage_GetLine(src);
+	for(unsigned y = 0; y < FreeImage_GetHeight(src); y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		if(type == FIT_BITMAP) {
+			memset(bits, 200, line);
+		} else {
+			for(unsigned x = 0; x < line / sizeof(float); x++) {
+				((float*)bits)[x] = 0.75f;
+			}
+		}
+	}
+	if(bpp == 8) {
+		RGBQUAD *pal = FreeImage_GetPalette(src);
+		for(unsigned i = 0; i < 256; i++) {
+			pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
+		}
+	}
+
+	static const int sizes[][2] = { { 17, 11 }, { 150, 29 }, { 20, 97 } };
+	for(int s = 0; s < 3; s++) {
+		FIBITMAP *dst = FreeImage_Rescale(src, sizes[s][0], sizes[s][1], filter);
+		assert(dst != NULL);
+		assert(FreeImage_GetBPP(dst) == bpp);
+		for(unsigned y = 0; y < FreeImage_GetHeight(dst); y++) {
+			const BYTE *bits = FreeImage_GetScanLine(dst, y);
+			for(unsigned x = 0; x < FreeImage_GetLine(dst); x++) {
+				if(type == FIT_BITMAP) {
+					assert(bits[x] == 200);
+				} else if(x % sizeof(float) == 0) {
+					assert(fabs(((const float*)bits)[x / sizeof(float)] - 0.75f) < 1e-5f);
+				}
+			}
+		}
+		FreeImage_Unload(dst);
+	}
+
+	FreeImage_Unload(src);
+}
+
+/**
+Prints how fast each filter shrinks and enlarges an image
+*/
+static void benchmarkRescale(FIBITMAP *src, const char *name) {
+	static const struct { FREE_IMAGE_FILTER filter; const char *name; } filters[] = {
+		{ FILTER_BOX, "box" }, { FILTER_BILINEAR, "bilinear" }, { FILTER_BICUBIC, "bicubic" }, 
+		{ FILTER_CATMULLROM, "Catmull-Rom" }, { FILTER_LANCZOS3, "Lanczos3" }
+	};
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const double megapixels = width * height / 1e6;
+	const int runs = 4;
+
+	printf("  %s:\n", name);
+	for(int f = 0; f < 5; f++) {
+		printf("    %-12s", filters[f].name);
+		// input megapixels per second, halving and then doubling each side
+		for(int grow = 0; grow < 2; grow++) {
+			const int dst_width = grow ? width * 2 : width / 2;
+			const int dst_height = grow ? height * 2 : height / 2;
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < runs; i++) {
+				FIBITMAP *dst = FreeImage_Rescale(src, dst_width, dst_height, filters[f].filter);
+				assert(dst != NULL);
+				FreeImage_Unload(dst);
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("  %s %.1f MP/s", grow ? "enlarge" : "shrink", runs * megapixels / seconds);
+		}
+		printf("\n");
+	}
+}
+
+/**
+Builds a 32-bit image by calling func(x, y, bits) on each pixel, with y counted from the top
+*/
+template <class FUNC> static FIBITMAP* createPatternImage(unsigned width, unsigned height, FUNC func) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 32);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
+		for(unsigned x = 0; x < width; x++, bits += 4) {
+			func(x, y, bits);
+		}
+	}
+	return dib;
+}
+
+/**
+Fraction of a level's pixels which pass the alpha test
+*/
+static double getCoverage(const BYTE *rgba, unsigned count, BYTE alpha_ref) {
+	unsigned passing = 0;
+	for(unsigned i = 0; i < count; i++) {
+		passing += (rgba[i * 4 + 3] >= alpha_ref);
+	}
+	return (double)passing / count;
+}
+
+/**
+Checks the layout, filtering modes and alpha coverage of FreeImage_GenerateMipmaps
+*/
+static void testMipmaps() {
+	DWORD offsets[16];
+
+	// layout: tightly packed levels down to 1x1, odd sizes rounding down
+	FIBITMAP *flat = createPatternImage(37, 21, [](unsigned x, unsigned y, BYTE *bits) {
+		bits[FI_RGBA_RED] = 128; bits[FI_RGBA_GREEN] = 20; bits[FI_RGBA_BLUE] = 230; bits[FI_RGBA_ALPHA] = 255;
+	});
+	assert(FreeImage_GetMipmapCount(37, 21) == 6);
+	const DWORD size = FreeImage_GenerateMipmaps(flat, NULL, 0, FI_MIPMAP_DEFAULT, 128, offsets);
+	assert(size == (37 * 21 + 18 * 10 + 9 * 5 + 4 * 2 + 2 * 1 + 1 * 1) * 4);
+	assert(offsets[1] == 37 * 21 * 4 && offsets[5] == size - 4);
+	std::vector<BYTE> chain(size);
+	assert(FreeImage_GenerateMipmaps(flat, &chain[0], 0, FI_MIPMAP_DEFAULT, 128, NULL) == size);
+	// the three-tap filter for odd sizes still keeps a flat image flat
+	for(DWORD i = 0; i < size; i += 4) {
+		assert(chain[i] == 128 && chain[i + 1] == 20 && chain[i + 2] == 230 && chain[i + 3] == 255);
+	}
+	assert(FreeImage_GenerateMipmaps(flat, NULL, 2, FI_MIPMAP_DEFAULT, 128, NULL) == offsets[2]);
+	FreeImage_Unload(flat);
+
+	// black and white pixels average to half the light, which is 188 in sRGB, or 128 as plain numbers
+	FIBITMAP *checker = createPatternImage(64, 64, [](unsigned x, unsigned y, BYTE *bits) {
+		bits[FI_RGBA_RED] = bits[FI_RGBA_GREEN] = bits[FI_RGBA_BLUE] = ((x ^ y) & 1) ? 255 : 0;
+		bits[FI_RGBA_ALPHA] = 255;
+	});
+	chain.resize(FreeImage_GenerateMipmaps(checker, NULL));
+	FreeImage_GenerateMipmaps(checker, &chain[0], 0, FI_MIPMAP_DEFAULT, 128, offsets);
+	assert(chain[offsets[1]] == 188 && chain[offsets[6]] == 188);
+	FreeImage_GenerateMipmaps(checker, &chain[0], 0, FI_MIPMAP_LINEAR, 128, offsets);
+	assert(chain[offsets[1]] == 128 && chain[offsets[6]] == 128);
+	FreeImage_Unload(checker);
+
+	// normals stay unit length
+	FIBITMAP *bumps = createPatternImage(64, 64, [](unsigned x, unsigned y, BYTE *bits) {
+		const double nx = sin(x * 0.7) * 0.6, ny = cos(y * 0.5) * 0.6, nz = sqrt(1 - nx * nx - ny * ny);
+		bits[FI_RGBA_RED] = (BYTE)((nx + 1) * 127.5 + 0.5);
+		bits[FI_RGBA_GREEN] = (BYTE)((ny + 1) * 127.5 + 0.5);
+		bits[FI_RGBA_BLUE] = (BYTE)((nz + 1) * 127.5 + 0.5);
+		bits[FI_RGBA_ALPHA] = 255;
+	});
+	chain.resize(FreeImage_GenerateMipmaps(bumps, NULL));
+	FreeImage_GenerateMipmaps(bumps, &chain[0], 0, FI_MIPMAP_NORMAL_MAP, 128, offsets);
+	for(DWORD i = offsets[1]; i < chain.size(); i += 4) {
+		const double nx = chain[i] / 127.5 - 1, ny = chain[i + 1] / 127.5 - 1, nz = chain[i + 2] / 127.5 - 1;
+		assert(fabs(sqrt(nx * nx + ny * ny + nz * nz) - 1) < 0.02);
+	}
+	FreeImage_Unload(bumps);
+
+	// thin foliage-like strands fade away in plain mipmaps, but keep their coverage with FI_MIPMAP_ALPHA_COVERAGE
+	FIBITMAP *leaves = createPatternImage(256, 256, [](unsigned x, unsigned y, BYTE *bits) {
+		bits[FI_RGBA_RED] = bits[FI_RGBA_GREEN] = bits[FI_RGBA_BLUE] = 100;
+		bits[FI_RGBA_ALPHA] = ((x % 8) < 2 || (y % 16) < 3) ? 255 : (BYTE)((x * 7 + y * 3) % 64);
+	});
+	const BYTE alpha_ref = 128;
+	chain.resize(FreeImage_GenerateMipmaps(leaves, NULL));
+	FreeImage_GenerateMipmaps(leaves, &chain[0], 0, FI_MIPMAP_ALPHA_COVERAGE, alpha_ref, offsets);
+	const double coverage = getCoverage(&chain[0], 256 * 256, alpha_ref);
+	// (past level 3, every pixel spans a whole period of the pattern in x, so only rows can differ)
+	for(unsigned level = 1; level < 4; level++) {
+		const unsigned count = (256 >> level) * (256 >> level);
+		assert(fabs(getCoverage(&chain[offsets[level]], count, alpha_ref) - coverage) < 0.05);
+	}
+	FreeImage_GenerateMipmaps(leaves, &chain[0], 0, FI_MIPMAP_DEFAULT, alpha_ref, offsets);
+	assert(getCoverage(&chain[offsets[4]], 16 * 16, alpha_ref) < coverage - 0.1);
+	FreeImage_Unload(leaves);
+}
+
+/**
+Prints how fast full mipmap chains are built
+*/
+static void benchmarkMipmaps(FIBITMAP *src) {
+	const double megapixels = FreeImage_GetWidth(src) * FreeImage_GetHeight(src) / 1e6;
+	const int runs = 4;
+	std::vector<BYTE> chain(FreeImage_GenerateMipmaps(src, NULL));
+
+	static const struct { unsigned flags; const char *name; } modes[] = {
+		{ FI_MIPMAP_DEFAULT, "sRGB" }, { FI_MIPMAP_LINEAR, "linear" }, { FI_MIPMAP_ALPHA_COVERAGE, "coverage" }, { FI_MIPMAP_NORMAL_MAP, "normal map" }
+	};
+	printf("  mipmaps:");
+	for(int m = 0; m < 4; m++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < runs; i++) {
+			FreeImage_GenerateMipmaps(src, &chain[0], 0, modes[m].flags, 128, NULL);
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("  %s %.1f MP/s", modes[m].name, runs * megapixels / seconds);
+	}
+	printf("\n");
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testRescale(unsigned width, unsigned height) {
+	printf("testRescale ...\n");
+
+	FIBITMAP *grey = createZonePlateImage(width, height, 64);
+	assert(grey != NULL);
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(grey);
+	assert(rgb != NULL);
+	FIBITMAP *rgba = FreeImage_ConvertTo32Bits(grey);
+	assert(rgba != NULL);
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(rgb);
+	assert(rgbf != NULL);
+	FIBITMAP *rgbaf = FreeImage_ConvertToRGBAF(rgba);
+	assert(rgbaf != NULL);
+	FIBITMAP *greyf = FreeImage_ConvertToFloat(grey);
+	assert(greyf != NULL);
+	FIBITMAP *rgb565 = FreeImage_ConvertTo16Bits565(rgb);
+	assert(rgb565 != NULL);
+	FIBITMAP *rgb16 = FreeImage_ConvertToRGB16(rgb);
+	assert(rgb16 != NULL);
+	FIBITMAP *rgba16 = FreeImage_ConvertToRGBA16(rgba);
+	assert(rgba16 != NULL);
+
+	// FI_RESCALE_NO_SIMD covers the scalar filters, which builds without SSE2 rely on
+	FIBITMAP *images[] = { grey, rgb, rgba, greyf, rgbf, rgbaf, rgb565, rgb16, rgba16 };
+	for(int i = 0; i < 9; i++) {
+		testRescaleRect(images[i], FILTER_CATMULLROM, FI_RESCALE_DEFAULT);
+		testRescaleRect(images[i], FILTER_BOX, FI_RESCALE_DEFAULT);
+		testRescaleRect(images[i], FILTER_CATMULLROM, FI_RESCALE_NO_SIMD);
+		testRescaleRect(images[i], FILTER_BOX, FI_RESCALE_NO_SIMD);
+		testRescaleSIMD(images[i], FILTER_CATMULLROM);
+	}
+
+	static const struct { FREE_IMAGE_TYPE type; unsigned bpp; } types[] = {
+		{ FIT_BITMAP, 8 }, { FIT_BITMAP, 24 }, { FIT_BITMAP, 32 }, { FIT_FLOAT, 32 }, { FIT_RGBF, 96 }, { FIT_RGBAF, 128 }
+	};
+	for(int t = 0; t < 6; t++) {
+		testRescaleFlat(types[t].type, types[t].bpp, FILTER_BILINEAR);
+		testRescaleFlat(types[t].type, types[t].bpp, FILTER_LANCZOS3);
+	}
+
+	testMipmaps();
+
+	benchmarkRescale(grey, "8-bit");
+	benchmarkRescale(rgb, "24-bit");
+	benchmarkRescale(rgba, "32-bit");
+	benchmarkRescale(rgbf, "RGBF");
+	benchmarkRescale(rgbaf, "RGBAF");
+	benchmarkMipmaps(rgba);
+
+	FreeImage_Unload(rgba16);
+	FreeImage_Unload(rgb16);
+	FreeImage_Unload(rgb565);
+	FreeImage_Unload(greyf);
+	FreeImage_Unload(rgbaf);
+	FreeImage_Unload(rgbf);
+	FreeImage_Unload(rgba);
+	FreeImage_Unload(rgb);
+	FreeImage_Unload(grey);
+}
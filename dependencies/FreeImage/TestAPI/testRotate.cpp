@@ -0,0 +1,134 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Checks that dst(x, y) = src(map(x, y)) for every pixel of dst. 
+Coordinates are those of the scanlines, i.e. from the bottom up.
+*/
+template <class MAP> static void checkMapping(FIBITMAP *src, FIBITMAP *dst, MAP map) {
+	assert(dst != NULL);
+	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+	for(unsigned y = 0; y < FreeImage_GetHeight(dst); y++) {
+		const BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(dst); x++) {
+			unsigned src_x, src_y;
+			map(x, y, src_x, src_y);
+			const BYTE *src_bits = FreeImage_GetScanLine(src, src_y) + src_x * bytespp;
+			assert(memcmp(dst_bits + x * bytespp, src_bits, bytespp) == 0);
+		}
+	}
+}
+
+/**
+Checks the exact rotations and the flips of one image against a pixel by pixel reference
+*/
+static void testExactTransforms(FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = createNoiseImage(type, bpp, width, height, width * 31 + height);
+	assert(src != NULL);
+
+	// counter clockwise, as seen on screen
+	FIBITMAP *dst = FreeImage_Rotate(src, 90, NULL);
+	assert((FreeImage_GetWidth(dst) == height) && (FreeImage_GetHeight(dst) == width));
+	checkMapping(src, dst, [=](unsigned x, unsigned y, unsigned &src_x, unsigned &src_y) { src_x = y; src_y = height - 1 - x; });
+	FreeImage_Unload(dst);
+
+	dst = FreeImage_Rotate(src, 180, NULL);
+	checkMapping(src, dst, [=](unsigned x, unsigned y, unsigned &src_x, unsigned &src_y) { src_x = width - 1 - x; src_y = height - 1 - y; });
+	FreeImage_Unload(dst);
+
+	dst = FreeImage_Rotate(src, 270, NULL);
+	assert((FreeImage_GetWidth(dst) == height) && (FreeImage_GetHeight(dst) == width));
+	checkMapping(src, dst, [=](unsigned x, unsigned y, unsigned &src_x, unsigned &src_y) { src_x = width - 1 - y; src_y = x; });
+	FreeImage_Unload(dst);
+
+	// in place
+	dst = FreeImage_Clone(src);
+	assert(FreeImage_FlipHorizontal(dst));
+	checkMapping(src, dst, [=](unsigned x, unsigned y, unsigned &src_x, unsigned &src_y) { src_x = width - 1 - x; src_y = y; });
+	assert(FreeImage_FlipVertical(dst));
+	checkMapping(src, dst, [=](unsigned x, unsigned y, unsigned &src_x, unsigned &src_y) { src_x = width - 1 - x; src_y = height - 1 - y; });
+	FreeImage_Unload(dst);
+
+	FreeImage_Unload(src);
+}
+
+/**
+Prints how fast exact rotations and flips go through an image
+*/
+static void benchmarkTransforms(unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = createNoiseImage(FIT_BITMAP, bpp, width, height, width * 31 + height);
+	assert(src != NULL);
+	const double megapixels = width * height / 1e6;
+
+	printf("  %2d-bit:", bpp);
+	const int angles[3] = { 90, 180, 270 };
+	for(int k = 0; k < 3; k++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FIBITMAP *dst = FreeImage_Rotate(src, angles[k], NULL);
+		assert(dst != NULL);
+		FreeImage_Unload(dst);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("  rotate %d %.1f MP/s", angles[k], megapixels / seconds);
+	}
+	for(int k = 0; k < 2; k++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		k ? FreeImage_FlipVertical(src) : FreeImage_FlipHorizontal(src);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("  flip %s %.1f MP/s", k ? "v" : "h", megapixels / seconds);
+	}
+	printf("\n");
+
+	FreeImage_Unload(src);
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testRotate(unsigned width, unsigned height) {
+	printf("testRotate ...\n");
+
+	const struct { FREE_IMAGE_TYPE type; unsigned bpp; } formats[] = {
+		{ FIT_BITMAP, 8 }, { FIT_BITMAP, 24 }, { FIT_BITMAP, 32 },
+		{ FIT_UINT16, 16 }, { FIT_RGB16, 48 }, { FIT_RGBA16, 64 },
+		{ FIT_FLOAT, 32 }, { FIT_RGBF, 96 }, { FIT_RGBAF, 128 }
+	};
+	for(unsigned i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		// whole SIMD blocks and tiles, then ragged edges on both sides
+		testExactTransforms(formats[i].type, formats[i].bpp, width, height);
+		testExactTransforms(formats[i].type, formats[i].bpp, width / 4 + 7, height / 8 + 3);
+		testExactTransforms(formats[i].type, formats[i].bpp, 1, 5);
+	}
+
+	const unsigned bpps[3] = { 8, 24, 32 };
+	for(int k = 0; k < 3; k++) {
+		benchmarkTransforms(bpps[k], width * 4, height * 4);
+	}
+}
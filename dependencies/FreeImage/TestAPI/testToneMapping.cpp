@@ -0,0 +1,209 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Builds a RGBF image whose rows are flat but which spans a wide dynamic range from the bottom row to the top one
+*/
+static FIBITMAP* createFlatRowsImage(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		const float base = (float)exp(12.0 * y / height - 6);
+		for(unsigned x = 0; x < width; x++) {
+			pixel[x].red = base;
+			pixel[x].green = base * 0.6F;
+			pixel[x].blue = base * 0.3F * (y % 3);
+		}
+	}
+	return dib;
+}
+
+/**
+Builds a RGBF image of exponential gradients with some noise
+*/
+static FIBITMAP* createHDRImage(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(dib != NULL);
+	FIBITMAP *noise = createNoiseImage(FIT_BITMAP, 24, width, height, 1);
+	assert(noise != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		const BYTE *bits = FreeImage_GetScanLine(noise, y);
+		for(unsigned x = 0; x < width; x++, bits += 3) {
+			const float base = (float)exp(10.0 * x / width - 4) * (1 + 0.5F * (float)sin(y * 0.05));
+			pixel[x].red = base * (0.5F + bits[FI_RGBA_RED] / 256.0F);
+			pixel[x].green = base * (0.3F + 0.4F * (y & 7) / 7);
+			pixel[x].blue = base * (0.2F + bits[FI_RGBA_BLUE] / 256.0F);
+		}
+	}
+	FreeImage_Unload(noise);
+	return dib;
+}
+
+/**
+Runs one of the operators: Reinhard05 with its default and with its complete algorithm, Drago03 or Fattal02
+*/
+static FIBITMAP* toneMap(FIBITMAP *src, int tmo) {
+	switch(tmo) {
+		case 0:
+			return FreeImage_TmoReinhard05Ex(src, 0, 0, 1, 0);
+		case 1:
+			return FreeImage_TmoReinhard05Ex(src, 0.5, 0, 0.4, 0.6);
+		case 2:
+			return FreeImage_TmoDrago03(src, 2.2, 0);
+		default:
+			return FreeImage_TmoFattal02(src, 0.5, 0.85);
+	}
+}
+
+/**
+Checks that every pixel of a flat row maps to the same colour, wherever it falls in a SIMD block or in the remainder
+*/
+static void testFlatRows(FIBITMAP *src, int tmo) {
+	FIBITMAP *dst = toneMap(src, tmo);
+	assert(dst != NULL);
+	assert(FreeImage_GetBPP(dst) == 24);
+
+	for(unsigned y = 0; y < FreeImage_GetHeight(dst); y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 1; x < FreeImage_GetWidth(dst); x++) {
+			for(int c = 0; c < 3; c++) {
+				assert(abs(bits[3 * x + c] - bits[c]) <= 1);
+			}
+		}
+	}
+
+	FreeImage_Unload(dst);
+}
+
+/**
+Checks that tone mapping twice gives the same image
+*/
+static void testToneMappingStable(FIBITMAP *src, int tmo) {
+	FIBITMAP *first = toneMap(src, tmo);
+	assert(first != NULL);
+	FIBITMAP *second = toneMap(src, tmo);
+	assert(second != NULL);
+
+	for(unsigned y = 0; y < FreeImage_GetHeight(src); y++) {
+		assert(memcmp(FreeImage_GetScanLine(first, y), FreeImage_GetScanLine(second, y), 3 * FreeImage_GetWidth(src)) == 0);
+	}
+
+	FreeImage_Unload(second);
+	FreeImage_Unload(first);
+}
+
+/**
+Checks that the Poisson solver integrates the Laplacian of a known function on a rectangular image. 
+width + 1 and height + 1 should be multiples of a power of 2, so that the solver's boundary lies just outside the image.
+*/
+static void testPoissonSolver(unsigned width, unsigned height) {
+	const double PI = 3.14159265358979323846;
+
+	FIBITMAP *laplacian = FreeImage_AllocateT(FIT_FLOAT, width, height);
+	assert(laplacian != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		float *pixel = (float*)FreeImage_GetScanLine(laplacian, y);
+		for(unsigned x = 0; x < width; x++) {
+			// discrete Laplacian of sin(pi x / (width + 1)) * sin(pi y / (height + 1)), which is zero on the boundary
+			const double u = sin(PI * (x + 1) / (width + 1)) * sin(PI * (y + 1) / (height + 1));
+			pixel[x] = (float)(u * (2 * cos(PI / (width + 1)) + 2 * cos(PI / (height + 1)) - 4));
+		}
+	}
+
+	FIBITMAP *solution = FreeImage_MultigridPoissonSolver(laplacian, 3);
+	assert(solution != NULL);
+	assert(FreeImage_GetWidth(solution) == width && FreeImage_GetHeight(solution) == height);
+
+	double error = 0;
+	for(unsigned y = 0; y < height; y++) {
+		const float *pixel = (float*)FreeImage_GetScanLine(solution, y);
+		for(unsigned x = 0; x < width; x++) {
+			const double u = sin(PI * (x + 1) / (width + 1)) * sin(PI * (y + 1) / (height + 1));
+			// the solution is normalized to [0..1], as is u but for the tiny values next to the boundary
+			const double difference = fabs(pixel[x] - u);
+			error = (difference > error) ? difference : error;
+		}
+	}
+	assert(error < 0.01);
+
+	FreeImage_Unload(solution);
+	FreeImage_Unload(laplacian);
+}
+
+/**
+Prints how fast each operator goes through an image
+*/
+static void benchmarkToneMapping(FIBITMAP *src) {
+	const int operators[] = { 0, 2, 3 };
+	const char *names[] = { "Reinhard05", "Drago03", "Fattal02" };
+	const double megapixels = FreeImage_GetWidth(src) * FreeImage_GetHeight(src) / 1e6;
+
+	printf(" ");
+	for(int i = 0; i < 3; i++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FIBITMAP *dst = toneMap(src, operators[i]);
+		assert(dst != NULL);
+		FreeImage_Unload(dst);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf(" %s %.1f MP/s", names[i], megapixels / seconds);
+	}
+	printf("\n");
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testToneMapping(unsigned width, unsigned height) {
+	printf("testToneMapping ...\n");
+
+	// an odd width leaves a remainder after each block of four pixels
+	FIBITMAP *src = createFlatRowsImage(width + 3, height / 4);
+	for(int tmo = 0; tmo < 3; tmo++) {
+		testFlatRows(src, tmo);
+	}
+	FreeImage_Unload(src);
+
+	src = createHDRImage(width + 1, height);
+	for(int tmo = 0; tmo < 4; tmo++) {
+		testToneMappingStable(src, tmo);
+	}
+	FreeImage_Unload(src);
+
+	testPoissonSolver(width - 1, height / 4 - 1);
+
+	src = createHDRImage(width * 2, height * 2);
+	benchmarkToneMapping(src);
+	FreeImage_Unload(src);
+}
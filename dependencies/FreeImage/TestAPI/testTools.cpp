@@ -80,3 +80,31 @@ FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale) {
 	return dst;
 }
 
+/** Create an image of pseudo-random bytes.
+
+  Every byte of every line, padding excluded, is the high byte of a linear congruential generator started at 'seed', 
+  so the same arguments always give the same image. Palettized images get a greyscale palette.
+*/
+FIBITMAP* createNoiseImage(FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height, unsigned seed) {
+	FIBITMAP *dst = FreeImage_AllocateT(type, width, height, bpp);
+	if(!dst)
+		return NULL;
+
+	const unsigned colors = FreeImage_GetColorsUsed(dst);
+	RGBQUAD *pal = FreeImage_GetPalette(dst);
+	for(unsigned i = 0; i < colors; i++) {
+		pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)(i * 255 / (colors - 1));
+	}
+
+	const unsigned line = FreeImage_GetLine(dst);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < line; x++) {
+			seed = seed * 1664525 + 1013904223;
+			bits[x] = (BYTE)(seed >> 24);
+		}
+	}
+
+	return dst;
+}
+
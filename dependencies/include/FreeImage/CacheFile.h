@@ -29,39 +29,36 @@
 
 // ----------------------------------------------------------
 
-static const int CACHE_SIZE = 32;
-static const int BLOCK_SIZE = (64 * 1024) - 8;
+static const int BLOCK_SIZE = 64 * 1024;
 
-// ----------------------------------------------------------
+// memory a cache may use before it spills blocks to its file, unless told otherwise
+static const size_t CACHE_MEMORY_SIZE = 32 * 1024 * 1024;
 
-#ifdef _WIN32
-#pragma pack(push, 1)
-#else
-#pragma pack(1)
-#endif // _WIN32
+// blocks in each mapped view of the cache file (4 MB)
+static const int SEGMENT_BLOCKS = 64;
 
+// ----------------------------------------------------------
+
+/**
+A block of a cached file. Block numbers index CacheFile::m_blocks directly.
+*/
 struct Block {
-     unsigned nr;
-     unsigned next;
-     BYTE *data;
+	int next;			//! next block of the same file, 0 at the end (block 0 is never used)
+	int lru_prev;		//! more recently used block in memory, -1 at the front
+	int lru_next;		//! less recently used block in memory, -1 at the back
+	BYTE *data;			//! block contents while in memory, NULL once spilled to the file
 };
 
-#ifdef _WIN32
-#pragma pack(pop)
-#else
-#pragma pack()
-#endif // _WIN32
-
 // ----------------------------------------------------------
 
+/**
+Stores compressed pages for the multi-page functions. 
+The most recently used blocks stay in memory, in an LRU list threaded through the block table, 
+and the least recently used ones are spilled to a memory-mapped file when the cache goes over its memory budget.
+*/
 class CacheFile {
-	typedef std::list<Block *> PageCache;
-	typedef std::list<Block *>::iterator PageCacheIt;
-	typedef std::map<int, PageCacheIt> PageMap;
-	typedef std::map<int, PageCacheIt>::iterator PageMapIt;
-
 public :
-	CacheFile(const std::string filename, BOOL keep_in_memory);
+	CacheFile(const std::string filename, BOOL keep_in_memory, size_t memory_size = CACHE_MEMORY_SIZE);
 	~CacheFile();
 
 	BOOL open();
@@ -69,23 +66,30 @@ public :
 	BOOL readFile(BYTE *data, int nr, int size);
 	int writeFile(BYTE *data, int size);
 	void deleteFile(int nr);
+	void prefetchFile(int nr);
 
 private :
 	void cleanupMemCache();
 	int allocateBlock();
-	Block *lockBlock(int nr);
-	BOOL unlockBlock(int nr);
+	void touchBlock(int nr);
+	void unlinkBlock(int nr);
+	BYTE *getSpilledBlock(int nr);
 	BOOL deleteBlock(int nr);
 
 private :
-	FILE *m_file;
+#ifdef _WIN32
+	void *m_file;
+#else
+	int m_file;
+#endif
 	std::string m_filename;
-	std::list<int> m_free_pages;
-	PageCache m_page_cache_mem;
-	PageCache m_page_cache_disk;
-	PageMap m_page_map;
-	int m_page_count;
-	Block *m_current_block;
+	std::vector<Block> m_blocks;
+	std::vector<int> m_free_blocks;
+	std::vector<BYTE *> m_segments;
+	int m_lru_front;
+	int m_lru_back;
+	int m_memory_blocks;
+	int m_max_memory_blocks;
 	BOOL m_keep_in_memory;
 };
 
@@ -387,7 +387,7 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 			return NULL;
 		}
 
-		bitmap->data = (BYTE *)FreeImage_Aligned_Malloc(dib_size * sizeof(BYTE), FIBITMAP_ALIGNMENT);
+		bitmap->data = (BYTE *)FreeImage_AllocateBitmapData(dib_size * sizeof(BYTE));
 
 		if (bitmap->data != NULL) {
 			memset(bitmap->data, 0, dib_size);
@@ -523,7 +523,7 @@ FreeImage_Unload(FIBITMAP *dib) {
 			FreeImage_Unload(FreeImage_GetThumbnail(dib));
 
 			// delete bitmap ...
-			FreeImage_Aligned_Free(dib->data);
+			FreeImage_FreeBitmapData(dib->data);
 		}
 
 		free(dib);		// ... and the wrapper
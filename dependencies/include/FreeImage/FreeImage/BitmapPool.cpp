@@ -0,0 +1,368 @@
+// ==========================================================
+// Bitmap memory pool
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include <atomic>
+#include <mutex>
+
+// ----------------------------------------------------------
+//   Blocks and size classes
+// ----------------------------------------------------------
+
+/**
+Every block starts with this header, so that FreeImage_FreeBitmapData can pool or release it 
+from nothing more than the address FreeImage_AllocateBitmapData returned
+*/
+struct PoolBlock {
+	size_t size;						//! size of the block's class, without the header
+	unsigned generation;				//! allocator the block came from, see FreeImage_SetBitmapAllocator
+	FI_DeallocateProc deallocate_proc;	//! how to give the block back to that allocator
+	void *user;
+};
+
+// header size, keeping the pixels on a FIBITMAP_ALIGNMENT boundary
+static const size_t POOL_HEADER_SIZE = (sizeof(PoolBlock) + FIBITMAP_ALIGNMENT - 1) & ~(size_t)(FIBITMAP_ALIGNMENT - 1);
+
+// blocks each thread keeps for itself before handing them to the shared pool
+static const unsigned THREAD_CACHE_BLOCKS = 8;
+
+// pooling limit until FreeImage_SetBitmapPoolSize says otherwise
+static const size_t DEFAULT_POOL_SIZE = (size_t)128 << 20;
+
+/**
+Rounds a size up to its class. Classes are a quarter of a power of two apart, 
+so a block is at most 25% bigger than the bitmap needs, and a few classes cover a whole batch of similar images.
+@return Returns the class size, or 0 if it doesn't fit in a size_t
+*/
+static size_t
+GetClassSize(size_t size) {
+	size_t step = 256;
+	while((step * 8 <= size) && (step < ((size_t)-1) / 16)) {
+		step <<= 1;
+	}
+	const size_t class_size = (size + step - 1) & ~(step - 1);
+	return ((class_size < size) || (class_size > ((size_t)-1) - POOL_HEADER_SIZE)) ? 0 : class_size;
+}
+
+// ----------------------------------------------------------
+//   Allocator and pool state
+// ----------------------------------------------------------
+
+static void * DLL_CALLCONV
+DefaultAllocateProc(size_t size, void *) {
+	return FreeImage_Aligned_Malloc(size, FIBITMAP_ALIGNMENT);
+}
+
+static void DLL_CALLCONV
+DefaultDeallocateProc(void *data, size_t, void *) {
+	FreeImage_Aligned_Free(data);
+}
+
+static FI_AllocateProc s_allocate_proc = DefaultAllocateProc;
+static FI_DeallocateProc s_deallocate_proc = DefaultDeallocateProc;
+static void *s_user = NULL;
+static std::atomic<unsigned> s_generation(0);
+
+static std::atomic<size_t> s_max_pooled_bytes(DEFAULT_POOL_SIZE);
+static std::atomic<size_t> s_pooled_bytes(0);
+static std::atomic<size_t> s_live_bytes(0);
+static std::atomic<size_t> s_peak_bytes(0);
+static std::atomic<size_t> s_allocations(0);
+static std::atomic<size_t> s_pool_hits(0);
+
+/**
+Blocks released by threads whose own caches are full, by size class
+*/
+struct SharedPool {
+	std::mutex mutex;
+	std::map<size_t, std::vector<PoolBlock*> > blocks;
+};
+
+static SharedPool& 
+GetSharedPool() {
+	// never destroyed, since threads and FreeImage_DeInitialise may still need it during static destruction
+	static SharedPool *s_pool = new SharedPool;
+	return *s_pool;
+}
+
+static void
+ReleaseBlock(PoolBlock *block) {
+	block->deallocate_proc(block, POOL_HEADER_SIZE + block->size, block->user);
+}
+
+static void
+ReleasePooledBlock(PoolBlock *block) {
+	s_pooled_bytes -= block->size;
+	ReleaseBlock(block);
+}
+
+/**
+Leaves a block in the shared pool, or releases it if it came from a previous allocator
+*/
+static void
+PutInSharedPool(PoolBlock *block) {
+	if(block->generation != s_generation) {
+		ReleasePooledBlock(block);
+		return;
+	}
+	SharedPool &pool = GetSharedPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	pool.blocks[block->size].push_back(block);
+}
+
+/**
+Takes a block of the given class from the shared pool, releasing any left over from a previous allocator on the way
+*/
+static PoolBlock *
+TakeFromSharedPool(size_t class_size) {
+	SharedPool &pool = GetSharedPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	std::map<size_t, std::vector<PoolBlock*> >::iterator i = pool.blocks.find(class_size);
+	while((i != pool.blocks.end()) && !i->second.empty()) {
+		PoolBlock *block = i->second.back();
+		i->second.pop_back();
+		if(block->generation == s_generation) {
+			return block;
+		}
+		ReleasePooledBlock(block);
+	}
+	return NULL;
+}
+
+/**
+The last few blocks a thread released, so that a thread churning through same-sized temporaries 
+recycles them without touching the shared pool's lock. 
+It has no constructor or destructor, so it stays usable for as long as its thread runs, static destructors included.
+*/
+struct ThreadCache {
+	PoolBlock *blocks[THREAD_CACHE_BLOCKS];
+	unsigned count;
+
+	PoolBlock *take(size_t class_size) {
+		for(unsigned i = count; i-- > 0; ) {
+			if(blocks[i]->size == class_size) {
+				PoolBlock *block = blocks[i];
+				blocks[i] = blocks[--count];
+				if(block->generation == s_generation) {
+					return block;
+				}
+				ReleasePooledBlock(block);
+			}
+		}
+		return NULL;
+	}
+
+	void put(PoolBlock *block) {
+		if(count == THREAD_CACHE_BLOCKS) {
+			// the oldest block goes to the shared pool
+			PutInSharedPool(blocks[0]);
+			memmove(&blocks[0], &blocks[1], (THREAD_CACHE_BLOCKS - 1) * sizeof(PoolBlock*));
+			count--;
+		}
+		blocks[count++] = block;
+	}
+
+	void release() {
+		for(unsigned i = 0; i < count; i++) {
+			ReleasePooledBlock(blocks[i]);
+		}
+		count = 0;
+	}
+
+	void flush() {
+		for(unsigned i = 0; i < count; i++) {
+			PutInSharedPool(blocks[i]);
+		}
+		count = 0;
+	}
+};
+
+static thread_local ThreadCache t_cache;
+
+/**
+Leaves a thread's cached blocks to the other threads when it exits
+*/
+struct ThreadCacheFlush {
+	~ThreadCacheFlush() {
+		t_cache.flush();
+	}
+};
+
+static ThreadCache& 
+GetThreadCache() {
+	static thread_local ThreadCacheFlush t_flush;
+	(void)t_flush;
+	return t_cache;
+}
+
+// ----------------------------------------------------------
+//   Internal allocation routines
+// ----------------------------------------------------------
+
+/**
+Allocates memory for a bitmap, aligned on FIBITMAP_ALIGNMENT. 
+Memory from a bitmap unloaded earlier is reused when one of the same size class is pooled.
+@param size Bytes needed
+@return Returns the memory, or NULL if the allocator ran out
+*/
+void* 
+FreeImage_AllocateBitmapData(size_t size) {
+	const size_t class_size = GetClassSize(size);
+	if(class_size == 0) {
+		return NULL;
+	}
+
+	PoolBlock *block = GetThreadCache().take(class_size);
+	if(!block) {
+		block = TakeFromSharedPool(class_size);
+	}
+
+	if(block) {
+		s_pooled_bytes -= class_size;
+		s_pool_hits++;
+	} else {
+		block = (PoolBlock*)s_allocate_proc(POOL_HEADER_SIZE + class_size, s_user);
+		if(!block) {
+			// memory held by the pool may be all that's missing
+			FreeImage_ReleaseBitmapPool();
+			block = (PoolBlock*)s_allocate_proc(POOL_HEADER_SIZE + class_size, s_user);
+			if(!block) {
+				return NULL;
+			}
+		}
+		block->size = class_size;
+		block->generation = s_generation;
+		block->deallocate_proc = s_deallocate_proc;
+		block->user = s_user;
+	}
+
+	s_allocations++;
+	const size_t live_bytes = (s_live_bytes += class_size);
+	size_t peak_bytes = s_peak_bytes;
+	while((live_bytes > peak_bytes) && !s_peak_bytes.compare_exchange_weak(peak_bytes, live_bytes)) {
+	}
+
+	return (BYTE*)block + POOL_HEADER_SIZE;
+}
+
+/**
+Releases memory from FreeImage_AllocateBitmapData, 
+keeping it in the pool for the next bitmap unless that would take the pool over its size
+*/
+void 
+FreeImage_FreeBitmapData(void *data) {
+	if(!data) {
+		return;
+	}
+	PoolBlock *block = (PoolBlock*)((BYTE*)data - POOL_HEADER_SIZE);
+	s_live_bytes -= block->size;
+
+	if((block->generation == s_generation) && ((s_pooled_bytes += block->size) <= s_max_pooled_bytes)) {
+		GetThreadCache().put(block);
+	} else {
+		if(block->generation == s_generation) {
+			s_pooled_bytes -= block->size;
+		}
+		ReleaseBlock(block);
+	}
+}
+
+// ----------------------------------------------------------
+//   Public routines
+// ----------------------------------------------------------
+
+/**
+Sets the functions bitmap memory comes from, e.g. to take it from an engine's own heap. 
+Memory given out by allocate_proc must be aligned on 16 bytes.
+Bitmaps allocated earlier are still released through the functions they came from.
+This should be called before other threads start using FreeImage.
+@param allocate_proc Allocates memory for a bitmap; NULL restores the default allocator
+@param deallocate_proc Releases memory from allocate_proc, given its address and the size that was asked for
+@param user Passed on to both functions
+*/
+void DLL_CALLCONV 
+FreeImage_SetBitmapAllocator(FI_AllocateProc allocate_proc, FI_DeallocateProc deallocate_proc, void *user) {
+	FreeImage_ReleaseBitmapPool();
+
+	if(allocate_proc && deallocate_proc) {
+		s_allocate_proc = allocate_proc;
+		s_deallocate_proc = deallocate_proc;
+		s_user = user;
+	} else {
+		s_allocate_proc = DefaultAllocateProc;
+		s_deallocate_proc = DefaultDeallocateProc;
+		s_user = NULL;
+	}
+	// blocks still cached by other threads belong to the old allocator: they won't be reused
+	s_generation++;
+}
+
+/**
+Sets how much memory unloaded bitmaps may keep for reuse (128 MB by default). 
+0 turns pooling off, so that every bitmap goes straight back to the allocator.
+*/
+void DLL_CALLCONV 
+FreeImage_SetBitmapPoolSize(size_t max_bytes) {
+	s_max_pooled_bytes = max_bytes;
+	if(s_pooled_bytes > max_bytes) {
+		FreeImage_ReleaseBitmapPool();
+	}
+}
+
+/**
+Gives the memory pooled from unloaded bitmaps back to the allocator. 
+Blocks cached by threads other than the calling one are not released: they move to the shared pool 
+when their thread's cache overflows or the thread exits, and stay there until the next call.
+*/
+void DLL_CALLCONV 
+FreeImage_ReleaseBitmapPool() {
+	t_cache.release();
+
+	SharedPool &pool = GetSharedPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	for(std::map<size_t, std::vector<PoolBlock*> >::iterator i = pool.blocks.begin(); i != pool.blocks.end(); ++i) {
+		for(size_t j = 0; j < i->second.size(); j++) {
+			ReleasePooledBlock(i->second[j]);
+		}
+	}
+	pool.blocks.clear();
+}
+
+/**
+Reports the memory held by bitmaps and by the pool
+@param stats Receives the figures
+@param reset_peak If TRUE, the peak starts over from the bytes live now, e.g. to measure each batch of a pipeline
+*/
+void DLL_CALLCONV 
+FreeImage_GetBitmapMemoryStats(FIPOOLSTATS *stats, BOOL reset_peak) {
+	if(stats) {
+		stats->live_bytes = s_live_bytes;
+		stats->peak_bytes = s_peak_bytes;
+		stats->pooled_bytes = s_pooled_bytes;
+		stats->allocations = s_allocations;
+		stats->pool_hits = s_pool_hits;
+	}
+	if(reset_peak) {
+		s_peak_bytes = (size_t)s_live_bytes;
+	}
+}
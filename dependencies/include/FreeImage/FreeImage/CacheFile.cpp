@@ -24,19 +24,58 @@
 #pragma warning (disable : 4786) // identifier was truncated to 'number' characters
 #endif 
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "CacheFile.h"
 
 // ----------------------------------------------------------
 
-CacheFile::CacheFile(const std::string filename, BOOL keep_in_memory) :
-m_file(NULL),
+static const size_t SEGMENT_SIZE = (size_t)SEGMENT_BLOCKS * BLOCK_SIZE;
+
+static const Block EMPTY_BLOCK = { 0, -1, -1, NULL };
+
+#ifdef _WIN32
+
+// PrefetchVirtualMemory only exists from Windows 8 on, so it's looked up rather than linked to
+
+struct PrefetchRange {
+	void *address;
+	size_t size;
+};
+
+typedef BOOL (WINAPI *PrefetchVirtualMemoryProc)(HANDLE process, ULONG_PTR count, PrefetchRange *ranges, ULONG flags);
+
+static PrefetchVirtualMemoryProc
+GetPrefetchVirtualMemory() {
+	static const PrefetchVirtualMemoryProc s_proc = (PrefetchVirtualMemoryProc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	return s_proc;
+}
+
+#endif // _WIN32
+
+// ----------------------------------------------------------
+
+CacheFile::CacheFile(const std::string filename, BOOL keep_in_memory, size_t memory_size) :
+#ifdef _WIN32
+m_file(INVALID_HANDLE_VALUE),
+#else
+m_file(-1),
+#endif
 m_filename(filename),
-m_free_pages(),
-m_page_cache_mem(),
-m_page_cache_disk(),
-m_page_map(),
-m_page_count(0),
-m_current_block(NULL),
+m_blocks(1, EMPTY_BLOCK),
+m_free_blocks(),
+m_segments(),
+m_lru_front(-1),
+m_lru_back(-1),
+m_memory_blocks(0),
+m_max_memory_blocks((int)MAX(MIN(memory_size / BLOCK_SIZE, (size_t)INT_MAX), (size_t)1)),
 m_keep_in_memory(keep_in_memory) {
 }
 
@@ -46,8 +85,18 @@ CacheFile::~CacheFile() {
 BOOL
 CacheFile::open() {
 	if ((!m_filename.empty()) && (!m_keep_in_memory)) {
-		m_file = fopen(m_filename.c_str(), "w+b");
-		return (m_file != NULL);
+#ifdef _WIN32
+		// the file goes away when it's closed, and the system keeps as much of it as it can in memory
+		m_file = CreateFileA(m_filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+		return (m_file != INVALID_HANDLE_VALUE);
+#else
+		m_file = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (m_file != -1) {
+			// the open descriptor keeps the file alive, and nothing is left behind if the process dies
+			unlink(m_filename.c_str());
+		}
+		return (m_file != -1);
+#endif
 	}
 
 	return (m_keep_in_memory == TRUE);
@@ -57,138 +106,190 @@ void
 CacheFile::close() {
 	// dispose the cache entries
 
-	while (!m_page_cache_disk.empty()) {
-		Block *block = *m_page_cache_disk.begin();
-		m_page_cache_disk.pop_front();
-		delete [] block->data;
-		delete block;
+	for (size_t i = 0; i < m_blocks.size(); ++i) {
+		delete [] m_blocks[i].data;
 	}
-	while (!m_page_cache_mem.empty()) { 
-		Block *block = *m_page_cache_mem.begin(); 
-		m_page_cache_mem.pop_front(); 
-		delete [] block->data; 
-		delete block; 
-	} 
-
-	if (m_file) {
-		// close the file
-
-		fclose(m_file);
-
-		// delete the file
+	m_blocks.assign(1, EMPTY_BLOCK);
+	m_free_blocks.clear();
+	m_lru_front = m_lru_back = -1;
+	m_memory_blocks = 0;
+
+	// unmap and close the file
+
+	for (size_t i = 0; i < m_segments.size(); ++i) {
+		if (m_segments[i]) {
+#ifdef _WIN32
+			UnmapViewOfFile(m_segments[i]);
+#else
+			munmap(m_segments[i], SEGMENT_SIZE);
+#endif
+		}
+	}
+	m_segments.clear();
 
-		remove(m_filename.c_str());
+#ifdef _WIN32
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
 	}
+#else
+	if (m_file != -1) {
+		::close(m_file);
+		m_file = -1;
+	}
+#endif
 }
 
-void
-CacheFile::cleanupMemCache() {
-	if (!m_keep_in_memory) {
-		if (m_page_cache_mem.size() > CACHE_SIZE) {
-			// flush the least used block to file
+/**
+Returns where a block lives in the file, mapping (and growing) the file as needed
+@return Returns NULL if the file can't be mapped
+*/
+BYTE *
+CacheFile::getSpilledBlock(int nr) {
+	const size_t segment = nr / SEGMENT_BLOCKS;
 
-			Block *old_block = m_page_cache_mem.back();
-			fseek(m_file, old_block->nr * BLOCK_SIZE, SEEK_SET);
-			fwrite(old_block->data, BLOCK_SIZE, 1, m_file);
-
-			// remove the data
-
-			delete [] old_block->data;
-			old_block->data = NULL;
-
-			// move the block to another list
+	if (segment >= m_segments.size()) {
+		m_segments.resize(segment + 1, NULL);
+	}
 
-			m_page_cache_disk.splice(m_page_cache_disk.begin(), m_page_cache_mem, --m_page_cache_mem.end());
-			m_page_map[old_block->nr] = m_page_cache_disk.begin();
+	if (!m_segments[segment]) {
+		const UINT64 file_size = (UINT64)(segment + 1) * SEGMENT_SIZE;
+		const UINT64 offset = (UINT64)segment * SEGMENT_SIZE;
+#ifdef _WIN32
+		if (m_file != INVALID_HANDLE_VALUE) {
+			// a mapping as large as the file needs to be grows it
+			HANDLE mapping = CreateFileMappingA(m_file, NULL, PAGE_READWRITE, (DWORD)(file_size >> 32), (DWORD)file_size, NULL);
+			if (mapping) {
+				m_segments[segment] = (BYTE *)MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, SEGMENT_SIZE);
+				CloseHandle(mapping);
+			}
 		}
+#else
+		struct stat file_info;
+		if ((m_file != -1) && (fstat(m_file, &file_info) == 0)) {
+			if (((UINT64)file_info.st_size >= file_size) || (ftruncate(m_file, (off_t)file_size) == 0)) {
+				void *view = mmap(NULL, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, (off_t)offset);
+				m_segments[segment] = (view != MAP_FAILED) ? (BYTE *)view : NULL;
+			}
+		}
+#endif
 	}
+
+	return m_segments[segment] ? m_segments[segment] + (size_t)(nr % SEGMENT_BLOCKS) * BLOCK_SIZE : NULL;
 }
 
-int
-CacheFile::allocateBlock() {
-	Block *block = new Block;
-	block->data = new BYTE[BLOCK_SIZE];
-	block->next = 0;
+void
+CacheFile::unlinkBlock(int nr) {
+	Block &block = m_blocks[nr];
 
-	if (!m_free_pages.empty()) {
-		block->nr = *m_free_pages.begin();
-		m_free_pages.pop_front();
+	if (block.lru_prev != -1) {
+		m_blocks[block.lru_prev].lru_next = block.lru_next;
 	} else {
-		block->nr = m_page_count++;
+		m_lru_front = block.lru_next;
+	}
+	if (block.lru_next != -1) {
+		m_blocks[block.lru_next].lru_prev = block.lru_prev;
+	} else {
+		m_lru_back = block.lru_prev;
 	}
 
-	m_page_cache_mem.push_front(block);
-	m_page_map[block->nr] = m_page_cache_mem.begin();
-
-	cleanupMemCache();
-
-	return block->nr;
+	block.lru_prev = block.lru_next = -1;
 }
 
-Block *
-CacheFile::lockBlock(int nr) {
-	if (m_current_block == NULL) {
-		PageMapIt it = m_page_map.find(nr);
-
-		if (it != m_page_map.end()) {
-			m_current_block = *(it->second);
+/**
+Moves a block in memory to the front of the LRU list, adding it if it's new
+*/
+void
+CacheFile::touchBlock(int nr) {
+	if (m_lru_front == nr) {
+		return;
+	}
+	if (m_blocks[nr].lru_prev != -1) {
+		unlinkBlock(nr);
+	}
 
-			// the block is swapped out to disc. load it back
-			// and remove the block from the cache. it might get cached
-			// again as soon as the memory buffer fills up
+	Block &block = m_blocks[nr];
+	block.lru_next = m_lru_front;
+	if (m_lru_front != -1) {
+		m_blocks[m_lru_front].lru_prev = nr;
+	} else {
+		m_lru_back = nr;
+	}
+	m_lru_front = nr;
+}
 
-			if (m_current_block->data == NULL) {
-				m_current_block->data = new BYTE[BLOCK_SIZE];
+void
+CacheFile::cleanupMemCache() {
+	if (!m_keep_in_memory) {
+		while (m_memory_blocks > m_max_memory_blocks) {
+			// flush the least used block to file
 
-				fseek(m_file, m_current_block->nr * BLOCK_SIZE, SEEK_SET);
-				fread(m_current_block->data, BLOCK_SIZE, 1, m_file);
+			const int nr = m_lru_back;
+			BYTE *spilled = getSpilledBlock(nr);
 
-				m_page_cache_mem.splice(m_page_cache_mem.begin(), m_page_cache_disk, it->second);
-				m_page_map[nr] = m_page_cache_mem.begin();
+			if (!spilled) {
+				// the file can't take it: keep the blocks in memory
+				break;
 			}
 
-			// if the memory cache size is too large, swap an item to disc
-
-			cleanupMemCache();
+			memcpy(spilled, m_blocks[nr].data, BLOCK_SIZE);
 
-			// return the current block
+			// remove the data
 
-			return m_current_block;
+			unlinkBlock(nr);
+			delete [] m_blocks[nr].data;
+			m_blocks[nr].data = NULL;
+			m_memory_blocks--;
 		}
 	}
-
-	return NULL;
 }
 
-BOOL
-CacheFile::unlockBlock(int nr) {
-	if (m_current_block) {
-		m_current_block = NULL;
+int
+CacheFile::allocateBlock() {
+	int nr;
 
-		return TRUE;
+	if (!m_free_blocks.empty()) {
+		nr = m_free_blocks.back();
+		m_free_blocks.pop_back();
+	} else {
+		nr = (int)m_blocks.size();
+		m_blocks.push_back(EMPTY_BLOCK);
 	}
 
-	return FALSE;
+	Block &block = m_blocks[nr];
+	block.data = new(std::nothrow) BYTE[BLOCK_SIZE];
+	block.next = 0;
+
+	if (!block.data) {
+		m_free_blocks.push_back(nr);
+		return 0;
+	}
+
+	touchBlock(nr);
+	m_memory_blocks++;
+
+	return nr;
 }
 
 BOOL
 CacheFile::deleteBlock(int nr) {
-	if (!m_current_block) {
-		PageMapIt it = m_page_map.find(nr);
+	Block &block = m_blocks[nr];
 
-		// remove block from cache
+	// remove block from cache
 
-		if (it != m_page_map.end())
-			m_page_map.erase(nr);
+	if (block.data) {
+		unlinkBlock(nr);
+		delete [] block.data;
+		block.data = NULL;
+		m_memory_blocks--;
+	}
+	block.next = 0;
 
-		// add block to free page list
+	// add block to free page list
 
-		m_free_pages.push_back(nr);
+	m_free_blocks.push_back(nr);
 
-		return TRUE;
-	}
-
-	return FALSE;
+	return TRUE;
 }
 
 BOOL
@@ -197,21 +298,26 @@ CacheFile::readFile(BYTE *data, int nr, int size) {
 		int s = 0;
 		int block_nr = nr;
 
-		do {
-			int copy_nr = block_nr;
-
-			Block *block = lockBlock(copy_nr);
-
-			block_nr = block->next;
-
-			memcpy(data + s, block->data, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
+		while ((s < size) && (block_nr > 0) && (block_nr < (int)m_blocks.size())) {
+			const BYTE *src = m_blocks[block_nr].data;
+
+			if (src) {
+				touchBlock(block_nr);
+			} else {
+				// spilled blocks are read straight from the mapping, leaving it to the system to cache them
+				src = getSpilledBlock(block_nr);
+				if (!src) {
+					return FALSE;
+				}
+			}
 
-			unlockBlock(copy_nr);
+			memcpy(data + s, src, MIN(size - s, BLOCK_SIZE));
 
 			s += BLOCK_SIZE;
-		} while (block_nr != 0);
+			block_nr = m_blocks[block_nr].next;
+		}
 
-		return TRUE;
+		return (s >= size);
 	}
 
 	return FALSE;
@@ -220,32 +326,33 @@ CacheFile::readFile(BYTE *data, int nr, int size) {
 int
 CacheFile::writeFile(BYTE *data, int size) {
 	if ((data) && (size > 0)) {
-		int nr_blocks_required = 1 + (size / BLOCK_SIZE);
-		int count = 0;
-		int s = 0;
-		int stored_alloc;
-		int alloc;
-		
-		stored_alloc = alloc = allocateBlock();
+		const int nr_blocks_required = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		int first = 0;
+		int last = 0;
 
-		do {
-			int copy_alloc = alloc;
+		for (int count = 0, s = 0; count < nr_blocks_required; ++count, s += BLOCK_SIZE) {
+			const int alloc = allocateBlock();
 
-			Block *block = lockBlock(copy_alloc);
-
-			block->next = 0;
+			if (alloc == 0) {
+				deleteFile(first);
+				return 0;
+			}
 
-			memcpy(block->data, data + s, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
+			memcpy(m_blocks[alloc].data, data + s, MIN(size - s, BLOCK_SIZE));
 
-			if (count + 1 < nr_blocks_required)
-				alloc = block->next = allocateBlock();
+			if (last) {
+				m_blocks[last].next = alloc;
+			} else {
+				first = alloc;
+			}
+			last = alloc;
 
-			unlockBlock(copy_alloc);
+			// if the memory cache size is too large, swap an item to disc
 
-			s += BLOCK_SIZE;			
-		} while (++count < nr_blocks_required);
+			cleanupMemCache();
+		}
 
-		return stored_alloc;
+		return first;
 	}
 
 	return 0;
@@ -253,19 +360,37 @@ CacheFile::writeFile(BYTE *data, int size) {
 
 void
 CacheFile::deleteFile(int nr) {
-	do {
-		Block *block = lockBlock(nr);
-
-		if (block == NULL)
-			break;
-
-		int next = block->next;
-
-		unlockBlock(nr);
+	while ((nr > 0) && (nr < (int)m_blocks.size())) {
+		const int next = m_blocks[nr].next;
 
 		deleteBlock(nr);
 
 		nr = next;
-	} while (nr != 0);
+	}
 }
 
+/**
+Asks the system to start reading a file's spilled blocks back in, so that a readFile soon after doesn't wait on the disk
+*/
+void
+CacheFile::prefetchFile(int nr) {
+	while ((nr > 0) && (nr < (int)m_blocks.size())) {
+		if (!m_blocks[nr].data) {
+			BYTE *spilled = getSpilledBlock(nr);
+
+			if (spilled) {
+#ifdef _WIN32
+				PrefetchVirtualMemoryProc prefetch_proc = GetPrefetchVirtualMemory();
+				if (prefetch_proc) {
+					PrefetchRange range = { spilled, BLOCK_SIZE };
+					prefetch_proc(GetCurrentProcess(), 1, &range, 0);
+				}
+#else
+				madvise(spilled, BLOCK_SIZE, MADV_WILLNEED);
+#endif
+			}
+		}
+
+		nr = m_blocks[nr].next;
+	}
+}
@@ -34,6 +34,9 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
 
 // Four primes near 500 - assume no image has a length so large
 // that it is divisible by all four primes
@@ -44,6 +47,9 @@
 #define prime3		487
 #define prime4		503
 
+// Entries in the colour -> palette index cache each thread keeps while writing the output image (a power of 2)
+#define MAP_CACHE_SIZE	4096
+
 // ----------------------------------------------------------------
 
 NNQuantizer::NNQuantizer(int PaletteSize)
@@ -245,8 +251,88 @@ int NNQuantizer::contest(int b, int g, int r) {
 	bestbiaspos = bestpos;
 	p = bias;
 	f = freq;
+	i = 0;
+
+#ifdef FREEIMAGE_SSE2
+	// four neurons at a time, each lane keeping the first best neuron it has seen
+	if (netsize >= 4) {
+		int target[4];
+		target[FI_RGBA_BLUE] = b;
+		target[FI_RGBA_GREEN] = g;
+		target[FI_RGBA_RED] = r;
+
+		const __m128i t0 = _mm_set1_epi32(target[0]);
+		const __m128i t1 = _mm_set1_epi32(target[1]);
+		const __m128i t2 = _mm_set1_epi32(target[2]);
+		const __m128i four = _mm_set1_epi32(4);
+		__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+		__m128i best_d = _mm_set1_epi32(bestd);
+		__m128i best_i = _mm_set1_epi32(-1);
+		__m128i bestbias_d = best_d;
+		__m128i bestbias_i = best_i;
+
+		for (; i + 4 <= netsize; i += 4, p += 4, f += 4) {
+			// transpose four BGRc neurons into one register per channel
+			const __m128i n0 = _mm_loadu_si128((const __m128i *)network[i]);
+			const __m128i n1 = _mm_loadu_si128((const __m128i *)network[i + 1]);
+			const __m128i n2 = _mm_loadu_si128((const __m128i *)network[i + 2]);
+			const __m128i n3 = _mm_loadu_si128((const __m128i *)network[i + 3]);
+			const __m128i lo01 = _mm_unpacklo_epi32(n0, n1);
+			const __m128i lo23 = _mm_unpacklo_epi32(n2, n3);
+			const __m128i hi01 = _mm_unpackhi_epi32(n0, n1);
+			const __m128i hi23 = _mm_unpackhi_epi32(n2, n3);
+
+			__m128i d0 = _mm_sub_epi32(_mm_unpacklo_epi64(lo01, lo23), t0);
+			__m128i d1 = _mm_sub_epi32(_mm_unpackhi_epi64(lo01, lo23), t1);
+			__m128i d2 = _mm_sub_epi32(_mm_unpacklo_epi64(hi01, hi23), t2);
+			__m128i sign = _mm_srai_epi32(d0, 31);
+			d0 = _mm_sub_epi32(_mm_xor_si128(d0, sign), sign);
+			sign = _mm_srai_epi32(d1, 31);
+			d1 = _mm_sub_epi32(_mm_xor_si128(d1, sign), sign);
+			sign = _mm_srai_epi32(d2, 31);
+			d2 = _mm_sub_epi32(_mm_xor_si128(d2, sign), sign);
+			const __m128i vdist = _mm_add_epi32(_mm_add_epi32(d0, d1), d2);
+
+			__m128i closer = _mm_cmplt_epi32(vdist, best_d);
+			best_d = _mm_or_si128(_mm_and_si128(closer, vdist), _mm_andnot_si128(closer, best_d));
+			best_i = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, best_i));
+
+			__m128i vbias = _mm_loadu_si128((const __m128i *)p);
+			const __m128i vbiasdist = _mm_sub_epi32(vdist, _mm_srai_epi32(vbias, intbiasshift - netbiasshift));
+			closer = _mm_cmplt_epi32(vbiasdist, bestbias_d);
+			bestbias_d = _mm_or_si128(_mm_and_si128(closer, vbiasdist), _mm_andnot_si128(closer, bestbias_d));
+			bestbias_i = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestbias_i));
+
+			__m128i vfreq = _mm_loadu_si128((const __m128i *)f);
+			const __m128i vbetafreq = _mm_srai_epi32(vfreq, betashift);
+			vfreq = _mm_sub_epi32(vfreq, vbetafreq);
+			vbias = _mm_add_epi32(vbias, _mm_slli_epi32(vbetafreq, gammashift));
+			_mm_storeu_si128((__m128i *)f, vfreq);
+			_mm_storeu_si128((__m128i *)p, vbias);
+
+			index = _mm_add_epi32(index, four);
+		}
 
-	for (i = 0; i < netsize; i++) {
+		// the lowest of the smallest distances, as the serial search would find
+		int lane_d[4], lane_i[4], lane_bias_d[4], lane_bias_i[4];
+		_mm_storeu_si128((__m128i *)lane_d, best_d);
+		_mm_storeu_si128((__m128i *)lane_i, best_i);
+		_mm_storeu_si128((__m128i *)lane_bias_d, bestbias_d);
+		_mm_storeu_si128((__m128i *)lane_bias_i, bestbias_i);
+		for (int lane = 0; lane < 4; lane++) {
+			if ((lane_i[lane] >= 0) && ((lane_d[lane] < bestd) || ((lane_d[lane] == bestd) && (lane_i[lane] < bestpos)))) {
+				bestd = lane_d[lane];
+				bestpos = lane_i[lane];
+			}
+			if ((lane_bias_i[lane] >= 0) && ((lane_bias_d[lane] < bestbiasd) || ((lane_bias_d[lane] == bestbiasd) && (lane_bias_i[lane] < bestbiaspos)))) {
+				bestbiasd = lane_bias_d[lane];
+				bestbiaspos = lane_bias_i[lane];
+			}
+		}
+	}
+#endif // FREEIMAGE_SSE2
+
+	for (; i < netsize; i++) {
 		n = network[i];
 		dist = n[FI_RGBA_BLUE] - b;
 		if (dist < 0)
@@ -490,18 +576,32 @@ FIBITMAP* NNQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, RGBQUAD *Reserve
 
 	inxbuild();
 
-	// 6) Write output image using inxsearch(b,g,r)
+	// 6) Write output image using inxsearch(b,g,r), remembering recent colours 
+	//    so that runs and repeats of a colour skip the search
+
+	FreeImage_ParallelFor(0, img_height, MAX(1, 65536 / MAX(img_width, 1)), [&](int first, int last) {
+		DWORD cache_color[MAP_CACHE_SIZE];
+		BYTE cache_index[MAP_CACHE_SIZE];
+		memset(cache_color, 0xFF, sizeof(cache_color));	// no 24-bit colour looks like this
+
+		for (int rows = first; rows < last; rows++) {
+			BYTE *new_bits = FreeImage_GetScanLine(new_dib, rows);
+			const BYTE *bits = FreeImage_GetScanLine(dib_ptr, rows);
 
-	for (WORD rows = 0; rows < img_height; rows++) {
-		BYTE *new_bits = FreeImage_GetScanLine(new_dib, rows);			
-		BYTE *bits = FreeImage_GetScanLine(dib_ptr, rows);
+			for (int cols = 0; cols < img_width; cols++) {
+				const DWORD color = ((DWORD)bits[FI_RGBA_RED] << 16) | ((DWORD)bits[FI_RGBA_GREEN] << 8) | (DWORD)bits[FI_RGBA_BLUE];
+				const unsigned slot = ((color * 2654435761U) >> 20) & (MAP_CACHE_SIZE - 1);
 
-		for (WORD cols = 0; cols < img_width; cols++) {
-			new_bits[cols] = (BYTE)inxsearch(bits[FI_RGBA_BLUE], bits[FI_RGBA_GREEN], bits[FI_RGBA_RED]);
+				if (cache_color[slot] != color) {
+					cache_color[slot] = color;
+					cache_index[slot] = (BYTE)inxsearch(bits[FI_RGBA_BLUE], bits[FI_RGBA_GREEN], bits[FI_RGBA_RED]);
+				}
+				new_bits[cols] = cache_index[slot];
 
-			bits += 3;
+				bits += 3;
+			}
 		}
-	}
+	});
 
 	return (FIBITMAP*) new_dib;
 }
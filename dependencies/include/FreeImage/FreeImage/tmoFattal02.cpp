@@ -43,7 +43,6 @@ followed by a subsampling by 2.
 */
 static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 	FIBITMAP *h_dib = NULL, *v_dib = NULL, *dst = NULL;
-	float *src_pixel, *dst_pixel;
 
 	try {
 		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
@@ -60,44 +59,80 @@ static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 
 		// horizontal convolution dib -> h_dib
 
-		src_pixel = (float*)FreeImage_GetBits(dib);
-		dst_pixel = (float*)FreeImage_GetBits(h_dib);
-
-		for(unsigned y = 0; y < height; y++) {
-			// work on line y
-			for(unsigned x = 2; x < width - 2; x++) {
-				dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
-				dst_pixel[x] /= 16;
+		const float *src_bits = (float*)FreeImage_GetBits(dib);
+		float *h_bits = (float*)FreeImage_GetBits(h_dib);
+
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				// work on line y
+				const float *src_pixel = src_bits + (size_t)y * pitch;
+				float *dst_pixel = h_bits + (size_t)y * pitch;
+				unsigned x = 2;
+#ifdef FREEIMAGE_SSE2
+				// same operations in the same order as below, so the result is bit for bit identical
+				for(; x + 4 <= width - 2; x += 4) {
+					const __m128 outer = _mm_add_ps(_mm_loadu_ps(&src_pixel[x-2]), _mm_loadu_ps(&src_pixel[x+2]));
+					const __m128 inner = _mm_mul_ps(_mm_set1_ps(4), _mm_add_ps(_mm_loadu_ps(&src_pixel[x-1]), _mm_loadu_ps(&src_pixel[x+1])));
+					const __m128 sum = _mm_add_ps(_mm_add_ps(outer, inner), _mm_mul_ps(_mm_set1_ps(6), _mm_loadu_ps(&src_pixel[x])));
+					_mm_storeu_ps(&dst_pixel[x], _mm_div_ps(sum, _mm_set1_ps(16)));
+				}
+#endif
+				for(; x < width - 2; x++) {
+					dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
+					dst_pixel[x] /= 16;
+				}
+				// boundary mirroring
+				dst_pixel[0] = (2 * src_pixel[2] + 8 * src_pixel[1] + 6 * src_pixel[0]) / 16;
+				dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
+				dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
+				dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
 			}
-			// boundary mirroring
-			dst_pixel[0] = (2 * src_pixel[2] + 8 * src_pixel[1] + 6 * src_pixel[0]) / 16;
-			dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
-			dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
-			dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
-
-			// next line
-			src_pixel += pitch;
-			dst_pixel += pitch;
-		}
+		});
 
-		// vertical convolution h_dib -> v_dib
+		// vertical convolution h_dib -> v_dib, a line at a time so that each pass reads whole rows
 
-		src_pixel = (float*)FreeImage_GetBits(h_dib);
-		dst_pixel = (float*)FreeImage_GetBits(v_dib);
+		const float *h_pixel = h_bits;
+		float *v_bits = (float*)FreeImage_GetBits(v_dib);
 
-		for(unsigned x = 0; x < width; x++) {		
-			// work on column x
-			for(unsigned y = 2; y < height - 2; y++) {
-				const unsigned index = y*pitch + x;
-				dst_pixel[index] = src_pixel[index-2*pitch] + src_pixel[index+2*pitch] + 4 * (src_pixel[index-pitch] + src_pixel[index+pitch]) + 6 * src_pixel[index];
-				dst_pixel[index] /= 16;
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				float *dst_pixel = v_bits + (size_t)y * pitch;
+				if(y < 2 || y >= height - 2) {
+					// boundary mirroring
+					for(unsigned x = 0; x < width; x++) {
+						const float *src_pixel = h_pixel + x;
+						if(y == 0) {
+							dst_pixel[x] = (2 * src_pixel[2*pitch] + 8 * src_pixel[pitch] + 6 * src_pixel[0]) / 16;
+						} else if(y == 1) {
+							dst_pixel[x] = (src_pixel[3*pitch] + 4 * (src_pixel[0] + src_pixel[2*pitch]) + 7 * src_pixel[pitch]) / 16;
+						} else if(y == height - 2) {
+							dst_pixel[x] = (src_pixel[(height-4)*pitch] + 5 * src_pixel[(height-1)*pitch] + 4 * src_pixel[(height-3)*pitch] + 6 * src_pixel[(height-2)*pitch]) / 16;
+						} else {
+							dst_pixel[x] = (src_pixel[(height-3)*pitch] + 5 * src_pixel[(height-2)*pitch] + 10 * src_pixel[(height-1)*pitch]) / 16;
+						}
+					}
+					continue;
+				}
+				const float *n2 = h_pixel + (size_t)(y-2) * pitch;
+				const float *n1 = n2 + pitch;
+				const float *c  = n1 + pitch;
+				const float *s1 = c + pitch;
+				const float *s2 = s1 + pitch;
+				unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+				for(; x + 4 <= width; x += 4) {
+					const __m128 outer = _mm_add_ps(_mm_loadu_ps(&n2[x]), _mm_loadu_ps(&s2[x]));
+					const __m128 inner = _mm_mul_ps(_mm_set1_ps(4), _mm_add_ps(_mm_loadu_ps(&n1[x]), _mm_loadu_ps(&s1[x])));
+					const __m128 sum = _mm_add_ps(_mm_add_ps(outer, inner), _mm_mul_ps(_mm_set1_ps(6), _mm_loadu_ps(&c[x])));
+					_mm_storeu_ps(&dst_pixel[x], _mm_div_ps(sum, _mm_set1_ps(16)));
+				}
+#endif
+				for(; x < width; x++) {
+					dst_pixel[x] = n2[x] + s2[x] + 4 * (n1[x] + s1[x]) + 6 * c[x];
+					dst_pixel[x] /= 16;
+				}
 			}
-			// boundary mirroring
-			dst_pixel[x] = (2 * src_pixel[x+2*pitch] + 8 * src_pixel[x+pitch] + 6 * src_pixel[x]) / 16;
-			dst_pixel[x+pitch] = (src_pixel[x+3*pitch] + 4 * (src_pixel[x] + src_pixel[x+2*pitch]) + 7 * src_pixel[x+pitch]) / 16;
-			dst_pixel[(height-2)*pitch+x] = (src_pixel[(height-4)*pitch+x] + 5 * src_pixel[(height-1)*pitch+x] + 4 * src_pixel[(height-3)*pitch+x] + 6 * src_pixel[(height-2)*pitch+x]) / 16;
-			dst_pixel[(height-1)*pitch+x] = (src_pixel[(height-3)*pitch+x] + 5 * src_pixel[(height-2)*pitch+x] + 10 * src_pixel[(height-1)*pitch+x]) / 16;
-		}
+		});
 
 		FreeImage_Unload(h_dib); h_dib = NULL;
 
@@ -171,30 +206,62 @@ static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
 		const unsigned pitch = FreeImage_GetPitch(H) / sizeof(float);
 		
 		const float divider = (float)(1 << (k + 1));
-		float average = 0;
 		
-		float *src_pixel = (float*)FreeImage_GetBits(H);
-		float *dst_pixel = (float*)FreeImage_GetBits(G);
+		const float *src_pixel = (float*)FreeImage_GetBits(H);
+		float *dst_bits = (float*)FreeImage_GetBits(G);
+
+		// gradient sum of each line, added up in order afterwards
+		std::vector<double> row_sum(height);
+
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [&](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				const unsigned n = (y == 0 ? 0 : y-1);
+				const unsigned s = (y+1 == height ? y : y+1);
+				const float *line = src_pixel + (size_t)y * pitch;
+				const float *north = src_pixel + (size_t)n * pitch;
+				const float *south = src_pixel + (size_t)s * pitch;
+				float *dst_pixel = dst_bits + (size_t)y * pitch;
+				double sum = 0;
+				unsigned x = 0;
+				// the first and last columns use one-sided differences
+				for(; x < MIN(1U, width); x++) {
+					const unsigned e = (x+1 == width ? x : x+1);
+					const float gx = (line[e] - line[x]) / divider;
+					const float gy = (south[x] - north[x]) / divider;
+					dst_pixel[x] = sqrt(gx*gx + gy*gy);
+					sum += dst_pixel[x];
+				}
+#ifdef FREEIMAGE_SSE2
+				for(; x + 4 < width; x += 4) {
+					// central difference
+					const __m128 gx = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(&line[x+1]), _mm_loadu_ps(&line[x-1])), _mm_set1_ps(divider));
+					const __m128 gy = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(&south[x]), _mm_loadu_ps(&north[x])), _mm_set1_ps(divider));
+					const __m128 gradient = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+					_mm_storeu_ps(&dst_pixel[x], gradient);
+					sum += TMO_SumToDouble(gradient);
+				}
+#endif
+				for(; x < width; x++) {
+					const unsigned w = (x == 0 ? 0 : x-1);
+					const unsigned e = (x+1 == width ? x : x+1);		
+					// central difference
+					const float gx = (line[e] - line[w]) / divider; // [Hk(x+1, y) - Hk(x-1, y)] / 2**(k+1)
+					const float gy = (south[x] - north[x]) / divider; // [Hk(x, y+1) - Hk(x, y-1)] / 2**(k+1)
+					// gradient
+					dst_pixel[x] = sqrt(gx*gx + gy*gy);
+					// average gradient
+					sum += dst_pixel[x];
+				}
+				row_sum[y] = sum;
+			}
+		});
 
+		double average = 0;
 		for(unsigned y = 0; y < height; y++) {
-			const unsigned n = (y == 0 ? 0 : y-1);
-			const unsigned s = (y+1 == height ? y : y+1);
-			for(unsigned x = 0; x < width; x++) {
-				const unsigned w = (x == 0 ? 0 : x-1);
-				const unsigned e = (x+1 == width ? x : x+1);		
-				// central difference
-				const float gx = (src_pixel[y*pitch+e] - src_pixel[y*pitch+w]) / divider; // [Hk(x+1, y) - Hk(x-1, y)] / 2**(k+1)
-				const float gy = (src_pixel[s*pitch+x] - src_pixel[n*pitch+x]) / divider; // [Hk(x, y+1) - Hk(x, y-1)] / 2**(k+1)
-				// gradient
-				dst_pixel[x] = sqrt(gx*gx + gy*gy);
-				// average gradient
-				average += dst_pixel[x];
-			}
-			// next line
-			dst_pixel += pitch;
+			average += row_sum[y];
 		}
 		
-		*avgGrad = average / (width * height);
+		*avgGrad = (float)(average / ((double)width * height));
 
 		return G;
 
@@ -241,7 +308,6 @@ Compute the gradient attenuation function PHI(x, y)
 @return Returns the attenuation matrix Phi if successful, returns NULL otherwise
 */
 static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, float alpha, float beta) {
-	float *src_pixel, *dst_pixel;
 	FIBITMAP **phi = NULL;
 
 	try {
@@ -268,35 +334,43 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 			phi[k] = FreeImage_AllocateT(FIT_FLOAT, width, height);
 			if(!phi[k]) throw(1);
 			
-			src_pixel = (float*)FreeImage_GetBits(Gk);
-			dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-			for(unsigned y = 0; y < height; y++) {
-				for(unsigned x = 0; x < width; x++) {
-					// compute (alpha / grad) * (grad / alpha) ** beta
-					const float v = src_pixel[x] / ALPHA;
-					const float value = (float)pow((float)v, (float)(beta-1));
-					dst_pixel[x] = (value > 1) ? 1 : value;
+			const float *g_bits = (float*)FreeImage_GetBits(Gk);
+			float *phi_bits = (float*)FreeImage_GetBits(phi[k]);
+			FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+				for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+					const float *src_pixel = g_bits + (size_t)y * pitch;
+					float *dst_pixel = phi_bits + (size_t)y * pitch;
+					unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+					for(; x + 4 <= width; x += 4) {
+						const __m128 v = _mm_div_ps(_mm_loadu_ps(&src_pixel[x]), _mm_set1_ps(ALPHA));
+						_mm_storeu_ps(&dst_pixel[x], _mm_min_ps(TMO_Pow(v, _mm_set1_ps(beta-1)), _mm_set1_ps(1)));
+					}
+#endif
+					for(; x < width; x++) {
+						// compute (alpha / grad) * (grad / alpha) ** beta
+						const float v = src_pixel[x] / ALPHA;
+						const float value = (float)pow((float)v, (float)(beta-1));
+						dst_pixel[x] = (value > 1) ? 1 : value;
+					}
 				}
-				// next line
-				src_pixel += pitch;
-				dst_pixel += pitch;
-			}
+			});
 
 			if(k < nlevels-1) {
 				// compute PHI(k) = L( PHI(k+1) ) * phi(k)
 				FIBITMAP *L = FreeImage_Rescale(phi[k+1], width, height, FILTER_BILINEAR);
 				if(!L) throw(1);
 
-				src_pixel = (float*)FreeImage_GetBits(L);
-				dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-				for(unsigned y = 0; y < height; y++) {
-					for(unsigned x = 0; x < width; x++) {
-						dst_pixel[x] *= src_pixel[x];
+				const float *l_bits = (float*)FreeImage_GetBits(L);
+				FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+					for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+						const float *src_pixel = l_bits + (size_t)y * pitch;
+						float *dst_pixel = phi_bits + (size_t)y * pitch;
+						for(unsigned x = 0; x < width; x++) {
+							dst_pixel[x] *= src_pixel[x];
+						}
 					}
-					// next line
-					src_pixel += pitch;
-					dst_pixel += pitch;
-				}
+				});
 
 				FreeImage_Unload(L);
 
@@ -335,7 +409,6 @@ then compute the divergence div G from the attenuated gradient.
 */
 static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
 	FIBITMAP *Gx = NULL, *Gy = NULL, *divG = NULL;
-	float *phi, *h, *gx, *gy, *divg;
 
 	try {
 		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(H);
@@ -353,46 +426,45 @@ static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
 		
 		// perform gradient attenuation
 
-		phi = (float*)FreeImage_GetBits(PHI);
-		h   = (float*)FreeImage_GetBits(H);
-		gx  = (float*)FreeImage_GetBits(Gx);
-		gy  = (float*)FreeImage_GetBits(Gy);
-
-		for(unsigned y = 0; y < height; y++) {
-			const unsigned s = (y+1 == height ? y : y+1);
-			for(unsigned x = 0; x < width; x++) {				
-				const unsigned e = (x+1 == width ? x : x+1);
-				// forward difference
-				const unsigned index = y*pitch + x;
-				const float phi_xy = phi[index];
-				const float h_xy   = h[index];
-				gx[x] = (h[y*pitch+e] - h_xy) * phi_xy; // [H(x+1, y) - H(x, y)] * PHI(x, y)
-				gy[x] = (h[s*pitch+x] - h_xy) * phi_xy; // [H(x, y+1) - H(x, y)] * PHI(x, y)
+		const float *phi = (float*)FreeImage_GetBits(PHI);
+		const float *h   = (float*)FreeImage_GetBits(H);
+		float *gx  = (float*)FreeImage_GetBits(Gx);
+		float *gy  = (float*)FreeImage_GetBits(Gy);
+
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				const unsigned s = (y+1 == height ? y : y+1);
+				for(unsigned x = 0; x < width; x++) {				
+					const unsigned e = (x+1 == width ? x : x+1);
+					// forward difference
+					const unsigned index = y*pitch + x;
+					const float phi_xy = phi[index];
+					const float h_xy   = h[index];
+					gx[index] = (h[y*pitch+e] - h_xy) * phi_xy; // [H(x+1, y) - H(x, y)] * PHI(x, y)
+					gy[index] = (h[s*pitch+x] - h_xy) * phi_xy; // [H(x, y+1) - H(x, y)] * PHI(x, y)
+				}
 			}
-			// next line
-			gx += pitch;
-			gy += pitch;
-		}
+		});
 
 		// calculate the divergence
 
 		divG = FreeImage_AllocateT(image_type, width, height);
 		if(!divG) throw(1);
 		
-		gx  = (float*)FreeImage_GetBits(Gx);
-		gy  = (float*)FreeImage_GetBits(Gy);
-		divg = (float*)FreeImage_GetBits(divG);
-
-		for(unsigned y = 0; y < height; y++) {
-			for(unsigned x = 0; x < width; x++) {				
-				// backward difference approximation
-				// divG = Gx(x, y) - Gx(x-1, y) + Gy(x, y) - Gy(x, y-1)
-				const unsigned index = y*pitch + x;
-				divg[index] = gx[index] + gy[index];
-				if(x > 0) divg[index] -= gx[index-1];
-				if(y > 0) divg[index] -= gy[index-pitch];
+		float *divg = (float*)FreeImage_GetBits(divG);
+
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				for(unsigned x = 0; x < width; x++) {				
+					// backward difference approximation
+					// divG = Gx(x, y) - Gx(x-1, y) + Gy(x, y) - Gy(x, y-1)
+					const unsigned index = y*pitch + x;
+					divg[index] = gx[index] + gy[index];
+					if(x > 0) divg[index] -= gx[index-1];
+					if(y > 0) divg[index] -= gy[index-pitch];
+				}
 			}
-		}
+		});
 
 		// no longer needed ... 
 		FreeImage_Unload(Gx);
@@ -427,34 +499,48 @@ static FIBITMAP* LogLuminance(FIBITMAP *Y) {
 		const unsigned height = FreeImage_GetHeight(H);
 		const unsigned pitch  = FreeImage_GetPitch(H);
 
-		// find max & min luminance values
-		float maxLum = -1e20F, minLum = 1e20F;
+		// find max & min luminance values, line by line
+		std::vector<float> row_max(height), row_min(height);
 
 		BYTE *bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			const float *pixel = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
-				const float value = pixel[x];
-				maxLum = (maxLum < value) ? value : maxLum;	// max Luminance in the scene
-				minLum = (minLum < value) ? minLum : value;	// min Luminance in the scene
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [&](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				const float *pixel = (float*)(bits + (size_t)y * pitch);
+				float maxLum = -1e20F, minLum = 1e20F;
+				for(unsigned x = 0; x < width; x++) {
+					const float value = pixel[x];
+					maxLum = (maxLum < value) ? value : maxLum;	// max Luminance in the scene
+					minLum = (minLum < value) ? minLum : value;	// min Luminance in the scene
+				}
+				row_max[y] = maxLum;
+				row_min[y] = minLum;
 			}
-			// next line
-			bits += pitch;
+		});
+		float maxLum = -1e20F, minLum = 1e20F;
+		for(unsigned y = 0; y < height; y++) {
+			maxLum = (maxLum < row_max[y]) ? row_max[y] : maxLum;
+			minLum = (minLum < row_min[y]) ? minLum : row_min[y];
 		}
 		if(maxLum == minLum) throw(1);
 
 		// normalize to range 0..100 and take the logarithm
 		const float scale = 100.F / (maxLum - minLum);
-		bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			float *pixel = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
-				const float value = (pixel[x] - minLum) * scale;
-				pixel[x] = log(value + EPSILON);
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				float *pixel = (float*)(bits + (size_t)y * pitch);
+				unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+				for(; x + 4 <= width; x += 4) {
+					const __m128 value = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pixel[x]), _mm_set1_ps(minLum)), _mm_set1_ps(scale));
+					_mm_storeu_ps(&pixel[x], TMO_Log(_mm_add_ps(value, _mm_set1_ps(EPSILON))));
+				}
+#endif
+				for(; x < width; x++) {
+					const float value = (pixel[x] - minLum) * scale;
+					pixel[x] = log(value + EPSILON);
+				}
 			}
-			// next line
-			bits += pitch;
-		}
+		});
 
 		return H;
 
@@ -474,13 +560,20 @@ static void ExpLuminance(FIBITMAP *Y) {
 	const unsigned pitch = FreeImage_GetPitch(Y);
 
 	BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
-	for(unsigned y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			pixel[x] = exp(pixel[x]) - EPSILON;
+	FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+		for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+			float *pixel = (float*)(bits + (size_t)y * pitch);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			for(; x + 4 <= width; x += 4) {
+				_mm_storeu_ps(&pixel[x], _mm_sub_ps(TMO_Exp(_mm_loadu_ps(&pixel[x])), _mm_set1_ps(EPSILON)));
+			}
+#endif
+			for(; x < width; x++) {
+				pixel[x] = exp(pixel[x]) - EPSILON;
+			}
 		}
-		bits += pitch;
-	}
+	});
 }
 
 // --------------------------------------------------------------------------
@@ -650,20 +743,34 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		BYTE *bits_yin  = (BYTE*)FreeImage_GetBits(Yin);
 		BYTE *bits_yout = (BYTE*)FreeImage_GetBits(Yout);
 
-		for(unsigned y = 0; y < height; y++) {
-			float *Lin = (float*)bits_yin;
-			float *Lout = (float*)bits_yout;
-			float *color = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
-				for(unsigned c = 0; c < 3; c++) {
-					*color = (Lin[x] > 0) ? pow(*color/Lin[x], s) * Lout[x] : 0;
-					color++;
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				const float *Lin = (float*)(bits_yin + (size_t)y * y_pitch);
+				const float *Lout = (float*)(bits_yout + (size_t)y * y_pitch);
+				float *color = (float*)(bits + (size_t)y * rgb_pitch);
+				unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+				for(; x + 4 <= width; x += 4, color += 12) {
+					const __m128 lin = _mm_loadu_ps(&Lin[x]);
+					const __m128 lout = _mm_loadu_ps(&Lout[x]);
+					const __m128 valid = _mm_cmpgt_ps(lin, _mm_setzero_ps());
+					__m128 channel[3];
+					TMO_LoadRGB(color, channel[0], channel[1], channel[2]);
+					for(unsigned c = 0; c < 3; c++) {
+						const __m128 value = _mm_mul_ps(TMO_Pow(_mm_div_ps(channel[c], lin), _mm_set1_ps(s)), lout);
+						channel[c] = _mm_and_ps(valid, value);
+					}
+					TMO_StoreRGB(color, channel[0], channel[1], channel[2]);
+				}
+#endif
+				for(; x < width; x++) {
+					for(unsigned c = 0; c < 3; c++) {
+						*color = (Lin[x] > 0) ? pow(*color/Lin[x], s) * Lout[x] : 0;
+						color++;
+					}
 				}
 			}
-			bits += rgb_pitch;
-			bits_yin += y_pitch;
-			bits_yout += y_pitch;
-		}
+		});
 
 		// not needed anymore
 		FreeImage_Unload(Yin);  Yin  = NULL;
@@ -52,9 +52,6 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 	float minLum = 1;	// min luminance
 	float maxLum = 1;	// max luminance
 
-	float L;		// pixel luminance
-	float I_g, I_l; // global and local light adaptation
-	float I_a;		// interpolated pixel light adaptation
 	float k;		// key (low-key means overall dark image, high-key means overall light image)
 
 	// check input parameters 
@@ -75,8 +72,7 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 	const unsigned y_pitch    = FreeImage_GetPitch(Y);
 
 	int i;
-	unsigned x, y;
-	BYTE *bits = NULL, *Ybits = NULL;
+	unsigned y;
 
 	// get statistics about the data (but only if its really needed)
 
@@ -95,36 +91,60 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 	}
 	m = (m > 0) ? m : (float)(0.3 + 0.7 * pow(k, 1.4F));
 
-	float max_color = -1e6F;
-	float min_color = +1e6F;
+	// colour range of each row, gathered in order afterwards
+	std::vector<float> row_max(height), row_min(height);
 
 	// tone map image
 
-	bits  = (BYTE*)FreeImage_GetBits(dib);
-	Ybits = (BYTE*)FreeImage_GetBits(Y);
+	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
+	const BYTE *Ybits = (BYTE*)FreeImage_GetBits(Y);
 
 	if((a == 1) && (c == 0)) {
 		// when using default values, use a fastest code
 
-		for(y = 0; y < height; y++) {
-			float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
-
-			for(x = 0; x < width; x++) {
-				I_a = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [&](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				const float *Y = (float*)(Ybits + (size_t)y * y_pitch);
+				float *color   = (float*)(bits + (size_t)y * dib_pitch);
+				float max_color = -1e6F;
+				float min_color = +1e6F;
+				unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+				__m128 max4 = _mm_set1_ps(max_color), min4 = _mm_set1_ps(min_color);
+				for(; x + 4 <= width; x += 4, color += 12) {
+					// the light adaptation is the same for the three channels
+					const __m128 I_a = _mm_loadu_ps(&Y[x]);	// luminance(x, y)
+					const __m128 adapt = TMO_Pow(_mm_mul_ps(_mm_set1_ps(f), I_a), _mm_set1_ps(m));
+					__m128 red, green, blue;
+					TMO_LoadRGB(color, red, green, blue);
+					red   = _mm_div_ps(red,   _mm_add_ps(red,   adapt));
+					green = _mm_div_ps(green, _mm_add_ps(green, adapt));
+					blue  = _mm_div_ps(blue,  _mm_add_ps(blue,  adapt));
+					TMO_StoreRGB(color, red, green, blue);
+					max4 = _mm_max_ps(max4, _mm_max_ps(red, _mm_max_ps(green, blue)));
+					min4 = _mm_min_ps(min4, _mm_min_ps(red, _mm_min_ps(green, blue)));
+				}
+				float lanes[4];
+				_mm_storeu_ps(lanes, max4);
+				max_color = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+				_mm_storeu_ps(lanes, min4);
+				min_color = MIN(MIN(lanes[0], lanes[1]), MIN(lanes[2], lanes[3]));
+#endif
+				for(; x < width; x++) {
+					const float adapt = pow(f * Y[x], m);	// luminance(x, y)
+					for (int i = 0; i < 3; i++) {
+						*color /= ( *color + adapt );
+						
+						max_color = (*color > max_color) ? *color : max_color;
+						min_color = (*color < min_color) ? *color : min_color;
 
-					color++;
+						color++;
+					}
 				}
+				row_max[y] = max_color;
+				row_min[y] = min_color;
 			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
-		}
+		});
 	} else {
 		// complete algorithm
 
@@ -133,67 +153,104 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 		Cav[0] = Cav[1] = Cav[2] = 0;
 		if((a != 1) && (c != 0)) {
 			// channel averages are not needed when (a == 1) or (c == 0)
-			bits = (BYTE*)FreeImage_GetBits(dib);
-			for(y = 0; y < height; y++) {
-				float *color = (float*)bits;
-				for(x = 0; x < width; x++) {
-					for(i = 0; i < 3; i++) {
-						Cav[i] += *color;
-						color++;
+			std::vector<double> row_sum(3 * height);
+			FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [&](int first, int last) {
+				for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+					const float *color = (float*)(bits + (size_t)y * dib_pitch);
+					double sum[3] = { 0, 0, 0 };
+					for(unsigned x = 0; x < width; x++) {
+						for(int i = 0; i < 3; i++) {
+							sum[i] += *color;
+							color++;
+						}
+					}
+					for(int i = 0; i < 3; i++) {
+						row_sum[3 * y + i] = sum[i];
 					}
 				}
-				// next line
-				bits += dib_pitch;
+			});
+			double sum[3] = { 0, 0, 0 };
+			for(y = 0; y < height; y++) {
+				for(i = 0; i < 3; i++) {
+					sum[i] += row_sum[3 * y + i];
+				}
 			}
-			const float image_size = (float)width * height;
+			const double image_size = (double)width * height;
 			for(i = 0; i < 3; i++) {
-				Cav[i] /= image_size;
+				Cav[i] = (float)(sum[i] / image_size);
 			}
 		}
 
 		// perform tone mapping
 
-		bits = (BYTE*)FreeImage_GetBits(dib);
-		for(y = 0; y < height; y++) {
-			const float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
-
-			for(x = 0; x < width; x++) {
-				L = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					I_l = c * *color + (1-c) * L;
-					I_g = c * Cav[i] + (1-c) * Lav;
-					I_a = a * I_l + (1-a) * I_g;
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
-
-					color++;
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [&](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				const float *Y = (float*)(Ybits + (size_t)y * y_pitch);
+				float *color   = (float*)(bits + (size_t)y * dib_pitch);
+				float max_color = -1e6F;
+				float min_color = +1e6F;
+				unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+				__m128 max4 = _mm_set1_ps(max_color), min4 = _mm_set1_ps(min_color);
+				for(; x + 4 <= width; x += 4, color += 12) {
+					const __m128 L = _mm_loadu_ps(&Y[x]);	// luminance(x, y)
+					__m128 channel[3];
+					TMO_LoadRGB(color, channel[0], channel[1], channel[2]);
+					for (int i = 0; i < 3; i++) {
+						const __m128 I_l = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c), channel[i]), _mm_mul_ps(_mm_set1_ps(1-c), L));
+						const __m128 I_g = _mm_set1_ps(c * Cav[i] + (1-c) * Lav);
+						const __m128 I_a = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a), I_l), _mm_mul_ps(_mm_set1_ps(1-a), I_g));
+						channel[i] = _mm_div_ps(channel[i], _mm_add_ps(channel[i], TMO_Pow(_mm_mul_ps(_mm_set1_ps(f), I_a), _mm_set1_ps(m))));
+						max4 = _mm_max_ps(max4, channel[i]);
+						min4 = _mm_min_ps(min4, channel[i]);
+					}
+					TMO_StoreRGB(color, channel[0], channel[1], channel[2]);
+				}
+				float lanes[4];
+				_mm_storeu_ps(lanes, max4);
+				max_color = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+				_mm_storeu_ps(lanes, min4);
+				min_color = MIN(MIN(lanes[0], lanes[1]), MIN(lanes[2], lanes[3]));
+#endif
+				for(; x < width; x++) {
+					const float L = Y[x];	// luminance(x, y)
+					for (int i = 0; i < 3; i++) {
+						const float I_l = c * *color + (1-c) * L;		// local light adaptation
+						const float I_g = c * Cav[i] + (1-c) * Lav;	// global light adaptation
+						const float I_a = a * I_l + (1-a) * I_g;		// interpolated pixel light adaptation
+						*color /= ( *color + pow(f * I_a, m) );
+						
+						max_color = (*color > max_color) ? *color : max_color;
+						min_color = (*color < min_color) ? *color : min_color;
+
+						color++;
+					}
 				}
+				row_max[y] = max_color;
+				row_min[y] = min_color;
 			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
-		}
+		});
+	}
+
+	float max_color = -1e6F;
+	float min_color = +1e6F;
+	for(y = 0; y < height; y++) {
+		max_color = MAX(max_color, row_max[y]);
+		min_color = MIN(min_color, row_min[y]);
 	}
 
 	// normalize intensities
 
 	if(max_color != min_color) {
-		bits = (BYTE*)FreeImage_GetBits(dib);
 		const float range = max_color - min_color;
-		for(y = 0; y < height; y++) {
-			float *color = (float*)bits;
-			for(x = 0; x < width; x++) {
-				for(i = 0; i < 3; i++) {
-					*color = (*color - min_color) / range;
-					color++;
+		FreeImage_ParallelFor(0, (int)height, ToneMappingMinRows(width), [=](int first, int last) {
+			for(unsigned y = (unsigned)first; y < (unsigned)last; y++) {
+				float *color = (float*)(bits + (size_t)y * dib_pitch);
+				for(unsigned x = 0; x < 3 * width; x++) {
+					color[x] = (color[x] - min_color) / range;
 				}
 			}
-			// next line
-			bits += dib_pitch;
-		}
+		});
 	}
 
 	return TRUE;
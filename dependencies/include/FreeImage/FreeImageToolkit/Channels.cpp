@@ -22,6 +22,164 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//   Channel extraction / insertion
+//
+//   A pixel holds 'samples' interleaved samples of 'sample_size' bytes each 
+//   (1 for BGR[A], 2 for RGB[A]16, 4 for RGB[A]F), and a channel plane holds 
+//   one of them per pixel. With SSSE3, 16 bytes of the plane are moved at a time 
+//   to or from 'samples' loads of 16 bytes of pixels, with byte shuffles.
+// ----------------------------------------------------------
+
+#ifdef FREEIMAGE_SSSE3
+
+/**
+Byte shuffles between the pixels and a channel plane, for one channel of a pixel format
+*/
+typedef struct tagChannelShuffle {
+	//! gather[k] moves the channel bytes of pixel load k to their place in the plane
+	BYTE gather[4][16];
+	//! scatter[k] moves plane bytes to their place in pixel load k
+	BYTE scatter[4][16];
+	//! keep[k] is 0xFF for the bytes of pixel load k that belong to other channels
+	BYTE keep[4][16];
+} ChannelShuffle;
+
+static void 
+InitChannelShuffle(ChannelShuffle *shuffle, unsigned samples, unsigned sample_size, unsigned c) {
+	for(unsigned k = 0; k < samples; k++) {
+		for(unsigned j = 0; j < 16; j++) {
+			// byte j of the plane, taken from load k if it holds it
+			const unsigned src_byte = ((j / sample_size) * samples + c) * sample_size + (j % sample_size);
+			shuffle->gather[k][j] = ((src_byte >> 4) == k) ? (BYTE)(src_byte & 15) : 0x80;
+
+			// byte j of load k, taken from the plane if it belongs to channel c
+			const unsigned pixel_byte = 16 * k + j;
+			const unsigned sample = pixel_byte / sample_size;
+			const BOOL in_channel = (sample % samples) == c;
+			shuffle->scatter[k][j] = in_channel ? (BYTE)((sample / samples) * sample_size + (pixel_byte % sample_size)) : 0x80;
+			shuffle->keep[k][j] = in_channel ? 0x00 : 0xFF;
+		}
+	}
+}
+
+/**
+Extracts a channel, 16 bytes of the plane at a time
+@return Returns the number of pixels done, the rest is left to the caller
+*/
+FREEIMAGE_TARGET_SSSE3 static unsigned 
+GetChannelSSSE3(BYTE *dst_bits, const BYTE *src_bits, unsigned width, unsigned samples, unsigned sample_size, const ChannelShuffle *shuffle) {
+	const unsigned step = 16 / sample_size;
+	unsigned x = 0;
+	for(; x + step <= width; x += step) {
+		__m128i plane = _mm_setzero_si128();
+		for(unsigned k = 0; k < samples; k++) {
+			const __m128i pixels = _mm_loadu_si128((const __m128i*)(src_bits + 16 * k));
+			plane = _mm_or_si128(plane, _mm_shuffle_epi8(pixels, _mm_loadu_si128((const __m128i*)shuffle->gather[k])));
+		}
+		_mm_storeu_si128((__m128i*)dst_bits, plane);
+		src_bits += 16 * samples;
+		dst_bits += 16;
+	}
+	return x;
+}
+
+/**
+Inserts a channel, 16 bytes of the plane at a time
+@return Returns the number of pixels done, the rest is left to the caller
+*/
+FREEIMAGE_TARGET_SSSE3 static unsigned 
+SetChannelSSSE3(BYTE *dst_bits, const BYTE *src_bits, unsigned width, unsigned samples, unsigned sample_size, const ChannelShuffle *shuffle) {
+	const unsigned step = 16 / sample_size;
+	unsigned x = 0;
+	for(; x + step <= width; x += step) {
+		const __m128i plane = _mm_loadu_si128((const __m128i*)src_bits);
+		for(unsigned k = 0; k < samples; k++) {
+			const __m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(dst_bits + 16 * k)), _mm_loadu_si128((const __m128i*)shuffle->keep[k]));
+			_mm_storeu_si128((__m128i*)(dst_bits + 16 * k), _mm_or_si128(pixels, _mm_shuffle_epi8(plane, _mm_loadu_si128((const __m128i*)shuffle->scatter[k]))));
+		}
+		src_bits += 16;
+		dst_bits += 16 * samples;
+	}
+	return x;
+}
+
+#endif // FREEIMAGE_SSSE3
+
+/**
+Copies channel c of every pixel of src into the plane dst, a band of lines per thread
+*/
+static void 
+GetChannelImage(FIBITMAP *dst, FIBITMAP *src, unsigned samples, unsigned sample_size, unsigned c) {
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	BOOL simd = FALSE;
+#ifdef FREEIMAGE_SSSE3
+	ChannelShuffle shuffle;
+	if(FreeImage_HasSSSE3()) {
+		InitChannelShuffle(&shuffle, samples, sample_size, c);
+		simd = TRUE;
+	}
+#endif
+
+	FreeImage_ParallelFor(0, (int)height, MAX(1, 65536 / (int)width), [&](int first, int last) {
+		for(int y = first; y < last; y++) {
+			const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSSE3
+			if(simd) {
+				x = GetChannelSSSE3(dst_bits, src_bits, width, samples, sample_size, &shuffle);
+			}
+#endif
+			for(; x < width; x++) {
+				AssignPixel(dst_bits + x * sample_size, src_bits + (x * samples + c) * sample_size, sample_size);
+			}
+		}
+	});
+}
+
+/**
+Copies the plane src into channel c of every pixel of dst, a band of lines per thread
+*/
+static void 
+SetChannelImage(FIBITMAP *dst, FIBITMAP *src, unsigned samples, unsigned sample_size, unsigned c) {
+	const unsigned width  = FreeImage_GetWidth(dst);
+	const unsigned height = FreeImage_GetHeight(dst);
+
+	BOOL simd = FALSE;
+#ifdef FREEIMAGE_SSSE3
+	ChannelShuffle shuffle;
+	if(FreeImage_HasSSSE3()) {
+		InitChannelShuffle(&shuffle, samples, sample_size, c);
+		simd = TRUE;
+	}
+#endif
+
+	FreeImage_ParallelFor(0, (int)height, MAX(1, 65536 / (int)width), [&](int first, int last) {
+		for(int y = first; y < last; y++) {
+			const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSSE3
+			if(simd) {
+				x = SetChannelSSSE3(dst_bits, src_bits, width, samples, sample_size, &shuffle);
+			}
+#endif
+			for(; x < width; x++) {
+				AssignPixel(dst_bits + (x * samples + c) * sample_size, src_bits + x * sample_size, sample_size);
+			}
+		}
+	});
+}
+
+// ----------------------------------------------------------
+
 
 /** @brief Retrieves the red, green, blue or alpha channel of a BGR[A] image. 
 @param src Input image to be processed.
@@ -72,16 +230,7 @@ FreeImage_GetChannel(FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel) {
 
 		// perform extraction
 
-		int bytespp = bpp / 8;	// bytes / pixel
-
-		for(unsigned y = 0; y < height; y++) {
-			BYTE *src_bits = FreeImage_GetScanLine(src, y);
-			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
-			for(unsigned x = 0; x < width; x++) {
-				dst_bits[x] = src_bits[c];
-				src_bits += bytespp;
-			}
-		}
+		GetChannelImage(dst, src, bpp / 8, sizeof(BYTE), c);
 
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(dst, src);
@@ -120,16 +269,7 @@ FreeImage_GetChannel(FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel) {
 
 		// perform extraction
 
-		int bytespp = bpp / 16;	// words / pixel
-
-		for(unsigned y = 0; y < height; y++) {
-			unsigned short *src_bits = (unsigned short*)FreeImage_GetScanLine(src, y);
-			unsigned short *dst_bits = (unsigned short*)FreeImage_GetScanLine(dst, y);
-			for(unsigned x = 0; x < width; x++) {
-				dst_bits[x] = src_bits[c];
-				src_bits += bytespp;
-			}
-		}
+		GetChannelImage(dst, src, bpp / 16, sizeof(WORD), c);
 
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(dst, src);
@@ -168,16 +308,7 @@ FreeImage_GetChannel(FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel) {
 
 		// perform extraction
 
-		int bytespp = bpp / 32;	// floats / pixel
-
-		for(unsigned y = 0; y < height; y++) {
-			float *src_bits = (float*)FreeImage_GetScanLine(src, y);
-			float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
-			for(unsigned x = 0; x < width; x++) {
-				dst_bits[x] = src_bits[c];
-				src_bits += bytespp;
-			}
-		}
+		GetChannelImage(dst, src, bpp / 32, sizeof(float), c);
 
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(dst, src);
@@ -249,16 +380,7 @@ FreeImage_SetChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL chan
 
 		// perform insertion
 
-		int bytespp = dst_bpp / 8;	// bytes / pixel
-
-		for(unsigned y = 0; y < dst_height; y++) {
-			BYTE *src_bits = FreeImage_GetScanLine(src, y);
-			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
-			for(unsigned x = 0; x < dst_width; x++) {
-				dst_bits[c] = src_bits[x];
-				dst_bits += bytespp;
-			}
-		}
+		SetChannelImage(dst, src, dst_bpp / 8, sizeof(BYTE), c);
 
 		return TRUE;
 	}
@@ -293,16 +415,7 @@ FreeImage_SetChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL chan
 
 		// perform insertion
 
-		int bytespp = dst_bpp / 16;	// words / pixel
-
-		for(unsigned y = 0; y < dst_height; y++) {
-			unsigned short *src_bits = (unsigned short*)FreeImage_GetScanLine(src, y);
-			unsigned short *dst_bits = (unsigned short*)FreeImage_GetScanLine(dst, y);
-			for(unsigned x = 0; x < dst_width; x++) {
-				dst_bits[c] = src_bits[x];
-				dst_bits += bytespp;
-			}
-		}
+		SetChannelImage(dst, src, dst_bpp / 16, sizeof(WORD), c);
 
 		return TRUE;
 	}
@@ -337,16 +450,7 @@ FreeImage_SetChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL chan
 
 		// perform insertion
 
-		int bytespp = dst_bpp / 32;	// floats / pixel
-
-		for(unsigned y = 0; y < dst_height; y++) {
-			float *src_bits = (float*)FreeImage_GetScanLine(src, y);
-			float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
-			for(unsigned x = 0; x < dst_width; x++) {
-				dst_bits[c] = src_bits[x];
-				dst_bits += bytespp;
-			}
-		}
+		SetChannelImage(dst, src, dst_bpp / 32, sizeof(float), c);
 
 		return TRUE;
 	}
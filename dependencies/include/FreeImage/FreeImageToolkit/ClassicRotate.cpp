@@ -36,8 +36,269 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef FREEIMAGE_SSSE3
+#include <tmmintrin.h>
+#endif
+
 #define RBLOCK		64	// image blocks of RBLOCK*RBLOCK pixels
 
+// --------------------------------------------------------------------------
+// Transposition
+//
+// All the exact rotations by 90 degrees reduce to dst(row i, col j) = src(row j, col i),
+// once the rows of one side are walked backwards (negative pitch).
+// Images are transposed by tiles of RBLOCK*RBLOCK pixels, which keeps both the source 
+// and the destination lines of a tile in cache, and each tile by small square blocks 
+// held in SSE registers.
+// --------------------------------------------------------------------------
+
+/**
+Transposes a small square block of pixels
+@param dst First pixel of the destination block
+@param dst_pitch Bytes from one destination row to the next (may be negative)
+@param src First pixel of the source block
+@param src_pitch Bytes from one source row to the next (may be negative)
+*/
+typedef void (*TransposeBlockFunc)(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch);
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Transposes 8x8 8-bit pixels
+*/
+static void 
+Transpose8x8_8(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch) {
+	__m128i a[8];
+	for(int k = 0; k < 8; k++) {
+		a[k] = _mm_loadl_epi64((const __m128i*)(src + k * src_pitch));
+	}
+	// interleave the rows by bytes, then by words, then by dwords
+	const __m128i t0 = _mm_unpacklo_epi8(a[0], a[1]);
+	const __m128i t1 = _mm_unpacklo_epi8(a[2], a[3]);
+	const __m128i t2 = _mm_unpacklo_epi8(a[4], a[5]);
+	const __m128i t3 = _mm_unpacklo_epi8(a[6], a[7]);
+	const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+	const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+	const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+	const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+	// each register now holds two destination rows
+	const __m128i r[4] = {
+		_mm_unpacklo_epi32(u0, u2), _mm_unpackhi_epi32(u0, u2),
+		_mm_unpacklo_epi32(u1, u3), _mm_unpackhi_epi32(u1, u3)
+	};
+	for(int k = 0; k < 4; k++) {
+		_mm_storel_epi64((__m128i*)(dst + (2 * k) * dst_pitch), r[k]);
+		_mm_storel_epi64((__m128i*)(dst + (2 * k + 1) * dst_pitch), _mm_unpackhi_epi64(r[k], r[k]));
+	}
+}
+
+/**
+Transposes 8x8 16-bit pixels
+*/
+static void 
+Transpose8x8_16(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch) {
+	__m128i a[8];
+	for(int k = 0; k < 8; k++) {
+		a[k] = _mm_loadu_si128((const __m128i*)(src + k * src_pitch));
+	}
+	__m128i t[8];
+	for(int k = 0; k < 4; k++) {
+		t[2 * k] = _mm_unpacklo_epi16(a[2 * k], a[2 * k + 1]);
+		t[2 * k + 1] = _mm_unpackhi_epi16(a[2 * k], a[2 * k + 1]);
+	}
+	const __m128i u0 = _mm_unpacklo_epi32(t[0], t[2]);
+	const __m128i u1 = _mm_unpackhi_epi32(t[0], t[2]);
+	const __m128i u2 = _mm_unpacklo_epi32(t[1], t[3]);
+	const __m128i u3 = _mm_unpackhi_epi32(t[1], t[3]);
+	const __m128i u4 = _mm_unpacklo_epi32(t[4], t[6]);
+	const __m128i u5 = _mm_unpackhi_epi32(t[4], t[6]);
+	const __m128i u6 = _mm_unpacklo_epi32(t[5], t[7]);
+	const __m128i u7 = _mm_unpackhi_epi32(t[5], t[7]);
+	const __m128i r[8] = {
+		_mm_unpacklo_epi64(u0, u4), _mm_unpackhi_epi64(u0, u4),
+		_mm_unpacklo_epi64(u1, u5), _mm_unpackhi_epi64(u1, u5),
+		_mm_unpacklo_epi64(u2, u6), _mm_unpackhi_epi64(u2, u6),
+		_mm_unpacklo_epi64(u3, u7), _mm_unpackhi_epi64(u3, u7)
+	};
+	for(int k = 0; k < 8; k++) {
+		_mm_storeu_si128((__m128i*)(dst + k * dst_pitch), r[k]);
+	}
+}
+
+/**
+Transposes 4x4 32-bit pixels
+*/
+static void 
+Transpose4x4_32(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch) {
+	const __m128i a0 = _mm_loadu_si128((const __m128i*)(src));
+	const __m128i a1 = _mm_loadu_si128((const __m128i*)(src + src_pitch));
+	const __m128i a2 = _mm_loadu_si128((const __m128i*)(src + 2 * src_pitch));
+	const __m128i a3 = _mm_loadu_si128((const __m128i*)(src + 3 * src_pitch));
+	const __m128i t0 = _mm_unpacklo_epi32(a0, a1);
+	const __m128i t1 = _mm_unpacklo_epi32(a2, a3);
+	const __m128i t2 = _mm_unpackhi_epi32(a0, a1);
+	const __m128i t3 = _mm_unpackhi_epi32(a2, a3);
+	_mm_storeu_si128((__m128i*)(dst), _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128((__m128i*)(dst + dst_pitch), _mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128((__m128i*)(dst + 2 * dst_pitch), _mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128((__m128i*)(dst + 3 * dst_pitch), _mm_unpackhi_epi64(t2, t3));
+}
+
+/**
+Transposes 2x2 64-bit pixels
+*/
+static void 
+Transpose2x2_64(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch) {
+	const __m128i a0 = _mm_loadu_si128((const __m128i*)(src));
+	const __m128i a1 = _mm_loadu_si128((const __m128i*)(src + src_pitch));
+	_mm_storeu_si128((__m128i*)(dst), _mm_unpacklo_epi64(a0, a1));
+	_mm_storeu_si128((__m128i*)(dst + dst_pitch), _mm_unpackhi_epi64(a0, a1));
+}
+
+/**
+Transposes 4x4 128-bit pixels
+*/
+static void 
+Transpose4x4_128(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch) {
+	for(int i = 0; i < 4; i++) {
+		for(int j = 0; j < 4; j++) {
+			_mm_storeu_si128((__m128i*)(dst + i * dst_pitch + j * 16), _mm_loadu_si128((const __m128i*)(src + j * src_pitch + i * 16)));
+		}
+	}
+}
+
+#endif // FREEIMAGE_SSE2
+
+#ifdef FREEIMAGE_SSSE3
+
+/**
+Transposes 4x4 24-bit pixels. 
+The pixels are widened to 32-bit, transposed as such, and packed again.
+*/
+FREEIMAGE_TARGET_SSSE3 static void 
+Transpose4x4_24(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch) {
+	const __m128i widen = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	// 12 bytes a row: never read past the block
+	__m128i a[4];
+	for(int k = 0; k < 4; k++) {
+		const BYTE *line = src + k * src_pitch;
+		int tail;
+		memcpy(&tail, line + 8, sizeof(tail));
+		a[k] = _mm_shuffle_epi8(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)line), _mm_cvtsi32_si128(tail)), widen);
+	}
+	const __m128i t0 = _mm_unpacklo_epi32(a[0], a[1]);
+	const __m128i t1 = _mm_unpacklo_epi32(a[2], a[3]);
+	const __m128i t2 = _mm_unpackhi_epi32(a[0], a[1]);
+	const __m128i t3 = _mm_unpackhi_epi32(a[2], a[3]);
+	const __m128i r[4] = {
+		_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+		_mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)
+	};
+	for(int k = 0; k < 4; k++) {
+		BYTE *line = dst + k * dst_pitch;
+		const __m128i v = _mm_shuffle_epi8(r[k], pack);
+		const int tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		_mm_storel_epi64((__m128i*)line, v);
+		memcpy(line + 8, &tail, sizeof(tail));
+	}
+}
+
+#endif // FREEIMAGE_SSSE3
+
+/**
+Transposes a width x height destination block, pixel by pixel
+*/
+static void 
+TransposeBlock(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch, int width, int height, unsigned bytespp) {
+	for(int i = 0; i < height; i++) {
+		BYTE *dst_bits = dst + i * dst_pitch;
+		const BYTE *src_bits = src + i * (int)bytespp;
+		for(int j = 0; j < width; j++) {
+			AssignPixel(dst_bits, src_bits, bytespp);
+			dst_bits += bytespp;
+			src_bits += src_pitch;
+		}
+	}
+}
+
+/**
+Transposes a whole image: dst(row i, col j) = src(row j, col i). 
+Bands of RBLOCK destination rows are spread over every hardware thread.
+@param dst First destination row
+@param dst_pitch Bytes from one destination row to the next (may be negative)
+@param src First source row
+@param src_pitch Bytes from one source row to the next (may be negative)
+@param dst_width Destination width, i.e. the source height
+@param dst_height Destination height, i.e. the source width
+@param bytespp Number of bytes per pixel
+*/
+static void 
+Transpose(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch, unsigned dst_width, unsigned dst_height, unsigned bytespp) {
+	TransposeBlockFunc kernel = NULL;
+	int block = 1;
+
+#ifdef FREEIMAGE_SSE2
+	switch(bytespp) {
+		case 1:
+			kernel = Transpose8x8_8;
+			block = 8;
+			break;
+		case 2:
+			kernel = Transpose8x8_16;
+			block = 8;
+			break;
+		case 4:
+			kernel = Transpose4x4_32;
+			block = 4;
+			break;
+		case 8:
+			kernel = Transpose2x2_64;
+			block = 2;
+			break;
+		case 16:
+			kernel = Transpose4x4_128;
+			block = 4;
+			break;
+	}
+#endif
+#ifdef FREEIMAGE_SSSE3
+	if((bytespp == 3) && FreeImage_HasSSSE3()) {
+		kernel = Transpose4x4_24;
+		block = 4;
+	}
+#endif
+
+	const int width = (int)dst_width;
+	const int height = (int)dst_height;
+	const int bands = (height + RBLOCK - 1) / RBLOCK;
+
+	FreeImage_ParallelFor(0, bands, MAX(1, 65536 / (RBLOCK * width)), [=](int first, int last) {
+		for(int ys = first * RBLOCK; ys < MIN(height, last * RBLOCK); ys += RBLOCK) {
+			const int ye = MIN(height, ys + RBLOCK);
+			for(int xs = 0; xs < width; xs += RBLOCK) {
+				const int xe = MIN(width, xs + RBLOCK);
+				// transpose the tile block by block, then its right and bottom edges pixel by pixel
+				int y = ys;
+				if(kernel) {
+					for(; y + block <= ye; y += block) {
+						int x = xs;
+						for(; x + block <= xe; x += block) {
+							kernel(dst + y * dst_pitch + x * bytespp, dst_pitch, src + x * src_pitch + y * bytespp, src_pitch);
+						}
+						TransposeBlock(dst + y * dst_pitch + x * bytespp, dst_pitch, src + x * src_pitch + y * bytespp, src_pitch, xe - x, block, bytespp);
+					}
+				}
+				TransposeBlock(dst + y * dst_pitch + xs * bytespp, dst_pitch, src + xs * src_pitch + y * bytespp, src_pitch, xe - xs, ye - y, bytespp);
+			}
+		}
+	});
+}
+
 // --------------------------------------------------------------------------
 
 /**
@@ -369,40 +630,10 @@ Rotate90(FIBITMAP *src) {
 			}
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
 				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
+				// dst(x, y) = src(dst_height - 1 - y, x), i.e. the transpose of src written from the last dst line up
 				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							BYTE *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							BYTE *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
+
+				Transpose(FreeImage_GetScanLine(dst, dst_height - 1), -(int)dst_pitch, FreeImage_GetBits(src), (int)src_pitch, dst_width, dst_height, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -412,21 +643,10 @@ Rotate90(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
 			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
-			}
+			Transpose(FreeImage_GetScanLine(dst, dst_height - 1), -(int)dst_pitch, FreeImage_GetBits(src), (int)src_pitch, dst_width, dst_height, bytespp);
 		}
 		break;
 	}
@@ -442,7 +662,7 @@ Precise rotation, no filters required.
 */
 static FIBITMAP* 
 Rotate180(FIBITMAP *src) {
-	int x, y, k, pos;
+	int k, pos;
 
 	const int bpp = FreeImage_GetBPP(src);
 
@@ -481,19 +701,17 @@ Rotate180(FIBITMAP *src) {
 		case FIT_RGBAF:
 		{
 			 // Calculate the number of bytes per pixel
-			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for(y = 0; y < src_height; y++) {
-				BYTE *src_bits = FreeImage_GetScanLine(src, y);
-				BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1) + (dst_width - 1) * bytespp;
-				for(x = 0; x < src_width; x++) {
-					// get pixel at (x, y)
-					// set pixel at (dst_width - x - 1, dst_height - y - 1)
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += bytespp;
-					dst_bits -= bytespp;					
-				}				
-			}
+			const unsigned line = FreeImage_GetLine(src);
+			const unsigned bytespp = line / FreeImage_GetWidth(src);
+
+			// copy each line to its mirror line, then mirror its pixels in place
+			FreeImage_ParallelFor(0, src_height, MAX(1, 65536 / (int)line), [=](int first, int last) {
+				for(int y = first; y < last; y++) {
+					BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1);
+					memcpy(dst_bits, FreeImage_GetScanLine(src, y), line);
+					MirrorLine(dst_bits, dst_width, bytespp);
+				}
+			});
 		}
 		break;
 	}
@@ -510,7 +728,7 @@ Code adapted from CxImage (http://www.xdp.it/cximage.htm)
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
+	int dlineup;
 
 	const unsigned bpp = FreeImage_GetBPP(src);
 
@@ -561,40 +779,10 @@ Rotate270(FIBITMAP *src) {
 			} 
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
 				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
+				// dst(x, y) = src(y, dst_width - 1 - x), i.e. the transpose of src read from its last line up
 				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							BYTE *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							BYTE *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
+				Transpose(FreeImage_GetBits(dst), (int)dst_pitch, FreeImage_GetScanLine(src, src_height - 1), -(int)src_pitch, dst_width, dst_height, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -604,21 +792,10 @@ Rotate270(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
 			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
-			}
+			Transpose(FreeImage_GetBits(dst), (int)dst_pitch, FreeImage_GetScanLine(src, src_height - 1), -(int)src_pitch, dst_width, dst_height, bytespp);
 		}
 		break;
 	}
@@ -663,20 +840,23 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		return NULL;
 	}
 	
-	for(u = 0; u < height_1; u++) {  
-		double dShear;
-
-		if(dTan >= 0)	{
-			// Positive angle
-			dShear = (u + 0.5) * dTan;
-		}
-		else {
-			// Negative angle
-			dShear = (double(u) - height_1 + 0.5) * dTan;
+	// rows are skewed independently, a band per thread
+	FreeImage_ParallelFor(0, height_1, MAX(1, 65536 / (int)width_1), [=](int first, int last) {
+		for(int row = first; row < last; row++) {  
+			double dShear;
+
+			if(dTan >= 0)	{
+				// Positive angle
+				dShear = (row + 0.5) * dTan;
+			}
+			else {
+				// Negative angle
+				dShear = (double(row) - height_1 + 0.5) * dTan;
+			}
+			int iShear = int(floor(dShear));
+			HorizontalSkew(src, dst1, row, iShear, dShear - double(iShear), bkcolor);
 		}
-		int iShear = int(floor(dShear));
-		HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
-	}
+	});
 
 	// Perform 2nd shear  (vertical)
 	// ----------------------------------------------------------------------
@@ -702,10 +882,22 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = -dSinE * (double(src_width) - width_2);
 	}
 
+	// the offsets are accumulated as they always were, then columns are skewed independently, a band per thread
+	double *offsets = (double*)malloc(MAX(width_2, height_2) * sizeof(double));
+	if(NULL == offsets) {
+		FreeImage_Unload(dst1);
+		FreeImage_Unload(dst2);
+		return NULL;
+	}
 	for(u = 0; u < width_2; u++, dOffset -= dSinE) {
-		int iShear = int(floor(dOffset));
-		VerticalSkew(dst1, dst2, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets[u] = dOffset;
 	}
+	FreeImage_ParallelFor(0, width_2, MAX(1, 65536 / (int)height_2), [=](int first, int last) {
+		for(int col = first; col < last; col++) {
+			int iShear = int(floor(offsets[col]));
+			VerticalSkew(dst1, dst2, col, iShear, offsets[col] - double(iShear), bkcolor);
+		}
+	});
 
 	// Perform 3rd shear (horizontal)
 	// ----------------------------------------------------------------------
@@ -721,6 +913,7 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	FIBITMAP *dst3 = FreeImage_AllocateT(image_type, width_3, height_3, bpp);
 	if(NULL == dst3) {
 		FreeImage_Unload(dst2);
+		free(offsets);
 		return NULL;
 	}
 
@@ -733,9 +926,16 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = dTan * ( (src_width - 1.0) * -dSinE + (1.0 - height_3) );
 	}
 	for(u = 0; u < height_3; u++, dOffset += dTan) {
-		int iShear = int(floor(dOffset));
-		HorizontalSkew(dst2, dst3, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets[u] = dOffset;
 	}
+	FreeImage_ParallelFor(0, height_3, MAX(1, 65536 / (int)width_3), [=](int first, int last) {
+		for(int row = first; row < last; row++) {
+			int iShear = int(floor(offsets[row]));
+			HorizontalSkew(dst2, dst3, row, iShear, offsets[row] - double(iShear), bkcolor);
+		}
+	});
+	free(offsets);
+
 	// Free result of 2nd shear    
 	FreeImage_Unload(dst2);
 
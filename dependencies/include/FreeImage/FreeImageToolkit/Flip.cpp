@@ -24,6 +24,111 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef FREEIMAGE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//  Line mirroring
+// ----------------------------------------------------------
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Reverses the order of the pixels held in v, for pixels of 1, 2, 4, 8 or 16 bytes
+*/
+static inline __m128i 
+ReversePixels(__m128i v, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			// reverse the words, then swap the bytes of each word
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_shufflelo_epi16(_mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		case 2:
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+			return _mm_shufflelo_epi16(_mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		case 4:
+			return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+		case 8:
+			return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		default:
+			return v;
+	}
+}
+
+#endif // FREEIMAGE_SSE2
+
+#ifdef FREEIMAGE_SSSE3
+
+/**
+Swaps 24-bit pixels between both ends of a line, 5 at a time from each end, until fewer than 32 bytes remain between left and right.
+The byte following the 5 pixels on the left (and preceding them on the right) is written back unchanged.
+*/
+FREEIMAGE_TARGET_SSSE3 static void 
+MirrorLine24SSSE3(BYTE *&left, BYTE *&right) {
+	// 5 pixels from bytes 1..15 to bytes 0..14 in reverse order, and back
+	const __m128i to_left = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1);
+	const __m128i to_right = _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+	const __m128i keep_last = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+	const __m128i keep_first = _mm_setr_epi8(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+	while(left + 32 <= right) {
+		const __m128i l = _mm_loadu_si128((const __m128i*)left);
+		const __m128i r = _mm_loadu_si128((const __m128i*)(right - 16));
+		_mm_storeu_si128((__m128i*)left, _mm_or_si128(_mm_shuffle_epi8(r, to_left), _mm_and_si128(l, keep_last)));
+		_mm_storeu_si128((__m128i*)(right - 16), _mm_or_si128(_mm_shuffle_epi8(l, to_right), _mm_and_si128(r, keep_first)));
+		left += 15;
+		right -= 15;
+	}
+}
+
+#endif // FREEIMAGE_SSSE3
+
+/**
+Reverses the order of the pixels of a line, in place
+@param bits First pixel of the line
+@param width Number of pixels
+@param bytespp Bytes per pixel, from 1 to 16
+*/
+void 
+MirrorLine(BYTE *bits, unsigned width, unsigned bytespp) {
+	BYTE *left = bits;
+	BYTE *right = bits + width * bytespp;
+
+#ifdef FREEIMAGE_SSE2
+	if((16 % bytespp) == 0) {
+		// 16 bytes from each end at a time
+		while(left + 32 <= right) {
+			const __m128i l = _mm_loadu_si128((const __m128i*)left);
+			const __m128i r = _mm_loadu_si128((const __m128i*)(right - 16));
+			_mm_storeu_si128((__m128i*)left, ReversePixels(r, bytespp));
+			_mm_storeu_si128((__m128i*)(right - 16), ReversePixels(l, bytespp));
+			left += 16;
+			right -= 16;
+		}
+	}
+#endif
+#ifdef FREEIMAGE_SSSE3
+	if((bytespp == 3) && FreeImage_HasSSSE3()) {
+		MirrorLine24SSSE3(left, right);
+	}
+#endif
+
+	// swap the remaining pixels one by one
+	BYTE pixel[16];
+	for(right -= bytespp; left < right; left += bytespp, right -= bytespp) {
+		AssignPixel(pixel, left, bytespp);
+		AssignPixel(left, right, bytespp);
+		AssignPixel(right, pixel, bytespp);
+	}
+}
+
+// ----------------------------------------------------------
+
 /**
 Flip the image horizontally along the vertical axis.
 @param src Input image to be processed.
@@ -39,6 +144,16 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 
 	unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
+	if (FreeImage_GetBPP(src) >= 8) {
+		// whole pixels are mirrored in place, a line per thread at a time
+		FreeImage_ParallelFor(0, (int)height, MAX(1, 65536 / (int)line), [=](int first, int last) {
+			for (int y = first; y < last; y++) {
+				MirrorLine(FreeImage_GetScanLine(src, y), width, bytespp);
+			}
+		});
+		return TRUE;
+	}
+
 	// copy between aligned memories
 	BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
 	if (!new_bits) return FALSE;
@@ -74,45 +189,6 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 				}
 			}
 			break;
-
-			case 8:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 16:
-			{				
-				WORD *dst_data = (WORD*) bits; 				
-				WORD *src_data = (WORD*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 24 :
-			case 32 :
-			case 48:
-			case 64:
-			case 96:
-			case 128:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 		
-					for(unsigned k = 0; k < bytespp; k++) {
-						*dst_data++ = src_data[k];  
-					}
-					src_data -= bytespp;
-				} 
-			}
-			break;
-
 		}
 	}
 
@@ -130,36 +206,29 @@ Flip the image vertically along the horizontal axis.
 
 BOOL DLL_CALLCONV 
 FreeImage_FlipVertical(FIBITMAP *src) {
-	BYTE *From, *Mid;
-
 	if (!FreeImage_HasPixels(src)) return FALSE;
 
 	// swap the buffer
 
-	unsigned pitch  = FreeImage_GetPitch(src);
-	unsigned height = FreeImage_GetHeight(src);
-
-	// copy between aligned memories
-	Mid = (BYTE*)FreeImage_Aligned_Malloc(pitch * sizeof(BYTE), FIBITMAP_ALIGNMENT);
-	if (!Mid) return FALSE;
-
-	From = FreeImage_GetBits(src);
-	
-	unsigned line_s = 0;
-	unsigned line_t = (height-1) * pitch;
-
-	for(unsigned y = 0; y < height/2; y++) {
-
-		memcpy(Mid, From + line_s, pitch);
-		memcpy(From + line_s, From + line_t, pitch);
-		memcpy(From + line_t, Mid, pitch);
-
-		line_s += pitch;
-		line_t -= pitch;
-
-	}
-
-	FreeImage_Aligned_Free(Mid);
+	const unsigned pitch  = FreeImage_GetPitch(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	BYTE *From = FreeImage_GetBits(src);
+
+	// swap pairs of lines in place, through a small buffer on each thread
+	FreeImage_ParallelFor(0, (int)(height / 2), MAX(1, 65536 / (int)pitch), [=](int first, int last) {
+		BYTE Mid[1024];
+		for (int y = first; y < last; y++) {
+			BYTE *line_s = From + y * pitch;
+			BYTE *line_t = From + (height - 1 - y) * pitch;
+			for (unsigned x = 0; x < pitch; x += sizeof(Mid)) {
+				const unsigned count = MIN((unsigned)sizeof(Mid), pitch - x);
+				memcpy(Mid, line_s + x, count);
+				memcpy(line_s + x, line_t + x, count);
+				memcpy(line_t + x, Mid, count);
+			}
+		}
+	});
 
 	return TRUE;
 }
@@ -0,0 +1,356 @@
+// ==========================================================
+// Mipmap chain generation
+//
+// Design and implementation by
+// - Andrew Baxter
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include <functional>
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//   sRGB conversion tables
+// ----------------------------------------------------------
+
+/**
+Lookup tables between 8-bit sRGB codes and linear light in [0, 1]
+*/
+class SRGBTables {
+public:
+	/// linear value of each code
+	float to_linear[256];
+	/// linear value halfway between each code and the next one
+	float midpoints[256];
+	/// the largest code whose lower midpoint is below i / 4095
+	BYTE from_linear[4096];
+
+	SRGBTables() {
+		for(int i = 0; i < 256; i++) {
+			to_linear[i] = decode(i / 255.0);
+			midpoints[i] = (i < 255) ? decode((i + 0.5) / 255.0) : 2.0f;
+		}
+		int code = 0;
+		for(int i = 0; i < 4096; i++) {
+			while(midpoints[code] <= i / 4095.0f) {
+				code++;
+			}
+			from_linear[i] = (BYTE)code;
+		}
+	}
+
+	/// Rounds a linear value to the nearest sRGB code
+	BYTE encode(float value) const {
+		value = CLAMP(value, 0.0f, 1.0f);
+		int code = from_linear[(int)(value * 4095)];
+		// the table gets within a code or two of the answer; the midpoints settle it
+		while(value >= midpoints[code]) {
+			code++;
+		}
+		return (BYTE)code;
+	}
+
+	/// The one copy of the tables, built on first use
+	static const SRGBTables& get() {
+		static const SRGBTables tables;
+		return tables;
+	}
+
+private:
+	static float decode(double c) {
+		return (float)((c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+	}
+};
+
+// ----------------------------------------------------------
+//   Filtering
+// ----------------------------------------------------------
+
+/**
+Source pixels and weights along one axis for one destination pixel.
+Halving an even line averages pairs; halving an odd line takes three pixels, weighted
+so that every source pixel contributes equally to the level as a whole.
+*/
+typedef struct tagMipTaps {
+	unsigned first;
+	unsigned count;
+	float weights[3];
+} MipTaps;
+
+static void
+GetMipTaps(unsigned src_size, unsigned index, MipTaps *taps) {
+	if(src_size == 1) {
+		taps->first = 0;
+		taps->count = 1;
+		taps->weights[0] = 1;
+	} else if((src_size & 1) == 0) {
+		taps->first = index * 2;
+		taps->count = 2;
+		taps->weights[0] = taps->weights[1] = 0.5f;
+	} else {
+		const float n = (float)(src_size / 2);
+		taps->first = index * 2;
+		taps->count = 3;
+		taps->weights[0] = (n - index) / src_size;
+		taps->weights[1] = n / src_size;
+		taps->weights[2] = (index + 1) / (float)src_size;
+	}
+}
+
+/**
+Derives one level from the one above it, both as 4 floats per pixel, top-down
+*/
+static void
+FilterLevel(const float *src, unsigned src_width, unsigned src_height, float *dst, unsigned dst_width, unsigned dst_height, BOOL normal_map) {
+	std::vector<MipTaps> x_taps(dst_width);
+	for(unsigned x = 0; x < dst_width; x++) {
+		GetMipTaps(src_width, x, &x_taps[x]);
+	}
+
+	FreeImage_ParallelFor(0, (int)dst_height, MAX(1, 4096 / (int)dst_width), [&](int first, int last) {
+		for(int y = first; y < last; y++) {
+			MipTaps y_taps;
+			GetMipTaps(src_height, y, &y_taps);
+			float *dst_bits = dst + (size_t)y * dst_width * 4;
+
+			for(unsigned x = 0; x < dst_width; x++, dst_bits += 4) {
+				const MipTaps &taps = x_taps[x];
+#ifdef FREEIMAGE_SSE2
+				__m128 sum = _mm_setzero_ps();
+				for(unsigned j = 0; j < y_taps.count; j++) {
+					const float *src_bits = src + ((size_t)(y_taps.first + j) * src_width + taps.first) * 4;
+					__m128 row = _mm_setzero_ps();
+					for(unsigned i = 0; i < taps.count; i++) {
+						row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(taps.weights[i]), _mm_loadu_ps(src_bits + i * 4)));
+					}
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(y_taps.weights[j]), row));
+				}
+				_mm_storeu_ps(dst_bits, sum);
+#else
+				float sum[4] = { 0, 0, 0, 0 };
+				for(unsigned j = 0; j < y_taps.count; j++) {
+					const float *src_bits = src + ((size_t)(y_taps.first + j) * src_width + taps.first) * 4;
+					for(unsigned i = 0; i < taps.count; i++) {
+						const float weight = y_taps.weights[j] * taps.weights[i];
+						for(int c = 0; c < 4; c++) {
+							sum[c] += weight * src_bits[i * 4 + c];
+						}
+					}
+				}
+				memcpy(dst_bits, sum, sizeof(sum));
+#endif
+				if(normal_map) {
+					// averaging unit vectors shortens them
+					const float length = sqrtf(dst_bits[0] * dst_bits[0] + dst_bits[1] * dst_bits[1] + dst_bits[2] * dst_bits[2]);
+					if(length > 0) {
+						dst_bits[0] /= length;
+						dst_bits[1] /= length;
+						dst_bits[2] /= length;
+					}
+				}
+			}
+		}
+	});
+}
+
+/**
+Finds the alpha a level's pixels need to pass the alpha test, so that as many of them pass as in the full size image
+*/
+static float
+GetCoverageThreshold(const float *pixels, size_t count, double coverage) {
+	const size_t passing = (size_t)(coverage * count + 0.5);
+	if(passing == 0) {
+		// out of reach of any alpha
+		return 2;
+	}
+	std::vector<float> alpha(count);
+	for(size_t i = 0; i < count; i++) {
+		alpha[i] = pixels[i * 4 + 3];
+	}
+	std::sort(alpha.begin(), alpha.end(), std::greater<float>());
+
+	// the alpha of the last pixel which should still pass; where it is shared with its 
+	// neighbours, either all of them pass or none do, whichever lands closer to the target
+	const float threshold = alpha[passing - 1];
+	const size_t with_ties = std::upper_bound(alpha.begin(), alpha.end(), threshold, std::greater<float>()) - alpha.begin();
+	const size_t without_ties = std::lower_bound(alpha.begin(), alpha.end(), threshold, std::greater<float>()) - alpha.begin();
+	if((without_ties > 0) && (passing - without_ties < with_ties - passing)) {
+		return alpha[without_ties - 1];
+	}
+	return threshold;
+}
+
+// ----------------------------------------------------------
+//   Main functions
+// ----------------------------------------------------------
+
+/**
+Number of levels in a full mipmap chain, from width x height down to 1 x 1
+*/
+unsigned DLL_CALLCONV
+FreeImage_GetMipmapCount(unsigned width, unsigned height) {
+	unsigned levels = 1;
+	for(unsigned size = MAX(width, height); size > 1; size >>= 1) {
+		levels++;
+	}
+	return levels;
+}
+
+/**
+Builds a mipmap chain in one block of memory, ready to be copied into a texture level by level.
+Each level is top-down R, G, B, A bytes, tightly packed, and directly follows the one above it.
+Pass bits = NULL to find out how much memory the chain needs.
+@param dib Source image, of any FIT_BITMAP bit depth
+@param bits Output buffer, or NULL
+@param levels Number of levels to build, including the full size one; 0 for the full chain
+@param flags FI_MIPMAP_DEFAULT, or a combination of FI_MIPMAP_LINEAR, FI_MIPMAP_ALPHA_COVERAGE and FI_MIPMAP_NORMAL_MAP
+@param alpha_ref The alpha test's reference value, for FI_MIPMAP_ALPHA_COVERAGE: pixels with alpha >= alpha_ref pass
+@param offsets If not NULL, receives the byte offset of each level
+@return Returns the size of the whole chain in bytes, or 0 if dib can't be used
+*/
+DWORD DLL_CALLCONV
+FreeImage_GenerateMipmaps(FIBITMAP *dib, BYTE *bits, unsigned levels, unsigned flags, BYTE alpha_ref, DWORD *offsets) {
+	if(!FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+		return 0;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned max_levels = FreeImage_GetMipmapCount(width, height);
+	if((levels == 0) || (levels > max_levels)) {
+		levels = max_levels;
+	}
+
+	// lay the levels out one after the other
+	DWORD size = 0;
+	for(unsigned level = 0; level < levels; level++) {
+		if(offsets) {
+			offsets[level] = size;
+		}
+		size += MAX(width >> level, 1U) * MAX(height >> level, 1U) * 4;
+	}
+	if(!bits) {
+		return size;
+	}
+
+	const BOOL normal_map = (flags & FI_MIPMAP_NORMAL_MAP) ? TRUE : FALSE;
+	const BOOL linear = (flags & (FI_MIPMAP_LINEAR | FI_MIPMAP_NORMAL_MAP)) ? TRUE : FALSE;
+	const BOOL keep_coverage = (flags & FI_MIPMAP_ALPHA_COVERAGE) ? TRUE : FALSE;
+	const SRGBTables &srgb = SRGBTables::get();
+
+	FIBITMAP *rgba = FreeImage_ConvertTo32Bits(dib);
+	if(!rgba) {
+		return 0;
+	}
+
+	// the full size level is the image itself, turned top-down into R, G, B, A bytes;
+	// every other level is filtered from the one above it, kept in floats so that errors don't add up
+	std::vector<float> src_level((levels > 1) ? (size_t)width * height * 4 : 0);
+	std::vector<float> dst_level;
+	size_t covered = 0;
+
+	FreeImage_ParallelFor(0, (int)height, MAX(1, 4096 / (int)width), [&](int first, int last) {
+		for(int y = first; y < last; y++) {
+			const BYTE *src_bits = FreeImage_GetScanLine(rgba, height - 1 - y);
+			BYTE *dst_bits = bits + (size_t)y * width * 4;
+
+			for(unsigned x = 0; x < width; x++, src_bits += 4, dst_bits += 4) {
+				dst_bits[0] = src_bits[FI_RGBA_RED];
+				dst_bits[1] = src_bits[FI_RGBA_GREEN];
+				dst_bits[2] = src_bits[FI_RGBA_BLUE];
+				dst_bits[3] = src_bits[FI_RGBA_ALPHA];
+			}
+			if(levels == 1) {
+				continue;
+			}
+
+			dst_bits = bits + (size_t)y * width * 4;
+			float *level_bits = &src_level[(size_t)y * width * 4];
+			for(unsigned x = 0; x < width; x++, dst_bits += 4, level_bits += 4) {
+				for(int c = 0; c < 3; c++) {
+					if(normal_map) {
+						level_bits[c] = dst_bits[c] / 127.5f - 1;
+					} else {
+						level_bits[c] = linear ? dst_bits[c] / 255.0f : srgb.to_linear[dst_bits[c]];
+					}
+				}
+				level_bits[3] = dst_bits[3] / 255.0f;
+			}
+		}
+	});
+	FreeImage_Unload(rgba);
+
+	if(keep_coverage) {
+		for(size_t i = 0; i < (size_t)width * height; i++) {
+			covered += (bits[i * 4 + 3] >= alpha_ref);
+		}
+	}
+	const double coverage = (double)covered / ((double)width * height);
+
+	unsigned src_width = width;
+	unsigned src_height = height;
+	BYTE *dst = bits;
+	for(unsigned level = 1; level < levels; level++) {
+		const unsigned dst_width = MAX(src_width / 2, 1U);
+		const unsigned dst_height = MAX(src_height / 2, 1U);
+		dst += src_width * src_height * 4;
+
+		dst_level.resize((size_t)dst_width * dst_height * 4);
+		FilterLevel(&src_level[0], src_width, src_height, &dst_level[0], dst_width, dst_height, normal_map);
+
+		// with FI_MIPMAP_ALPHA_COVERAGE, alpha is scaled to bring the threshold up (or down) to alpha_ref,
+		// and pixels right next to it are nudged to the correct side of it
+		const float threshold = keep_coverage ? GetCoverageThreshold(&dst_level[0], (size_t)dst_width * dst_height, coverage) : 0;
+		const float alpha_scale = (keep_coverage && (threshold > 0) && (threshold <= 1)) ? (alpha_ref / 255.0f) / threshold : 1;
+
+		// write the level out as bytes
+		FreeImage_ParallelFor(0, (int)dst_height, MAX(1, 4096 / (int)dst_width), [&](int first, int last) {
+			for(int y = first; y < last; y++) {
+				const float *level_bits = &dst_level[(size_t)y * dst_width * 4];
+				BYTE *dst_bits = dst + (size_t)y * dst_width * 4;
+
+				for(unsigned x = 0; x < dst_width; x++, level_bits += 4, dst_bits += 4) {
+					for(int c = 0; c < 3; c++) {
+						if(normal_map) {
+							dst_bits[c] = (BYTE)CLAMP((int)((level_bits[c] + 1) * 127.5f + 0.5f), 0, 0xFF);
+						} else if(linear) {
+							dst_bits[c] = (BYTE)CLAMP((int)(level_bits[c] * 255 + 0.5f), 0, 0xFF);
+						} else {
+							dst_bits[c] = srgb.encode(level_bits[c]);
+						}
+					}
+					int alpha = CLAMP((int)(level_bits[3] * alpha_scale * 255 + 0.5f), 0, 0xFF);
+					if(keep_coverage && (alpha_ref > 0)) {
+						alpha = (level_bits[3] >= threshold) ? MAX(alpha, (int)alpha_ref) : MIN(alpha, alpha_ref - 1);
+					}
+					dst_bits[3] = (BYTE)alpha;
+				}
+			}
+		});
+
+		src_level.swap(dst_level);
+		src_width = dst_width;
+		src_height = dst_height;
+	}
+
+	return size;
+}
@@ -23,6 +23,13 @@
 
 #include "Resize.h"
 
+#include <mutex>
+#include <typeinfo>
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
 /**
 Returns the color type of a bitmap. In contrast to FreeImage_GetColorType,
 this function optionally supports a boolean OUT parameter, that receives TRUE,
@@ -216,6 +223,15 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 		}
 
 	} // next dst pixel
+
+	// single precision copy for the SSE2 filters, zero padded so they can read 4 weights at a time
+	m_FloatStride = (m_WindowSize + 3) & ~3;
+	m_FloatWeights = (float*)calloc(m_LineLength * m_FloatStride, sizeof(float));
+	for(unsigned u = 0; u < m_LineLength; u++) {
+		for(unsigned i = m_WeightTable[u].Left; i < m_WeightTable[u].Right; i++) {
+			m_FloatWeights[u * m_FloatStride + i - m_WeightTable[u].Left] = (float)m_WeightTable[u].Weights[i - m_WeightTable[u].Left];
+		}
+	}
 }
 
 CWeightsTable::~CWeightsTable() {
@@ -225,8 +241,314 @@ CWeightsTable::~CWeightsTable() {
 	}
 	// free list of pixels contributions
 	free(m_WeightTable);
+	free(m_FloatWeights);
+}
+
+/**
+Returns the weights table for scaling a line of uSrcSize pixels to uDstSize pixels with pFilter.
+The most recently used tables are kept, so that scaling many images to the same size (thumbnails,
+mipmap chains, video frames) computes them only once. Filters are told apart by their class, their
+width and a couple of sampled values. Tables may be in use by several threads at once, so they
+must not be modified.
+*/
+static std::shared_ptr<CWeightsTable>
+GetWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize) {
+	typedef struct {
+		const std::type_info *type;
+		double width, probe[2];
+		unsigned dst_size, src_size;
+		std::shared_ptr<CWeightsTable> table;
+	} CacheEntry;
+
+	static const size_t max_entries = 8;
+	static std::mutex cache_mutex;
+	static std::list<CacheEntry> cache;
+
+	CacheEntry key;
+	key.type = &typeid(*pFilter);
+	key.width = pFilter->GetWidth();
+	key.probe[0] = pFilter->Filter(0.25);
+	key.probe[1] = pFilter->Filter(1.25);
+	key.dst_size = uDstSize;
+	key.src_size = uSrcSize;
+
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		for (std::list<CacheEntry>::iterator i = cache.begin(); i != cache.end(); ++i) {
+			if ((*i->type == *key.type) && (i->width == key.width) && (i->probe[0] == key.probe[0]) && (i->probe[1] == key.probe[1])
+				&& (i->dst_size == uDstSize) && (i->src_size == uSrcSize)) {
+				// move to the front, so the least recently used table is dropped first
+				cache.splice(cache.begin(), cache, i);
+				return cache.front().table;
+			}
+		}
+	}
+
+	// compute the table outside the lock, so other threads aren't held up
+	key.table = std::make_shared<CWeightsTable>(pFilter, uDstSize, uSrcSize);
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	cache.push_front(key);
+	if (cache.size() > max_entries) {
+		cache.pop_back();
+	}
+	return key.table;
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Describes how the SSE2 filters see a FIT_BITMAP or float image:
+as 'channels' interleaved samples per pixel, stored either as bytes or as floats.
+@return Returns FALSE if the SSE2 filters can't handle this source and destination pair
+*/
+static BOOL
+GetSSE2Layout(FIBITMAP *src, FIBITMAP *dst, const RGBQUAD *src_pal, unsigned *channels, BOOL *is_float) {
+	switch (FreeImage_GetImageType(src)) {
+		case FIT_BITMAP:
+			*is_float = FALSE;
+			if (FreeImage_GetBPP(src) != FreeImage_GetBPP(dst)) {
+				return FALSE;
+			}
+			switch (FreeImage_GetBPP(src)) {
+				case 8:
+					// palettes that aren't a linear grey ramp are left to the scalar filters
+					*channels = 1;
+					return (src_pal == NULL);
+				case 24:
+					*channels = 3;
+					return TRUE;
+				case 32:
+					*channels = 4;
+					return TRUE;
+			}
+			return FALSE;
+
+		case FIT_FLOAT:
+			*is_float = TRUE;
+			*channels = 1;
+			return TRUE;
+		case FIT_RGBF:
+			*is_float = TRUE;
+			*channels = 3;
+			return TRUE;
+		case FIT_RGBAF:
+			*is_float = TRUE;
+			*channels = 4;
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/**
+Converts a row of pixels into floats: one per pixel for single channel images,
+four per pixel (the last one 0 for three channel images) otherwise
+*/
+static void
+LoadLineSSE2(const BYTE *bits, unsigned count, unsigned channels, BOOL is_float, float *line) {
+	if (is_float) {
+		const float *src_bits = (const float*)bits;
+		if (channels == 1 || channels == 4) {
+			memcpy(line, src_bits, count * channels * sizeof(float));
+		} else {
+			for (unsigned x = 0; x < count; x++, src_bits += 3, line += 4) {
+				_mm_storeu_ps(line, _mm_setr_ps(src_bits[0], src_bits[1], src_bits[2], 0));
+			}
+		}
+		return;
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const unsigned samples = (channels == 3) ? count * 4 : count * channels;
+	unsigned i = 0;
+	if (channels != 3) {
+		// 16 bytes at a time
+		for (; i + 16 <= samples; i += 16) {
+			const __m128i bytes = _mm_loadu_si128((const __m128i*)(bits + i));
+			const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_ps(line + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+			_mm_storeu_ps(line + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+			_mm_storeu_ps(line + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+			_mm_storeu_ps(line + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+		}
+		for (; i < samples; i++) {
+			line[i] = (float)bits[i];
+		}
+	} else {
+		for (unsigned x = 0; x < count; x++, bits += 3, line += 4) {
+			_mm_storeu_ps(line, _mm_cvtepi32_ps(_mm_setr_epi32(bits[0], bits[1], bits[2], 0)));
+		}
+	}
 }
 
+/**
+Performs horizontal image filtering with SSE2, spreading rows over every hardware thread
+@return Returns FALSE if the image must go through CResizeEngine::horizontalFilter's scalar code
+*/
+static BOOL
+HorizontalFilterSSE2(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
+	unsigned channels;
+	BOOL is_float;
+	if (!GetSSE2Layout(src, dst, src_pal, &channels, &is_float)) {
+		return FALSE;
+	}
+	const unsigned src_offset = src_offset_x * channels * (is_float ? sizeof(float) : 1);
+
+	// a slice should be worth starting a thread for
+	const int min_rows = MAX(1, (1 << 16) / int(dst_width * channels));
+
+	FreeImage_ParallelFor(0, (int)height, min_rows, [&](int first, int last) {
+		// padded so that single channel rows can be read 4 pixels at a time
+		std::vector<float> line(((channels == 1) ? src_width + 4 : src_width * 4), 0.0f);
+
+		for (int y = first; y < last; y++) {
+			LoadLineSSE2(FreeImage_GetScanLine(src, y + src_offset_y) + src_offset, src_width, channels, is_float, &line[0]);
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+
+			for (unsigned x = 0; x < dst_width; x++) {
+				const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
+				const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
+				const float *weights = weightsTable.getFloatWeights(x);
+
+				if (channels == 1) {
+					// dot product of the weights with the neighboring pixels
+					const float *pixel = &line[iLeft];
+					__m128 sum = _mm_setzero_ps();
+					for (unsigned i = 0; i < iLimit; i += 4) {
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(weights + i), _mm_loadu_ps(pixel + i)));
+					}
+					sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+					sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+					const float value = _mm_cvtss_f32(sum);
+
+					if (is_float) {
+						((float*)dst_bits)[x] = value;
+					} else {
+						dst_bits[x] = (BYTE)CLAMP<int>((int)(value + 0.5f), 0, 0xFF);
+					}
+				} else {
+					// accumulate all channels of a pixel at once
+					const float *pixel = &line[iLeft * 4];
+					__m128 value = _mm_setzero_ps();
+					for (unsigned i = 0; i < iLimit; i++, pixel += 4) {
+						value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(pixel)));
+					}
+
+					if (is_float) {
+						float result[4];
+						_mm_storeu_ps(result, value);
+						memcpy(dst_bits + x * channels * sizeof(float), result, channels * sizeof(float));
+					} else {
+						// round, then clamp by saturating packs
+						__m128i result = _mm_cvttps_epi32(_mm_add_ps(value, _mm_set1_ps(0.5f)));
+						result = _mm_packs_epi32(result, result);
+						result = _mm_packus_epi16(result, result);
+						const DWORD packed = (DWORD)_mm_cvtsi128_si32(result);
+						memcpy(dst_bits + x * channels, &packed, channels);
+					}
+				}
+			}
+		}
+	});
+
+	return TRUE;
+}
+
+/**
+Performs vertical image filtering with SSE2. Since all pixels of a row share the same weights,
+whole rows are accumulated at once, whatever their layout, and destination rows are spread over
+every hardware thread.
+@return Returns FALSE if the image must go through CResizeEngine::verticalFilter's scalar code
+*/
+static BOOL
+VerticalFilterSSE2(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
+	unsigned channels;
+	BOOL is_float;
+	if (!GetSSE2Layout(src, dst, src_pal, &channels, &is_float)) {
+		return FALSE;
+	}
+	const unsigned samples = width * channels;
+	const unsigned sample_size = is_float ? sizeof(float) : 1;
+
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const BYTE *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * channels * sample_size;
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+	BYTE *const dst_base = FreeImage_GetBits(dst);
+
+	const int min_rows = MAX(1, (1 << 16) / int(samples));
+
+	FreeImage_ParallelFor(0, (int)dst_height, min_rows, [&](int first, int last) {
+		std::vector<float> sum(samples);
+
+		for (int y = first; y < last; y++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
+			const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
+			const float *weights = weightsTable.getFloatWeights(y);
+			float *acc = &sum[0];
+			std::fill(sum.begin(), sum.end(), 0.0f);
+
+			// accumulate weighted effect of each neighboring row
+			for (unsigned i = 0; i < iLimit; i++) {
+				const BYTE *src_bits = src_base + (iLeft + i) * src_pitch;
+				const float weight = weights[i];
+				const __m128 w = _mm_set1_ps(weight);
+				unsigned j = 0;
+
+				if (is_float) {
+					const float *src_float = (const float*)src_bits;
+					for (; j + 4 <= samples; j += 4) {
+						_mm_storeu_ps(acc + j, _mm_add_ps(_mm_loadu_ps(acc + j), _mm_mul_ps(w, _mm_loadu_ps(src_float + j))));
+					}
+					for (; j < samples; j++) {
+						acc[j] += weight * src_float[j];
+					}
+				} else {
+					const __m128i zero = _mm_setzero_si128();
+					for (; j + 16 <= samples; j += 16) {
+						const __m128i bytes = _mm_loadu_si128((const __m128i*)(src_bits + j));
+						const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+						const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+						_mm_storeu_ps(acc + j, _mm_add_ps(_mm_loadu_ps(acc + j), _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)))));
+						_mm_storeu_ps(acc + j + 4, _mm_add_ps(_mm_loadu_ps(acc + j + 4), _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)))));
+						_mm_storeu_ps(acc + j + 8, _mm_add_ps(_mm_loadu_ps(acc + j + 8), _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)))));
+						_mm_storeu_ps(acc + j + 12, _mm_add_ps(_mm_loadu_ps(acc + j + 12), _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)))));
+					}
+					for (; j < samples; j++) {
+						acc[j] += weight * (float)src_bits[j];
+					}
+				}
+			}
+
+			// place the row in the destination image
+			BYTE *dst_bits = dst_base + y * dst_pitch;
+			if (is_float) {
+				memcpy(dst_bits, acc, samples * sizeof(float));
+			} else {
+				const __m128 half = _mm_set1_ps(0.5f);
+				unsigned j = 0;
+				for (; j + 16 <= samples; j += 16) {
+					// round, then clamp by saturating packs
+					const __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(acc + j), half));
+					const __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(acc + j + 4), half));
+					const __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(acc + j + 8), half));
+					const __m128i d = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(acc + j + 12), half));
+					_mm_storeu_si128((__m128i*)(dst_bits + j), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+				}
+				for (; j < samples; j++) {
+					dst_bits[j] = (BYTE)CLAMP<int>((int)(acc[j] + 0.5f), 0, 0xFF);
+				}
+			}
+		}
+	});
+
+	return TRUE;
+}
+
+#endif // FREEIMAGE_SSE2
+
 // --------------------------------------------------------------------------
 
 FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags) {
@@ -234,6 +556,8 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 	const unsigned src_bpp = FreeImage_GetBPP(src);
 
+	m_bUseSIMD = ((flags & FI_RESCALE_NO_SIMD) != FI_RESCALE_NO_SIMD);
+
 	// determine the image's color type
 	BOOL bIsGreyscale = FALSE;
 	FREE_IMAGE_COLOR_TYPE color_type;
@@ -507,8 +831,15 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 
 void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
 
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_width, src_width);
+	// allocate and calculate the contributions, or reuse those of an earlier call
+	std::shared_ptr<CWeightsTable> table = GetWeightsTable(m_pFilter, dst_width, src_width);
+	CWeightsTable &weightsTable = *table;
+
+#ifdef FREEIMAGE_SSE2
+	if (m_bUseSIMD && HorizontalFilterSSE2(weightsTable, src, height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width)) {
+		return;
+	}
+#endif
 
 	// step through rows
 	switch(FreeImage_GetImageType(src)) {
@@ -980,7 +1311,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						// image has 565 format
 						for (unsigned y = 0; y < height; y++) {
 							// scale each row
-							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
 
 							for (unsigned x = 0; x < dst_width; x++) {
@@ -1124,11 +1455,11 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_UINT16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = FreeImage_GetBPP(src) / (8 * sizeof(WORD));
 
 			for (unsigned y = 0; y < height; y++) {
 				// scale each row
-				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * wordspp;
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
 
 				for (unsigned x = 0; x < dst_width; x++) {
@@ -1158,11 +1489,11 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGB16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = FreeImage_GetBPP(src) / (8 * sizeof(WORD));
 
 			for (unsigned y = 0; y < height; y++) {
 				// scale each row
-				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * wordspp;
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
 
 				for (unsigned x = 0; x < dst_width; x++) {
@@ -1196,11 +1527,11 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGBA16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = FreeImage_GetBPP(src) / (8 * sizeof(WORD));
 
 			for (unsigned y = 0; y < height; y++) {
 				// scale each row
-				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * wordspp;
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
 
 				for (unsigned x = 0; x < dst_width; x++) {
@@ -1238,11 +1569,11 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGBAF:
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / src_width) / sizeof(float);
+			const unsigned floatspp = FreeImage_GetBPP(src) / (8 * sizeof(float));
 
 			for(unsigned y = 0; y < height; y++) {
 				// scale each row
-				const float *src_bits = (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(float);
+				const float *src_bits = (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * floatspp;
 				float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
 
 				for(unsigned x = 0; x < dst_width; x++) {
@@ -1278,8 +1609,15 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 /// Performs vertical image filtering
 void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
 
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_height, src_height);
+	// allocate and calculate the contributions, or reuse those of an earlier call
+	std::shared_ptr<CWeightsTable> table = GetWeightsTable(m_pFilter, dst_height, src_height);
+	CWeightsTable &weightsTable = *table;
+
+#ifdef FREEIMAGE_SSE2
+	if (m_bUseSIMD && VerticalFilterSSE2(weightsTable, src, width, src_offset_x, src_offset_y, src_pal, dst, dst_height)) {
+		return;
+	}
+#endif
 
 	// step through columns
 	switch(FreeImage_GetImageType(src)) {
@@ -1935,7 +2273,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_UINT16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = FreeImage_GetBPP(src) / (8 * sizeof(WORD));
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -1976,7 +2314,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGB16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = FreeImage_GetBPP(src) / (8 * sizeof(WORD));
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -2022,7 +2360,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGBA16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = FreeImage_GetBPP(src) / (8 * sizeof(WORD));
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -2072,7 +2410,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGBAF:
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / width) / sizeof(float);
+			const unsigned floatspp = FreeImage_GetBPP(src) / (8 * sizeof(float));
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(float);
 			float *const dst_base = (float *)FreeImage_GetBits(dst);
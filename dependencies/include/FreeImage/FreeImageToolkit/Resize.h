@@ -52,6 +52,10 @@ private:
 	unsigned m_WindowSize;
 	/// Length of line (no. of rows / cols) 
 	unsigned m_LineLength;
+	/// The same weights as floats, zero padded to m_FloatStride per destination pixel 
+	float *m_FloatWeights;
+	/// Window size rounded up to a multiple of 4 
+	unsigned m_FloatStride;
 
 public:
 	/** 
@@ -93,6 +97,16 @@ public:
 	unsigned getRightBoundary(unsigned dst_pos) {
 		return m_WeightTable[dst_pos].Right;
 	}
+
+	/** Retrieve all filter weights of a destination position, as floats.
+	There are at least getRightBoundary - getLeftBoundary of them, followed by 
+	zeros up to the next multiple of 4.
+	@param dst_pos Pixel position in destination line buffer
+	@return Returns the filter weights, starting at the left boundary
+	*/
+	const float* getFloatWeights(unsigned dst_pos) const {
+		return m_FloatWeights + dst_pos * m_FloatStride;
+	}
 };
 
 // ---------------------------------------------
@@ -102,7 +116,10 @@ public:
  This class performs filtered zoom. It scales an image to the desired dimensions with 
  any of the CGenericFilter derived filter class.<br>
  It works with FIT_BITMAP buffers, WORD buffers (FIT_UINT16, FIT_RGB16, FIT_RGBA16) 
- and float buffers (FIT_FLOAT, FIT_RGBF, FIT_RGBAF).<br><br>
+ and float buffers (FIT_FLOAT, FIT_RGBF, FIT_RGBAF).<br>
+ Where SSE2 is available, 8-bit greyscale, 24- and 32-bit images and float buffers are 
+ filtered in single precision, four samples at a time, with rows spread over every 
+ hardware thread. Weights tables are shared by calls with the same filter and sizes.<br><br>
 
  <b>References</b> : <br>
  [1] Paul Heckbert, C code to zoom raster images up or down, with nice filtering. 
@@ -117,13 +134,16 @@ private:
 	/// Pointer to the FIR / IIR filter
 	CGenericFilter* m_pFilter;
 
+	/// FALSE if FI_RESCALE_NO_SIMD was given, so every image goes through the scalar filters
+	BOOL m_bUseSIMD;
+
 public:
 
 	/**
 	Constructor
 	@param filter FIR /IIR filter to be used
 	*/
-	CResizeEngine(CGenericFilter* filter):m_pFilter(filter) {}
+	CResizeEngine(CGenericFilter* filter):m_pFilter(filter), m_bUseSIMD(TRUE) {}
 
 	/// Destructor
 	virtual ~CResizeEngine() {}
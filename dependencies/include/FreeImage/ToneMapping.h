@@ -41,4 +41,127 @@ FIBITMAP* ClampConvertRGBFTo24(FIBITMAP *src);
 }
 #endif
 
+// ----------------------------------------------------------
+//   Helpers for the threaded passes (include Utilities.h first)
+// ----------------------------------------------------------
+
+/**
+Rows given to each thread at least, so that small images stay on the calling thread
+*/
+inline int
+ToneMappingMinRows(unsigned width) {
+	return MAX(1, 4096 / (int)MAX(width, 1U));
+}
+
+#ifdef FREEIMAGE_SSE2
+
+#include <emmintrin.h>
+
+/**
+Natural logarithm of four floats, within 2 ulp of logf (Cephes polynomial).
+Values below the smallest normal float, zero and negative values included, are clamped to it.
+*/
+inline __m128
+TMO_Log(__m128 x) {
+	const __m128 one = _mm_set1_ps(1.0F);
+	x = _mm_max_ps(x, _mm_set1_ps(FLT_MIN));
+
+	// split x into a mantissa in [sqrt(0.5), sqrt(2)) and an exponent
+	__m128i exponent = _mm_srli_epi32(_mm_castps_si128(x), 23);
+	x = _mm_or_ps(_mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x007FFFFF))), _mm_set1_ps(0.5F));
+	__m128 e = _mm_add_ps(_mm_cvtepi32_ps(_mm_sub_epi32(exponent, _mm_set1_epi32(0x7F))), one);
+	const __m128 small = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524F));
+	e = _mm_sub_ps(e, _mm_and_ps(one, small));
+	x = _mm_add_ps(_mm_sub_ps(x, one), _mm_and_ps(x, small));
+
+	// log(1 + x) on [sqrt(0.5) - 1, sqrt(2) - 1)
+	const __m128 z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(7.0376836292E-2F);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1F));
+	y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+	y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440E-4F)));
+	y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5F)));
+	return _mm_add_ps(_mm_add_ps(x, y), _mm_mul_ps(e, _mm_set1_ps(0.693359375F)));
+}
+
+/**
+Exponential of four floats, within 2 ulp of expf (Cephes polynomial).
+Arguments are clamped to [-88.37, 88.37].
+*/
+inline __m128
+TMO_Exp(__m128 x) {
+	const __m128 one = _mm_set1_ps(1.0F);
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-88.3762626647949F)), _mm_set1_ps(88.3762626647949F));
+
+	// x = n * log(2) + r, with n = round(x / log(2))
+	__m128 n = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341F)), _mm_set1_ps(0.5F));
+	const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(n));
+	n = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, n), one));
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375F)));
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440E-4F)));
+
+	// exp(r)
+	const __m128 z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(1.9875691500E-4F);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1F));
+	y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), one);
+
+	// times 2^n
+	const __m128i pow2n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(0x7F)), 23);
+	return _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+}
+
+/**
+x to the power y, for x > 0; other values of x are taken as the smallest normal float
+*/
+inline __m128
+TMO_Pow(__m128 x, __m128 y) {
+	return TMO_Exp(_mm_mul_ps(y, TMO_Log(x)));
+}
+
+/**
+Loads four FIRGBF pixels as one register per channel
+*/
+inline void
+TMO_LoadRGB(const float *pixel, __m128 &red, __m128 &green, __m128 &blue) {
+	const __m128 a = _mm_loadu_ps(pixel);		// r0 g0 b0 r1
+	const __m128 b = _mm_loadu_ps(pixel + 4);	// g1 b1 r2 g2
+	const __m128 c = _mm_loadu_ps(pixel + 8);	// b2 r3 g3 b3
+	red   = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	green = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	blue  = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+Stores one register per channel as four FIRGBF pixels
+*/
+inline void
+TMO_StoreRGB(float *pixel, __m128 red, __m128 green, __m128 blue) {
+	_mm_storeu_ps(pixel,     _mm_shuffle_ps(_mm_shuffle_ps(red, green, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(blue, red, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(pixel + 4, _mm_shuffle_ps(_mm_shuffle_ps(green, blue, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(red, green, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(pixel + 8, _mm_shuffle_ps(_mm_shuffle_ps(blue, red, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(green, blue, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+/**
+Sum of four floats, added in double precision
+*/
+inline double
+TMO_SumToDouble(__m128 x) {
+	const __m128d sum = _mm_add_pd(_mm_cvtps_pd(x), _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+	return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+#endif // FREEIMAGE_SSE2
+
 #endif // TONE_MAPPING_H
@@ -12,7 +12,6 @@ Includes universally-required headers and defines some rudimentary functions
 
 #include <stdint.h>
 #include <array>
-#include <queue>
 #include <vector>
 #include <algorithm>
 #include <string>
@@ -31,10 +30,81 @@ Includes universally-required headers and defines some rudimentary functions
 
 namespace Basilisk
 {
-	extern std::queue<std::string> errors;
-	extern std::queue<std::string> warnings;
+	enum class Severity : uint8_t
+	{
+		Info,
+		Warning,
+		Error
+	};
+
+	/**
+	\brief One entry in the engine log
+	Fixed-size, so reporting a failure never allocates
+	*/
+	struct LogRecord
+	{
+		uint64_t timestamp; //Nanoseconds since the first message was logged
+		uint32_t messageId; //From `InternMessage()`
+		VkResult code; //`VK_SUCCESS` if the failure didn't come from Vulkan
+		uint32_t detail; //Replaces the first %u in the message, if there is one
+		uint32_t thread; //Small per-thread index, in order of each thread's first message
+		Severity severity;
+	};
+
+	/**
+	\brief Registers a message so records can refer to it by index
+	Called once per call site, through the `BASILISK_LOG` macros
+
+	\param[in] message The text to register. Must point to static storage.
+	\return The message's index
+	*/
+	uint32_t InternMessage(const char *message);
+	/**
+	\return The text registered under `messageId`, or `nullptr` if there is none
+	*/
+	const char *MessageText(uint32_t messageId);
+
+	/**
+	\brief Adds a record to the log
+	Lock-free, and safe to call from any thread. If the log is full, the record is dropped and counted.
+	*/
+	void Log(Severity severity, uint32_t messageId, VkResult code = VK_SUCCESS, uint32_t detail = 0);
+
+	/**
+	\brief Removes the oldest record from the log
+
+	\param[out] record Where to store the record
+	\return If a record was available, `true`. If the log is empty, `false`.
+	*/
+	bool PopLog(LogRecord &record);
+	/**
+	\return How many records have been dropped because the log was full, since the last call
+	*/
+	uint32_t TakeDroppedLogCount();
+
+	/**
+	Converts a record to a single line of text, such as "[Error] Vulkan::Initialize() could not create a Vulkan Instance (VkResult -3) on thread 0 at 1.250ms"
+	*/
+	std::string FormatLog(const LogRecord &record);
+
+	/**
+	\brief Empties the log into a file, one line per record
+
+	\param[in] filename The file to append to
+	\return If successful, `true`. If the file could not be opened, `false`, and the log is left untouched.
+	*/
+	bool DrainLogToFile(const std::string &filename);
 }
 
+//Interns the message the first time this call site fails, so the success path is untouched
+#define BASILISK_LOG(severity, message, code, detail) \
+	do { static const uint32_t basiliskMessageId = Basilisk::InternMessage(message); Basilisk::Log(severity, basiliskMessageId, code, detail); } while (0)
+
+#define BASILISK_ERROR(message) BASILISK_LOG(Basilisk::Severity::Error, message, VK_SUCCESS, 0)
+#define BASILISK_ERROR_CODE(message, code) BASILISK_LOG(Basilisk::Severity::Error, message, code, 0)
+#define BASILISK_WARNING(message) BASILISK_LOG(Basilisk::Severity::Warning, message, VK_SUCCESS, 0)
+#define BASILISK_WARNING_DETAIL(message, detail) BASILISK_LOG(Basilisk::Severity::Warning, message, VK_SUCCESS, detail)
+
 //Check Vulkan error codes
 
 inline bool Succeeded(VkResult val) {
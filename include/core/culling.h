@@ -0,0 +1,115 @@
+/**
+\file culling.h
+\author Andrew Baxter
+\date April 4, 2016
+
+Decides which objects each view can see, so nothing off-screen is drawn
+
+*/
+
+#ifndef BASILISK_CULLING_H
+#define BASILISK_CULLING_H
+
+#include "common.h"
+#include "core/task_graph.h"
+
+namespace Basilisk
+{
+	/**
+	Six inward-facing planes, as (normal, distance) with unit normals
+	A point `p` is inside a plane when `dot(plane.xyz, p) + plane.w >= 0`
+	*/
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+
+		/**
+		Extracts the planes of a view-projection matrix, using Vulkan's [0, 1] depth range
+		*/
+		static Frustum FromMatrix(const glm::mat4 &viewProjection);
+	};
+
+	/**
+	\brief Tests an array of bounding spheres against a frustum, four at a time, without any hierarchy
+
+	\param[in] x,y,z,radius The spheres, as separate arrays of `count` floats
+	\param[out] visible The indices of every sphere at least partly inside the frustum are appended here
+	*/
+	void CullSpheres(const Frustum &frustum, const float *x, const float *y, const float *z, const float *radius, uint32_t count, std::vector<uint32_t> &visible);
+
+	/**
+	\brief A bounding volume hierarchy over axis-aligned boxes, built for frustum culling
+
+	Every node holds the bounds of its four children as separate arrays, so one node is tested against a plane in a single SSE pass.
+	Each child covers a contiguous range of objects, so a child entirely inside the frustum is accepted without visiting its descendants,
+	and leaves hold up to four objects, which are tested four at a time as well.
+	Objects which move can be handled with `Refit()`, which keeps the tree's shape and only recomputes bounds.
+	*/
+	class CullingBVH
+	{
+	public:
+		CullingBVH() = default;
+		~CullingBVH() = default;
+
+		/**
+		\brief Builds the tree from scratch, splitting at the median along the longest axis
+
+		\param[in] mins,maxs The corners of each object's box, indexed the same way as the results of `Cull()`
+		*/
+		void Build(const glm::vec3 *mins, const glm::vec3 *maxs, uint32_t count);
+
+		/**
+		\brief Updates every box without changing the tree's shape
+		Cheaper than `Build()`, but culls less well as objects drift from where they were built
+
+		\param[in] mins,maxs Must be indexed the same way, and have the same size, as those given to `Build()`
+		*/
+		void Refit(const glm::vec3 *mins, const glm::vec3 *maxs);
+
+		/**
+		\brief Finds the objects which are at least partly inside a frustum
+		Safe to call from several threads at once
+
+		\param[out] visible Cleared, then filled with the index of each visible object. Neighbouring objects tend to be next to each other.
+		*/
+		void Cull(const Frustum &frustum, std::vector<uint32_t> &visible) const;
+
+		/**
+		\brief Adds one task per view to `graph`, each culling into its own list
+		Nothing may rebuild or refit the tree, or touch `views` or `visible`, until the graph has executed
+
+		\param[out] visible Resized to one list per view
+		\return The tasks that were added, so drawing can depend on them
+		*/
+		std::vector<TaskId> Cull(TaskGraph &graph, const std::vector<Frustum> &views, std::vector< std::vector<uint32_t> > &visible) const;
+
+		inline uint32_t NumObjects() const {
+			return static_cast<uint32_t>(m_order.size());
+		}
+		inline size_t NumNodes() const {
+			return m_nodes.size();
+		}
+
+	private:
+		struct Node
+		{
+			float minX[4], minY[4], minZ[4];
+			float maxX[4], maxY[4], maxZ[4];
+			uint32_t child[4]; //Index of a child node, or 0xFFFFFFFF if the child holds objects directly
+			uint32_t first[4]; //The child's objects, as a range of slots
+			uint32_t count[4]; //0 if the child is unused
+		};
+
+		uint32_t BuildNode(uint32_t begin, uint32_t end, const std::vector<glm::vec3> &centers);
+		void RefitNodes();
+
+		std::vector<Node> m_nodes; //Parents always come before their children
+		std::vector<uint32_t> m_order; //The object in each slot
+
+		//Object bounds in slot order, padded so four can be loaded from any slot
+		std::vector<float> m_minX, m_minY, m_minZ;
+		std::vector<float> m_maxX, m_maxY, m_maxZ;
+	};
+}
+
+#endif
@@ -7,71 +7,154 @@ Distributes tasks among an arbitrary number of persistent threads
 
 */
 
-
+#ifndef BASILISK_TASK_GRAPH_H
+#define BASILISK_TASK_GRAPH_H
 
 #include "common.h"
 #include <thread>
-#include <future>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace Basilisk
+{
+	typedef uint32_t TaskId;
+	constexpr TaskId invalidTask = 0xFFFFFFFF;
+
+	/**
+	\brief A fixed-capacity Chase-Lev work-stealing deque of task indices
+
+	Only the owning thread may call `Push()` and `Pop()`, which operate on the bottom of the deque.
+	Any thread may call `Steal()`, which takes from the top.
+	Capacity is set before a run begins and never grows, since the task graph knows exactly how many tasks can be in flight.
+	*/
+	class WorkQueue
+	{
+	public:
+		WorkQueue();
+		~WorkQueue() = default;
+
+		/**
+		Empties the deque and makes sure it can hold at least `capacity` entries
+		Must not be called while any thread is using the deque
+		*/
+		void Reset(uint32_t capacity);
+
+		void Push(TaskId task);
+		bool Pop(TaskId *task);
+		bool Steal(TaskId *task);
+
+	private:
+		std::unique_ptr<std::atomic<TaskId>[]> m_buffer;
+		uint32_t m_mask;
+
+		//Padded onto separate cache lines so thieves don't thrash the owner
+		std::atomic<int64_t> m_top;
+		char m_padding[64];
+		std::atomic<int64_t> m_bottom;
+	};
+
+	/**
+	\brief Schedules and executes a graph of dependent tasks among a set number of persistent threads
+
+	Tasks are added along with the tasks they depend on, then `Execute()` runs the whole graph.
+	The graph is kept afterwards, so per-frame work can be built once and executed every frame.
+	When a task finishes, the first successor it makes ready is run immediately on the same thread as a continuation;
+	any others are pushed to that thread's deque, where idle threads can steal them.
+
+	Cannot be exported to a DLL since members of the `std` namespace have to be passed as parameters
+	*/
+	class TaskGraph
+	{
+	public:
+		/**
+		Starts the worker threads
+
+		\param[in] numThreads How many threads execute tasks, including the one that calls `Execute()`. 0 uses one per hardware thread.
+		*/
+		TaskGraph(size_t numThreads = 0);
+		~TaskGraph();
+
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph &operator=(const TaskGraph&) = delete;
+
+		/**
+		\brief Add a task to the graph
+		Tasks are not scheduled until `Execute()` is called, and must not be added while it is running
+
+		\param[in] task The work to perform
+		\param[in] predecessors Tasks which must complete before this one may start
+		\return An identifier for the new task, or `invalidTask` if a predecessor does not exist
+		*/
+		TaskId Add(std::function<void(void)> task, const std::vector<TaskId> &predecessors = {});
+
+		/**
+		\brief Add a task which becomes ready as soon as `predecessor` finishes
+
+		The thread that finished `predecessor` goes straight on to the first successor it readies, without a trip
+		through its queue. If `predecessor` readies several, the others are pushed to that thread's queue instead,
+		where any thread may steal them, so this task is only guaranteed to follow on directly if it is the sole successor.
+
+		\param[in] predecessor The task to continue from
+		\param[in] task The work to perform
+		\return An identifier for the new task, or `invalidTask` if `predecessor` does not exist
+		*/
+		TaskId Continue(TaskId predecessor, std::function<void(void)> task);
+
+		/**
+		\brief Make `after` wait on `before`
+
+		\return If both tasks exist and are distinct, `true`. Otherwise, `false`.
+		*/
+		bool Precede(TaskId before, TaskId after);
+
+		/**
+		\brief Run every task in the graph, respecting dependencies
+		The calling thread participates, and returns once every task has completed.
+
+		\return If the graph was acyclic and executed, `true`. If it contains a cycle, `false`.
+		*/
+		bool Execute();
+
+		/**
+		Removes every task from the graph
+		Must not be called from within a task
+		*/
+		void Clear();
+
+		inline size_t NumThreads() const {
+			return m_queues.size();
+		}
+		inline size_t NumTasks() const {
+			return m_work.size();
+		}
+
+	private:
+		void WorkerFunction(uint32_t index);
+		void RunUntilDone(uint32_t index);
+		void RunTask(uint32_t index, TaskId task);
+		bool Steal(uint32_t thief, TaskId *task);
+		bool SortTasks();
+
+		//Task data, indexed by TaskId
+		std::vector< std::function<void(void)> > m_work;
+		std::vector< std::vector<TaskId> > m_successors;
+		std::vector<uint32_t> m_numPredecessors;
+		std::unique_ptr<std::atomic<uint32_t>[]> m_pending;
+		std::vector<TaskId> m_roots;
+
+		//One deque per thread; the calling thread owns index 0
+		std::vector< std::unique_ptr<WorkQueue> > m_queues;
+		std::vector<std::thread> m_workers;
+
+		std::atomic<uint32_t> m_remaining;
+		std::atomic<uint32_t> m_busyWorkers;
 
+		std::mutex m_wakeLock;
+		std::condition_variable m_wake;
+		uint64_t m_generation;
+		bool m_terminate;
+	};
+}
 
-//namespace Basilisk
-//{
-//
-//	/**
-//	\brief Schedules and executes tasks among a set number of threads
-//
-//	Cannot be exported to a DLL since members of the `std` namespace have to be passed as parameters
-//	*/
-//	class TaskGraph
-//	{
-//	public:
-//		TaskGraph(size_t numThreads);
-//		~TaskGraph();
-//
-//		/**
-//		\brief Add a task to the graph
-//		Tasks are not sorted until `Execute()` is called
-//
-//		\template ResultType The return type of the provided task
-//		\param[in]task The task to complete
-//
-//		\return A `std::future`
-//		*/
-//		template<typename ResultType>
-//			const std::future<ResultType>&
-//			Add(std::packaged_task<ResultType(void)> &task);
-//
-//		void Add(std::packaged_task<void(void)> &task);
-//
-//		/**
-//		\brief Launch the threads
-//		If they are already launched, nothing happens
-//
-//		*/
-//		void Launch();
-//		/**
-//
-//		*/
-//		bool Clear();
-//		/**
-//
-//		*/
-//		bool Reset();
-//		/**
-//		Wait for all worker threads to finish
-//		*/
-//		void Join();
-//	private:
-//		void WorkerFunction();
-//		bool SortTasks();
-//		bool StartWorkers();
-//
-//
-//		std::vector< std::packaged_task<void(void)>& > m_tasks;
-//		std::mutex m_tasksLock;
-//		std::atomic<bool> m_terminate;
-//
-//		std::thread *m_workers;
-//	};
-//}
\ No newline at end of file
+#endif
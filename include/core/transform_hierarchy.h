@@ -0,0 +1,122 @@
+/**
+\file transform_hierarchy.h
+\author Andrew Baxter
+\date April 2, 2016
+
+Stores every transform in a scene, and batches the update of their world matrices
+
+*/
+
+#ifndef BASILISK_TRANSFORM_HIERARCHY_H
+#define BASILISK_TRANSFORM_HIERARCHY_H
+
+#include "common.h"
+#include <glm/glm/gtc/quaternion.hpp>
+
+namespace Basilisk
+{
+	typedef uint32_t TransformId;
+	constexpr TransformId invalidTransform = 0xFFFFFFFF;
+
+	/**
+	\brief A forest of transforms, each with a position, rotation and scale relative to its parent
+
+	Transforms are kept in depth-first order, so every parent precedes its children and every subtree is one contiguous range.
+	Local position, rotation and scale are stored as separate arrays of floats, and `Update()` turns four of them at a time
+	into matrices with SSE before multiplying each by its parent's world matrix in a single forward pass.
+
+	Changing a transform marks it dirty, and `Update()` only recomputes the subtrees under dirty transforms,
+	so transforms which never move cost nothing per frame.
+	Structural changes (adding, removing or reparenting) are cheap until the next `Update()`, which restores depth-first
+	order in one linear pass and then recomputes everything.
+	*/
+	class TransformHierarchy
+	{
+	public:
+		TransformHierarchy();
+		~TransformHierarchy() = default;
+
+		/**
+		\brief Adds a transform
+		Its world matrix is valid after the next `Update()`
+
+		\param[in] parent The transform this one is relative to, or `invalidTransform` for a root
+		\return An identifier for the new transform, or `invalidTransform` if `parent` does not exist
+		*/
+		TransformId Add(TransformId parent = invalidTransform, const glm::vec3 &position = glm::vec3(0.0f),
+			const glm::quat &rotation = glm::quat(), const glm::vec3 &scale = glm::vec3(1.0f));
+		/**
+		\brief Removes a transform along with all of its descendants
+
+		\return If `id` existed, `true`. Otherwise, `false`.
+		*/
+		bool Remove(TransformId id);
+		/**
+		\brief Moves a transform, along with its descendants, under a new parent
+		Keeps its local position, rotation and scale
+
+		\param[in] parent The new parent, or `invalidTransform` to make it a root
+		\return If both exist and `parent` is not a descendant of `id`, `true`. Otherwise, `false`.
+		*/
+		bool SetParent(TransformId id, TransformId parent);
+		TransformId GetParent(TransformId id) const;
+
+		bool SetLocal(TransformId id, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+		bool SetPosition(TransformId id, const glm::vec3 &position);
+		bool SetRotation(TransformId id, const glm::quat &rotation);
+		bool SetScale(TransformId id, const glm::vec3 &scale);
+
+		glm::vec3 GetPosition(TransformId id) const;
+		glm::quat GetRotation(TransformId id) const;
+		glm::vec3 GetScale(TransformId id) const;
+		/**
+		\return The transform's world matrix as of the last `Update()`, or identity if it does not exist
+		*/
+		const glm::mat4 &GetWorld(TransformId id) const;
+
+		/**
+		Recomputes the world matrix of every dirty transform and its descendants
+		*/
+		void Update();
+
+		bool Exists(TransformId id) const;
+		inline size_t Size() const {
+			return m_ids.size();
+		}
+
+		/**
+		\return World matrices in depth-first order, with `Size()` elements, as of the last `Update()`
+		*/
+		inline const glm::mat4 *Worlds() const {
+			return m_world.data();
+		}
+		/**
+		\return Where `id`'s world matrix is in `Worlds()`, or `invalidTransform` if it does not exist. Changed by structural edits.
+		*/
+		uint32_t IndexOf(TransformId id) const;
+
+	private:
+		void MarkDirty(uint32_t index);
+		void Reorder();
+		void UpdateRange(uint32_t begin, uint32_t end);
+
+		//Dense data, in depth-first order
+		std::vector<uint32_t> m_parent; //Index of the parent, or 0xFFFFFFFF for a root
+		std::vector<uint32_t> m_subtreeEnd; //One past the last descendant; only valid while `m_reorder` is false
+		std::vector<TransformId> m_ids;
+		std::vector<float> m_posX, m_posY, m_posZ;
+		std::vector<float> m_rotX, m_rotY, m_rotZ, m_rotW;
+		std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+		std::vector<glm::mat4> m_world;
+		std::vector<uint8_t> m_dirty;
+		std::vector<uint32_t> m_dirtyList; //Every index with its dirty flag set
+
+		//Maps stable identifiers to dense indices
+		std::vector<uint32_t> m_indexOf;
+		std::vector<TransformId> m_freeIds;
+
+		bool m_reorder; //Depth-first order was broken by a structural change
+	};
+}
+
+#endif
@@ -5,7 +5,10 @@
 
 Defines the `Profiler` class, which tracks performance across various parts of the engine
 
-\todo Finish writing
+Zones are opened with `BASILISK_PROFILE_ZONE("Name")` and close at the end of the enclosing scope.
+Each thread writes finished zones into its own ring buffer without locking or allocating;
+a background thread drains those buffers, builds a zone tree for every completed frame,
+and keeps the raw events for export to `chrome://tracing` or Perfetto.
 
 */
 
@@ -13,26 +16,122 @@ Defines the `Profiler` class, which tracks performance across various parts of t
 #define BASILISK_PROFILING_H
 
 #include "common.h"
-#include <chrono>
 
 namespace Basilisk
 {
-	/*class Profiler
+	/**
+	A single finished zone, as written by the thread that ran it
+	Frame boundaries are stored as events with a null `name`
+	*/
+	struct ProfileEvent
+	{
+		const char *name; //Must point to static storage, such as a string literal
+		uint64_t begin, end; //Nanoseconds, from `Profiler::Now()`
+		uint32_t depth; //How many zones enclosed this one on its thread
+		uint32_t thread; //Index of the recording thread's buffer, written when the event is recorded
+	};
+
+	/**
+	Time spent in one zone during one frame, merged across every call with the same name and parent
+	*/
+	struct ZoneNode
+	{
+		const char *name;
+		uint32_t thread;
+		uint32_t calls;
+		double milliseconds;
+		std::vector<ZoneNode> children;
+	};
+
+	/**
+	\brief Collects zones from every thread, and aggregates them per frame
+
+	All members are static, since there is exactly one timeline per process
+	*/
+	class Profiler
 	{
 	public:
-		Profiler();// :
-			//m_numInvocations(0),
-			//m_totalTime(0),
-			//m_startTime(0) {}
+		/**
+		Launches the background thread which drains each thread's events
+
+		\param[in] flushIntervalMs How long the background thread sleeps between passes
+		\return If the thread was launched, `true`. If it was already running, `false`.
+		*/
+		static bool Start(uint32_t flushIntervalMs = 10);
+		/**
+		Drains any remaining events, then stops the background thread
+		*/
+		static void Stop();
+
+		/**
+		Marks the boundary between two frames
+		Should be called once per frame, from the thread that drives the main loop
+		*/
+		static void NextFrame();
+
+		/**
+		Labels the calling thread in exported traces
+
+		\param[in] name The label to use. Must point to static storage.
+		*/
+		static void SetThreadName(const char *name);
+
+		/**
+		\brief Fetches the zone tree of a completed frame
+		Zones which were still open when the frame was aggregated are counted in the frame they closed in
+
+		\param[in] framesAgo 0 is the most recently completed frame
+		\param[out] roots One top-level node per zone with no parent, on every thread
+		\return If the frame is still in the history, `true`. Otherwise, `false`.
+		*/
+		static bool GetFrame(uint32_t framesAgo, std::vector<ZoneNode> &roots);
+
+		/**
+		Writes every retained event as a Chrome trace event JSON file, which Perfetto can also open
+
+		\param[in] filename Where to write the trace
+		\return If successful, `true`. If the file could not be written, `false`.
+		*/
+		static bool ExportChromeTrace(const std::string &filename);
+
+		/**
+		\return The current time, in nanoseconds
+		*/
+		static uint64_t Now();
+
+		//Used by `ProfileZone`
+		static uint64_t BeginZone();
+		static void EndZone(const char *name, uint64_t begin);
+	};
+
+	/**
+	Records a zone covering its own lifetime
+	Use through `BASILISK_PROFILE_ZONE` rather than directly
+	*/
+	class ProfileZone
+	{
+	public:
+		inline ProfileZone(const char *name) : m_name(name), m_begin(Profiler::BeginZone()) {}
+		inline ~ProfileZone() {
+			Profiler::EndZone(m_name, m_begin);
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone &operator=(const ProfileZone&) = delete;
 
-		void startBlock();
-		void endBlock();
 	private:
-		std::chrono::high_resolution_clock m_clock;
-		std::chrono::time_point<std::chrono::high_resolution_clock> m_startTime;
-		std::chrono::duration<double> m_totalTime;
-		unsigned long long m_numInvocations;
-	};*/
+		const char *m_name;
+		uint64_t m_begin;
+	};
 }
 
-#endif
\ No newline at end of file
+#define BASILISK_CONCAT_IMPL(a, b) a##b
+#define BASILISK_CONCAT(a, b) BASILISK_CONCAT_IMPL(a, b)
+
+#ifdef BASILISK_DISABLE_PROFILING
+#define BASILISK_PROFILE_ZONE(name)
+#else
+#define BASILISK_PROFILE_ZONE(name) Basilisk::ProfileZone BASILISK_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#endif
@@ -24,7 +24,7 @@ namespace Vulkan
 	constexpr uint32_t graphicsIndex = 0; //Index of graphics (render + present) queue
 
 	VkSwapchainCreateInfoKHR SwapChainCreateInfo(glm::tvec2<uint32_t> resolution, uint32_t numBuffers);
-	VkImageCreateInfo ImageCreateInfo(VkImageType dimensionality, VkFormat format, VkExtent3D resolution, VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	VkImageCreateInfo ImageCreateInfo(VkImageType dimensionality, VkFormat format, VkExtent3D resolution, VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, uint32_t mipLevels = 1);
 	VkImageViewCreateInfo ImageViewCreateInfo(VkImage image, VkFormat format, VkImageAspectFlags aspect);
 	VkAttachmentDescription AttachmentDescription(VkFormat format, VkAttachmentLoadOp loadOp);
 
@@ -62,6 +62,16 @@ namespace Vulkan
 		VkShaderStageFlagBits visibility;
 	};
 
+	/**
+	Where one object's indices live in the bound index and vertex buffers
+	*/
+	struct IndexedDraw
+	{
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+	};
+
 	class SwapChain
 	{
 	public:
@@ -248,6 +258,15 @@ namespace Vulkan
 
 		void DrawIndexed(uint32_t count);
 
+		/**
+		\brief Draws only the objects in `visible`, such as the output of `Basilisk::CullingBVH::Cull()`
+		Each object's index is passed as its first instance, so shaders can look up per-object data with it
+
+		\param[in] draws Every object's draw, indexed by object
+		\param[in] visible The objects to draw
+		*/
+		void DrawIndexed(const std::vector<IndexedDraw> &draws, const std::vector<uint32_t> &visible);
+
 		void SetLineWidth(float width);
 
 		void SetViewport(const VkViewport &viewport);
@@ -333,6 +352,16 @@ namespace Vulkan
 		*/
 		template<typename T>
 		std::shared_ptr<Buffer> CreateBuffer(VkBufferUsageFlags usage, const std::vector<T> &data, bool staged);
+		/**
+		Creates a buffer from an array which isn't held in a vector, such as the vertex or index blob of a cooked `Basilisk::Mesh`
+
+		\param[in] data The initial data stored in the buffer
+		\param[in] count How many elements of `data` to store
+		\param[in] staged If true, makes the memory faster accessed, but read-only and only visible on the GPU
+		\return If successful, a pointer to the resulting buffer. If failed, `nullptr`.
+		*/
+		template<typename T>
+		std::shared_ptr<Buffer> CreateBuffer(VkBufferUsageFlags usage, const T *data, size_t count, bool staged);
 		
 		/**
 		Creates a graphics pipeline
@@ -522,7 +551,13 @@ namespace Vulkan
 	template<typename T>
 	std::shared_ptr<Buffer> Device::CreateBuffer(VkBufferUsageFlags usage, const std::vector<T> &data, bool staged)
 	{
-		uint32_t buff_size = static_cast<uint32_t>(sizeof(T) * data.size());
+		return CreateBuffer(usage, data.data(), data.size(), staged);
+	}
+
+	template<typename T>
+	std::shared_ptr<Buffer> Device::CreateBuffer(VkBufferUsageFlags usage, const T *data, size_t count, bool staged)
+	{
+		uint32_t buff_size = static_cast<uint32_t>(sizeof(T) * count);
 		VkMemoryAllocateInfo mem_alloc = {
 			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO
 		};
@@ -550,7 +585,7 @@ namespace Vulkan
 		);
 		
 		
-		if (stage)
+		if (staged)
 		{
 			//Create intermediate buffer
 			std::unique_ptr<Buffer> intermediate(new Buffer, 
@@ -567,7 +602,7 @@ namespace Vulkan
 			res = vkCreateBuffer(m_device, &buffer_info, nullptr, &intermediate->m_buffer);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not create the intermediate buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not create the intermediate buffer", res);
 				return nullptr;
 			}
 			vkGetBufferMemoryRequirements(m_device, &intermediate->m_buffer, mem_reqs);
@@ -575,13 +610,13 @@ namespace Vulkan
 			mem_alloc.allocationSize = mem_reqs.size();
 			if (!GetMemoryTypeFromProps(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &mem_alloc.memoryTypeIndex))
 			{
-				Basilisk.errors.push("Vulkan::Device::CreateBuffer() could not determine required memory type for the intermediate buffer");
+				BASILISK_ERROR("Vulkan::Device::CreateBuffer() could not determine required memory type for the intermediate buffer");
 				return nullptr;
 			}
 			res = vkAllocateMemory(m_device, &mem_alloc, nullptr, &intermediate->m_memory);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not allocate intermediate buffer memory");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not allocate intermediate buffer memory", res);
 				return nullptr;
 			}
 			
@@ -589,17 +624,17 @@ namespace Vulkan
 			res = vkMapMemory(m_device, intermediate->m_memory, 0, mem_alloc.allocationSize, 0,  &mapped);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not copy to the intermediate buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not copy to the intermediate buffer", res);
 				return nullptr;
 			}
 
-			memcpy_s(mapped, buff_size, data.data(), buff_size);
+			memcpy_s(mapped, buff_size, data, buff_size);
 
 			vkUnmapMemory(m_device, intermediate->m_memory);
 			res = vkBindBufferMemory(m_device, intermediate->m_buffer, intermediate->m_memory, 0);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not map intermediate buffer memory");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not map intermediate buffer memory", res);
 				return nullptr;
 			}
 
@@ -609,7 +644,7 @@ namespace Vulkan
 			res = vkCreateBuffer(m_device, &buffer_info, nullptr, &out->m_buffer);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not create the buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not create the buffer", res);
 				return nullptr;
 			}
 			vkGetBufferMemoryRequirements(m_device, &out->m_buffer, mem_reqs);
@@ -617,19 +652,19 @@ namespace Vulkan
 			mem_alloc.allocationSize = mem_reqs.size();
 			if (!GetMemoryTypeFromProps(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mem_alloc.memoryTypeIndex))
 			{
-				Basilisk.errors.push("Vulkan::Device::CreateBuffer() could not determine required memory type for the buffer");
+				BASILISK_ERROR("Vulkan::Device::CreateBuffer() could not determine required memory type for the buffer");
 				return nullptr;
 			}
 			res = vkAllocateMemory(m_device, &mem_alloc, nullptr, &out->m_memory);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not allocate buffer memory");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not allocate buffer memory", res);
 				return nullptr;
 			}
 			res = vkBindBufferMemory(m_device, out->m_buffer, out->m_memory, 0);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not bind buffer memory");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not bind buffer memory", res);
 				return nullptr;
 			}
 
@@ -649,14 +684,14 @@ namespace Vulkan
 			res = vkBeginCommandBuffer(m_cmdSetup, &cmd_begin_info);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not begin the setup command buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not begin the setup command buffer", res);
 				return nullptr;
 			}
 			vkCmdCopyBuffer(m_cmdSetup, intermediate->m_buffer, out->m_buffer, 1, &copy_region);
 			res = vkEndCommandBuffer(m_cmdSetup);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not end the setup command buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not end the setup command buffer", res);
 				return nullptr;
 			}
 
@@ -671,13 +706,13 @@ namespace Vulkan
 			res = vkQueueSubmit(m_queues[graphicsIndex], 1, &cmd_submit_info, VK_NULL_HANDLE);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not submit the setup command buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not submit the setup command buffer", res);
 				return nullptr;
 			}
 			res = vkQueueWaitIdle(m_queues[graphicsIndex]);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not wait on the setup command buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not wait on the setup command buffer", res);
 				return nullptr;
 			}
 		}
@@ -688,7 +723,7 @@ namespace Vulkan
 			res = vkCreateBuffer(m_device, &buffer_info, nullptr, &out->m_buffer);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not create the buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not create the buffer", res);
 				return nullptr;
 			}
 			vkGetBufferMemoryRequirements(m_device, &out->m_buffer, mem_reqs);
@@ -696,13 +731,13 @@ namespace Vulkan
 			mem_alloc.allocationSize = mem_reqs.size();
 			if (!GetMemoryTypeFromProps(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &mem_alloc.memoryTypeIndex))
 			{
-				Basilisk.errors.push("Vulkan::Device::CreateBuffer() could not determine required memory type for the buffer");
+				BASILISK_ERROR("Vulkan::Device::CreateBuffer() could not determine required memory type for the buffer");
 				return nullptr;
 			}
 			res = vkAllocateMemory(m_device, &mem_alloc, nullptr, &out->m_memory);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not allocate buffer memory");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not allocate buffer memory", res);
 				return nullptr;
 			}
 
@@ -710,24 +745,24 @@ namespace Vulkan
 			res = vkMapMemory(m_device, out->m_memory, 0, mem_alloc.allocationSize, 0, &mapped);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not copy to the buffer");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not copy to the buffer", res);
 				return nullptr;
 			}
 
-			memcpy_s(mapped, buff_size, data.data(), buff_size);
+			memcpy_s(mapped, buff_size, data, buff_size);
 
 			vkUnmapMemory(m_device, out->m_memory);
 			res = vkBindBufferMemory(m_device, out->m_buffer, out->m_memory, 0);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not map buffer memory");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not map buffer memory", res);
 				return nullptr;
 			}
 
 			res = vkBindBufferMemory(m_device, out->m_buffer, out->m_memory, 0);
 			if (Failed(res))
 			{
-				Basilisk::errors.push("Vulkan::Device::CreateBuffer() could not bind buffer memory");
+				BASILISK_ERROR_CODE("Vulkan::Device::CreateBuffer() could not bind buffer memory", res);
 				return nullptr;
 			}
 		}
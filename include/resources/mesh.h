@@ -0,0 +1,178 @@
+/**
+\file   mesh.h
+\author Andrew Baxter
+\date   April 6, 2016
+
+A static mesh, cooked offline and loaded ready for upload
+
+*/
+
+#ifndef BASILISK_MESH_H
+#define BASILISK_MESH_H
+
+#include "common.h"
+#include "resources/mesh_file.h"
+#include <cmath>
+#include <cfloat>
+
+namespace Basilisk
+{
+	/**
+	\brief A cooked mesh, as described in `mesh_file.h`
+	Loading reads the whole file in one go and checks its tables, but never touches a vertex,
+	so the vertex and index blobs can be handed to `Device::CreateBuffer()` exactly as they are.
+	*/
+	class Mesh
+	{
+	public:
+		Mesh();
+		~Mesh() = default;
+
+		/**
+		\brief Loads a file written by `CookMesh()`
+		Clears the old mesh, if any
+
+		\param[in] filename The file to read from
+		\param[in] deep Whether to check every index, for files which may not have come from the cooker
+		\return If successful, `true`. If failed, `false`, with the mesh left empty.
+		*/
+		bool Load(const std::string &filename, bool deep = false);
+
+		void Clear();
+
+		inline bool Empty() const {
+			return m_data.empty();
+		}
+
+		/**
+		Only valid while the mesh isn't empty
+		*/
+		inline const MeshFile::Header &GetHeader() const {
+			return *reinterpret_cast<const MeshFile::Header*>(m_data.data());
+		}
+
+		inline uint32_t NumAttributes() const {
+			return m_numAttributes;
+		}
+		inline const MeshFile::Attribute *Attributes() const {
+			return m_attributes;
+		}
+		/**
+		\return The attribute with the given meaning, or `nullptr` if the mesh doesn't have one
+		*/
+		const MeshFile::Attribute *FindAttribute(MeshFile::Semantic semantic) const;
+
+		inline uint32_t NumSubmeshes() const {
+			return m_numSubmeshes;
+		}
+		inline const MeshFile::Submesh *Submeshes() const {
+			return m_submeshes;
+		}
+		/**
+		\return The name of a material slot, or `nullptr` if there is no such slot
+		*/
+		const char *MaterialName(uint32_t material) const;
+
+		/**
+		\return The number of simplified versions of a submesh, not counting the submesh itself
+		*/
+		inline uint32_t NumLods(uint32_t submesh) const {
+			return m_submeshes[submesh].numLods;
+		}
+		/**
+		\return A submesh's simplified versions, from finest to coarsest
+		*/
+		inline const MeshFile::Lod *Lods(uint32_t submesh) const {
+			return m_lods + m_firstLods[submesh];
+		}
+		/**
+		\brief Picks the coarsest version of a submesh whose error, once projected, is within `threshold` pixels
+		The result is drawn with the submesh's vertex offset, like the submesh itself.
+
+		\param[in] submesh The submesh to draw
+		\param[in] errorScale Pixels per object-space unit at the submesh, as from `LodErrorScale()`
+		\param[in] threshold The most error visible, in pixels
+		\return The indices to draw. When no simplified version will do, the full submesh, with an error of 0.
+		*/
+		MeshFile::Lod SelectLod(uint32_t submesh, float errorScale, float threshold = 1.0f) const;
+
+		/**
+		\return The number of meshlets a submesh was split into, which is 0 if the mesh was cooked without them
+		*/
+		inline uint32_t NumMeshlets(uint32_t submesh) const {
+			return m_meshletRanges ? m_meshletRanges[submesh].numMeshlets : 0;
+		}
+		/**
+		\return A submesh's meshlets, for `CullMeshlets()`
+		*/
+		inline const MeshFile::Meshlet *Meshlets(uint32_t submesh) const {
+			return m_meshletRanges ? m_meshlets + m_meshletRanges[submesh].firstMeshlet : nullptr;
+		}
+		inline const uint32_t *MeshletVertices() const {
+			return m_meshletVertices;
+		}
+		inline const uint8_t *MeshletTriangles() const {
+			return m_meshletTriangles;
+		}
+
+		inline uint32_t NumVertices() const {
+			return m_numVertices;
+		}
+		inline uint32_t VertexStride() const {
+			return Empty() ? 0 : GetHeader().vertexStride;
+		}
+		inline const uint8_t *Vertices() const {
+			return m_vertices;
+		}
+
+		inline uint32_t NumIndices() const {
+			return m_numIndices;
+		}
+		inline uint32_t IndexSize() const {
+			return Empty() ? 0 : GetHeader().indexSize;
+		}
+		inline VkIndexType IndexType() const {
+			return (IndexSize() == 2) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		}
+		inline const uint8_t *Indices() const {
+			return m_indices;
+		}
+
+	private:
+		std::vector<uint64_t> m_data; //The whole file. 64-bit elements keep the header and tables aligned.
+
+		const MeshFile::Attribute *m_attributes;
+		const MeshFile::Material *m_materials;
+		const MeshFile::Submesh *m_submeshes;
+		const MeshFile::Lod *m_lods;
+		std::vector<uint32_t> m_firstLods; //Per submesh, into `m_lods`
+		const MeshFile::MeshletRange *m_meshletRanges;
+		const MeshFile::Meshlet *m_meshlets;
+		const uint32_t *m_meshletVertices;
+		const uint8_t *m_meshletTriangles;
+		const uint8_t *m_vertices;
+		const uint8_t *m_indices;
+		uint32_t m_numAttributes;
+		uint32_t m_numMaterials;
+		uint32_t m_numSubmeshes;
+		uint32_t m_numVertices;
+		uint32_t m_numIndices;
+	};
+
+	/**
+	\brief How many pixels tall an object-space distance appears, for choosing levels of detail
+	Uses the distance to the object rather than the depth, so the result doesn't change as the camera turns
+
+	\param[in] distance From the camera to the nearest point of the object's bounds
+	\param[in] viewportHeight In pixels
+	\param[in] fovY The vertical field of view, in radians
+	\param[in] objectScale The largest scale in the object's world transform
+	*/
+	inline float LodErrorScale(float distance, float viewportHeight, float fovY, float objectScale = 1.0f)
+	{
+		//Anything at or behind the camera gets the full detail
+		return (distance > 0.0f) ? objectScale * viewportHeight / (2.0f * tanf(fovY * 0.5f) * distance) : FLT_MAX;
+	}
+}
+
+#endif
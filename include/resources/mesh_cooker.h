@@ -0,0 +1,65 @@
+/**
+\file   mesh_cooker.h
+\author Andrew Baxter
+\date   April 6, 2016
+
+Turns meshes imported by assimp into cooked mesh files, offline
+
+*/
+
+#ifndef BASILISK_MESH_COOKER_H
+#define BASILISK_MESH_COOKER_H
+
+#include "common.h"
+#include "resources/mesh_file.h"
+#include "resources/mesh_optimizer.h"
+#include "resources/mesh_simplifier.h"
+#include "resources/meshlets.h"
+
+struct aiScene;
+
+namespace Basilisk
+{
+	struct MeshCookOptions
+	{
+		bool optimize = true; //Reorder each submesh with `OptimizeMesh()`
+		float overdrawThreshold = defaultOverdrawThreshold;
+		size_t numThreads = 0; //Submeshes are optimised in parallel on this many threads; 0 uses one per hardware thread
+		uint32_t maxLods = 4; //Simplified versions to generate for each submesh, if they stay within `lodMaxError`
+		float lodReduction = 0.5f; //Each level of detail aims for this fraction of the last one's triangles
+		float lodMaxError = 0.05f; //The most error a level of detail may have, as a fraction of the longest side of its submesh's bounds
+		bool meshlets = true; //Split each submesh into meshlets with `BuildMeshlets()`
+		uint32_t meshletMaxVertices = defaultMeshletVertices;
+		uint32_t meshletMaxTriangles = defaultMeshletTriangles;
+	};
+
+	/**
+	\brief Converts every triangle mesh in an imported scene into one cooked mesh, with one submesh per `aiMesh`
+	Only the scene's plain data is read, so nothing here needs the assimp library; only the tool which runs the importer links against it.
+
+	Node transforms are ignored, so import with `aiProcess_PreTransformVertices` to flatten the hierarchy,
+	and with `aiProcess_Triangulate | aiProcess_SortByPType` so that every face is a triangle.
+	Points and lines are skipped. Attributes are taken from the first texture coordinate and color sets, and any attribute
+	present in one mesh is given to every vertex, with defaults where a mesh lacks it.
+	Each submesh gets a chain of levels of detail, each simplified from the last with `SimplifyMesh()`, until one would
+	exceed the error limit or stops getting much smaller. Each submesh's full detail triangles are also split into meshlets, for culling in clusters.
+
+	The output is the same whatever the number of threads, so cooking is repeatable.
+
+	\param[in] scene The imported scene
+	\param[out] blob Cleared, then filled with the contents of a file which `Mesh::Load()` can read
+	\param[out] stats If not `nullptr` and `options.optimize` is set, filled with the results of optimising each submesh
+	\return If the scene held at least one triangle, `true`. Otherwise, `false`.
+	*/
+	bool CookMesh(const aiScene &scene, std::vector<uint8_t> &blob, const MeshCookOptions &options = MeshCookOptions(),
+		std::vector<MeshOptimizeStats> *stats = nullptr);
+	/**
+	\brief As above, but writes the result straight to a file
+
+	\param[in] filename The file to write to
+	*/
+	bool CookMesh(const aiScene &scene, const std::string &filename, const MeshCookOptions &options = MeshCookOptions(),
+		std::vector<MeshOptimizeStats> *stats = nullptr);
+}
+
+#endif
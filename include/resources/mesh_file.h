@@ -0,0 +1,172 @@
+/**
+\file   mesh_file.h
+\author Andrew Baxter
+\date   April 6, 2016
+
+Describes the cooked mesh format, which is written offline by `CookMesh()` and uploaded without any processing
+
+A file is a header, a run of blobs, and a section table describing each blob, just like a scene file.
+Vertices are interleaved and quantised, in exactly the layout the vertex shader reads, and indices are
+16-bit whenever every submesh is small enough, so both blobs go straight to `Device::CreateBuffer()`.
+Simplified levels of detail reuse their submesh's vertices, and only add indices.
+Each submesh can also be split into meshlets: small clusters of triangles with their own bounds, which are culled on their own.
+All values are little-endian.
+
+*/
+
+#ifndef BASILISK_MESH_FILE_H
+#define BASILISK_MESH_FILE_H
+
+#include "common.h"
+
+namespace Basilisk
+{
+	namespace MeshFile
+	{
+		constexpr uint32_t magic = 0x48534D42; //"BMSH"
+		constexpr uint16_t versionMajor = 1; //Changes whenever old readers can no longer load new files
+		constexpr uint16_t versionMinor = 2; //1 added levels of detail, 2 added meshlets
+		constexpr uint64_t blobAlignment = 64;
+		constexpr size_t maxNameLength = 64; //Including the terminator
+		constexpr uint32_t maxSubmeshVertices = 0x10000; //Most vertices a submesh can have while still using 16-bit indices
+
+		enum class SectionType : uint32_t
+		{
+			Attributes = 1, //Attribute[], in the order they appear in a vertex; exactly one
+			Materials, //Material[], indexed by `Submesh::material`; exactly one
+			Submeshes, //Submesh[]; exactly one
+			Vertices, //Interleaved vertices, `Header::vertexStride` bytes each; exactly one
+			Indices, //uint16_t[] or uint32_t[], by `Header::indexSize`; exactly one
+			Lods, //Lod[], grouped by submesh in submesh order; needed only if a submesh has any
+			MeshletRanges, //MeshletRange[], one per submesh; optional, but needs the three sections after it
+			Meshlets, //Meshlet[]
+			MeshletVertices, //uint32_t[], relative to the submesh's first vertex
+			MeshletTriangles //uint8_t[], three indices into the meshlet's vertices for each triangle
+		};
+
+		enum class Semantic : uint32_t
+		{
+			Position, //R16G16B16A16_UNORM within the header's bounds, with w always 1
+			Normal, //R8G8B8A8_SNORM, with w always 0
+			Tangent, //R8G8B8A8_SNORM, with w holding the bitangent's sign
+			TexCoord0, //R16G16_SFLOAT
+			TexCoord1, //R16G16_SFLOAT
+			Color //R8G8B8A8_UNORM
+		};
+
+		struct Header
+		{
+			uint32_t magic;
+			uint16_t versionMajor;
+			uint16_t versionMinor;
+			uint32_t numSections;
+			uint32_t vertexStride;
+			uint32_t indexSize; //2 or 4
+			uint32_t reserved;
+			float boundsMin[3]; //Of every vertex. Positions are stored as fractions of the distance from `boundsMin` to `boundsMax`.
+			float boundsMax[3];
+			uint64_t sectionTableOffset;
+			uint64_t fileSize;
+		};
+
+		struct Section
+		{
+			SectionType type;
+			uint32_t elementSize;
+			uint64_t offset; //From the start of the file
+			uint64_t count; //Elements, not bytes
+		};
+
+		struct Attribute
+		{
+			Semantic semantic;
+			VkFormat format;
+			uint32_t offset; //From the start of a vertex
+			uint32_t reserved;
+		};
+
+		struct Material
+		{
+			char name[maxNameLength]; //As named by the source asset, and possibly empty
+		};
+
+		/**
+		One draw's worth of the mesh, using a single material
+		Indices are relative to `firstVertex`, so they're drawn with it as the vertex offset
+		*/
+		struct Submesh
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t material;
+			uint32_t numLods; //Simplified versions in the Lods section, not counting the submesh itself. Always 0 before version 1.1.
+			float boundsMin[3];
+			float boundsMax[3];
+		};
+
+		/**
+		A simplified version of a submesh, drawn with the same vertices and vertex offset
+		Each of a submesh's levels of detail has fewer triangles and a larger error than the last.
+		*/
+		struct Lod
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error; //How far the surface may have moved from the full submesh, in object space
+			uint32_t reserved;
+		};
+
+		/**
+		A submesh's meshlets, as a range of the Meshlets section
+		*/
+		struct MeshletRange
+		{
+			uint32_t firstMeshlet;
+			uint32_t numMeshlets;
+		};
+
+		/**
+		\brief A cluster of neighbouring triangles from one submesh, with bounds for culling it
+		The normal cone bounds every triangle's facing: the whole meshlet faces away from any eye for which
+		`dot(normalize(coneApex - eye), coneAxis) > coneCutoff`. Meshlets whose triangles face too many ways
+		have a zero axis and a cutoff of 1, so they're never rejected that way.
+		*/
+		struct Meshlet
+		{
+			uint32_t vertexOffset; //Into the MeshletVertices section
+			uint32_t triangleOffset; //Into the MeshletTriangles section, in bytes, and always a multiple of 4
+			uint32_t vertexCount; //At most 256
+			uint32_t triangleCount;
+			float center[3]; //The bounding sphere, in object space
+			float radius;
+			float coneApex[3];
+			float coneCutoff; //The sine of the cone's half-angle
+			float coneAxis[3];
+			uint32_t reserved;
+		};
+
+		static_assert(sizeof(Header) == 64 && sizeof(Section) == 24 && sizeof(Attribute) == 16 && sizeof(Material) == 64 &&
+			sizeof(Submesh) == 48 && sizeof(Lod) == 16 && sizeof(MeshletRange) == 8 && sizeof(Meshlet) == 64, "Mesh file structures must not be padded");
+
+		/**
+		\brief Checks that a file is safe to use
+		The shallow check covers the header, every section, every submesh, every level of detail and every meshlet, so each draw lies inside its blobs.
+		The deep check also makes sure every index refers to a vertex in its own submesh, or its own meshlet.
+
+		\param[in] data The start of the file. Must be 8-byte aligned.
+		\param[in] size The size of the file, in bytes
+		\param[in] deep Whether to check every index as well
+		\return If the file is well-formed, `true`. Otherwise, `false`, with the reason logged.
+		*/
+		bool Validate(const uint8_t *data, size_t size, bool deep);
+
+		/**
+		\return The first section of `type`, or `nullptr` if there is none
+		*/
+		const Section *FindSection(const uint8_t *data, SectionType type);
+	}
+}
+
+#endif
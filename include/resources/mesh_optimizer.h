@@ -0,0 +1,124 @@
+/**
+\file   mesh_optimizer.h
+\author Andrew Baxter
+\date   April 8, 2016
+
+Reorders triangles and vertices so the GPU transforms, shades and fetches less of each mesh
+
+Three passes run in order, each on a single triangle list:
+the vertex cache pass reorders triangles so recently transformed vertices are reused (Forsyth's algorithm),
+the overdraw pass splits that order into clusters and draws outward-facing clusters first, giving up a bounded amount of cache efficiency,
+and the vertex fetch pass renumbers vertices in the order they're first used, so fetches walk memory linearly.
+Every pass is deterministic, so cooking the same mesh twice always gives the same bytes.
+
+*/
+
+#ifndef BASILISK_MESH_OPTIMIZER_H
+#define BASILISK_MESH_OPTIMIZER_H
+
+#include "common.h"
+
+namespace Basilisk
+{
+	constexpr uint32_t defaultCacheSize = 16; //Entries in the modelled post-transform FIFO
+	constexpr float defaultOverdrawThreshold = 1.05f; //How much the overdraw pass may worsen ACMR
+	constexpr uint32_t unusedVertex = 0xFFFFFFFF; //In a remap table, for vertices no triangle refers to
+
+	/**
+	How well a triangle list reuses a FIFO post-transform cache
+	*/
+	struct VertexCacheStats
+	{
+		uint32_t transformed; //Cache misses, each of which runs the vertex shader
+		float acmr; //Average cache miss ratio: transformed vertices per triangle, from 3 down to about 0.5
+		float atvr; //Average transformed vertex ratio: transformed vertices per referenced vertex, down to 1
+	};
+
+	/**
+	How much vertex memory is read to draw a triangle list
+	*/
+	struct VertexFetchStats
+	{
+		uint64_t bytesFetched; //Whole 64-byte lines loaded by post-transform cache misses
+		float overfetch; //`bytesFetched` over the size of every referenced vertex, down to 1
+	};
+
+	/**
+	The state of a mesh before and after each pass of `OptimizeMesh()`
+	*/
+	struct MeshOptimizeStats
+	{
+		VertexCacheStats original;
+		VertexCacheStats vertexCache;
+		VertexCacheStats overdraw;
+		VertexFetchStats fetchOriginal;
+		VertexFetchStats fetchOptimized;
+	};
+
+	VertexCacheStats AnalyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = defaultCacheSize);
+	VertexFetchStats AnalyzeVertexFetch(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t vertexStride, uint32_t cacheSize = defaultCacheSize);
+
+	/**
+	\brief Reorders triangles to reuse transformed vertices, using Forsyth's linear-speed algorithm
+	Scores every vertex by its position in a modelled LRU cache and its number of remaining triangles,
+	then repeatedly emits the best-scoring triangle touching the cache.
+
+	\param[out] dst The reordered indices; may be `indices`
+	*/
+	void OptimizeVertexCache(uint32_t *dst, const uint32_t *indices, size_t indexCount, uint32_t vertexCount);
+
+	/**
+	\brief Reorders clusters of triangles so that outward-facing ones are drawn first, and more of the mesh fails the depth test
+	Meant to run after `OptimizeVertexCache()`. The order is split into the smallest clusters whose ACMR, with the cache
+	flushed between clusters, is within `threshold` of the input's, and clusters are then sorted by how far they face out from the mesh's centroid.
+
+	\param[out] dst The reordered indices; may be `indices`
+	\param[in] positions One per vertex
+	\param[in] threshold How much worse, as a ratio, the result's ACMR may be than the input's
+	*/
+	void OptimizeOverdraw(uint32_t *dst, const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount,
+		float threshold = defaultOverdrawThreshold);
+
+	/**
+	\brief Renumbers vertices in the order the triangles first use them
+	Vertices no triangle uses are dropped.
+
+	\param[in,out] indices Rewritten to use the new numbering
+	\param[out] remap The new index of each old vertex, or `unusedVertex`, with `vertexCount` elements. Apply with `RemapVertices()`.
+	\return The number of vertices left
+	*/
+	uint32_t OptimizeVertexFetch(uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t *remap);
+
+	/**
+	Moves each vertex attribute to its new index from `OptimizeVertexFetch()`, dropping unused vertices
+
+	\param[out] dst Must not overlap `src`, and must have room for as many vertices as `OptimizeVertexFetch()` returned
+	*/
+	template<typename T>
+	void RemapVertices(T *dst, const T *src, uint32_t vertexCount, const uint32_t *remap);
+
+	/**
+	\brief Runs all three passes on one triangle list
+	Safe to run on different meshes from several threads at once
+
+	\param[in,out] indices Reordered and renumbered
+	\param[in] positions One per original vertex
+	\param[in] vertexStride The size of a vertex once cooked, for the fetch statistics
+	\param[out] remap Filled as by `OptimizeVertexFetch()`
+	\return Statistics from before and after each pass
+	*/
+	MeshOptimizeStats OptimizeMesh(std::vector<uint32_t> &indices, const glm::vec3 *positions, uint32_t vertexCount, uint32_t vertexStride,
+		std::vector<uint32_t> &remap, float overdrawThreshold = defaultOverdrawThreshold);
+
+	template<typename T>
+	void RemapVertices(T *dst, const T *src, uint32_t vertexCount, const uint32_t *remap)
+	{
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			if (remap[i] != unusedVertex)
+				dst[remap[i]] = src[i];
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,42 @@
+/**
+\file   mesh_simplifier.h
+\author Andrew Baxter
+\date   April 9, 2016
+
+Reduces triangle lists by collapsing edges, for generating levels of detail offline
+
+Each collapse moves one vertex onto a neighbour, so no vertices are created and every level of detail can share
+its mesh's vertex buffer. Collapses are ranked by quadric error: the squared distance from the planes of the triangles
+around the moved vertex, plus how far each vertex attribute drifts from what those triangles interpolated.
+Borders and UV seams only ever slide along themselves, and vertices where they meet never move, so holes don't open and textures don't tear.
+
+*/
+
+#ifndef BASILISK_MESH_SIMPLIFIER_H
+#define BASILISK_MESH_SIMPLIFIER_H
+
+#include "common.h"
+
+namespace Basilisk
+{
+	constexpr uint32_t maxSimplifyAttributes = 16; //Floats per vertex which the simplifier can keep track of
+
+	/**
+	\brief Collapses edges until there are at most `targetIndexCount` indices left, or every remaining collapse costs more than `maxError`
+	Errors are distances, in the same units as the positions.
+
+	\param[out] dst Room for `indexCount` indices; may be `indices`
+	\param[in] positions One per vertex
+	\param[in] attributes `attributeCount` floats for each vertex, with consecutive vertices `attributeStride` floats apart, or `nullptr`
+	\param[in] attributeWeights One per attribute: how far a change of 1 in the attribute counts as moving, as a fraction of the longest side of the mesh's bounds
+	\param[in] targetIndexCount The number of indices to aim for
+	\param[in] maxError The largest error any collapse may introduce
+	\param[out] error If not `nullptr`, the largest error introduced by any collapse
+	\return The number of indices written to `dst`
+	*/
+	size_t SimplifyMesh(uint32_t *dst, const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount,
+		const float *attributes, uint32_t attributeStride, const float *attributeWeights, uint32_t attributeCount,
+		size_t targetIndexCount, float maxError, float *error = nullptr);
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+\file   meshlets.h
+\author Andrew Baxter
+\date   April 10, 2016
+
+Splits triangle lists into meshlets offline, and culls them before drawing
+
+A meshlet is a small cluster of neighbouring triangles, with few enough vertices that its triangles can use 8-bit indices into its own vertex list.
+Each has a bounding sphere and a normal cone bounding the way its triangles face, so whole clusters can be skipped
+when they're off-screen, or when every triangle in them faces away from the camera, long before the rasteriser would have rejected them one by one.
+
+*/
+
+#ifndef BASILISK_MESHLETS_H
+#define BASILISK_MESHLETS_H
+
+#include "common.h"
+#include "core/culling.h"
+#include "resources/mesh_file.h"
+
+namespace Basilisk
+{
+	constexpr uint32_t defaultMeshletVertices = 64;
+	constexpr uint32_t defaultMeshletTriangles = 124; //Under the 126 NVIDIA suggests for mesh shaders, and a multiple of 4
+	constexpr uint32_t maxMeshletVertices = 256; //So local indices fit in a byte
+	constexpr float defaultMeshletConeWeight = 0.25f;
+
+	/**
+	How many meshlets `CullMeshlets()` rejected for each reason
+	*/
+	struct MeshletCullStats
+	{
+		uint32_t outside; //Entirely outside the frustum
+		uint32_t backfacing; //Inside, but facing entirely away from the eye
+	};
+
+	/**
+	\brief Greedily grows meshlets across a triangle list, appending them to the three arrays
+	Each meshlet starts at the first triangle not yet taken, then repeatedly takes the neighbouring triangle which adds the fewest vertices
+	and bends its normal cone the least, until it's full or nothing is left next to it. Meant to run after `OptimizeVertexCache()`,
+	so meshlets come out in roughly the order the mesh is drawn.
+
+	\param[in,out] meshlets Appended to, with offsets into `meshletVertices` and `meshletTriangles` as they are at the end
+	\param[in,out] meshletVertices Appended to, with the vertex indices each meshlet uses
+	\param[in,out] meshletTriangles Appended to, with three local indices per triangle, and each meshlet padded to a multiple of 4 bytes
+	\param[in] positions One per vertex, in the space the bounds should be in
+	\param[in] maxVertices The most vertices in one meshlet, up to `maxMeshletVertices`
+	\param[in] maxTriangles The most triangles in one meshlet
+	\param[in] coneWeight How much a narrow normal cone counts against a compact cluster of vertices; 0 ignores facing entirely
+	\return The number of meshlets added
+	*/
+	size_t BuildMeshlets(std::vector<MeshFile::Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles,
+		const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount,
+		uint32_t maxVertices = defaultMeshletVertices, uint32_t maxTriangles = defaultMeshletTriangles, float coneWeight = defaultMeshletConeWeight);
+
+	/**
+	\brief Tests meshlets against a frustum and against their normal cones, four at a time
+	Both tests happen in the mesh's own space, so transform the camera into it rather than every meshlet out of it:
+	build the frustum from the view-projection times the world matrix, and take the eye through the inverse world matrix.
+
+	\param[in] frustum The view frustum, in the mesh's space
+	\param[in] eye The camera's position, in the mesh's space
+	\param[out] visible The index of each meshlet which may have triangles on screen is appended here
+	\param[in,out] stats If not `nullptr`, the number of meshlets rejected is added to it
+	*/
+	void CullMeshlets(const Frustum &frustum, const glm::vec3 &eye, const MeshFile::Meshlet *meshlets, uint32_t count,
+		std::vector<uint32_t> &visible, MeshletCullStats *stats = nullptr);
+
+	/**
+	\brief Turns meshlets back into a triangle list, for drawing the survivors of `CullMeshlets()` without mesh shaders
+	Indices are relative to the submesh's first vertex, like the submesh's own.
+
+	\param[in] which Indices into `meshlets`, as from `CullMeshlets()`
+	\param[out] indices Three indices per triangle are appended here
+	*/
+	void ExpandMeshlets(const MeshFile::Meshlet *meshlets, const uint32_t *which, uint32_t count,
+		const uint32_t *meshletVertices, const uint8_t *meshletTriangles, std::vector<uint32_t> &indices);
+}
+
+#endif
@@ -5,7 +5,13 @@
 
 Represents a persistent game level
 
-\todo Utilize data-oriented design
+Entities are stored by archetype: every entity with exactly the same set of components shares one archetype,
+which keeps each component type in its own contiguous array. Systems iterate those arrays directly,
+either a whole archetype at a time or in task-sized chunks spread across a `TaskGraph`.
+
+Scenes are saved in the binary format described in `scene_file.h`. Loading maps the file and points each
+archetype's arrays straight into the mapping, which is copy-on-write, so nothing is parsed or copied
+until an archetype has to grow.
 
 */
 
@@ -13,9 +19,150 @@ Represents a persistent game level
 #define BASILISK_SCENE_H
 
 #include "common.h"
+#include "core/task_graph.h"
+#include "scene_file.h"
+#include <unordered_map>
+#include <type_traits>
 
 namespace Basilisk
 {
+	/**
+	An entity handle. The low 24 bits index the scene's entity records, and the high 8 bits are a generation
+	counter, so handles to destroyed entities stop resolving even after their slot is reused.
+	*/
+	typedef uint32_t Entity;
+	constexpr Entity invalidEntity = 0xFFFFFFFF;
+
+	typedef uint64_t ComponentMask;
+	constexpr uint32_t maxComponentTypes = 64; //One bit per type in a ComponentMask
+	constexpr uint32_t defaultChunkSize = 4096; //Entities per task in ParallelForEachChunk()
+	constexpr size_t columnAlignment = 64; //Cache line, and wide enough for any SIMD load
+
+	/**
+	Assigns the next component type index
+	Use `ComponentType<T>()` instead of calling this directly
+
+	\return The new type's index, or `maxComponentTypes` if every index is taken or `alignment` exceeds `columnAlignment`
+	*/
+	uint32_t RegisterComponentType(size_t size, size_t alignment);
+	size_t ComponentSize(uint32_t type);
+	size_t ComponentAlignment(uint32_t type);
+
+	/**
+	\brief Gives a component type the persistent name it is saved under
+	Type indices depend on registration order, so scene files identify components by name instead
+
+	\param[in] name Unique, and shorter than `SceneFile::maxNameLength`
+	\return If the name was free and fits, `true`. Otherwise, `false`.
+	*/
+	bool NameComponentType(uint32_t type, const char *name);
+	/**
+	\return The component type's name, or `nullptr` if it has none
+	*/
+	const char *ComponentName(uint32_t type);
+	/**
+	\return The component type with the given name, or `maxComponentTypes` if there is none
+	*/
+	uint32_t FindComponentType(const char *name);
+
+	/**
+	\return The index of component type `T`, registering it on first use, or `maxComponentTypes` if it could not be registered
+	*/
+	template<typename T>
+	uint32_t ComponentType()
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Components must be plain data, since archetypes move them with memcpy and never destroy them");
+		static_assert(alignof(T) <= columnAlignment, "Components must fit the alignment of an archetype column");
+		static const uint32_t type = RegisterComponentType(sizeof(T), alignof(T));
+		return type;
+	}
+
+	template<typename T>
+	bool NameComponent(const char *name)
+	{
+		return NameComponentType(ComponentType<T>(), name);
+	}
+
+	/**
+	\brief Sets one bit for each component type in `Ts`
+
+	\param[out] mask The combined mask
+	\return If every type could be registered, `true`. Otherwise, `false`, and `mask` is left unchanged.
+	*/
+	template<typename... Ts>
+	bool MaskOf(ComponentMask &mask)
+	{
+		std::array<uint32_t, sizeof...(Ts) + 1> indices = { 0, ComponentType<Ts>()... };
+		ComponentMask out = 0;
+		for (size_t i = 1; i < indices.size(); ++i)
+		{
+			if (indices[i] >= maxComponentTypes)
+			{
+				BASILISK_ERROR("Basilisk::MaskOf() was given a component type which could not be registered");
+				return false;
+			}
+			out |= ComponentMask(1) << indices[i];
+		}
+		mask = out;
+		return true;
+	}
+
+	/**
+	\brief Every entity which has exactly one particular set of components
+	Each component type is held in its own 64-byte aligned array, with one row per entity.
+	*/
+	class Archetype
+	{
+	public:
+		Archetype(ComponentMask mask);
+		~Archetype();
+
+		Archetype(const Archetype&) = delete;
+		Archetype &operator=(const Archetype&) = delete;
+
+		inline ComponentMask Mask() const {
+			return m_mask;
+		}
+		inline uint32_t Size() const {
+			return m_size;
+		}
+		inline const Entity *Entities() const {
+			return m_entities;
+		}
+
+		/**
+		\return The array holding component `type`, or `nullptr` if this archetype doesn't have it
+		*/
+		void *Column(uint32_t type);
+
+		template<typename T>
+		inline T *Components() {
+			return static_cast<T*>(Column(ComponentType<T>()));
+		}
+
+	private:
+		friend class Scene;
+
+		//Appends a zeroed row, or returns false if there was no memory for it
+		bool PushBack(Entity entity, uint32_t &row);
+		//Fills `row` with the last row, and returns the entity that moved, or `invalidEntity` if it was the last row
+		Entity SwapRemove(uint32_t row);
+		//Leaves the archetype unchanged, and returns false, if the memory could not be allocated
+		bool Reserve(uint32_t capacity);
+		//Uses arrays owned by someone else, such as a mapped scene file, until the archetype has to grow
+		void Borrow(Entity *entities, const std::vector<uint8_t*> &columns, uint32_t size);
+
+		ComponentMask m_mask;
+		std::array<int8_t, maxComponentTypes> m_columnIndex; //-1 if the type is absent
+		std::vector<uint32_t> m_types;
+		std::vector<size_t> m_sizes; //Parallel to m_types, so the hot paths need not take the types lock
+		std::vector<uint8_t*> m_columns; //Parallel to m_types
+		Entity *m_entities;
+		uint32_t m_size;
+		uint32_t m_capacity;
+		bool m_borrowed;
+	};
+
 	class Scene
 	{
 	public:
@@ -28,17 +175,231 @@ namespace Basilisk
 
 		/**
 		\brief Load a scene from a file
-		Clears the old scene, if any
+		Clears the old scene, if any. The file stays mapped until the scene is cleared.
+		Every component type in the file must already be named with `NameComponentType()`.
+		Only the file's tables are checked, so loading takes the same time however many entities it holds.
 
 		\param[in] filename The file to read from
+		\param[in] deep Whether to check every entity record too, for files which may not have come from `Save()`
 		*/
-		bool Load(const std::string &filename);
+		bool Load(const std::string &filename, bool deep = false);
+
+		/**
+		\brief Write the scene to a file which `Load()` can map
+		Every component type in use must be named with `NameComponentType()`
+
+		\param[in] filename The file to write to
+		*/
+		bool Save(const std::string &filename) const;
 
 		void Clear();
 
+		/**
+		Creates an entity with no components
+		*/
+		Entity Create();
+		/**
+		Creates an entity with the given components
+
+		\return The new entity, or `invalidEntity` if the scene is full, out of memory, or a component type could not be registered
+		*/
+		template<typename... Ts>
+		Entity Create(const Ts&... components);
+
+		/**
+		\return If `entity` existed, `true`. Otherwise, `false`.
+		*/
+		bool Destroy(Entity entity);
+		bool IsAlive(Entity entity) const;
+
+		inline uint32_t NumEntities() const {
+			return m_numEntities;
+		}
+		inline uint32_t NumArchetypes() const {
+			return static_cast<uint32_t>(m_archetypes.size());
+		}
+
+		/**
+		\brief Adds a component to an entity, or overwrites it if the entity already has one
+		Moves the entity to a different archetype, so this is far slower than modifying a component in place
+
+		\return If `entity` exists and could be moved, `true`. Otherwise, `false`.
+		*/
+		template<typename T>
+		bool Add(Entity entity, const T &component);
+		/**
+		\return If `entity` exists, had the component and could be moved, `true`. Otherwise, `false`.
+		*/
+		template<typename T>
+		bool Remove(Entity entity);
+		/**
+		\return A pointer to the entity's component, or `nullptr` if it doesn't exist or has none.
+		Invalidated by any call that creates, destroys or changes the components of any entity.
+		*/
+		template<typename T>
+		T *Get(Entity entity);
+
+		/**
+		\brief Calls `func(const Entity *entities, uint32_t count, Ts *...components)` once per archetype with every component in `Ts`
+		*/
+		template<typename... Ts, typename Func>
+		void ForEachChunk(Func func);
+		/**
+		\brief Calls `func(Entity entity, Ts &...components)` for every entity with every component in `Ts`
+		*/
+		template<typename... Ts, typename Func>
+		void ForEach(Func func);
+		/**
+		\brief Splits every entity with every component in `Ts` into ranges of at most `chunkSize`, and adds one task per range to `graph`
+		Each task calls `func(const Entity *entities, uint32_t count, Ts *...components)`.
+		No entity may be created, destroyed or change components until the graph has executed.
+
+		\return The tasks that were added, so later work can depend on them
+		*/
+		template<typename... Ts, typename Func>
+		std::vector<TaskId> ParallelForEachChunk(TaskGraph &graph, Func func, uint32_t chunkSize = defaultChunkSize);
+
 	private:
+		typedef SceneFile::Record EntityRecord;
+		static constexpr uint32_t invalidArchetype = SceneFile::freeRecord;
+
+		uint32_t FindOrCreateArchetype(ComponentMask mask);
+		const EntityRecord *Find(Entity entity) const;
+		Entity Allocate(uint32_t archetype);
+		bool MoveEntity(Entity entity, uint32_t target);
+		//Whether the record of the entity that a swap-remove would move lies inside the scene
+		bool CanSwapRemove(const Archetype &arch) const;
+		//Copies borrowed records out of the mapped file, before anything modifies them
+		void OwnRecords();
 
+		inline const EntityRecord *Records() const {
+			return m_borrowedRecords ? m_borrowedRecords : m_records.data();
+		}
+		inline uint32_t NumRecords() const {
+			return m_borrowedRecords ? m_numBorrowedRecords : static_cast<uint32_t>(m_records.size());
+		}
+
+		std::vector< std::unique_ptr<Archetype> > m_archetypes; //Never moved once created, so running tasks can hold pointers
+		std::unordered_map<ComponentMask, uint32_t> m_archetypeLookup;
+		std::vector<EntityRecord> m_records; //Empty while the records are borrowed
+		const EntityRecord *m_borrowedRecords; //From the mapped file until the scene first changes, or `nullptr`
+		uint32_t m_numBorrowedRecords;
+		std::vector<uint32_t> m_freeRecords;
+		uint32_t m_numEntities;
+		std::shared_ptr<MappedFile> m_file; //Backs any borrowed archetypes
 	};
+
+	template<typename... Ts>
+	Entity Scene::Create(const Ts&... components)
+	{
+		ComponentMask mask;
+		if (!MaskOf<Ts...>(mask))
+			return invalidEntity;
+
+		uint32_t index = FindOrCreateArchetype(mask);
+		Entity entity = Allocate(index);
+		if (entity == invalidEntity)
+			return invalidEntity;
+
+		Archetype &arch = *m_archetypes[index];
+		uint32_t row = arch.Size() - 1;
+		int expand[] = { 0, (arch.Components<Ts>()[row] = components, 0)... };
+		(void)expand;
+		return entity;
+	}
+
+	template<typename T>
+	bool Scene::Add(Entity entity, const T &component)
+	{
+		ComponentMask bit;
+		const EntityRecord *record = Find(entity);
+		if (!record || !MaskOf<T>(bit))
+			return false;
+
+		uint32_t target = FindOrCreateArchetype(m_archetypes[record->archetype]->Mask() | bit);
+		if (target != record->archetype && !MoveEntity(entity, target))
+			return false;
+
+		record = Find(entity);
+		m_archetypes[record->archetype]->Components<T>()[record->row] = component;
+		return true;
+	}
+
+	template<typename T>
+	bool Scene::Remove(Entity entity)
+	{
+		ComponentMask bit;
+		const EntityRecord *record = Find(entity);
+		if (!record || !MaskOf<T>(bit))
+			return false;
+
+		ComponentMask mask = m_archetypes[record->archetype]->Mask();
+		if (!(mask & bit))
+			return false;
+
+		return MoveEntity(entity, FindOrCreateArchetype(mask & ~bit));
+	}
+
+	template<typename T>
+	T *Scene::Get(Entity entity)
+	{
+		const EntityRecord *record = Find(entity);
+		if (!record)
+			return nullptr;
+
+		T *column = m_archetypes[record->archetype]->Components<T>();
+		return column ? column + record->row : nullptr;
+	}
+
+	template<typename... Ts, typename Func>
+	void Scene::ForEachChunk(Func func)
+	{
+		ComponentMask query;
+		if (!MaskOf<Ts...>(query))
+			return;
+
+		for (auto &arch : m_archetypes)
+		{
+			if ((arch->Mask() & query) == query && arch->Size() > 0)
+				func(arch->Entities(), arch->Size(), arch->template Components<Ts>()...);
+		}
+	}
+
+	template<typename... Ts, typename Func>
+	void Scene::ForEach(Func func)
+	{
+		ForEachChunk<Ts...>([&](const Entity *entities, uint32_t count, Ts *...components) {
+			for (uint32_t i = 0; i < count; ++i)
+				func(entities[i], components[i]...);
+		});
+	}
+
+	template<typename... Ts, typename Func>
+	std::vector<TaskId> Scene::ParallelForEachChunk(TaskGraph &graph, Func func, uint32_t chunkSize)
+	{
+		std::vector<TaskId> out;
+		ComponentMask query;
+		if (!MaskOf<Ts...>(query))
+			return out;
+
+		chunkSize = std::max(1u, chunkSize);
+
+		for (auto &iter : m_archetypes)
+		{
+			Archetype *arch = iter.get();
+			if ((arch->Mask() & query) != query)
+				continue;
+
+			for (uint32_t start = 0; start < arch->Size(); start += chunkSize)
+			{
+				uint32_t count = std::min(chunkSize, arch->Size() - start);
+				out.push_back(graph.Add([=] {
+					func(arch->Entities() + start, count, (arch->template Components<Ts>() + start)...);
+				}));
+			}
+		}
+		return out;
+	}
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,142 @@
+/**
+\file   scene_file.h
+\author Andrew Baxter
+\date   March 30, 2016
+
+Describes the binary scene format, which is mapped into memory and used in place
+
+A file is a header, a run of blobs, and a section table describing each blob.
+Every reference is an offset from the start of the file or an index into another section, never a pointer,
+so the file works wherever it is mapped. Blobs start on `blobAlignment` boundaries, so component arrays can be
+read with aligned SIMD loads straight from the mapping. All values are little-endian.
+
+*/
+
+#ifndef BASILISK_SCENE_FILE_H
+#define BASILISK_SCENE_FILE_H
+
+#include "common.h"
+
+namespace Basilisk
+{
+	namespace SceneFile
+	{
+		constexpr uint32_t magic = 0x4E435342; //"BSCN"
+		constexpr uint16_t versionMajor = 1; //Changes whenever old readers can no longer load new files
+		constexpr uint16_t versionMinor = 0;
+		constexpr uint64_t blobAlignment = 64; //Matches archetype columns; a multiple of every SIMD width we use
+		constexpr size_t maxNameLength = 48; //Including the terminator
+		constexpr uint32_t none = 0xFFFFFFFF; //For `Section::archetype` and `Section::component`
+		constexpr uint32_t freeRecord = 0xFFFFFFFF; //For `Record::archetype`
+
+		enum class SectionType : uint32_t
+		{
+			Components = 1, //ComponentDesc[]; exactly one
+			Archetypes, //ArchetypeDesc[]; exactly one
+			Records, //Record[], indexed by the low bits of an entity handle; exactly one
+			FreeRecords, //uint32_t[] of free record indices, reused last first; exactly one
+			Entities, //Entity[], one per archetype
+			Column //Component data, one per component of each archetype
+		};
+
+		struct Header
+		{
+			uint32_t magic;
+			uint16_t versionMajor;
+			uint16_t versionMinor;
+			uint32_t numSections;
+			uint32_t reserved;
+			uint64_t sectionTableOffset;
+			uint64_t fileSize;
+		};
+
+		struct Section
+		{
+			SectionType type;
+			uint32_t archetype; //Index into the archetype table, or `none`
+			uint32_t component; //Index into the component table, or `none`
+			uint32_t elementSize;
+			uint64_t offset; //From the start of the file
+			uint64_t count; //Elements, not bytes
+		};
+
+		struct ComponentDesc
+		{
+			char name[maxNameLength];
+			uint32_t size;
+			uint32_t alignment;
+			uint64_t reserved;
+		};
+
+		struct ArchetypeDesc
+		{
+			uint64_t components; //One bit per entry in the component table
+			uint32_t size; //Entities
+			uint32_t reserved;
+		};
+
+		struct Record
+		{
+			uint32_t archetype; //`freeRecord` if the slot is unused
+			uint32_t row;
+			uint32_t generation;
+		};
+
+		static_assert(sizeof(Header) == 32 && sizeof(Section) == 32 && sizeof(ComponentDesc) == 64 &&
+			sizeof(ArchetypeDesc) == 16 && sizeof(Record) == 12, "Scene file structures must not be padded");
+
+		/**
+		\brief Checks that a file is safe to map
+		The shallow check covers the header and every section, so each blob lies inside the file and agrees with its tables.
+		The deep check also walks every record and entity, making sure they refer to one another.
+
+		\param[in] data The start of the file. Must be 8-byte aligned.
+		\param[in] size The size of the file, in bytes
+		\param[in] deep Whether to check every record as well
+		\return If the file is well-formed, `true`. Otherwise, `false`, with the reason logged.
+		*/
+		bool Validate(const uint8_t *data, size_t size, bool deep);
+
+		/**
+		\return The first section of `type` belonging to `archetype` and `component`, or `nullptr` if there is none
+		*/
+		const Section *FindSection(const uint8_t *data, SectionType type, uint32_t archetype = none, uint32_t component = none);
+	}
+
+	/**
+	\brief A whole file mapped into memory
+	The mapping is copy-on-write: the contents may be modified, but changes never reach the file
+	*/
+	class MappedFile
+	{
+	public:
+		/**
+		\brief Maps a file
+
+		\param[in] filename The file to map
+		\return The mapping, or `nullptr` if the file could not be opened or mapped
+		*/
+		static std::shared_ptr<MappedFile> Open(const std::string &filename);
+
+		void Release(); //Custom deallocator for shared_ptr. Unmaps the file and closes its handles
+
+		inline uint8_t *Data() {
+			return m_data;
+		}
+		inline size_t Size() const {
+			return m_size;
+		}
+
+	private:
+		MappedFile();
+
+		uint8_t *m_data;
+		size_t m_size;
+#ifdef _WIN32
+		void *m_file;
+		void *m_mapping;
+#endif
+	};
+}
+
+#endif
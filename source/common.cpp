@@ -3,11 +3,16 @@
 \author Andrew Baxter
 \date   March 9, 2015
 
-Links to Vulkan binaries
+Links to Vulkan binaries, and owns the engine log
 
 */
 
 #include "../include/common.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
 
 
 #ifdef ENVIRONMENT64
@@ -16,5 +21,189 @@ Links to Vulkan binaries
 #pragma comment(lib, "Bin32/vulkan-1.lib")
 #endif
 
-std::queue<std::string> Basilisk::errors;
-std::queue<std::string> Basilisk::warnings;
\ No newline at end of file
+namespace
+{
+	constexpr uint32_t logCapacity = 1024; //Must be a power of two
+	constexpr uint32_t maxMessages = 4096;
+
+	/**
+	Bounded multi-producer, multi-consumer ring
+	Each cell's sequence number says whether it is ready to be written (== position) or read (== position + 1)
+	*/
+	struct LogCell
+	{
+		std::atomic<uint64_t> sequence;
+		Basilisk::LogRecord record;
+	};
+
+	struct LogRing
+	{
+		LogRing() : enqueuePos(0), dequeuePos(0), dropped(0), numThreads(0), origin(std::chrono::steady_clock::now()), numMessages(0)
+		{
+			for (uint32_t i = 0; i < logCapacity; ++i)
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		std::array<LogCell, logCapacity> cells;
+		std::atomic<uint64_t> enqueuePos;
+		char padding[64];
+		std::atomic<uint64_t> dequeuePos;
+		std::atomic<uint32_t> dropped;
+		std::atomic<uint32_t> numThreads;
+		std::chrono::steady_clock::time_point origin;
+
+		//Interned messages. Written under the lock, read without it.
+		std::mutex messagesLock;
+		std::array<std::atomic<const char*>, maxMessages> messages;
+		std::atomic<uint32_t> numMessages;
+	};
+
+	LogRing &GetLog()
+	{
+		static LogRing log; //Constructed on first use, so logging works during static initialization
+		return log;
+	}
+
+	thread_local uint32_t t_logThread = 0xFFFFFFFF;
+}
+
+uint32_t Basilisk::InternMessage(const char *message)
+{
+	LogRing &log = GetLog();
+	std::lock_guard<std::mutex> lock(log.messagesLock);
+
+	uint32_t count = log.numMessages.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (strcmp(log.messages[i].load(std::memory_order_relaxed), message) == 0)
+			return i;
+	}
+	if (count == maxMessages)
+		return maxMessages; //MessageText() reports it as unknown
+
+	log.messages[count].store(message, std::memory_order_relaxed);
+	log.numMessages.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+const char *Basilisk::MessageText(uint32_t messageId)
+{
+	LogRing &log = GetLog();
+	if (messageId >= log.numMessages.load(std::memory_order_acquire))
+		return nullptr;
+	return log.messages[messageId].load(std::memory_order_relaxed);
+}
+
+void Basilisk::Log(Severity severity, uint32_t messageId, VkResult code, uint32_t detail)
+{
+	LogRing &log = GetLog();
+	if (t_logThread == 0xFFFFFFFF)
+		t_logThread = log.numThreads.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t pos = log.enqueuePos.load(std::memory_order_relaxed);
+	LogCell *cell;
+	for (;;)
+	{
+		cell = &log.cells[pos & (logCapacity - 1)];
+		uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+		int64_t diff = static_cast<int64_t>(seq - pos);
+		if (diff == 0)
+		{ //Cell is free; try to claim it
+			if (log.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{ //Full
+			log.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+		{ //Another producer got here first
+			pos = log.enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - log.origin).count();
+	cell->record.messageId = messageId;
+	cell->record.code = code;
+	cell->record.detail = detail;
+	cell->record.thread = t_logThread;
+	cell->record.severity = severity;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool Basilisk::PopLog(LogRecord &record)
+{
+	LogRing &log = GetLog();
+	uint64_t pos = log.dequeuePos.load(std::memory_order_relaxed);
+	LogCell *cell;
+	for (;;)
+	{
+		cell = &log.cells[pos & (logCapacity - 1)];
+		uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+		int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+		if (diff == 0)
+		{
+			if (log.dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{ //Empty
+			return false;
+		}
+		else
+		{
+			pos = log.dequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	record = cell->record;
+	cell->sequence.store(pos + logCapacity, std::memory_order_release);
+	return true;
+}
+
+uint32_t Basilisk::TakeDroppedLogCount()
+{
+	return GetLog().dropped.exchange(0, std::memory_order_relaxed);
+}
+
+std::string Basilisk::FormatLog(const LogRecord &record)
+{
+	static const char *severities[] = { "Info", "Warning", "Error" };
+
+	//Messages are never used as format strings, so a stray '%' in one is printed as it is
+	const char *message = MessageText(record.messageId);
+	const char *placeholder = message ? strstr(message, "%u") : nullptr;
+	char text[512];
+	if (!message)
+		snprintf(text, sizeof(text), "Unknown message %u", record.messageId);
+	else if (placeholder)
+		snprintf(text, sizeof(text), "%.*s%u%s", static_cast<int>(placeholder - message), message, record.detail, placeholder + 2);
+	else
+		snprintf(text, sizeof(text), "%s", message);
+
+	char line[640];
+	if (Succeeded(record.code))
+		snprintf(line, sizeof(line), "[%s] %s on thread %u at %.3fms", severities[static_cast<uint8_t>(record.severity)], text, record.thread, record.timestamp / 1e6);
+	else
+		snprintf(line, sizeof(line), "[%s] %s (VkResult %d) on thread %u at %.3fms", severities[static_cast<uint8_t>(record.severity)], text, record.code, record.thread, record.timestamp / 1e6);
+	return line;
+}
+
+bool Basilisk::DrainLogToFile(const std::string &filename)
+{
+	FILE *file = fopen(filename.c_str(), "a");
+	if (!file)
+		return false;
+
+	LogRecord record;
+	while (PopLog(record))
+		fprintf(file, "%s\n", FormatLog(record).c_str());
+
+	uint32_t dropped = TakeDroppedLogCount();
+	if (dropped)
+		fprintf(file, "[Warning] %u messages were dropped because the log was full\n", dropped);
+
+	fclose(file);
+	return true;
+}
\ No newline at end of file
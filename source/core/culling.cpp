@@ -0,0 +1,328 @@
+/**
+\file culling.cpp
+\author Andrew Baxter
+\date April 4, 2016
+
+Frustum tests with SSE, four boxes or spheres at a time
+
+*/
+
+#include "core/culling.h"
+#include "profiling.h"
+#include <xmmintrin.h>
+#include <cfloat>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t leafNode = 0xFFFFFFFF;
+	constexpr uint32_t maxLeafSize = 4;
+	constexpr uint32_t maxStackDepth = 96; //Three pending siblings per level of a balanced tree, with room to spare
+
+	//Planes broadcast across all four lanes, along with which corner of a box lies furthest along each normal
+	struct PlaneSet
+	{
+		__m128 x[6], y[6], z[6], w[6];
+		bool positive[6][3];
+
+		PlaneSet(const Frustum &frustum)
+		{
+			for (int i = 0; i < 6; ++i)
+			{
+				const glm::vec4 &p = frustum.planes[i];
+				x[i] = _mm_set1_ps(p.x);
+				y[i] = _mm_set1_ps(p.y);
+				z[i] = _mm_set1_ps(p.z);
+				w[i] = _mm_set1_ps(p.w);
+				positive[i][0] = p.x >= 0.0f;
+				positive[i][1] = p.y >= 0.0f;
+				positive[i][2] = p.z >= 0.0f;
+			}
+		}
+	};
+
+	inline __m128 Distance(const PlaneSet &planes, int i, __m128 x, __m128 y, __m128 z)
+	{
+		__m128 out = _mm_add_ps(_mm_mul_ps(planes.x[i], x), planes.w[i]);
+		out = _mm_add_ps(out, _mm_mul_ps(planes.y[i], y));
+		return _mm_add_ps(out, _mm_mul_ps(planes.z[i], z));
+	}
+
+	/**
+	Tests four boxes against every plane
+	\param[out] inside Bit `i` is set if box `i` is entirely inside the frustum
+	\return Bit `i` is set if box `i` is entirely outside any plane
+	*/
+	inline int TestBoxes(const PlaneSet &planes, const float *minX, const float *minY, const float *minZ,
+		const float *maxX, const float *maxY, const float *maxZ, int *inside)
+	{
+		__m128 lo[3] = { _mm_loadu_ps(minX), _mm_loadu_ps(minY), _mm_loadu_ps(minZ) };
+		__m128 hi[3] = { _mm_loadu_ps(maxX), _mm_loadu_ps(maxY), _mm_loadu_ps(maxZ) };
+		__m128 zero = _mm_setzero_ps();
+		__m128 outMask = zero;
+		__m128 inMask = _mm_cmpeq_ps(zero, zero);
+
+		for (int i = 0; i < 6; ++i)
+		{
+			const bool *pos = planes.positive[i];
+			__m128 farthest = Distance(planes, i, pos[0] ? hi[0] : lo[0], pos[1] ? hi[1] : lo[1], pos[2] ? hi[2] : lo[2]);
+			outMask = _mm_or_ps(outMask, _mm_cmplt_ps(farthest, zero));
+			if (inside)
+			{
+				__m128 nearest = Distance(planes, i, pos[0] ? lo[0] : hi[0], pos[1] ? lo[1] : hi[1], pos[2] ? lo[2] : hi[2]);
+				inMask = _mm_and_ps(inMask, _mm_cmpge_ps(nearest, zero));
+			}
+		}
+
+		if (inside)
+			*inside = _mm_movemask_ps(inMask);
+		return _mm_movemask_ps(outMask);
+	}
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4 &viewProjection)
+{
+	//Rows of the matrix; glm stores columns
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum out;
+	out.planes[0] = row[3] + row[0]; //Left
+	out.planes[1] = row[3] - row[0]; //Right
+	out.planes[2] = row[3] + row[1]; //Bottom
+	out.planes[3] = row[3] - row[1]; //Top
+	out.planes[4] = row[2]; //Near, since depth starts at 0
+	out.planes[5] = row[3] - row[2]; //Far
+
+	for (auto &iter : out.planes)
+		iter /= glm::length(glm::vec3(iter));
+	return out;
+}
+
+void Basilisk::CullSpheres(const Frustum &frustum, const float *x, const float *y, const float *z, const float *radius, uint32_t count, std::vector<uint32_t> &visible)
+{
+	PlaneSet planes(frustum);
+	__m128 zero = _mm_setzero_ps();
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i);
+		__m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + i));
+		__m128 outMask = zero;
+		for (int p = 0; p < 6; ++p)
+			outMask = _mm_or_ps(outMask, _mm_cmplt_ps(Distance(planes, p, cx, cy, cz), negRadius));
+
+		for (int bits = ~_mm_movemask_ps(outMask) & 0xF; bits; bits &= bits - 1)
+		{
+			int lane = 0;
+			while (!(bits & (1 << lane)))
+				++lane;
+			visible.push_back(i + lane);
+		}
+	}
+
+	for (; i < count; ++i)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+			outside = glm::dot(glm::vec3(frustum.planes[p]), glm::vec3(x[i], y[i], z[i])) + frustum.planes[p].w < -radius[i];
+		if (!outside)
+			visible.push_back(i);
+	}
+}
+
+void CullingBVH::Build(const glm::vec3 *mins, const glm::vec3 *maxs, uint32_t count)
+{
+	m_nodes.clear();
+	m_order.resize(count);
+	std::vector<glm::vec3> centers(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		m_order[i] = i;
+		centers[i] = (mins[i] + maxs[i]) * 0.5f;
+	}
+
+	if (count > 0)
+		BuildNode(0, count, centers);
+	Refit(mins, maxs);
+}
+
+uint32_t CullingBVH::BuildNode(uint32_t begin, uint32_t end, const std::vector<glm::vec3> &centers)
+{
+	//Median split along the longest axis of the centers
+	auto split = [&](uint32_t b, uint32_t e) {
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		for (uint32_t i = b; i < e; ++i)
+		{
+			lo = glm::min(lo, centers[m_order[i]]);
+			hi = glm::max(hi, centers[m_order[i]]);
+		}
+		glm::vec3 extent = hi - lo;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+		uint32_t mid = b + (e - b) / 2;
+		std::nth_element(m_order.begin() + b, m_order.begin() + mid, m_order.begin() + e, [&](uint32_t l, uint32_t r) {
+			return centers[l][axis] < centers[r][axis];
+		});
+		return mid;
+	};
+
+	//Split twice for four children, leaving any range small enough to be a leaf alone
+	uint32_t bounds[5] = { begin, end, end, end, end };
+	uint32_t numParts = 1;
+	if (end - begin > maxLeafSize)
+	{
+		uint32_t mid = split(begin, end);
+		uint32_t parts[5];
+		numParts = 0;
+		for (auto range : { std::make_pair(begin, mid), std::make_pair(mid, end) })
+		{
+			parts[numParts++] = range.first;
+			if (range.second - range.first > maxLeafSize)
+				parts[numParts++] = split(range.first, range.second);
+		}
+		parts[numParts] = end;
+		std::copy(parts, parts + numParts + 1, bounds);
+	}
+
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		uint32_t first = i < numParts ? bounds[i] : end;
+		uint32_t count = i < numParts ? bounds[i + 1] - first : 0;
+		uint32_t child = count > maxLeafSize ? BuildNode(first, first + count, centers) : leafNode;
+
+		Node &node = m_nodes[index]; //Recursion may have moved it
+		node.first[i] = first;
+		node.count[i] = count;
+		node.child[i] = child;
+	}
+	return index;
+}
+
+void CullingBVH::Refit(const glm::vec3 *mins, const glm::vec3 *maxs)
+{
+	uint32_t count = static_cast<uint32_t>(m_order.size());
+
+	//Padding is never visible, and lets leaves load four objects regardless of where they start
+	m_minX.assign(count + 3, FLT_MAX);
+	m_minY.assign(count + 3, FLT_MAX);
+	m_minZ.assign(count + 3, FLT_MAX);
+	m_maxX.assign(count + 3, -FLT_MAX);
+	m_maxY.assign(count + 3, -FLT_MAX);
+	m_maxZ.assign(count + 3, -FLT_MAX);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const glm::vec3 &lo = mins[m_order[i]], &hi = maxs[m_order[i]];
+		m_minX[i] = lo.x;
+		m_minY[i] = lo.y;
+		m_minZ[i] = lo.z;
+		m_maxX[i] = hi.x;
+		m_maxY[i] = hi.y;
+		m_maxZ[i] = hi.z;
+	}
+
+	RefitNodes();
+}
+
+void CullingBVH::RefitNodes()
+{
+	//Children always come after their parents, so walking backwards sees them first
+	for (size_t n = m_nodes.size(); n-- > 0;)
+	{
+		Node &node = m_nodes[n];
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+			if (node.count[i] > 0 && node.child[i] == leafNode)
+			{
+				for (uint32_t s = node.first[i]; s < node.first[i] + node.count[i]; ++s)
+				{
+					lo = glm::min(lo, glm::vec3(m_minX[s], m_minY[s], m_minZ[s]));
+					hi = glm::max(hi, glm::vec3(m_maxX[s], m_maxY[s], m_maxZ[s]));
+				}
+			}
+			else if (node.count[i] > 0)
+			{
+				const Node &child = m_nodes[node.child[i]];
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					if (child.count[c] == 0)
+						continue;
+					lo = glm::min(lo, glm::vec3(child.minX[c], child.minY[c], child.minZ[c]));
+					hi = glm::max(hi, glm::vec3(child.maxX[c], child.maxY[c], child.maxZ[c]));
+				}
+			}
+
+			node.minX[i] = lo.x;
+			node.minY[i] = lo.y;
+			node.minZ[i] = lo.z;
+			node.maxX[i] = hi.x;
+			node.maxY[i] = hi.y;
+			node.maxZ[i] = hi.z;
+		}
+	}
+}
+
+void CullingBVH::Cull(const Frustum &frustum, std::vector<uint32_t> &visible) const
+{
+	BASILISK_PROFILE_ZONE("CullingBVH::Cull");
+	visible.clear();
+	if (m_nodes.empty())
+		return;
+
+	PlaneSet planes(frustum);
+	uint32_t stack[maxStackDepth];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const Node &node = m_nodes[stack[--top]];
+		int inside;
+		int outside = TestBoxes(planes, node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, &inside);
+
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			uint32_t first = node.first[i], count = node.count[i];
+			if (count == 0 || (outside & (1 << i)))
+				continue;
+
+			if (inside & (1 << i))
+			{ //Every object below is visible; no need to look any closer
+				visible.insert(visible.end(), m_order.begin() + first, m_order.begin() + first + count);
+			}
+			else if (node.child[i] != leafNode)
+			{
+				stack[top++] = node.child[i];
+			}
+			else
+			{
+				int objectsOutside = TestBoxes(planes, &m_minX[first], &m_minY[first], &m_minZ[first],
+					&m_maxX[first], &m_maxY[first], &m_maxZ[first], nullptr);
+				for (uint32_t s = 0; s < count; ++s)
+				{
+					if (!(objectsOutside & (1 << s)))
+						visible.push_back(m_order[first + s]);
+				}
+			}
+		}
+	}
+}
+
+std::vector<TaskId> CullingBVH::Cull(TaskGraph &graph, const std::vector<Frustum> &views, std::vector< std::vector<uint32_t> > &visible) const
+{
+	std::vector<TaskId> out;
+	visible.resize(views.size());
+	for (size_t i = 0; i < views.size(); ++i)
+	{
+		const Frustum *view = &views[i];
+		std::vector<uint32_t> *list = &visible[i];
+		out.push_back(graph.Add([this, view, list] { Cull(*view, *list); }));
+	}
+	return out;
+}
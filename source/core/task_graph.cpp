@@ -5,39 +5,307 @@
 
 Controls the scheduling and execution of per-frame behaviors
 
-\todo Finish
-
 */
 
 #include "core/task_graph.h"
-//#include "core/traits.h"
-
-//using namespace Basilisk;
-//
-//TaskGraph::TaskGraph(size_t numThreads)
-//{
-//	m_workers = new std::thread[numThreads];
-//}
-//
-//TaskGraph::~TaskGraph()
-//{
-//	Join();
-//	delete[] m_workers;
-//}
-//
-//
-//template<typename ResultType>
-//void TaskGraph::Add(std::packaged_task<ResultType(void)> task)
-//{
-//	
-//}
-//
-//void TaskGraph::Add(std::packaged_task< void(void) > task)
-//{
-//	
-//}
-//
-//bool TaskGraph::Execute()
-//{
-//	return (ScheduleTasks() && StartWorkers());
-//}
\ No newline at end of file
+#include "profiling.h"
+
+using namespace Basilisk;
+
+WorkQueue::WorkQueue() : m_mask(0), m_top(0), m_bottom(0)
+{
+
+}
+
+void WorkQueue::Reset(uint32_t capacity)
+{
+	uint32_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	if (!m_buffer || size > m_mask + 1)
+	{
+		m_buffer.reset(new std::atomic<TaskId>[size]);
+		m_mask = size - 1;
+	}
+	m_top.store(0, std::memory_order_relaxed);
+	m_bottom.store(0, std::memory_order_relaxed);
+}
+
+void WorkQueue::Push(TaskId task)
+{
+	int64_t b = m_bottom.load(std::memory_order_relaxed);
+	m_buffer[b & m_mask].store(task, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+bool WorkQueue::Pop(TaskId *task)
+{
+	int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = m_top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{ //Empty
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	*task = m_buffer[b & m_mask].load(std::memory_order_relaxed);
+	if (t == b)
+	{ //Last entry; race any thieves for it
+		bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+bool WorkQueue::Steal(TaskId *task)
+{
+	int64_t t = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = m_bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return false;
+
+	TaskId out = m_buffer[t & m_mask].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return false; //Lost to the owner or another thief
+
+	*task = out;
+	return true;
+}
+
+TaskGraph::TaskGraph(size_t numThreads) : m_remaining(0), m_busyWorkers(0), m_generation(0), m_terminate(false)
+{
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	m_queues.resize(numThreads);
+	for (auto &iter : m_queues)
+		iter.reset(new WorkQueue);
+
+	//The thread calling Execute() takes the first queue
+	m_workers.reserve(numThreads - 1);
+	for (uint32_t i = 1; i < numThreads; ++i)
+		m_workers.emplace_back(&TaskGraph::WorkerFunction, this, i);
+}
+
+TaskGraph::~TaskGraph()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeLock);
+		m_terminate = true;
+	}
+	m_wake.notify_all();
+
+	for (auto &iter : m_workers)
+		iter.join();
+}
+
+TaskId TaskGraph::Add(std::function<void(void)> task, const std::vector<TaskId> &predecessors)
+{
+	TaskId id = static_cast<TaskId>(m_work.size());
+	for (TaskId pred : predecessors)
+	{
+		if (pred >= id)
+		{
+			BASILISK_ERROR("Basilisk::TaskGraph::Add() was given a predecessor which does not exist");
+			return invalidTask;
+		}
+	}
+
+	m_work.push_back(std::move(task));
+	m_successors.emplace_back();
+	m_numPredecessors.push_back(static_cast<uint32_t>(predecessors.size()));
+	for (TaskId pred : predecessors)
+		m_successors[pred].push_back(id);
+
+	m_pending.reset(); //Graph changed; SortTasks() must run again
+	return id;
+}
+
+TaskId TaskGraph::Continue(TaskId predecessor, std::function<void(void)> task)
+{
+	return Add(std::move(task), { predecessor });
+}
+
+bool TaskGraph::Precede(TaskId before, TaskId after)
+{
+	if (before >= m_work.size() || after >= m_work.size() || before == after)
+	{
+		BASILISK_ERROR("Basilisk::TaskGraph::Precede() was given an invalid pair of tasks");
+		return false;
+	}
+
+	m_successors[before].push_back(after);
+	++m_numPredecessors[after];
+	m_pending.reset();
+	return true;
+}
+
+void TaskGraph::Clear()
+{
+	m_work.clear();
+	m_successors.clear();
+	m_numPredecessors.clear();
+	m_roots.clear();
+	m_pending.reset();
+}
+
+bool TaskGraph::SortTasks()
+{
+	uint32_t numTasks = static_cast<uint32_t>(m_work.size());
+
+	//Kahn's algorithm, only to find the roots and prove there are no cycles
+	std::vector<uint32_t> counts(m_numPredecessors);
+	std::vector<TaskId> ready;
+	ready.reserve(numTasks);
+	m_roots.clear();
+	for (TaskId i = 0; i < numTasks; ++i)
+	{
+		if (counts[i] == 0)
+		{
+			m_roots.push_back(i);
+			ready.push_back(i);
+		}
+	}
+
+	uint32_t visited = 0;
+	while (!ready.empty())
+	{
+		TaskId task = ready.back();
+		ready.pop_back();
+		++visited;
+		for (TaskId succ : m_successors[task])
+		{
+			if (--counts[succ] == 0)
+				ready.push_back(succ);
+		}
+	}
+	if (visited != numTasks)
+		return false;
+
+	m_pending.reset(new std::atomic<uint32_t>[numTasks]);
+	return true;
+}
+
+bool TaskGraph::Execute()
+{
+	BASILISK_PROFILE_ZONE("TaskGraph::Execute");
+	if (m_work.empty())
+		return true;
+
+	if (!m_pending && !SortTasks())
+	{
+		BASILISK_ERROR("Basilisk::TaskGraph::Execute() found a cycle in the task graph");
+		return false;
+	}
+
+	uint32_t numTasks = static_cast<uint32_t>(m_work.size());
+	for (TaskId i = 0; i < numTasks; ++i)
+		m_pending[i].store(m_numPredecessors[i], std::memory_order_relaxed);
+
+	//Each task is pushed at most once per run, so no deque can overflow
+	for (auto &iter : m_queues)
+		iter->Reset(numTasks);
+	for (size_t i = 0; i < m_roots.size(); ++i)
+		m_queues[i % m_queues.size()]->Push(m_roots[i]);
+
+	m_remaining.store(numTasks, std::memory_order_relaxed);
+	m_busyWorkers.store(static_cast<uint32_t>(m_workers.size()), std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_wakeLock);
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	RunUntilDone(0);
+
+	//Nobody may touch the deques once this returns, or the next Execute() would race them
+	while (m_busyWorkers.load(std::memory_order_acquire) != 0)
+		std::this_thread::yield();
+
+	return true;
+}
+
+void TaskGraph::WorkerFunction(uint32_t index)
+{
+	Profiler::SetThreadName("TaskGraph worker");
+
+	uint64_t seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_wakeLock);
+			m_wake.wait(lock, [&] { return m_terminate || m_generation != seen; });
+			if (m_terminate)
+				return;
+			seen = m_generation;
+		}
+
+		RunUntilDone(index);
+		m_busyWorkers.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void TaskGraph::RunUntilDone(uint32_t index)
+{
+	TaskId task;
+	while (m_remaining.load(std::memory_order_acquire) != 0)
+	{
+		if (m_queues[index]->Pop(&task) || Steal(index, &task))
+			RunTask(index, task);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void TaskGraph::RunTask(uint32_t index, TaskId task)
+{
+	while (task != invalidTask)
+	{
+		m_work[task]();
+
+		//Continue into the first successor this task readies, and share the rest
+		TaskId next = invalidTask;
+		for (TaskId succ : m_successors[task])
+		{
+			if (m_pending[succ].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				if (next == invalidTask)
+					next = succ;
+				else
+					m_queues[index]->Push(succ);
+			}
+		}
+
+		m_remaining.fetch_sub(1, std::memory_order_release);
+		task = next;
+	}
+}
+
+bool TaskGraph::Steal(uint32_t thief, TaskId *task)
+{
+	//Xorshift, so threads spread their attempts over different victims
+	static thread_local uint32_t seed = 0;
+	if (seed == 0)
+		seed = 0x9E3779B9u * (thief + 1);
+
+	uint32_t numQueues = static_cast<uint32_t>(m_queues.size());
+	for (uint32_t attempt = 0; attempt < numQueues; ++attempt)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+
+		uint32_t victim = seed % numQueues;
+		if (victim != thief && m_queues[victim]->Steal(task))
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,482 @@
+/**
+\file transform_hierarchy.cpp
+\author Andrew Baxter
+\date April 2, 2016
+
+Maintains depth-first order, and computes world matrices four transforms at a time with SSE
+
+*/
+
+#include "core/transform_hierarchy.h"
+#include "profiling.h"
+#include <xmmintrin.h>
+#include <cstring>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t none = 0xFFFFFFFF; //A root's parent index
+	const glm::mat4 identity(1.0f);
+
+	template<typename T>
+	void Permute(std::vector<T> &data, const std::vector<uint32_t> &order)
+	{
+		std::vector<T> out(order.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			out[i] = data[order[i]];
+		data.swap(out);
+	}
+
+	//Loads up to four consecutive floats, padding the rest with `fill`
+	inline __m128 Load4(const std::vector<float> &data, uint32_t index, uint32_t count, float fill)
+	{
+		if (count == 4)
+			return _mm_loadu_ps(&data[index]);
+
+		float out[4] = { fill, fill, fill, fill };
+		for (uint32_t i = 0; i < count; ++i)
+			out[i] = data[index + i];
+		return _mm_loadu_ps(out);
+	}
+
+	//`world = parent * local`, where `local` is affine
+	inline void MultiplyAffine(const float *parent, const float *local, float *world)
+	{
+		__m128 p0 = _mm_loadu_ps(parent);
+		__m128 p1 = _mm_loadu_ps(parent + 4);
+		__m128 p2 = _mm_loadu_ps(parent + 8);
+		__m128 p3 = _mm_loadu_ps(parent + 12);
+
+		for (int col = 0; col < 3; ++col)
+		{
+			const float *l = local + col * 4;
+			__m128 r = _mm_mul_ps(p0, _mm_set1_ps(l[0]));
+			r = _mm_add_ps(r, _mm_mul_ps(p1, _mm_set1_ps(l[1])));
+			r = _mm_add_ps(r, _mm_mul_ps(p2, _mm_set1_ps(l[2])));
+			_mm_storeu_ps(world + col * 4, r);
+		}
+
+		__m128 r = _mm_add_ps(p3, _mm_mul_ps(p0, _mm_set1_ps(local[12])));
+		r = _mm_add_ps(r, _mm_mul_ps(p1, _mm_set1_ps(local[13])));
+		r = _mm_add_ps(r, _mm_mul_ps(p2, _mm_set1_ps(local[14])));
+		_mm_storeu_ps(world + 12, r);
+	}
+}
+
+TransformHierarchy::TransformHierarchy() : m_reorder(false)
+{
+
+}
+
+bool TransformHierarchy::Exists(TransformId id) const
+{
+	return id < m_indexOf.size() && m_indexOf[id] != none;
+}
+
+uint32_t TransformHierarchy::IndexOf(TransformId id) const
+{
+	return Exists(id) ? m_indexOf[id] : invalidTransform;
+}
+
+void TransformHierarchy::MarkDirty(uint32_t index)
+{
+	if (!m_dirty[index])
+	{
+		m_dirty[index] = 1;
+		m_dirtyList.push_back(index);
+	}
+}
+
+TransformId TransformHierarchy::Add(TransformId parent, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+	if (parent != invalidTransform && !Exists(parent))
+	{
+		BASILISK_ERROR("Basilisk::TransformHierarchy::Add() was given a parent which does not exist");
+		return invalidTransform;
+	}
+
+	TransformId id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = static_cast<TransformId>(m_indexOf.size());
+		m_indexOf.push_back(none);
+	}
+
+	uint32_t index = static_cast<uint32_t>(m_ids.size());
+	uint32_t parentIndex = parent == invalidTransform ? none : m_indexOf[parent];
+	m_indexOf[id] = index;
+	m_ids.push_back(id);
+	m_parent.push_back(parentIndex);
+	m_subtreeEnd.push_back(index + 1);
+	m_posX.push_back(position.x);
+	m_posY.push_back(position.y);
+	m_posZ.push_back(position.z);
+	m_rotX.push_back(rotation.x);
+	m_rotY.push_back(rotation.y);
+	m_rotZ.push_back(rotation.z);
+	m_rotW.push_back(rotation.w);
+	m_scaleX.push_back(scale.x);
+	m_scaleY.push_back(scale.y);
+	m_scaleZ.push_back(scale.z);
+	m_world.push_back(identity);
+	m_dirty.push_back(0);
+	MarkDirty(index);
+
+	//Appending under the last subtree keeps depth-first order, which is how loaders usually build hierarchies
+	if (!m_reorder && parentIndex != none)
+	{
+		if (m_subtreeEnd[parentIndex] == index)
+		{
+			for (uint32_t i = parentIndex; i != none; i = m_parent[i])
+				m_subtreeEnd[i] = index + 1;
+		}
+		else
+			m_reorder = true;
+	}
+	return id;
+}
+
+bool TransformHierarchy::Remove(TransformId id)
+{
+	if (!Exists(id))
+		return false;
+	if (m_reorder)
+		Reorder();
+
+	uint32_t begin = m_indexOf[id], end = m_subtreeEnd[begin], count = end - begin;
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		m_indexOf[m_ids[i]] = none;
+		m_freeIds.push_back(m_ids[i]);
+	}
+
+	auto erase = [&](auto &data) {
+		data.erase(data.begin() + begin, data.begin() + end);
+	};
+	erase(m_ids);
+	erase(m_parent);
+	erase(m_subtreeEnd);
+	erase(m_posX);
+	erase(m_posY);
+	erase(m_posZ);
+	erase(m_rotX);
+	erase(m_rotY);
+	erase(m_rotZ);
+	erase(m_rotW);
+	erase(m_scaleX);
+	erase(m_scaleY);
+	erase(m_scaleZ);
+	erase(m_world);
+	erase(m_dirty);
+
+	//Ancestors shrink; everything after the hole moves down
+	for (uint32_t i = 0; i < begin; ++i)
+	{
+		if (m_subtreeEnd[i] > begin)
+			m_subtreeEnd[i] -= count;
+	}
+	for (uint32_t i = begin; i < m_ids.size(); ++i)
+	{
+		m_subtreeEnd[i] -= count;
+		if (m_parent[i] != none && m_parent[i] >= end)
+			m_parent[i] -= count;
+		m_indexOf[m_ids[i]] = i;
+	}
+
+	m_dirtyList.clear();
+	for (uint32_t i = 0; i < m_dirty.size(); ++i)
+	{
+		if (m_dirty[i])
+			m_dirtyList.push_back(i);
+	}
+	return true;
+}
+
+bool TransformHierarchy::SetParent(TransformId id, TransformId parent)
+{
+	if (!Exists(id) || (parent != invalidTransform && !Exists(parent)))
+	{
+		BASILISK_ERROR("Basilisk::TransformHierarchy::SetParent() was given a transform which does not exist");
+		return false;
+	}
+
+	uint32_t index = m_indexOf[id];
+	uint32_t parentIndex = parent == invalidTransform ? none : m_indexOf[parent];
+	for (uint32_t i = parentIndex; i != none; i = m_parent[i])
+	{
+		if (i == index)
+		{
+			BASILISK_ERROR("Basilisk::TransformHierarchy::SetParent() would have made a cycle");
+			return false;
+		}
+	}
+
+	if (m_parent[index] != parentIndex)
+	{
+		m_parent[index] = parentIndex;
+		m_reorder = true;
+	}
+	return true;
+}
+
+TransformId TransformHierarchy::GetParent(TransformId id) const
+{
+	if (!Exists(id))
+		return invalidTransform;
+	uint32_t parent = m_parent[m_indexOf[id]];
+	return parent == none ? invalidTransform : m_ids[parent];
+}
+
+bool TransformHierarchy::SetLocal(TransformId id, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+	return SetPosition(id, position) && SetRotation(id, rotation) && SetScale(id, scale);
+}
+
+bool TransformHierarchy::SetPosition(TransformId id, const glm::vec3 &position)
+{
+	if (!Exists(id))
+		return false;
+
+	uint32_t i = m_indexOf[id];
+	m_posX[i] = position.x;
+	m_posY[i] = position.y;
+	m_posZ[i] = position.z;
+	MarkDirty(i);
+	return true;
+}
+
+bool TransformHierarchy::SetRotation(TransformId id, const glm::quat &rotation)
+{
+	if (!Exists(id))
+		return false;
+
+	uint32_t i = m_indexOf[id];
+	m_rotX[i] = rotation.x;
+	m_rotY[i] = rotation.y;
+	m_rotZ[i] = rotation.z;
+	m_rotW[i] = rotation.w;
+	MarkDirty(i);
+	return true;
+}
+
+bool TransformHierarchy::SetScale(TransformId id, const glm::vec3 &scale)
+{
+	if (!Exists(id))
+		return false;
+
+	uint32_t i = m_indexOf[id];
+	m_scaleX[i] = scale.x;
+	m_scaleY[i] = scale.y;
+	m_scaleZ[i] = scale.z;
+	MarkDirty(i);
+	return true;
+}
+
+glm::vec3 TransformHierarchy::GetPosition(TransformId id) const
+{
+	if (!Exists(id))
+		return glm::vec3(0.0f);
+	uint32_t i = m_indexOf[id];
+	return glm::vec3(m_posX[i], m_posY[i], m_posZ[i]);
+}
+
+glm::quat TransformHierarchy::GetRotation(TransformId id) const
+{
+	if (!Exists(id))
+		return glm::quat();
+	uint32_t i = m_indexOf[id];
+	return glm::quat(m_rotW[i], m_rotX[i], m_rotY[i], m_rotZ[i]);
+}
+
+glm::vec3 TransformHierarchy::GetScale(TransformId id) const
+{
+	if (!Exists(id))
+		return glm::vec3(1.0f);
+	uint32_t i = m_indexOf[id];
+	return glm::vec3(m_scaleX[i], m_scaleY[i], m_scaleZ[i]);
+}
+
+const glm::mat4 &TransformHierarchy::GetWorld(TransformId id) const
+{
+	return Exists(id) ? m_world[m_indexOf[id]] : identity;
+}
+
+void TransformHierarchy::Reorder()
+{
+	uint32_t numNodes = static_cast<uint32_t>(m_ids.size());
+
+	//Bucket children by parent, keeping their current relative order
+	std::vector<uint32_t> firstChild(numNodes + 1, 0);
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		if (m_parent[i] != none)
+			firstChild[m_parent[i] + 1]++;
+	}
+	for (uint32_t i = 0; i < numNodes; ++i)
+		firstChild[i + 1] += firstChild[i];
+
+	std::vector<uint32_t> children(numNodes);
+	std::vector<uint32_t> cursor(firstChild.begin(), firstChild.end() - 1);
+	std::vector<uint32_t> stack;
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		if (m_parent[i] != none)
+			children[cursor[m_parent[i]]++] = i;
+		else
+			stack.push_back(i);
+	}
+
+	//Pre-order traversal; pushed in reverse so siblings come out in order
+	std::reverse(stack.begin(), stack.end());
+	std::vector<uint32_t> order;
+	order.reserve(numNodes);
+	while (!stack.empty())
+	{
+		uint32_t node = stack.back();
+		stack.pop_back();
+		order.push_back(node);
+		for (uint32_t i = firstChild[node + 1]; i > firstChild[node]; --i)
+			stack.push_back(children[i - 1]);
+	}
+
+	std::vector<uint32_t> newIndex(numNodes);
+	for (uint32_t i = 0; i < numNodes; ++i)
+		newIndex[order[i]] = i;
+
+	Permute(m_ids, order);
+	Permute(m_parent, order);
+	Permute(m_posX, order);
+	Permute(m_posY, order);
+	Permute(m_posZ, order);
+	Permute(m_rotX, order);
+	Permute(m_rotY, order);
+	Permute(m_rotZ, order);
+	Permute(m_rotW, order);
+	Permute(m_scaleX, order);
+	Permute(m_scaleY, order);
+	Permute(m_scaleZ, order);
+	Permute(m_world, order); //Remove() reorders without updating, and GetWorld() must still see the last Update()
+
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		if (m_parent[i] != none)
+			m_parent[i] = newIndex[m_parent[i]];
+		m_indexOf[m_ids[i]] = i;
+		m_subtreeEnd[i] = i + 1;
+	}
+	for (uint32_t i = numNodes; i-- > 0;)
+	{
+		if (m_parent[i] != none)
+			m_subtreeEnd[m_parent[i]] = std::max(m_subtreeEnd[m_parent[i]], m_subtreeEnd[i]);
+	}
+
+	//Subtree order changed, so recompute everything; marking the roots covers every subtree
+	std::fill(m_dirty.begin(), m_dirty.end(), 0);
+	m_dirtyList.clear();
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		if (m_parent[i] == none)
+			MarkDirty(i);
+	}
+	m_reorder = false;
+}
+
+void TransformHierarchy::Update()
+{
+	BASILISK_PROFILE_ZONE("TransformHierarchy::Update");
+	if (m_reorder)
+		Reorder();
+	if (m_dirtyList.empty())
+		return;
+
+	//Nested subtrees are skipped, since their ancestor's range already covers them
+	uint32_t numNodes = static_cast<uint32_t>(m_ids.size());
+	if (m_dirtyList.size() > numNodes / 16)
+	{ //Cheaper to scan the flags than to sort the list
+		for (uint32_t i = 0; i < numNodes;)
+		{
+			if (m_dirty[i])
+			{
+				UpdateRange(i, m_subtreeEnd[i]);
+				i = m_subtreeEnd[i];
+			}
+			else
+				++i;
+		}
+	}
+	else
+	{
+		std::sort(m_dirtyList.begin(), m_dirtyList.end());
+		uint32_t covered = 0;
+		for (uint32_t i : m_dirtyList)
+		{
+			if (i >= covered)
+			{
+				UpdateRange(i, m_subtreeEnd[i]);
+				covered = m_subtreeEnd[i];
+			}
+		}
+	}
+
+	for (uint32_t i : m_dirtyList)
+		m_dirty[i] = 0;
+	m_dirtyList.clear();
+}
+
+void TransformHierarchy::UpdateRange(uint32_t begin, uint32_t end)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	float local[4][16];
+
+	for (uint32_t base = begin; base < end; base += 4)
+	{
+		uint32_t count = std::min(4u, end - base);
+
+		//Rotation matrices from quaternions, scaled per column, for four transforms at once
+		__m128 x = Load4(m_rotX, base, count, 0.0f);
+		__m128 y = Load4(m_rotY, base, count, 0.0f);
+		__m128 z = Load4(m_rotZ, base, count, 0.0f);
+		__m128 w = Load4(m_rotW, base, count, 1.0f);
+		__m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+		__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+		__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+		__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+		__m128 sx = Load4(m_scaleX, base, count, 1.0f);
+		__m128 sy = Load4(m_scaleY, base, count, 1.0f);
+		__m128 sz = Load4(m_scaleZ, base, count, 1.0f);
+
+		__m128 cols[4][4] = {
+			{ _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(xz, wy), sx), zero },
+			{ _mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy), _mm_mul_ps(_mm_add_ps(yz, wx), sy), zero },
+			{ _mm_mul_ps(_mm_add_ps(xz, wy), sz), _mm_mul_ps(_mm_sub_ps(yz, wx), sz), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), zero },
+			{ Load4(m_posX, base, count, 0.0f), Load4(m_posY, base, count, 0.0f), Load4(m_posZ, base, count, 0.0f), one }
+		};
+
+		//Each register holds one component of four transforms; transpose so each holds one column of one transform
+		for (int col = 0; col < 4; ++col)
+		{
+			_MM_TRANSPOSE4_PS(cols[col][0], cols[col][1], cols[col][2], cols[col][3]);
+			for (int i = 0; i < 4; ++i)
+				_mm_storeu_ps(&local[i][col * 4], cols[col][i]);
+		}
+
+		//Parents always come first, so theirs are already up to date
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t node = base + i;
+			float *world = &m_world[node][0][0];
+			if (m_parent[node] == none)
+				memcpy(world, local[i], sizeof(local[i]));
+			else
+				MultiplyAffine(&m_world[m_parent[node]][0][0], local[i], world);
+		}
+	}
+}
@@ -1,15 +1,364 @@
 /**
-\file   profiling.h
+\file   profiling.cpp
 \author Andrew Baxter
 \date February 18, 2016
 
 Operates the `Profiler` subsystem
 
-\todo Finish
-
 */
 
 #include "profiling.h"
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <cstdio>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t frameMarker = 0xFFFFFFFF; //Depth of the events written by NextFrame()
+	constexpr size_t bufferCapacity = 1 << 14; //Events per thread between flushes; must be a power of two
+	constexpr size_t maxTraceEvents = 1 << 20; //Events retained for export
+	constexpr size_t maxFrameHistory = 120; //Zone trees retained for GetFrame()
+
+	/**
+	Single-producer, single-consumer ring of finished zones
+	The owning thread writes; only the flush pass reads
+	*/
+	struct ThreadBuffer
+	{
+		std::array<ProfileEvent, bufferCapacity> events;
+		std::atomic<uint64_t> head; //Written by the owning thread
+		char padding[64];
+		std::atomic<uint64_t> tail; //Written by the flush pass
+		std::atomic<uint32_t> dropped;
+		uint32_t index;
+		const char *name;
+	};
+
+	struct ProfilerState
+	{
+		~ProfilerState() {
+			Profiler::Stop();
+		}
+
+		//Every thread which has ever recorded a zone. Buffers outlive their threads so nothing is lost.
+		std::mutex registryLock;
+		std::vector< std::unique_ptr<ThreadBuffer> > buffers;
+
+		//Background flush thread
+		std::thread flusher;
+		std::mutex wakeLock;
+		std::condition_variable wake;
+		bool running = false;
+
+		//Everything below is guarded by flushLock
+		std::mutex flushLock;
+		std::vector<ProfileEvent> pending; //Drained but not yet aggregated into a completed frame
+		std::vector<ProfileEvent> trace; //Retained for export
+		std::deque<uint64_t> frameMarks;
+		std::deque< std::vector<ZoneNode> > frames; //Most recent last
+		uint64_t droppedEvents = 0;
+	};
+
+	ProfilerState state;
+
+	thread_local ThreadBuffer *t_buffer = nullptr;
+	thread_local uint32_t t_depth = 0;
+
+	ThreadBuffer *RegisterThread()
+	{
+		std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+		buffer->head.store(0, std::memory_order_relaxed);
+		buffer->tail.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+		buffer->name = nullptr;
+
+		std::lock_guard<std::mutex> lock(state.registryLock);
+		buffer->index = static_cast<uint32_t>(state.buffers.size());
+		state.buffers.push_back(std::move(buffer));
+		return state.buffers.back().get();
+	}
+
+	void Record(const char *name, uint64_t begin, uint64_t end, uint32_t depth)
+	{
+		if (!t_buffer)
+			t_buffer = RegisterThread();
+
+		ThreadBuffer &buffer = *t_buffer;
+		uint64_t head = buffer.head.load(std::memory_order_relaxed);
+		if (head - buffer.tail.load(std::memory_order_acquire) >= bufferCapacity)
+		{ //Flush thread has fallen behind
+			buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		buffer.events[head & (bufferCapacity - 1)] = { name, begin, end, depth, buffer.index };
+		buffer.head.store(head + 1, std::memory_order_release);
+	}
+
+	/**
+	Merges a frame's events into trees, one per thread
+	Events arrive sorted by thread, then start time, so parents always come before their children
+	*/
+	std::vector<ZoneNode> BuildTree(std::vector<ProfileEvent> &events)
+	{
+		std::sort(events.begin(), events.end(), [](const ProfileEvent &a, const ProfileEvent &b) {
+			if (a.thread != b.thread) return a.thread < b.thread;
+			if (a.begin != b.begin) return a.begin < b.begin;
+			return a.depth < b.depth;
+		});
+
+		std::vector<ZoneNode> roots;
+		std::vector<size_t> path; //Child indices from the roots down to the innermost open zone
+		std::vector<uint32_t> pathDepths;
+		uint32_t thread = frameMarker;
+
+		for (const auto &iter : events)
+		{
+			if (iter.thread != thread)
+			{
+				thread = iter.thread;
+				path.clear();
+				pathDepths.clear();
+			}
+			while (!pathDepths.empty() && pathDepths.back() >= iter.depth)
+			{
+				path.pop_back();
+				pathDepths.pop_back();
+			}
+
+			std::vector<ZoneNode> *siblings = &roots;
+			for (size_t index : path)
+				siblings = &(*siblings)[index].children;
+
+			auto node = std::find_if(siblings->begin(), siblings->end(), [&](const ZoneNode &n) {
+				return n.thread == iter.thread && n.name == iter.name;
+			});
+			if (node == siblings->end())
+			{
+				siblings->push_back({ iter.name, iter.thread, 0, 0.0, {} });
+				node = siblings->end() - 1;
+			}
+			node->calls++;
+			node->milliseconds += (iter.end - iter.begin) / 1e6;
+
+			path.push_back(node - siblings->begin());
+			pathDepths.push_back(iter.depth);
+		}
+		return roots;
+	}
+
+	/**
+	Drains every thread's buffer, then aggregates any frames which are now complete
+	Caller must hold `state.flushLock`
+	*/
+	void Flush()
+	{
+		//Buffers are drained one after another, so a frame marker drained late in this pass may follow zones which
+		//closed after their own buffer was drained. Only frames which ended before the pass started are complete.
+		uint64_t drainStart = Profiler::Now();
+		{
+			std::lock_guard<std::mutex> lock(state.registryLock);
+			for (auto &iter : state.buffers)
+			{
+				ThreadBuffer &buffer = *iter;
+				uint64_t tail = buffer.tail.load(std::memory_order_relaxed);
+				uint64_t head = buffer.head.load(std::memory_order_acquire);
+				for (; tail != head; ++tail)
+				{
+					const ProfileEvent &event = buffer.events[tail & (bufferCapacity - 1)];
+					if (event.depth == frameMarker)
+					{
+						state.frameMarks.push_back(event.begin);
+						continue;
+					}
+
+					state.pending.push_back(event);
+					if (state.trace.size() < maxTraceEvents)
+						state.trace.push_back(event);
+					else
+						state.droppedEvents++;
+				}
+				buffer.tail.store(tail, std::memory_order_release);
+				state.droppedEvents += buffer.dropped.exchange(0, std::memory_order_relaxed);
+			}
+		}
+
+		//Zones are written when they close, so each frame is aggregated once the next one has started
+		while (state.frameMarks.size() >= 2 && state.frameMarks[1] < drainStart)
+		{
+			uint64_t begin = state.frameMarks[0], end = state.frameMarks[1];
+			state.frameMarks.pop_front();
+
+			auto split = std::partition(state.pending.begin(), state.pending.end(), [=](const ProfileEvent &e) {
+				return e.begin < end;
+			});
+			std::vector<ProfileEvent> frame;
+			for (auto iter = state.pending.begin(); iter != split; ++iter)
+			{
+				if (iter->end >= begin) //A zone still open when its own frame was aggregated counts where it closed
+					frame.push_back(*iter);
+			}
+			state.pending.erase(state.pending.begin(), split);
+
+			state.frames.push_back(BuildTree(frame));
+			if (state.frames.size() > maxFrameHistory)
+				state.frames.pop_front();
+		}
+
+		//NextFrame() is never being called; the events are still in the trace
+		if (state.frameMarks.empty() && state.pending.size() > maxTraceEvents)
+			state.pending.clear();
+	}
+
+	//Writes `text` as a quoted JSON string
+	void WriteString(FILE *file, const char *text)
+	{
+		fputc('"', file);
+		for (; *text; ++text)
+		{
+			unsigned char c = static_cast<unsigned char>(*text);
+			if (c == '"' || c == '\\')
+				fprintf(file, "\\%c", c);
+			else if (c < 0x20)
+				fprintf(file, "\\u%04x", c);
+			else
+				fputc(c, file);
+		}
+		fputc('"', file);
+	}
+
+	void FlushThread(uint32_t intervalMs)
+	{
+		std::unique_lock<std::mutex> lock(state.wakeLock);
+		while (state.running)
+		{
+			state.wake.wait_for(lock, std::chrono::milliseconds(intervalMs));
+			lock.unlock();
+			{
+				std::lock_guard<std::mutex> flush(state.flushLock);
+				Flush();
+			}
+			lock.lock();
+		}
+	}
+}
+
+uint64_t Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Profiler::BeginZone()
+{
+	++t_depth;
+	return Now();
+}
+
+void Profiler::EndZone(const char *name, uint64_t begin)
+{
+	Record(name, begin, Now(), --t_depth);
+}
+
+void Profiler::NextFrame()
+{
+	uint64_t now = Now();
+	Record(nullptr, now, now, frameMarker);
+}
+
+void Profiler::SetThreadName(const char *name)
+{
+	if (!t_buffer)
+		t_buffer = RegisterThread();
+
+	std::lock_guard<std::mutex> lock(state.registryLock);
+	t_buffer->name = name;
+}
+
+bool Profiler::Start(uint32_t flushIntervalMs)
+{
+	std::lock_guard<std::mutex> lock(state.wakeLock);
+	if (state.running)
+		return false;
+
+	state.running = true;
+	state.flusher = std::thread(FlushThread, flushIntervalMs);
+	return true;
+}
+
+void Profiler::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(state.wakeLock);
+		if (!state.running)
+			return;
+		state.running = false;
+	}
+	state.wake.notify_all();
+	state.flusher.join();
+
+	std::lock_guard<std::mutex> flush(state.flushLock);
+	Flush();
+}
+
+bool Profiler::GetFrame(uint32_t framesAgo, std::vector<ZoneNode> &roots)
+{
+	std::lock_guard<std::mutex> flush(state.flushLock);
+	if (framesAgo >= state.frames.size())
+		return false;
+
+	roots = state.frames[state.frames.size() - 1 - framesAgo];
+	return true;
+}
+
+bool Profiler::ExportChromeTrace(const std::string &filename)
+{
+	std::lock_guard<std::mutex> flush(state.flushLock);
+	Flush();
+
+	FILE *file = fopen(filename.c_str(), "w");
+	if (!file)
+	{
+		BASILISK_ERROR("Basilisk::Profiler::ExportChromeTrace() could not open the output file");
+		return false;
+	}
+
+	uint64_t origin = state.trace.empty() ? 0 : state.trace.front().begin;
+	for (const auto &iter : state.trace)
+		origin = std::min(origin, iter.begin);
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(state.registryLock);
+		for (const auto &iter : state.buffers)
+		{
+			if (!iter->name)
+				continue;
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", iter->index);
+			WriteString(file, iter->name);
+			fprintf(file, "}}");
+			first = false;
+		}
+	}
+	for (const auto &iter : state.trace)
+	{
+		fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+		WriteString(file, iter.name);
+		fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			iter.thread, (iter.begin - origin) / 1e3, (iter.end - iter.begin) / 1e3);
+		first = false;
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%llu}}\n", static_cast<unsigned long long>(state.droppedEvents));
 
-using namespace Basilisk;
\ No newline at end of file
+	bool ok = (ferror(file) == 0);
+	fclose(file);
+	if (!ok)
+		BASILISK_ERROR("Basilisk::Profiler::ExportChromeTrace() could not write the output file");
+	return ok;
+}
@@ -39,7 +39,7 @@ std::shared_ptr<CommandBuffer> Device::CreateCommandBuffer(uint32_t poolIndex, b
 	VkResult res = vkAllocateCommandBuffers(m_device, &cmd_info, &out->m_commandBuffer);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateCommandBuffer() could not create the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateCommandBuffer() could not create the command buffer", res);
 		return nullptr;
 	}
 
@@ -61,7 +61,7 @@ bool CommandBuffer::Begin(bool reusable)
 	VkResult res = vkBeginCommandBuffer(m_commandBuffer, &begin_info);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::CommandBuffer::Begin() could not begin writing to the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::CommandBuffer::Begin() could not begin writing to the command buffer", res);
 		return false;
 	}
 
@@ -88,7 +88,7 @@ void CommandBuffer::BindGraphicsPipeline(const std::shared_ptr<GraphicsPipeline>
 	if (pipeline)
 		vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->m_pipeline);
 	else
-		Basilisk::errors.push("Vulkan::CommandBuffer::BindGraphicsPipeline()::pipeline must not be a null pointer");
+		BASILISK_ERROR("Vulkan::CommandBuffer::BindGraphicsPipeline()::pipeline must not be a null pointer");
 }
 
 void CommandBuffer::SetLineWidth(float width)
@@ -134,6 +134,15 @@ void CommandBuffer::DrawIndexed(uint32_t count)
 	vkCmdDrawIndexed(m_commandBuffer, count, 1, 0, 0, 1);
 }
 
+void CommandBuffer::DrawIndexed(const std::vector<IndexedDraw> &draws, const std::vector<uint32_t> &visible)
+{
+	for (uint32_t object : visible)
+	{
+		const IndexedDraw &draw = draws[object];
+		vkCmdDrawIndexed(m_commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, object);
+	}
+}
+
 
 
 void CommandBuffer::EndRendering()
@@ -146,7 +155,7 @@ bool CommandBuffer::End()
 	VkResult res = vkEndCommandBuffer(m_commandBuffer);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::CommandBuffer::Begin() could not close the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::CommandBuffer::Begin() could not close the command buffer", res);
 		return false;
 	}
 
@@ -7,7 +7,6 @@
 
 */
 
-#include <sstream>
 #include "rendering/backend.h"
 using namespace Vulkan;
 
@@ -111,21 +110,16 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 {
 	if (m_gpus.size() == 0 || gpuIndex > m_gpus.size() - 1)
 	{
-		Basilisk::errors.push("Vulkan::Instance::::CreateDevice()::gpuIndex is out of GPU array bounds");
+		BASILISK_ERROR("Vulkan::Instance::::CreateDevice()::gpuIndex is out of GPU array bounds");
 		return nullptr;
 	}
 	if (VK_VERSION_MAJOR(VK_API_VERSION) != VK_VERSION_MAJOR(m_gpuProps[gpuIndex].props.apiVersion))
 	{
-		std::stringstream message("Vulkan may not operate properly without compatible API support. Application requires API version ");
-		message << VK_VERSION_MAJOR(VK_API_VERSION) << "." << VK_VERSION_MINOR(VK_API_VERSION) << "." << VK_VERSION_PATCH(VK_API_VERSION);
-		message << " but the selected GPU is using version ";
-		message << VK_VERSION_MAJOR(m_gpuProps[gpuIndex].props.apiVersion) << "." << VK_VERSION_MINOR(m_gpuProps[gpuIndex].props.apiVersion) << "." << VK_VERSION_PATCH(m_gpuProps[gpuIndex].props.apiVersion);
-
-		Basilisk::warnings.push(message.str());
+		BASILISK_WARNING_DETAIL("Vulkan may not operate properly without compatible API support. The selected GPU reports API version %u, whose major version the application does not use", m_gpuProps[gpuIndex].props.apiVersion);
 	}
 	if (!IsWindow(hWnd))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow():hWnd is not a valid window");
+		BASILISK_ERROR("Vulkan::Instance::CreateDeviceOnWindow():hWnd is not a valid window");
 		return false;
 	}
 
@@ -155,7 +149,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = pfnCreateWin32SurfaceKHR(m_instance, &surface_info, nullptr, &out->m_targetSurface.surface);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not connect to the provided window");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDeviceOnWindow() could not connect to the provided window", res);
 		return false;
 	}
 
@@ -167,7 +161,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 		res = pfnGetPhysicalDeviceSurfaceSupportKHR(m_gpus[gpuIndex], i, out->m_targetSurface.surface, &supportsPresent[i]);
 		if (Failed(res))
 		{ //Error getting the GPU's surface support
-			Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not query the GPU's surface support");
+			BASILISK_ERROR_CODE("Vulkan::Instance::CreateDeviceOnWindow() could not query the GPU's surface support", res);
 			return false;
 		}
 	}
@@ -183,7 +177,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	}
 	if (std::numeric_limits<uint32_t>::max() == out->m_targetSurface.queueIndex)
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not find a present-capable graphics queue");
+		BASILISK_ERROR("Vulkan::Instance::CreateDeviceOnWindow() could not find a present-capable graphics queue");
 		return false;
 	}
 
@@ -193,7 +187,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = pfnGetPhysicalDeviceSurfaceFormatsKHR(m_gpus[gpuIndex], out->m_targetSurface.surface, &formatCount, nullptr);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not count window surface formats");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDeviceOnWindow() could not count window surface formats", res);
 		return false;
 	}
 
@@ -201,13 +195,13 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = pfnGetPhysicalDeviceSurfaceFormatsKHR(m_gpus[gpuIndex], out->m_targetSurface.surface, &formatCount, surfFormats.data());
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not retrieve window surface formats");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDeviceOnWindow() could not retrieve window surface formats", res);
 		return false;
 	}
 
 	if (formatCount == 0)
 	{ //Surface isn't playing nice
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not find a preferred format for the window surface");
+		BASILISK_ERROR("Vulkan::Instance::CreateDeviceOnWindow() could not find a preferred format for the window surface");
 		return false;
 	}
 	else if (formatCount == 1 && surfFormats[0].format == VK_FORMAT_UNDEFINED)
@@ -224,7 +218,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = pfnGetPhysicalDeviceSurfaceCapabilitiesKHR(m_gpus[gpuIndex], out->m_targetSurface.surface, &out->m_targetSurface.caps);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not retrieve the GPU's surface capabilities");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDeviceOnWindow() could not retrieve the GPU's surface capabilities", res);
 		return false;
 	}
 
@@ -232,12 +226,12 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = pfnGetPhysicalDeviceSurfacePresentModesKHR(m_gpus[gpuIndex], out->m_targetSurface.surface, &presentModeCount, nullptr);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not count the GPU's present modes");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDeviceOnWindow() could not count the GPU's present modes", res);
 		return false;
 	}
 	if (presentModeCount == 0)
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not detect any present modes for the provided GPU");
+		BASILISK_ERROR("Vulkan::Instance::CreateDeviceOnWindow() could not detect any present modes for the provided GPU");
 		return false;
 	}
 
@@ -246,7 +240,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = pfnGetPhysicalDeviceSurfacePresentModesKHR(m_gpus[gpuIndex], out->m_targetSurface.surface, &presentModeCount, out->m_targetSurface.presentModes.data());
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDeviceOnWindow() could not list the GPU's present modes");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDeviceOnWindow() could not list the GPU's present modes", res);
 		return false;
 	}
 
@@ -281,7 +275,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = vkCreateDevice(m_gpus[gpuIndex], &device_info, nullptr, &out->m_device);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDevice() failed to create the device");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDevice() failed to create the device", res);
 		return nullptr;
 	}
 	//Store the queues we created above in the device
@@ -298,7 +292,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = vkCreateCommandPool(out->m_device, &render_pool_info, nullptr, &out->m_commandPools[graphicsIndex]);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDevice() failed to create the graphics command pool");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDevice() failed to create the graphics command pool", res);
 		return nullptr;
 	}
 
@@ -312,13 +306,13 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = vkCreateSemaphore(out->m_device, &semaphore_info, nullptr, &out->m_renderComplete);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDevice() could not create the render semaphore");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDevice() could not create the render semaphore", res);
 		return nullptr;
 	}
 	res = vkCreateSemaphore(out->m_device, &semaphore_info, nullptr, &out->m_presentComplete);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDevice() could not create the presentation semaphore");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDevice() could not create the presentation semaphore", res);
 		return nullptr;
 	}
 
@@ -333,7 +327,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	res = vkAllocateCommandBuffers(out->m_device, &cmd_buffer_info, &out->m_cmdPrePresent);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Instance::CreateDevice() could not create the required command buffers");
+		BASILISK_ERROR_CODE("Vulkan::Instance::CreateDevice() could not create the required command buffers", res);
 		return nullptr;
 	}
 	//Store submit info for graphics commands
@@ -349,7 +343,7 @@ std::shared_ptr<Device> Instance::CreateDeviceOnWindow(uint32_t gpuIndex, HWND h
 	//Normally I stray away from macros, but here it actually makes sure I don't mistype the extension string names
 #define GET_PROCADDR(name) \
 	out->pfn##name = reinterpret_cast<PFN_vk##name>(vkGetDeviceProcAddr(out->m_device, "vk"#name)); \
-	if (!out->pfn##name) { Basilisk::errors.push("Vulkan::Instance::CreateDevice() could not find the proc address for vk"#name); return nullptr; }
+	if (!out->pfn##name) { BASILISK_ERROR("Vulkan::Instance::CreateDevice() could not find the proc address for vk"#name); return nullptr; }
 
 	//Store VK_KHR_swapchain function pointers
 	GET_PROCADDR(CreateSwapchainKHR);
@@ -398,7 +392,7 @@ std::shared_ptr<PipelineLayout> Device::CreatePipelineLayout(const std::vector<D
 		&out->m_setLayout);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreatePipelineLayout() could not create the descriptor set layout");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreatePipelineLayout() could not create the descriptor set layout", res);
 		return nullptr;
 	}
 
@@ -415,7 +409,7 @@ std::shared_ptr<PipelineLayout> Device::CreatePipelineLayout(const std::vector<D
 	res = vkCreatePipelineLayout(m_device, &pipeline_info, nullptr, &out->m_layout);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulan::Device::CreatePipelineLayout() could not create the pipeline layout");
+		BASILISK_ERROR_CODE("Vulan::Device::CreatePipelineLayout() could not create the pipeline layout", res);
 		return nullptr;
 	}
 
@@ -438,14 +432,14 @@ bool Device::ExecuteCommands(const std::vector<std::shared_ptr<CommandBuffer>> &
 		res = vkQueueSubmit(m_queues[graphicsIndex], 1, &m_submitInfo, VK_NULL_HANDLE);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::ExecuteCommands() could not submit the commands to the graphics queue");
+			BASILISK_ERROR_CODE("Vulkan::Device::ExecuteCommands() could not submit the commands to the graphics queue", res);
 			return false;
 		}
 		else return true;
 	}
 	else
 	{
-		Basilisk::errors.push("Vulkan::Device::ExecuteCommands()::commands must not be empty");
+		BASILISK_ERROR("Vulkan::Device::ExecuteCommands()::commands must not be empty");
 		return false;
 	}
 }
@@ -478,7 +472,7 @@ bool Device::PrePresent(const std::shared_ptr<SwapChain> &swapChain)
 	VkResult res = vkBeginCommandBuffer(m_cmdPrePresent, &begin_info);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::PrePresent() could not begin the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::Device::PrePresent() could not begin the command buffer", res);
 		return false;
 	}
 
@@ -494,14 +488,14 @@ bool Device::PrePresent(const std::shared_ptr<SwapChain> &swapChain)
 	res = vkEndCommandBuffer(m_cmdPrePresent);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::PrePresent() could not end the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::Device::PrePresent() could not end the command buffer", res);
 		return false;
 	}
 
 	res = vkQueueSubmit(m_queues[graphicsIndex], 1, &submit_info, VK_NULL_HANDLE);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::PrePresent() could not submit the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::Device::PrePresent() could not submit the command buffer", res);
 		return false;
 	}
 
@@ -517,9 +511,10 @@ bool Device::Present(const std::shared_ptr<SwapChain> &swapChain)
 	present_info.pSwapchains = &swapChain->m_swapChain;
 	present_info.pImageIndices = swapChain->GetBufferIndex();
 
-	if (Failed(pfnQueuePresentKHR(m_queues[graphicsIndex], &present_info)))
+	VkResult res = pfnQueuePresentKHR(m_queues[graphicsIndex], &present_info);
+	if (Failed(res))
 	{
-		Basilisk::errors.push("Failed to present swap chain");
+		BASILISK_ERROR_CODE("Vulkan::Device::Present() could not present the swap chain", res);
 		return false;
 	}
 	else return true;
@@ -553,7 +548,7 @@ bool Device::PostPresent(const std::shared_ptr<SwapChain> &swapChain)
 	VkResult res = vkBeginCommandBuffer(m_cmdPostPresent, &begin_info);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::PostPresent() could not begin the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::Device::PostPresent() could not begin the command buffer", res);
 		return false;
 	}
 
@@ -569,14 +564,14 @@ bool Device::PostPresent(const std::shared_ptr<SwapChain> &swapChain)
 	res = vkEndCommandBuffer(m_cmdPostPresent);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::PostPresent() could not end the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::Device::PostPresent() could not end the command buffer", res);
 		return false;
 	}
 
 	res = vkQueueSubmit(m_queues[graphicsIndex], 1, &submit_info, VK_NULL_HANDLE);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::PrePresent() could not submit the command buffer");
+		BASILISK_ERROR_CODE("Vulkan::Device::PrePresent() could not submit the command buffer", res);
 		return false;
 	}
 
@@ -83,7 +83,7 @@ bool FrameBuffer::SetClearValues(std::vector<VkClearValue> clearValues)
 	}
 	else
 	{
-		Basilisk::errors.push("Vulkan::FrameBuffer::SetClearValues()::clearValues does not contain the correct amount of values");
+		BASILISK_ERROR("Vulkan::FrameBuffer::SetClearValues()::clearValues does not contain the correct amount of values");
 		return false;
 	}
 }
@@ -92,7 +92,7 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 {
 	if (colorAttachments.size() == 0 && !depthBuffer)
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() must have at least one attachment");
+		BASILISK_ERROR("Vulkan::Device::CreateFrameBuffer() must have at least one attachment");
 		return nullptr;
 	}
 
@@ -163,7 +163,7 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 		res = vkCreateImage(m_device, &colorAttachments[i].image, nullptr, &out->m_images[i]);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not create all color images");
+			BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not create all color images", res);
 			return nullptr;
 		}
 
@@ -172,19 +172,19 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 		memAlloc.allocationSize = memReqs.size;
 		if (!MemoryTypeFromProps(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAlloc.memoryTypeIndex))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not determine appropriate memory type for all color images");
+			BASILISK_ERROR("Vulkan::Device::CreateFrameBuffer() could not determine appropriate memory type for all color images");
 			return nullptr;
 		}
 		res = vkAllocateMemory(m_device, &memAlloc, nullptr, &out->m_memory[i]);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not allocate memory for all color images");
+			BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not allocate memory for all color images", res);
 			return nullptr;
 		}
 		vkBindImageMemory(m_device, out->m_images[i], out->m_memory[i], 0);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not bind memory for all color images");
+			BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not bind memory for all color images", res);
 			return nullptr;
 		}
 
@@ -194,7 +194,7 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 		res = vkCreateImageView(m_device, &view_create_info, nullptr, &out->m_views[i]);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not create an image view for all color buffers");
+			BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not create an image view for all color buffers", res);
 			return nullptr;
 		}
 	}
@@ -209,7 +209,7 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 		VkImageCreateInfo depth_image_info = ImageCreateInfo(VK_IMAGE_TYPE_2D, m_gpuProps.depthFormat, { colorAttachments[0].image.extent.width, colorAttachments[0].image.extent.height, 1 }, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 		res = vkCreateImage(m_device, &depth_image_info, nullptr, &out->m_images[i]);
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not creat the depth stencil image");
+			BASILISK_ERROR("Vulkan::Device::CreateFrameBuffer() could not creat the depth stencil image");
 			return nullptr;
 		}
 
@@ -218,19 +218,19 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 		memAlloc.allocationSize = memReqs.size;
 		if (!MemoryTypeFromProps(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAlloc.memoryTypeIndex))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not determine appropriate memory type for the depth stencil image");
+			BASILISK_ERROR("Vulkan::Device::CreateFrameBuffer() could not determine appropriate memory type for the depth stencil image");
 			return nullptr;
 		}
 		res = vkAllocateMemory(m_device, &memAlloc, nullptr, &out->m_memory[i]);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not allocate memory for the depth stencil image");
+			BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not allocate memory for the depth stencil image", res);
 			return nullptr;
 		}
 		vkBindImageMemory(m_device, out->m_images[i], out->m_memory[i], 0);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not bind memory for the depth stencil image");
+			BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not bind memory for the depth stencil image", res);
 			return nullptr;
 		}
 
@@ -240,7 +240,7 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 		res = vkCreateImageView(m_device, &view_create_info, nullptr, &out->m_views[i]);
 		if (Failed(res))
 		{
-			Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not create an image view for all color buffers");
+			BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not create an image view for all color buffers", res);
 			return nullptr;
 		}
 	}
@@ -248,7 +248,7 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 	res = vkCreateRenderPass(m_device, &rp_create_info, nullptr, &out->m_renderPass);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateFrameBuffer() could not create the render pass");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateFrameBuffer() could not create the render pass", res);
 		return nullptr;
 	}
 
@@ -258,7 +258,7 @@ std::shared_ptr<FrameBuffer> Device::CreateFrameBuffer(std::vector<AttachmentInf
 	res = vkCreateFramebuffer(m_device, &fb_create_info, nullptr, &out->m_frameBuffer);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Basilisk::Device::CreateFrameBuffer() could not create the frame buffer");
+		BASILISK_ERROR_CODE("Basilisk::Device::CreateFrameBuffer() could not create the frame buffer", res);
 		return nullptr;
 	}
 
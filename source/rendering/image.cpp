@@ -10,7 +10,7 @@ Defines the behavior of the half-built Vulkan::Image class, and helps with
 #include "rendering/backend.h"
 using namespace Vulkan;
 
-VkImageCreateInfo Vulkan::ImageCreateInfo(VkImageType dimensionality, VkFormat format, VkExtent3D resolution, VkImageUsageFlags usage, VkImageLayout initialLayout)
+VkImageCreateInfo Vulkan::ImageCreateInfo(VkImageType dimensionality, VkFormat format, VkExtent3D resolution, VkImageUsageFlags usage, VkImageLayout initialLayout, uint32_t mipLevels)
 {
 	return {
 		VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -19,7 +19,7 @@ VkImageCreateInfo Vulkan::ImageCreateInfo(VkImageType dimensionality, VkFormat f
 		dimensionality,
 		format,
 		resolution,
-		1, //Mip levels
+		mipLevels, //Mip levels, as from FreeImage_GetMipmapCount() for a texture whose chain came from FreeImage_GenerateMipmaps()
 		1, //Array levels
 		VK_SAMPLE_COUNT_1_BIT,
 		VK_IMAGE_TILING_OPTIMAL,
@@ -111,14 +111,14 @@ std::shared_ptr<Instance> Vulkan::Initialize(const std::string &appName, uint32_
 	VkResult result = vkCreateInstance(&instanceInfo, nullptr, &out->m_instance);
 	if (Failed(result))
 	{
-		Basilisk::errors.push("Vulkan::Initialize() could not create a Vulkan Instance");
+		BASILISK_ERROR_CODE("Vulkan::Initialize() could not create a Vulkan Instance", result);
 		return nullptr;
 	}
 
 //Normally I wouldn't use macros, but it actually makes sure I don't mistype the extension string names (in addition to simplifying the code)
 #define GET_PROCADDR(name) \
 	out->pfn##name = reinterpret_cast<PFN_vk##name>(vkGetInstanceProcAddr(out->m_instance, "vk"#name)); \
-	if (!out->pfn##name) { Basilisk::errors.push("Vulkan::Initialize() could not find the proc address for vk"#name); return nullptr; }
+	if (!out->pfn##name) { BASILISK_ERROR("Vulkan::Initialize() could not find the proc address for vk"#name); return nullptr; }
 
 	//Store VK_KHR_surface function pointers
 	GET_PROCADDR(DestroySurfaceKHR);
@@ -145,7 +145,7 @@ uint32_t Instance::FindGpus()
 	result = vkEnumeratePhysicalDevices(m_instance, &count, nullptr);
 	if (Failed(result))
 	{
-		Basilisk::errors.push("Vulkan::Instance::::FindGpus() could not count physical devices");
+		BASILISK_ERROR_CODE("Vulkan::Instance::::FindGpus() could not count physical devices", result);
 		return 0;
 	}
 	//Resize our arrays to store all devices
@@ -155,7 +155,7 @@ uint32_t Instance::FindGpus()
 	result = vkEnumeratePhysicalDevices(m_instance, &count, m_gpus.data());
 	if (Failed(result))
 	{
-		Basilisk::errors.push("Vulkan::Instance::::FindGpus() could not list physical devices");
+		BASILISK_ERROR_CODE("Vulkan::Instance::::FindGpus() could not list physical devices", result);
 		return 0;
 	}
 
@@ -198,7 +198,7 @@ uint32_t Instance::FindGpus()
 		}
 		if (VK_FORMAT_UNDEFINED == m_gpuProps[i].depthFormat)
 		{
-			Basilisk::warnings.push("Vulkan::Instance::::FindGpus() could not find a depth format for GPU at index " + std::to_string(i));
+			BASILISK_WARNING_DETAIL("Vulkan::Instance::::FindGpus() could not find a depth format for GPU at index %u", i);
 		}
 	}
 
@@ -209,7 +209,7 @@ const GpuProperties *Instance::GetGpuProperties(uint32_t gpuIndex)
 {
 	if (m_gpuProps.size() < 0 || gpuIndex > m_gpuProps.size() - 1)
 	{
-		Basilisk::warnings.push("Vulkan::Instance::GetGpuProperties() called on a nonexisted GPU (at index " + std::to_string(gpuIndex) + ")");
+		BASILISK_WARNING_DETAIL("Vulkan::Instance::GetGpuProperties() called on a nonexisted GPU (at index %u)", gpuIndex);
 		return nullptr;
 	}
 	else
@@ -46,7 +46,7 @@ std::shared_ptr<Shader> Device::CreateShaderFromSPIRV(const std::vector<uint32_t
 	VkResult res = vkCreateShaderModule(m_device, &create_info, nullptr, &out->m_module);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateShaderFromSPIRV() failed");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateShaderFromSPIRV() failed", res);
 		return nullptr;
 	}
 
@@ -59,7 +59,7 @@ std::shared_ptr<Shader> Device::CreateShaderFromGLSL(const std::string &source,
 	std::bitset<sizeof(VkShaderStageFlagBits)*8> bits(stage);
 	if (bits.count() != 1)
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateShaderFromGLSL()::stage must have a single bit set");
+		BASILISK_ERROR("Vulkan::Device::CreateShaderFromGLSL()::stage must have a single bit set");
 		return nullptr;
 	}
 
@@ -92,7 +92,7 @@ std::shared_ptr<Shader> Device::CreateShaderFromGLSL(const std::string &source,
 	VkResult res = vkCreateShaderModule(m_device, &create_info, nullptr, &out->m_module);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateShaderFromGLSL() failed");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateShaderFromGLSL() failed", res);
 		return nullptr;
 	}
 
@@ -319,7 +319,7 @@ std::shared_ptr<GraphicsPipeline> Device::CreateGraphicsPipeline(const std::shar
 	VkResult res = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &out->m_pipeline);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateGraphicsPipeline() could not create the graphics pipeline");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateGraphicsPipeline() could not create the graphics pipeline", res);
 		return nullptr;
 	}
 
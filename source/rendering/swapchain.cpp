@@ -126,7 +126,7 @@ std::shared_ptr<SwapChain> Device::CreateSwapChain(VkSwapchainCreateInfoKHR &swa
 	VkResult res = pfnCreateSwapchainKHR(m_device, &swapchain_info, nullptr, &out->m_swapChain);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateSwapChain() could not create the swap chain");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateSwapChain() could not create the swap chain", res);
 		return nullptr;
 	}
 
@@ -135,7 +135,7 @@ std::shared_ptr<SwapChain> Device::CreateSwapChain(VkSwapchainCreateInfoKHR &swa
 	res = pfnGetSwapchainImagesKHR(m_device, out->m_swapChain, &swapchain_info.minImageCount, nullptr);
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateSwapChain() could not count the swap chain's back buffers");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateSwapChain() could not count the swap chain's back buffers", res);
 		return nullptr;
 	}
 
@@ -144,7 +144,7 @@ std::shared_ptr<SwapChain> Device::CreateSwapChain(VkSwapchainCreateInfoKHR &swa
 	res = pfnGetSwapchainImagesKHR(m_device, out->m_swapChain, &swapchain_info.minImageCount, out->m_images.data());
 	if (Failed(res))
 	{
-		Basilisk::errors.push("Vulkan::Device::CreateSwapChain() could not count the swap chain's back buffers");
+		BASILISK_ERROR_CODE("Vulkan::Device::CreateSwapChain() could not count the swap chain's back buffers", res);
 		return nullptr;
 	}
 
@@ -0,0 +1,138 @@
+/**
+\file   mesh.cpp
+\author Andrew Baxter
+\date   April 6, 2016
+
+Loads cooked meshes
+
+*/
+
+#include "resources/mesh.h"
+#include <cstdio>
+
+using namespace Basilisk;
+using namespace Basilisk::MeshFile;
+
+Mesh::Mesh() : m_attributes(nullptr), m_materials(nullptr), m_submeshes(nullptr), m_lods(nullptr),
+	m_meshletRanges(nullptr), m_meshlets(nullptr), m_meshletVertices(nullptr), m_meshletTriangles(nullptr), m_vertices(nullptr), m_indices(nullptr),
+	m_numAttributes(0), m_numMaterials(0), m_numSubmeshes(0), m_numVertices(0), m_numIndices(0)
+{
+
+}
+
+bool Mesh::Load(const std::string &filename, bool deep)
+{
+	Clear();
+
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+	{
+		BASILISK_ERROR("Basilisk::Mesh::Load() could not open the file");
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size <= 0)
+	{
+		fclose(file);
+		BASILISK_ERROR("Basilisk::Mesh::Load() could not determine the size of the file");
+		return false;
+	}
+
+	m_data.resize((static_cast<size_t>(size) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	bool ok = (fread(m_data.data(), 1, static_cast<size_t>(size), file) == static_cast<size_t>(size));
+	fclose(file);
+
+	const uint8_t *data = reinterpret_cast<const uint8_t*>(m_data.data());
+	if (!ok || !Validate(data, static_cast<size_t>(size), deep))
+	{
+		BASILISK_ERROR("Basilisk::Mesh::Load() could not load the mesh");
+		Clear();
+		return false;
+	}
+
+	const Section *attributes = FindSection(data, SectionType::Attributes);
+	const Section *materials = FindSection(data, SectionType::Materials);
+	const Section *submeshes = FindSection(data, SectionType::Submeshes);
+	const Section *vertices = FindSection(data, SectionType::Vertices);
+	const Section *indices = FindSection(data, SectionType::Indices);
+
+	m_attributes = reinterpret_cast<const Attribute*>(data + attributes->offset);
+	m_materials = reinterpret_cast<const Material*>(data + materials->offset);
+	m_submeshes = reinterpret_cast<const Submesh*>(data + submeshes->offset);
+	m_vertices = data + vertices->offset;
+	m_indices = data + indices->offset;
+	m_numAttributes = static_cast<uint32_t>(attributes->count);
+	m_numMaterials = static_cast<uint32_t>(materials->count);
+	m_numSubmeshes = static_cast<uint32_t>(submeshes->count);
+	m_numVertices = static_cast<uint32_t>(vertices->count);
+	m_numIndices = static_cast<uint32_t>(indices->count);
+
+	const Section *lods = FindSection(data, SectionType::Lods);
+	m_lods = lods ? reinterpret_cast<const Lod*>(data + lods->offset) : nullptr;
+	m_firstLods.resize(m_numSubmeshes);
+	uint32_t firstLod = 0;
+	for (uint32_t i = 0; i < m_numSubmeshes; ++i)
+	{
+		m_firstLods[i] = firstLod;
+		firstLod += m_submeshes[i].numLods;
+	}
+
+	//Validation made sure the other three meshlet sections are there too
+	const Section *meshletRanges = FindSection(data, SectionType::MeshletRanges);
+	if (meshletRanges)
+	{
+		m_meshletRanges = reinterpret_cast<const MeshletRange*>(data + meshletRanges->offset);
+		m_meshlets = reinterpret_cast<const Meshlet*>(data + FindSection(data, SectionType::Meshlets)->offset);
+		m_meshletVertices = reinterpret_cast<const uint32_t*>(data + FindSection(data, SectionType::MeshletVertices)->offset);
+		m_meshletTriangles = data + FindSection(data, SectionType::MeshletTriangles)->offset;
+	}
+	return true;
+}
+
+void Mesh::Clear()
+{
+	m_data.clear();
+	m_data.shrink_to_fit();
+	m_attributes = nullptr;
+	m_materials = nullptr;
+	m_submeshes = nullptr;
+	m_lods = nullptr;
+	m_firstLods.clear();
+	m_meshletRanges = nullptr;
+	m_meshlets = nullptr;
+	m_meshletVertices = nullptr;
+	m_meshletTriangles = nullptr;
+	m_vertices = nullptr;
+	m_indices = nullptr;
+	m_numAttributes = m_numMaterials = m_numSubmeshes = m_numVertices = m_numIndices = 0;
+}
+
+const Attribute *Mesh::FindAttribute(Semantic semantic) const
+{
+	for (uint32_t i = 0; i < m_numAttributes; ++i)
+	{
+		if (m_attributes[i].semantic == semantic)
+			return &m_attributes[i];
+	}
+	return nullptr;
+}
+
+const char *Mesh::MaterialName(uint32_t material) const
+{
+	return (material < m_numMaterials) ? m_materials[material].name : nullptr;
+}
+
+Lod Mesh::SelectLod(uint32_t submesh, float errorScale, float threshold) const
+{
+	const Submesh &iter = m_submeshes[submesh];
+	Lod out = { iter.firstIndex, iter.indexCount, 0.0f, 0 };
+
+	//Errors only grow, so stop at the first one which is too large
+	const Lod *lods = Lods(submesh);
+	for (uint32_t i = 0; i < iter.numLods && lods[i].error * errorScale <= threshold; ++i)
+		out = lods[i];
+	return out;
+}
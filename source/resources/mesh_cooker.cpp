@@ -0,0 +1,510 @@
+/**
+\file   mesh_cooker.cpp
+\author Andrew Baxter
+\date   April 6, 2016
+
+Gathers assimp meshes, then quantises and interleaves them into the cooked mesh format
+
+*/
+
+#include "resources/mesh_cooker.h"
+#include "core/task_graph.h"
+#include <assimp/scene.h>
+#include <glm/glm/gtc/packing.hpp>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+
+using namespace Basilisk;
+using namespace Basilisk::MeshFile;
+
+namespace
+{
+	//Which optional attributes any of the source meshes had
+	struct Layout
+	{
+		bool normals = false;
+		bool tangents = false;
+		bool texCoords[2] = { false, false };
+		bool colors = false;
+	};
+
+	constexpr float normalWeight = 0.5f; //How much the simplifier cares about each attribute, relative to position
+	constexpr float texCoordWeight = 1.0f;
+	constexpr float colorWeight = 0.5f;
+	constexpr float minLodReduction = 0.8f; //A level of detail with more than this fraction of the last one's triangles isn't worth keeping
+
+	struct SourceLod
+	{
+		std::vector<uint32_t> indices;
+		float error;
+	};
+
+	//One `aiMesh`, reduced to triangles and full-precision attributes
+	struct SourceMesh
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec4> tangents; //w holds the bitangent's sign
+		std::vector<glm::vec2> texCoords[2];
+		std::vector<glm::vec4> colors;
+		std::vector<uint32_t> indices;
+		std::vector<SourceLod> lods;
+		std::vector<Meshlet> meshlets; //With offsets into this mesh's own arrays
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		uint32_t material;
+		glm::vec3 boundsMin, boundsMax;
+	};
+
+	inline uint64_t AlignBlob(uint64_t offset)
+	{
+		return (offset + blobAlignment - 1) & ~(blobAlignment - 1);
+	}
+
+	inline glm::vec3 ToVec3(const aiVector3D &v)
+	{
+		return glm::vec3(v.x, v.y, v.z);
+	}
+
+	glm::vec3 SafeNormalize(const glm::vec3 &v, const glm::vec3 &fallback)
+	{
+		float length = glm::length(v);
+		return (length > 1e-12f) ? v / length : fallback;
+	}
+
+	//Reads AI_MATKEY_NAME without aiGetMaterialString(), which would need the assimp library
+	void MaterialName(const aiMaterial &material, char (&name)[maxNameLength])
+	{
+		memset(name, 0, maxNameLength);
+		for (unsigned i = 0; i < material.mNumProperties; ++i)
+		{
+			const aiMaterialProperty &prop = *material.mProperties[i];
+			if (prop.mType != aiPTI_String || prop.mDataLength < sizeof(uint32_t) || strcmp(prop.mKey.C_Str(), "?mat.name") != 0)
+				continue;
+
+			//Strings are stored as a 32-bit length followed by the characters
+			uint32_t length;
+			memcpy(&length, prop.mData, sizeof(uint32_t));
+			length = std::min<uint32_t>(length, std::min<uint32_t>(prop.mDataLength - sizeof(uint32_t), maxNameLength - 1));
+			memcpy(name, prop.mData + sizeof(uint32_t), length);
+			return;
+		}
+	}
+
+	bool Gather(const aiMesh &src, SourceMesh &dst)
+	{
+		if (!src.HasPositions() || !src.HasFaces() || !(src.mPrimitiveTypes & aiPrimitiveType_TRIANGLE))
+			return false;
+
+		dst.indices.reserve(src.mNumFaces * 3);
+		for (unsigned i = 0; i < src.mNumFaces; ++i)
+		{
+			const aiFace &face = src.mFaces[i];
+			if (face.mNumIndices == 3)
+				dst.indices.insert(dst.indices.end(), face.mIndices, face.mIndices + 3);
+		}
+		if (dst.indices.empty())
+			return false;
+
+		uint32_t count = src.mNumVertices;
+		dst.material = src.mMaterialIndex;
+		dst.positions.resize(count);
+		dst.boundsMin = glm::vec3(FLT_MAX);
+		dst.boundsMax = glm::vec3(-FLT_MAX);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			dst.positions[i] = ToVec3(src.mVertices[i]);
+			dst.boundsMin = glm::min(dst.boundsMin, dst.positions[i]);
+			dst.boundsMax = glm::max(dst.boundsMax, dst.positions[i]);
+		}
+
+		if (src.HasNormals())
+		{
+			dst.normals.resize(count);
+			for (uint32_t i = 0; i < count; ++i)
+				dst.normals[i] = SafeNormalize(ToVec3(src.mNormals[i]), glm::vec3(0.0f, 0.0f, 1.0f));
+		}
+		if (src.HasNormals() && src.HasTangentsAndBitangents())
+		{
+			dst.tangents.resize(count);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				glm::vec3 tangent = SafeNormalize(ToVec3(src.mTangents[i]), glm::vec3(1.0f, 0.0f, 0.0f));
+				float sign = (glm::dot(glm::cross(dst.normals[i], tangent), ToVec3(src.mBitangents[i])) < 0.0f) ? -1.0f : 1.0f;
+				dst.tangents[i] = glm::vec4(tangent, sign);
+			}
+		}
+		for (unsigned set = 0; set < 2; ++set)
+		{
+			if (!src.HasTextureCoords(set))
+				continue;
+			dst.texCoords[set].resize(count);
+			for (uint32_t i = 0; i < count; ++i)
+				dst.texCoords[set][i] = glm::vec2(src.mTextureCoords[set][i].x, src.mTextureCoords[set][i].y);
+		}
+		if (src.HasVertexColors(0))
+		{
+			dst.colors.resize(count);
+			for (uint32_t i = 0; i < count; ++i)
+				dst.colors[i] = glm::vec4(src.mColors[0][i].r, src.mColors[0][i].g, src.mColors[0][i].b, src.mColors[0][i].a);
+		}
+		return true;
+	}
+
+	template<typename T>
+	void Remap(std::vector<T> &attribute, const std::vector<uint32_t> &remap, uint32_t numUsed)
+	{
+		if (attribute.empty())
+			return;
+		std::vector<T> out(numUsed);
+		RemapVertices(out.data(), attribute.data(), static_cast<uint32_t>(attribute.size()), remap.data());
+		attribute.swap(out);
+	}
+
+	//Reorders a mesh's triangles and vertices, dropping vertices no triangle uses
+	MeshOptimizeStats Optimize(SourceMesh &mesh, uint32_t stride, float overdrawThreshold)
+	{
+		std::vector<uint32_t> remap;
+		MeshOptimizeStats stats = OptimizeMesh(mesh.indices, mesh.positions.data(), static_cast<uint32_t>(mesh.positions.size()), stride, remap, overdrawThreshold);
+
+		uint32_t numUsed = static_cast<uint32_t>(std::count_if(remap.begin(), remap.end(), [](uint32_t v) { return v != unusedVertex; }));
+		Remap(mesh.positions, remap, numUsed);
+		Remap(mesh.normals, remap, numUsed);
+		Remap(mesh.tangents, remap, numUsed);
+		Remap(mesh.texCoords[0], remap, numUsed);
+		Remap(mesh.texCoords[1], remap, numUsed);
+		Remap(mesh.colors, remap, numUsed);
+
+		mesh.boundsMin = glm::vec3(FLT_MAX);
+		mesh.boundsMax = glm::vec3(-FLT_MAX);
+		for (const auto &iter : mesh.positions)
+		{
+			mesh.boundsMin = glm::min(mesh.boundsMin, iter);
+			mesh.boundsMax = glm::max(mesh.boundsMax, iter);
+		}
+		return stats;
+	}
+
+	//Simplifies each level of detail from the last, so the errors add up to a bound on the distance from the full mesh
+	void BuildLods(SourceMesh &mesh, const MeshCookOptions &options)
+	{
+		uint32_t count = static_cast<uint32_t>(mesh.positions.size());
+		std::vector<float> weights;
+		if (!mesh.normals.empty())
+			weights.insert(weights.end(), 3, normalWeight);
+		for (const auto &set : mesh.texCoords)
+		{
+			if (!set.empty())
+				weights.insert(weights.end(), 2, texCoordWeight);
+		}
+		if (!mesh.colors.empty())
+			weights.insert(weights.end(), 4, colorWeight);
+
+		uint32_t numAttributes = static_cast<uint32_t>(weights.size());
+		std::vector<float> attributes(size_t(count) * numAttributes);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float *dst = attributes.data() + size_t(i) * numAttributes;
+			if (!mesh.normals.empty())
+				dst = std::copy(&mesh.normals[i].x, &mesh.normals[i].x + 3, dst);
+			for (const auto &set : mesh.texCoords)
+			{
+				if (!set.empty())
+					dst = std::copy(&set[i].x, &set[i].x + 2, dst);
+			}
+			if (!mesh.colors.empty())
+				std::copy(&mesh.colors[i].x, &mesh.colors[i].x + 4, dst);
+		}
+
+		glm::vec3 size = mesh.boundsMax - mesh.boundsMin;
+		float maxError = options.lodMaxError * std::max(size.x, std::max(size.y, size.z));
+		float error = 0.0f;
+		for (uint32_t level = 0; level < options.maxLods && error < maxError; ++level)
+		{
+			const std::vector<uint32_t> &previous = mesh.lods.empty() ? mesh.indices : mesh.lods.back().indices;
+			SourceLod lod;
+			lod.indices.resize(previous.size());
+			size_t target = static_cast<size_t>(previous.size() / 3 * options.lodReduction) * 3;
+			float lodError;
+			lod.indices.resize(SimplifyMesh(lod.indices.data(), previous.data(), previous.size(), mesh.positions.data(), count,
+				numAttributes ? attributes.data() : nullptr, numAttributes, weights.data(), numAttributes, target, maxError - error, &lodError));
+			if (lod.indices.empty() || lod.indices.size() > previous.size() * minLodReduction)
+				break;
+
+			if (options.optimize)
+			{
+				OptimizeVertexCache(lod.indices.data(), lod.indices.data(), lod.indices.size(), count);
+				OptimizeOverdraw(lod.indices.data(), lod.indices.data(), lod.indices.size(), mesh.positions.data(), count, options.overdrawThreshold);
+			}
+			error += lodError;
+			lod.error = error;
+			mesh.lods.push_back(std::move(lod));
+		}
+	}
+
+	//Writes one mesh's vertices into the interleaved stream, quantised to the formats in `attributes`
+	void Interleave(const SourceMesh &src, const std::vector<Attribute> &attributes, uint32_t stride,
+		const glm::vec3 &boundsMin, const glm::vec3 &scale, uint8_t *out)
+	{
+		for (size_t i = 0; i < src.positions.size(); ++i, out += stride)
+		{
+			for (const auto &attr : attributes)
+			{
+				uint8_t *dst = out + attr.offset;
+				uint32_t packed;
+				switch (attr.semantic)
+				{
+				case Semantic::Position:
+				{
+					uint64_t position = glm::packUnorm4x16(glm::vec4((src.positions[i] - boundsMin) * scale, 1.0f));
+					memcpy(dst, &position, sizeof(uint64_t));
+					continue;
+				}
+				case Semantic::Normal:
+					packed = glm::packSnorm4x8(glm::vec4(src.normals.empty() ? glm::vec3(0.0f, 0.0f, 1.0f) : src.normals[i], 0.0f));
+					break;
+				case Semantic::Tangent:
+					packed = glm::packSnorm4x8(src.tangents.empty() ? glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) : src.tangents[i]);
+					break;
+				case Semantic::TexCoord0:
+				case Semantic::TexCoord1:
+				{
+					const auto &set = src.texCoords[attr.semantic == Semantic::TexCoord0 ? 0 : 1];
+					packed = glm::packHalf2x16(set.empty() ? glm::vec2(0.0f) : set[i]);
+					break;
+				}
+				case Semantic::Color:
+					packed = glm::packUnorm4x8(src.colors.empty() ? glm::vec4(1.0f) : src.colors[i]);
+					break;
+				default:
+					continue;
+				}
+				memcpy(dst, &packed, sizeof(uint32_t));
+			}
+		}
+	}
+}
+
+bool Basilisk::CookMesh(const aiScene &scene, std::vector<uint8_t> &blob, const MeshCookOptions &options, std::vector<MeshOptimizeStats> *stats)
+{
+	blob.clear();
+
+	std::vector<SourceMesh> meshes;
+	Layout layout;
+	for (unsigned i = 0; i < scene.mNumMeshes; ++i)
+	{
+		SourceMesh mesh;
+		if (!Gather(*scene.mMeshes[i], mesh))
+			continue;
+
+		layout.normals |= !mesh.normals.empty();
+		layout.tangents |= !mesh.tangents.empty();
+		layout.texCoords[0] |= !mesh.texCoords[0].empty();
+		layout.texCoords[1] |= !mesh.texCoords[1].empty();
+		layout.colors |= !mesh.colors.empty();
+		meshes.push_back(std::move(mesh));
+	}
+	if (meshes.empty())
+	{
+		BASILISK_ERROR("Basilisk::CookMesh() found no triangles in the scene");
+		return false;
+	}
+
+	//Lay out a vertex, largest attributes first
+	std::vector<Attribute> attributes;
+	uint32_t stride = 0;
+	auto addAttribute = [&](Semantic semantic, VkFormat format, uint32_t size) {
+		attributes.push_back({ semantic, format, stride, 0 });
+		stride += size;
+	};
+	addAttribute(Semantic::Position, VK_FORMAT_R16G16B16A16_UNORM, 8);
+	if (layout.normals)
+		addAttribute(Semantic::Normal, VK_FORMAT_R8G8B8A8_SNORM, 4);
+	if (layout.tangents)
+		addAttribute(Semantic::Tangent, VK_FORMAT_R8G8B8A8_SNORM, 4);
+	if (layout.texCoords[0])
+		addAttribute(Semantic::TexCoord0, VK_FORMAT_R16G16_SFLOAT, 4);
+	if (layout.texCoords[1])
+		addAttribute(Semantic::TexCoord1, VK_FORMAT_R16G16_SFLOAT, 4);
+	if (layout.colors)
+		addAttribute(Semantic::Color, VK_FORMAT_R8G8B8A8_UNORM, 4);
+
+	//Each mesh is independent, so the result doesn't depend on scheduling.
+	//Levels of detail come after optimising, so they only use vertices in the full mesh's new order,
+	//and meshlets are built from the optimised order so they come out roughly in the order the mesh is drawn.
+	if (options.optimize || options.maxLods > 0 || options.meshlets)
+	{
+		std::vector<MeshOptimizeStats> results(meshes.size());
+		TaskGraph graph(options.numThreads);
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			graph.Add([&, i] {
+				if (options.optimize)
+					results[i] = Optimize(meshes[i], stride, options.overdrawThreshold);
+				BuildLods(meshes[i], options);
+				if (options.meshlets)
+				{
+					SourceMesh &mesh = meshes[i];
+					BuildMeshlets(mesh.meshlets, mesh.meshletVertices, mesh.meshletTriangles, mesh.indices.data(), mesh.indices.size(),
+						mesh.positions.data(), static_cast<uint32_t>(mesh.positions.size()), options.meshletMaxVertices, options.meshletMaxTriangles);
+				}
+			});
+		}
+		graph.Execute();
+		if (stats && options.optimize)
+			stats->swap(results);
+	}
+
+	//Every submesh needs a slot, even if the scene had no materials
+	std::vector<Material> materials(std::max(scene.mNumMaterials, 1u));
+	for (unsigned i = 0; i < scene.mNumMaterials; ++i)
+		MaterialName(*scene.mMaterials[i], materials[i].name);
+
+	//Submesh indices are relative to their first vertex, so 16 bits will do unless one submesh is huge
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	//Each submesh's levels of detail follow its own indices, and its meshlets follow the last submesh's
+	std::vector<Submesh> submeshes;
+	std::vector<Lod> lods;
+	std::vector<MeshletRange> meshletRanges;
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	uint32_t numVertices = 0, numIndices = 0, indexSize = 2;
+	for (const auto &iter : meshes)
+	{
+		Submesh submesh = {};
+		submesh.firstIndex = numIndices;
+		submesh.indexCount = static_cast<uint32_t>(iter.indices.size());
+		submesh.firstVertex = numVertices;
+		submesh.vertexCount = static_cast<uint32_t>(iter.positions.size());
+		submesh.material = (iter.material < materials.size()) ? iter.material : 0;
+		submesh.numLods = static_cast<uint32_t>(iter.lods.size());
+		memcpy(submesh.boundsMin, &iter.boundsMin, sizeof(submesh.boundsMin));
+		memcpy(submesh.boundsMax, &iter.boundsMax, sizeof(submesh.boundsMax));
+		submeshes.push_back(submesh);
+
+		numIndices += submesh.indexCount;
+		numVertices += submesh.vertexCount;
+		for (const auto &lod : iter.lods)
+		{
+			lods.push_back({ numIndices, static_cast<uint32_t>(lod.indices.size()), lod.error, 0 });
+			numIndices += lods.back().indexCount;
+		}
+		meshletRanges.push_back({ static_cast<uint32_t>(meshlets.size()), static_cast<uint32_t>(iter.meshlets.size()) });
+		for (Meshlet meshlet : iter.meshlets)
+		{
+			meshlet.vertexOffset += static_cast<uint32_t>(meshletVertices.size());
+			meshlet.triangleOffset += static_cast<uint32_t>(meshletTriangles.size());
+			meshlets.push_back(meshlet);
+		}
+		meshletVertices.insert(meshletVertices.end(), iter.meshletVertices.begin(), iter.meshletVertices.end());
+		meshletTriangles.insert(meshletTriangles.end(), iter.meshletTriangles.begin(), iter.meshletTriangles.end());
+		if (submesh.vertexCount > maxSubmeshVertices)
+			indexSize = 4;
+		boundsMin = glm::min(boundsMin, iter.boundsMin);
+		boundsMax = glm::max(boundsMax, iter.boundsMax);
+	}
+
+	//Lay out every blob, then the section table
+	std::vector<Section> sections;
+	uint64_t offset = sizeof(Header);
+	auto addSection = [&](SectionType type, uint32_t elementSize, uint64_t count) {
+		offset = AlignBlob(offset);
+		sections.push_back({ type, elementSize, offset, count });
+		offset += elementSize * count;
+		return sections.back().offset;
+	};
+	uint64_t attributeOffset = addSection(SectionType::Attributes, sizeof(Attribute), attributes.size());
+	uint64_t materialOffset = addSection(SectionType::Materials, sizeof(Material), materials.size());
+	uint64_t submeshOffset = addSection(SectionType::Submeshes, sizeof(Submesh), submeshes.size());
+	uint64_t vertexOffset = addSection(SectionType::Vertices, stride, numVertices);
+	uint64_t indexOffset = addSection(SectionType::Indices, indexSize, numIndices);
+	uint64_t lodOffset = lods.empty() ? 0 : addSection(SectionType::Lods, sizeof(Lod), lods.size());
+	uint64_t meshletRangeOffset = 0, meshletOffset = 0, meshletVertexOffset = 0, meshletTriangleOffset = 0;
+	if (options.meshlets)
+	{
+		meshletRangeOffset = addSection(SectionType::MeshletRanges, sizeof(MeshletRange), meshletRanges.size());
+		meshletOffset = addSection(SectionType::Meshlets, sizeof(Meshlet), meshlets.size());
+		meshletVertexOffset = addSection(SectionType::MeshletVertices, sizeof(uint32_t), meshletVertices.size());
+		meshletTriangleOffset = addSection(SectionType::MeshletTriangles, sizeof(uint8_t), meshletTriangles.size());
+	}
+
+	Header header = {};
+	header.magic = magic;
+	header.versionMajor = versionMajor;
+	header.versionMinor = versionMinor;
+	header.numSections = static_cast<uint32_t>(sections.size());
+	header.vertexStride = stride;
+	header.indexSize = indexSize;
+	memcpy(header.boundsMin, &boundsMin, sizeof(header.boundsMin));
+	memcpy(header.boundsMax, &boundsMax, sizeof(header.boundsMax));
+	header.sectionTableOffset = AlignBlob(offset);
+	header.fileSize = header.sectionTableOffset + sizeof(Section) * sections.size();
+
+	blob.resize(static_cast<size_t>(header.fileSize));
+	uint8_t *data = blob.data();
+	memcpy(data, &header, sizeof(Header));
+	memcpy(data + attributeOffset, attributes.data(), sizeof(Attribute) * attributes.size());
+	memcpy(data + materialOffset, materials.data(), sizeof(Material) * materials.size());
+	memcpy(data + submeshOffset, submeshes.data(), sizeof(Submesh) * submeshes.size());
+	if (!lods.empty())
+		memcpy(data + lodOffset, lods.data(), sizeof(Lod) * lods.size());
+	if (options.meshlets)
+	{
+		//Spheres were fitted to the exact positions, so grow them to cover the rounding in the quantised ones
+		float rounding = 0.5f * glm::length(boundsMax - boundsMin) / 65535.0f;
+		for (auto &iter : meshlets)
+			iter.radius += rounding;
+		memcpy(data + meshletRangeOffset, meshletRanges.data(), sizeof(MeshletRange) * meshletRanges.size());
+		memcpy(data + meshletOffset, meshlets.data(), sizeof(Meshlet) * meshlets.size());
+		memcpy(data + meshletVertexOffset, meshletVertices.data(), sizeof(uint32_t) * meshletVertices.size());
+		memcpy(data + meshletTriangleOffset, meshletTriangles.data(), meshletTriangles.size());
+	}
+	memcpy(data + header.sectionTableOffset, sections.data(), sizeof(Section) * sections.size());
+
+	//Positions are stored as fractions of the bounds, so a flat axis gets a zero scale
+	glm::vec3 extent = boundsMax - boundsMin;
+	glm::vec3 scale(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	auto writeIndices = [&](const std::vector<uint32_t> &indices, uint32_t firstIndex) {
+		uint8_t *dst = data + indexOffset + uint64_t(firstIndex) * indexSize;
+		if (indexSize == 4)
+		{
+			memcpy(dst, indices.data(), sizeof(uint32_t) * indices.size());
+			return;
+		}
+		for (size_t j = 0; j < indices.size(); ++j)
+		{
+			uint16_t index = static_cast<uint16_t>(indices[j]);
+			memcpy(dst + j * sizeof(uint16_t), &index, sizeof(uint16_t));
+		}
+	};
+	for (size_t i = 0, lod = 0; i < meshes.size(); ++i)
+	{
+		Interleave(meshes[i], attributes, stride, boundsMin, scale, data + vertexOffset + uint64_t(submeshes[i].firstVertex) * stride);
+		writeIndices(meshes[i].indices, submeshes[i].firstIndex);
+		for (const auto &iter : meshes[i].lods)
+			writeIndices(iter.indices, lods[lod++].firstIndex);
+	}
+	return true;
+}
+
+bool Basilisk::CookMesh(const aiScene &scene, const std::string &filename, const MeshCookOptions &options, std::vector<MeshOptimizeStats> *stats)
+{
+	std::vector<uint8_t> blob;
+	if (!CookMesh(scene, blob, options, stats))
+		return false;
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file)
+	{
+		BASILISK_ERROR("Basilisk::CookMesh() could not open the output file");
+		return false;
+	}
+
+	bool ok = (fwrite(blob.data(), 1, blob.size(), file) == blob.size() && ferror(file) == 0);
+	fclose(file);
+	if (!ok)
+		BASILISK_ERROR("Basilisk::CookMesh() could not write the output file");
+	return ok;
+}
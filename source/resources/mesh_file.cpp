@@ -0,0 +1,284 @@
+/**
+\file   mesh_file.cpp
+\author Andrew Baxter
+\date   April 6, 2016
+
+Validates cooked mesh files
+
+*/
+
+#include "resources/mesh_file.h"
+#include <cstring>
+
+using namespace Basilisk;
+using namespace Basilisk::MeshFile;
+
+namespace
+{
+	inline const Header &GetHeader(const uint8_t *data)
+	{
+		return *reinterpret_cast<const Header*>(data);
+	}
+
+	inline const Section *GetSections(const uint8_t *data)
+	{
+		return reinterpret_cast<const Section*>(data + GetHeader(data).sectionTableOffset);
+	}
+
+	template<typename T>
+	inline const T *Blob(const uint8_t *data, const Section *section)
+	{
+		return reinterpret_cast<const T*>(data + section->offset);
+	}
+
+	uint32_t FormatSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R16G16B16A16_UNORM: return 8;
+		case VK_FORMAT_R8G8B8A8_SNORM:
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R16G16_SFLOAT: return 4;
+		default: return 0;
+		}
+	}
+
+	template<typename Index>
+	bool ValidateRange(const Index *indices, uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount)
+	{
+		const Index *end = indices + firstIndex + indexCount;
+		for (const Index *index = indices + firstIndex; index != end; ++index)
+		{
+			if (*index >= vertexCount)
+				return false;
+		}
+		return true;
+	}
+
+	template<typename Index>
+	bool ValidateIndices(const Index *indices, const Submesh *submeshes, uint64_t numSubmeshes, const Lod *lods)
+	{
+		for (uint64_t i = 0; i < numSubmeshes; ++i)
+		{
+			const Submesh &iter = submeshes[i];
+			bool ok = ValidateRange(indices, iter.firstIndex, iter.indexCount, iter.vertexCount);
+			for (uint32_t j = 0; ok && j < iter.numLods; ++j, ++lods)
+				ok = ValidateRange(indices, lods->firstIndex, lods->indexCount, iter.vertexCount);
+			if (!ok)
+			{
+				BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an index outside of submesh %u", static_cast<uint32_t>(i));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ValidateMeshlets(const Submesh *submeshes, uint64_t numSubmeshes, const MeshletRange *ranges, const Meshlet *meshlets,
+		const uint32_t *meshletVertices, const uint8_t *meshletTriangles)
+	{
+		for (uint64_t i = 0; i < numSubmeshes; ++i)
+		{
+			const MeshletRange &range = ranges[i];
+			for (uint32_t j = range.firstMeshlet; j < range.firstMeshlet + range.numMeshlets; ++j)
+			{
+				const Meshlet &iter = meshlets[j];
+				bool ok = ValidateRange(meshletVertices, iter.vertexOffset, iter.vertexCount, submeshes[i].vertexCount) &&
+					ValidateRange(meshletTriangles, iter.triangleOffset, iter.triangleCount * 3, iter.vertexCount);
+				if (!ok)
+				{
+					BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an index outside of meshlet %u", j);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+const Section *MeshFile::FindSection(const uint8_t *data, SectionType type)
+{
+	const Section *sections = GetSections(data);
+	for (uint32_t i = 0; i < GetHeader(data).numSections; ++i)
+	{
+		if (sections[i].type == type)
+			return &sections[i];
+	}
+	return nullptr;
+}
+
+bool MeshFile::Validate(const uint8_t *data, size_t size, bool deep)
+{
+	if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % 8 != 0)
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() was given a buffer too small or misaligned to be a mesh");
+		return false;
+	}
+
+	const Header &header = GetHeader(data);
+	if (header.magic != magic)
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() was given a file which is not a mesh");
+		return false;
+	}
+	if (header.versionMajor != versionMajor)
+	{
+		BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() cannot read mesh format version %u", header.versionMajor);
+		return false;
+	}
+	if (header.fileSize != size || header.sectionTableOffset % 8 != 0 || header.sectionTableOffset > size ||
+		header.numSections > (size - header.sectionTableOffset) / sizeof(Section))
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() found a truncated mesh file");
+		return false;
+	}
+	if ((header.indexSize != 2 && header.indexSize != 4) || header.vertexStride == 0 || header.vertexStride % 4 != 0)
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() found a mesh with an invalid vertex or index size");
+		return false;
+	}
+
+	//Every blob must lie within the file and have the element size its type demands
+	const Section *sections = GetSections(data);
+	for (uint32_t i = 0; i < header.numSections; ++i)
+	{
+		const Section &iter = sections[i];
+		uint32_t expected = 0;
+		switch (iter.type)
+		{
+		case SectionType::Attributes: expected = sizeof(Attribute); break;
+		case SectionType::Materials: expected = sizeof(Material); break;
+		case SectionType::Submeshes: expected = sizeof(Submesh); break;
+		case SectionType::Vertices: expected = header.vertexStride; break;
+		case SectionType::Indices: expected = header.indexSize; break;
+		case SectionType::Lods: expected = sizeof(Lod); break;
+		case SectionType::MeshletRanges: expected = sizeof(MeshletRange); break;
+		case SectionType::Meshlets: expected = sizeof(Meshlet); break;
+		case SectionType::MeshletVertices: expected = sizeof(uint32_t); break;
+		case SectionType::MeshletTriangles: expected = sizeof(uint8_t); break;
+		default:
+			continue; //Added by a later minor version
+		}
+
+		if (iter.elementSize != expected || iter.offset % blobAlignment != 0 || iter.offset > size ||
+			iter.count > (size - iter.offset) / iter.elementSize)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an invalid section at index %u", i);
+			return false;
+		}
+	}
+
+	const Section *attributes = FindSection(data, SectionType::Attributes);
+	const Section *materials = FindSection(data, SectionType::Materials);
+	const Section *submeshes = FindSection(data, SectionType::Submeshes);
+	const Section *vertices = FindSection(data, SectionType::Vertices);
+	const Section *indices = FindSection(data, SectionType::Indices);
+	if (!attributes || !materials || !submeshes || !vertices || !indices)
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() found a mesh with a required section missing");
+		return false;
+	}
+
+	//Attributes must fit in a vertex, and the position must be there for anything to be drawn
+	const Attribute *attribute = Blob<Attribute>(data, attributes);
+	bool hasPosition = false;
+	for (uint32_t i = 0; i < attributes->count; ++i)
+	{
+		uint32_t bytes = FormatSize(attribute[i].format);
+		if (bytes == 0 || bytes > header.vertexStride || attribute[i].offset > header.vertexStride - bytes)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an invalid attribute at index %u", i);
+			return false;
+		}
+		hasPosition |= (attribute[i].semantic == Semantic::Position);
+	}
+	if (!hasPosition)
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() found a mesh with no positions");
+		return false;
+	}
+
+	const Material *material = Blob<Material>(data, materials);
+	for (uint32_t i = 0; i < materials->count; ++i)
+	{
+		if (memchr(material[i].name, '\0', maxNameLength) == nullptr)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an unterminated material name at index %u", i);
+			return false;
+		}
+	}
+
+	const Submesh *submesh = Blob<Submesh>(data, submeshes);
+	uint32_t maxVertices = (header.indexSize == 2) ? maxSubmeshVertices : 0xFFFFFFFF;
+	uint64_t numLods = 0;
+	for (uint32_t i = 0; i < submeshes->count; ++i)
+	{
+		const Submesh &iter = submesh[i];
+		if (iter.indexCount % 3 != 0 || iter.firstIndex > indices->count || iter.indexCount > indices->count - iter.firstIndex ||
+			iter.firstVertex > vertices->count || iter.vertexCount > vertices->count - iter.firstVertex ||
+			iter.vertexCount > maxVertices || iter.material >= materials->count)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an invalid submesh at index %u", i);
+			return false;
+		}
+		numLods += iter.numLods;
+	}
+
+	//Levels of detail are only found by counting through the submeshes, so there must be exactly as many as they claim
+	const Section *lods = FindSection(data, SectionType::Lods);
+	const Lod *lod = lods ? Blob<Lod>(data, lods) : nullptr;
+	if (numLods != (lods ? lods->count : 0))
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() found a mesh whose submeshes don't match its levels of detail");
+		return false;
+	}
+	for (uint32_t i = 0; i < numLods; ++i)
+	{
+		const Lod &iter = lod[i];
+		if (iter.indexCount % 3 != 0 || iter.firstIndex > indices->count || iter.indexCount > indices->count - iter.firstIndex || !(iter.error >= 0.0f))
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an invalid level of detail at index %u", i);
+			return false;
+		}
+	}
+
+	//Meshlets come as a set of four sections, with every range and every meshlet inside the next section along
+	const Section *meshletRanges = FindSection(data, SectionType::MeshletRanges);
+	const Section *meshlets = FindSection(data, SectionType::Meshlets);
+	const Section *meshletVertices = FindSection(data, SectionType::MeshletVertices);
+	const Section *meshletTriangles = FindSection(data, SectionType::MeshletTriangles);
+	if (meshletRanges && (!meshlets || !meshletVertices || !meshletTriangles || meshletRanges->count != submeshes->count))
+	{
+		BASILISK_ERROR("Basilisk::MeshFile::Validate() found a mesh whose submeshes don't match its meshlets");
+		return false;
+	}
+	const MeshletRange *range = meshletRanges ? Blob<MeshletRange>(data, meshletRanges) : nullptr;
+	const Meshlet *meshlet = meshletRanges ? Blob<Meshlet>(data, meshlets) : nullptr;
+	for (uint32_t i = 0; range && i < meshletRanges->count; ++i)
+	{
+		if (range[i].firstMeshlet > meshlets->count || range[i].numMeshlets > meshlets->count - range[i].firstMeshlet)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an invalid meshlet range at index %u", i);
+			return false;
+		}
+	}
+	for (uint32_t i = 0; meshlet && i < meshlets->count; ++i)
+	{
+		const Meshlet &iter = meshlet[i];
+		if (iter.vertexOffset > meshletVertices->count || iter.vertexCount > meshletVertices->count - iter.vertexOffset || iter.vertexCount > 256 ||
+			iter.triangleOffset % 4 != 0 || iter.triangleOffset > meshletTriangles->count ||
+			iter.triangleCount > (meshletTriangles->count - iter.triangleOffset) / 3 || !(iter.radius >= 0.0f))
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::MeshFile::Validate() found an invalid meshlet at index %u", i);
+			return false;
+		}
+	}
+
+	if (!deep)
+		return true;
+	if (range && !ValidateMeshlets(submesh, submeshes->count, range, meshlet,
+		Blob<uint32_t>(data, meshletVertices), Blob<uint8_t>(data, meshletTriangles)))
+		return false;
+	if (header.indexSize == 2)
+		return ValidateIndices(Blob<uint16_t>(data, indices), submesh, submeshes->count, lod);
+	return ValidateIndices(Blob<uint32_t>(data, indices), submesh, submeshes->count, lod);
+}
@@ -0,0 +1,345 @@
+/**
+\file   mesh_optimizer.cpp
+\author Andrew Baxter
+\date   April 8, 2016
+
+Vertex cache, overdraw and vertex fetch optimisation of triangle lists
+
+*/
+
+#include "resources/mesh_optimizer.h"
+#include <cmath>
+#include <cstring>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t none = 0xFFFFFFFF;
+	constexpr uint32_t forsythCacheSize = 32; //The LRU cache Forsyth's scores model, larger than any real FIFO on purpose
+	constexpr uint32_t maxValence = 32; //Vertices with more remaining triangles than this all score the same
+	constexpr uint32_t fetchLineSize = 64;
+	constexpr uint32_t fetchCacheLines = 256; //A 16KB direct-mapped cache in front of vertex memory
+
+	/**
+	Forsyth's vertex scores, tabulated once
+	Vertices in the last triangle score a fixed amount so the next triangle doesn't reuse them too eagerly,
+	the rest decay with their position in the cache, and vertices with few remaining triangles get a boost so they're finished off.
+	*/
+	struct ScoreTables
+	{
+		ScoreTables()
+		{
+			for (uint32_t i = 0; i < forsythCacheSize; ++i)
+				cache[i] = (i < 3) ? 0.75f : powf(1.0f - float(i - 3) / float(forsythCacheSize - 3), 1.5f);
+			valence[0] = 0.0f;
+			for (uint32_t i = 1; i <= maxValence; ++i)
+				valence[i] = 2.0f * powf(float(i), -0.5f);
+		}
+
+		float cache[forsythCacheSize];
+		float valence[maxValence + 1];
+	};
+
+	const ScoreTables &Tables()
+	{
+		static const ScoreTables tables;
+		return tables;
+	}
+
+	inline float VertexScore(const ScoreTables &tables, int32_t cachePosition, uint32_t liveTriangles)
+	{
+		if (liveTriangles == 0)
+			return -1.0f; //Nothing left to draw, so it will never be chosen
+		float score = (cachePosition >= 0) ? tables.cache[cachePosition] : 0.0f;
+		return score + tables.valence[std::min(liveTriangles, maxValence)];
+	}
+
+	/**
+	Models a FIFO cache by stamping each vertex with the time it was last transformed
+	A vertex is still cached if fewer than `size` others have been transformed since
+	*/
+	struct FifoCache
+	{
+		FifoCache(uint32_t vertexCount, uint32_t cacheSize) : stamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) { }
+
+		//Transforms `vertex` if it isn't cached. Returns whether it had to be.
+		inline bool Access(uint32_t vertex)
+		{
+			if (time - stamps[vertex] <= size)
+				return false;
+			stamps[vertex] = time++;
+			return true;
+		}
+
+		inline void Flush()
+		{
+			time += size + 1;
+		}
+
+		std::vector<uint32_t> stamps;
+		uint32_t time;
+		uint32_t size;
+	};
+}
+
+VertexCacheStats Basilisk::AnalyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<uint8_t> referenced(vertexCount, 0);
+	uint32_t numReferenced = 0, transformed = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t vertex = indices[i];
+		transformed += cache.Access(vertex);
+		numReferenced += !referenced[vertex];
+		referenced[vertex] = 1;
+	}
+
+	VertexCacheStats out;
+	out.transformed = transformed;
+	out.acmr = (indexCount >= 3) ? float(transformed) / float(indexCount / 3) : 0.0f;
+	out.atvr = numReferenced ? float(transformed) / float(numReferenced) : 0.0f;
+	return out;
+}
+
+VertexFetchStats Basilisk::AnalyzeVertexFetch(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t vertexStride, uint32_t cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<uint8_t> referenced(vertexCount, 0);
+	uint64_t lines[fetchCacheLines] = {}; //One more than the cached line, so 0 is empty
+	uint64_t numReferenced = 0, bytesFetched = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t vertex = indices[i];
+		numReferenced += !referenced[vertex];
+		referenced[vertex] = 1;
+		if (!cache.Access(vertex))
+			continue;
+
+		uint64_t first = uint64_t(vertex) * vertexStride / fetchLineSize;
+		uint64_t last = (uint64_t(vertex + 1) * vertexStride - 1) / fetchLineSize;
+		for (uint64_t line = first; line <= last; ++line)
+		{
+			uint64_t &slot = lines[line % fetchCacheLines];
+			if (slot != line + 1)
+			{
+				slot = line + 1;
+				bytesFetched += fetchLineSize;
+			}
+		}
+	}
+
+	VertexFetchStats out;
+	out.bytesFetched = bytesFetched;
+	out.overfetch = numReferenced ? float(double(bytesFetched) / double(numReferenced * vertexStride)) : 0.0f;
+	return out;
+}
+
+void Basilisk::OptimizeVertexCache(uint32_t *dst, const uint32_t *indices, size_t indexCount, uint32_t vertexCount)
+{
+	const ScoreTables &tables = Tables();
+	size_t numTriangles = indexCount / 3;
+
+	//Triangles using each vertex. The first `live[v]` entries of each list haven't been emitted yet.
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (size_t i = 0; i < numTriangles * 3; ++i)
+		live[indices[i]]++;
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+	std::vector<uint32_t> adjacency(offsets[vertexCount]);
+	{
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < numTriangles * 3; ++i)
+			adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(tables, -1, live[v]);
+
+	std::vector<uint8_t> emitted(numTriangles, 0);
+
+	std::vector<uint32_t> out(numTriangles * 3);
+	uint32_t cache[forsythCacheSize + 3], newCache[forsythCacheSize + 3];
+	uint32_t cacheCount = 0;
+	size_t cursor = 0;
+	uint32_t best = none;
+
+	for (size_t numEmitted = 0; numEmitted < numTriangles; ++numEmitted)
+	{
+		if (best == none)
+		{ //Nothing in the cache has triangles left, so carry on from the next triangle in input order
+			while (emitted[cursor])
+				++cursor;
+			best = static_cast<uint32_t>(cursor);
+		}
+
+		const uint32_t *triangle = indices + size_t(best) * 3;
+		memcpy(&out[numEmitted * 3], triangle, 3 * sizeof(uint32_t));
+		emitted[best] = 1;
+
+		uint32_t newCount = 0;
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			uint32_t v = triangle[k];
+			uint32_t *list = &adjacency[offsets[v]];
+			uint32_t *found = std::find(list, list + live[v], best);
+			std::swap(*found, list[live[v] - 1]);
+			live[v]--;
+
+			if (std::find(newCache, newCache + newCount, v) == newCache + newCount) //Degenerate triangles repeat vertices
+				newCache[newCount++] = v;
+		}
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+				newCache[newCount++] = cache[i];
+		}
+
+		//Rescore every vertex that moved or fell out, then pick the best triangle still using a cached vertex
+		for (uint32_t i = 0; i < newCount; ++i)
+		{
+			uint32_t v = newCache[i];
+			cachePosition[v] = (i < forsythCacheSize) ? static_cast<int32_t>(i) : -1;
+			vertexScore[v] = VertexScore(tables, cachePosition[v], live[v]);
+		}
+
+		best = none;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < std::min(newCount, forsythCacheSize); ++i)
+		{
+			uint32_t v = newCache[i];
+			const uint32_t *list = &adjacency[offsets[v]];
+			for (uint32_t j = 0; j < live[v]; ++j)
+			{
+				uint32_t t = list[j];
+				const uint32_t *tri = indices + size_t(t) * 3;
+				float score = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+				if (score > bestScore || (score == bestScore && t < best))
+				{
+					best = t;
+					bestScore = score;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, forsythCacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+	}
+
+	std::copy(out.begin(), out.end(), dst);
+}
+
+void Basilisk::OptimizeOverdraw(uint32_t *dst, const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount, float threshold)
+{
+	size_t numTriangles = indexCount / 3;
+	if (numTriangles == 0)
+		return;
+
+	//Split into the smallest clusters which, even starting from a cold cache, stay within the threshold
+	float target = AnalyzeVertexCache(indices, numTriangles * 3, vertexCount).acmr * threshold;
+	FifoCache cache(vertexCount, defaultCacheSize);
+	std::vector<size_t> clusterStart;
+	size_t start = 0;
+	uint32_t misses = 0;
+	for (size_t t = 0; t < numTriangles; ++t)
+	{
+		if (t == start)
+		{
+			cache.Flush();
+			misses = 0;
+		}
+		misses += cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+		if (misses <= target * float(t - start + 1))
+		{
+			clusterStart.push_back(start);
+			start = t + 1;
+		}
+	}
+	if (start < numTriangles)
+		clusterStart.push_back(start);
+	clusterStart.push_back(numTriangles);
+	size_t numClusters = clusterStart.size() - 1;
+
+	//Clusters facing away from the middle of the mesh are most likely to hide others, so they go first
+	std::vector<glm::vec3> centroids(numClusters), normals(numClusters);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < numClusters; ++c)
+	{
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+		{
+			const glm::vec3 &a = positions[indices[t * 3]], &b = positions[indices[t * 3 + 1]], &c2 = positions[indices[t * 3 + 2]];
+			glm::vec3 cross = glm::cross(b - a, c2 - a);
+			float triangleArea = glm::length(cross);
+			centroid += (a + b + c2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids[c] = (area > 0.0f) ? centroid / area : positions[indices[clusterStart[c] * 3]];
+		normals[c] = normal;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> sortKey(numClusters);
+	std::vector<uint32_t> order(numClusters);
+	for (size_t c = 0; c < numClusters; ++c)
+	{
+		float length = glm::length(normals[c]);
+		sortKey[c] = (length > 0.0f) ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+		order[c] = static_cast<uint32_t>(c);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return sortKey[a] > sortKey[b];
+	});
+
+	std::vector<uint32_t> out;
+	out.reserve(numTriangles * 3);
+	for (uint32_t c : order)
+		out.insert(out.end(), indices + clusterStart[c] * 3, indices + clusterStart[c + 1] * 3);
+	std::copy(out.begin(), out.end(), dst);
+}
+
+uint32_t Basilisk::OptimizeVertexFetch(uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t *remap)
+{
+	std::fill(remap, remap + vertexCount, unusedVertex);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t &mapped = remap[indices[i]];
+		if (mapped == unusedVertex)
+			mapped = next++;
+		indices[i] = mapped;
+	}
+	return next;
+}
+
+MeshOptimizeStats Basilisk::OptimizeMesh(std::vector<uint32_t> &indices, const glm::vec3 *positions, uint32_t vertexCount, uint32_t vertexStride,
+	std::vector<uint32_t> &remap, float overdrawThreshold)
+{
+	MeshOptimizeStats stats;
+	size_t count = indices.size() - indices.size() % 3;
+	uint32_t *data = indices.data();
+
+	stats.original = AnalyzeVertexCache(data, count, vertexCount);
+	stats.fetchOriginal = AnalyzeVertexFetch(data, count, vertexCount, vertexStride);
+
+	OptimizeVertexCache(data, data, count, vertexCount);
+	stats.vertexCache = AnalyzeVertexCache(data, count, vertexCount);
+
+	OptimizeOverdraw(data, data, count, positions, vertexCount, overdrawThreshold);
+	stats.overdraw = AnalyzeVertexCache(data, count, vertexCount);
+
+	remap.resize(vertexCount);
+	uint32_t numUsed = OptimizeVertexFetch(data, count, vertexCount, remap.data());
+	stats.fetchOptimized = AnalyzeVertexFetch(data, count, numUsed, vertexStride);
+	return stats;
+}
@@ -0,0 +1,576 @@
+/**
+\file   mesh_simplifier.cpp
+\author Andrew Baxter
+\date   April 9, 2016
+
+Edge collapse simplification with attribute-aware quadric error metrics
+
+*/
+
+#include "resources/mesh_simplifier.h"
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t none = 0xFFFFFFFF;
+	constexpr float borderWeight = 10.0f; //How much more moving away from a border or seam costs than moving off a face
+	constexpr float passSlack = 2.25f; //How far past the expected error a pass may go, squared
+	constexpr float minFlipCosine = 0.25f; //A collapse is refused if it turns any remaining triangle further than about 75 degrees
+
+	enum VertexKind : uint8_t
+	{
+		Manifold, //Surrounded by triangles, with one set of attributes
+		Border, //On a single open edge loop
+		Seam, //One of exactly two vertices sharing a position on a UV or normal seam, with matching open edges
+		Locked, //Anything else, such as where seams meet or a mesh is pinched, which never moves
+		NumKinds
+	};
+
+	//Which kinds may move onto which; borders and seams are also held to their own edges
+	const bool canCollapse[NumKinds][NumKinds] = {
+		{ true, true, true, true },
+		{ false, true, false, true },
+		{ false, false, true, false },
+		{ false, false, false, false }
+	};
+
+	/**
+	A symmetric 3x3 quadratic form, giving the weighted sum of squared distances from a set of planes
+	*/
+	struct Quadric
+	{
+		float a00, a11, a22, a10, a20, a21;
+		float b0, b1, b2;
+		float c;
+		float w; //Total weight, so errors can be averaged
+	};
+
+	//The change in one attribute across a triangle, as a linear function of position
+	struct Gradient
+	{
+		glm::vec3 g;
+		float d;
+	};
+
+	void AddPlane(Quadric &q, const glm::vec3 &n, float d, float w)
+	{
+		q.a00 += w * n.x * n.x;
+		q.a11 += w * n.y * n.y;
+		q.a22 += w * n.z * n.z;
+		q.a10 += w * n.y * n.x;
+		q.a20 += w * n.z * n.x;
+		q.a21 += w * n.z * n.y;
+		q.b0 += w * n.x * d;
+		q.b1 += w * n.y * d;
+		q.b2 += w * n.z * d;
+		q.c += w * d * d;
+	}
+
+	void AddQuadric(Quadric &q, const Quadric &r)
+	{
+		q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+		q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+		q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+		q.c += r.c;
+		q.w += r.w;
+	}
+
+	inline float Evaluate(const Quadric &q, const glm::vec3 &p)
+	{
+		float rx = q.a00 * p.x + q.a10 * p.y + q.a20 * p.z + 2.0f * q.b0;
+		float ry = q.a10 * p.x + q.a11 * p.y + q.a21 * p.z + 2.0f * q.b1;
+		float rz = q.a20 * p.x + q.a21 * p.y + q.a22 * p.z + 2.0f * q.b2;
+		return rx * p.x + ry * p.y + rz * p.z + q.c;
+	}
+
+	/**
+	Vertex to triangle adjacency, with the vertex that follows in each triangle so edges can be looked up
+	*/
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> next;
+		std::vector<uint32_t> triangles;
+	};
+
+	void BuildAdjacency(Adjacency &adjacency, const std::vector<uint32_t> &indices, uint32_t vertexCount)
+	{
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		for (uint32_t v : indices)
+			adjacency.offsets[v + 1]++;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+		adjacency.next.resize(indices.size());
+		adjacency.triangles.resize(indices.size());
+		std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			uint32_t slot = cursor[indices[i]]++;
+			adjacency.next[slot] = indices[i - i % 3 + (i + 1) % 3];
+			adjacency.triangles[slot] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	inline bool HasEdge(const Adjacency &adjacency, uint32_t a, uint32_t b)
+	{
+		for (uint32_t i = adjacency.offsets[a]; i < adjacency.offsets[a + 1]; ++i)
+		{
+			if (adjacency.next[i] == b)
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	Groups vertices sharing a position: `positionId` is the lowest-numbered vertex at each position,
+	and `wedge` links every vertex to the next at the same position, in a ring
+	*/
+	void BuildWedges(const glm::vec3 *positions, uint32_t vertexCount, std::vector<uint32_t> &positionId, std::vector<uint32_t> &wedge)
+	{
+		std::vector<uint32_t> order(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			order[v] = v;
+		auto less = [&](uint32_t a, uint32_t b) {
+			const glm::vec3 &pa = positions[a], &pb = positions[b];
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		positionId.resize(vertexCount);
+		wedge.resize(vertexCount);
+		for (uint32_t begin = 0; begin < vertexCount;)
+		{
+			uint32_t end = begin + 1;
+			while (end < vertexCount && positions[order[end]] == positions[order[begin]])
+				++end;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				positionId[order[i]] = order[begin];
+				wedge[order[i]] = order[(i + 1 < end) ? i + 1 : begin];
+			}
+			begin = end;
+		}
+	}
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float error;
+	};
+
+	//Orders collapses by error, keeping equal ones in the order they were found. Errors are never negative, so their bits sort as integers.
+	void SortCollapses(const std::vector<Collapse> &collapses, std::vector<uint32_t> &order)
+	{
+		size_t count = collapses.size();
+		std::vector<uint32_t> keys(count), temp(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			memcpy(&keys[i], &collapses[i].error, sizeof(uint32_t));
+			temp[i] = static_cast<uint32_t>(i);
+		}
+
+		order.resize(count);
+		std::vector<uint32_t> histogram(0x10000);
+		for (int shift = 0; shift < 32; shift += 16)
+		{
+			std::fill(histogram.begin(), histogram.end(), 0);
+			for (size_t i = 0; i < count; ++i)
+				histogram[(keys[i] >> shift) & 0xFFFF]++;
+			uint32_t sum = 0;
+			for (auto &iter : histogram)
+			{
+				uint32_t bucket = iter;
+				iter = sum;
+				sum += bucket;
+			}
+			for (uint32_t i : temp)
+				order[histogram[(keys[i] >> shift) & 0xFFFF]++] = i;
+			temp.swap(order);
+		}
+		order.swap(temp);
+	}
+
+	/**
+	Everything the simplifier knows about the mesh between passes
+	Positions are scaled to fit a unit cube and attributes are premultiplied by their weights, so every error is in the same units.
+	*/
+	struct State
+	{
+		uint32_t vertexCount;
+		uint32_t attributeCount;
+		std::vector<glm::vec3> points;
+		std::vector<float> attributes;
+		std::vector<uint32_t> positionId, wedge;
+		std::vector<uint8_t> kind;
+		std::vector<uint32_t> openIn, openOut; //The neighbours along this vertex's open edges, if any
+		std::vector<Quadric> quadrics; //By position, so every vertex at a position shares one
+		std::vector<Quadric> attributeQuadrics; //By vertex
+		std::vector<Gradient> gradients; //`attributeCount` per vertex
+
+		//Where the other vertex at a seam goes when `from` moves onto `to`, or `none` if the seam can't follow
+		uint32_t SeamTarget(uint32_t from, uint32_t to) const
+		{
+			uint32_t twin = wedge[from];
+			uint32_t target = (openOut[from] == to) ? openIn[twin] : (openIn[from] == to) ? openOut[twin] : none;
+			if (target == none || kind[target] != Seam || positionId[target] != positionId[to] || target == to)
+				return none;
+			return target;
+		}
+
+		bool CanCollapse(uint32_t from, uint32_t to) const
+		{
+			if (!canCollapse[kind[from]][kind[to]])
+				return false;
+			if (kind[from] != Manifold && openOut[from] != to && openIn[from] != to)
+				return false;
+			return kind[from] != Seam || SeamTarget(from, to) != none;
+		}
+
+		float AttributeError(uint32_t vertex, uint32_t target, const glm::vec3 &p) const
+		{
+			const Quadric &q = attributeQuadrics[vertex];
+			const Gradient *g = &gradients[size_t(vertex) * attributeCount];
+			const float *a = &attributes[size_t(target) * attributeCount];
+			float error = Evaluate(q, p);
+			for (uint32_t k = 0; k < attributeCount; ++k)
+				error += a[k] * (a[k] * q.w - 2.0f * (glm::dot(g[k].g, p) + g[k].d));
+			return error;
+		}
+
+		//The average squared error of moving `from` onto `to`, and the other side of the seam with it
+		float CollapseError(uint32_t from, uint32_t to) const
+		{
+			const Quadric &q = quadrics[positionId[from]];
+			const glm::vec3 &p = points[to];
+			float error = Evaluate(q, p);
+			if (attributeCount)
+			{
+				error += AttributeError(from, to, p);
+				if (kind[from] == Seam)
+					error += AttributeError(wedge[from], SeamTarget(from, to), p);
+			}
+			return fabsf(error) / std::max(q.w, FLT_MIN);
+		}
+	};
+
+	void Classify(State &state, const Adjacency &adjacency)
+	{
+		uint32_t count = state.vertexCount;
+		state.openIn.assign(count, none);
+		state.openOut.assign(count, none);
+		for (uint32_t v = 0; v < count; ++v)
+		{
+			for (uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i)
+			{
+				uint32_t w = adjacency.next[i];
+				if (HasEdge(adjacency, w, v))
+					continue;
+				//A second open edge in the same direction means the vertex isn't on a simple loop; pointing at itself marks that
+				state.openOut[v] = (state.openOut[v] == none) ? w : v;
+				state.openIn[w] = (state.openIn[w] == none) ? v : w;
+			}
+		}
+
+		const std::vector<uint32_t> &id = state.positionId, &wedge = state.wedge, &in = state.openIn, &out = state.openOut;
+		state.kind.assign(count, Locked);
+		for (uint32_t v = 0; v < count; ++v)
+		{
+			bool simple = (in[v] != none && in[v] != v && out[v] != none && out[v] != v);
+			if (wedge[v] == v)
+			{
+				if (in[v] == none && out[v] == none)
+					state.kind[v] = Manifold;
+				else if (simple)
+					state.kind[v] = Border;
+			}
+			else if (wedge[wedge[v]] == v && simple)
+			{ //The seam's open edges run in opposite directions on each side
+				uint32_t w = wedge[v];
+				if (in[w] != none && in[w] != w && out[w] != none && out[w] != w &&
+					id[in[v]] == id[out[w]] && id[out[v]] == id[in[w]] && id[in[v]] != id[out[v]])
+					state.kind[v] = Seam;
+			}
+		}
+	}
+
+	void BuildQuadrics(State &state, const std::vector<uint32_t> &indices, const Adjacency &adjacency)
+	{
+		uint32_t k = state.attributeCount;
+		state.quadrics.assign(state.vertexCount, Quadric());
+		state.attributeQuadrics.assign(k ? state.vertexCount : 0, Quadric());
+		state.gradients.assign(size_t(state.vertexCount) * k, Gradient{ glm::vec3(0.0f), 0.0f });
+
+		for (size_t t = 0; t < indices.size(); t += 3)
+		{
+			const uint32_t *tri = &indices[t];
+			const glm::vec3 &p0 = state.points[tri[0]], &p1 = state.points[tri[1]], &p2 = state.points[tri[2]];
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			if (area <= 0.0f)
+				continue;
+			normal /= area;
+
+			float d = -glm::dot(normal, p0);
+			for (int i = 0; i < 3; ++i)
+			{
+				Quadric &q = state.quadrics[state.positionId[tri[i]]];
+				AddPlane(q, normal, d, area);
+				q.w += area;
+			}
+
+			//Open edges get a plane at right angles to the face, so the border keeps its shape
+			for (int i = 0; i < 3; ++i)
+			{
+				uint32_t a = tri[i], b = tri[(i + 1) % 3];
+				if (HasEdge(adjacency, b, a))
+					continue;
+				glm::vec3 edge = state.points[b] - state.points[a];
+				float length = glm::length(edge);
+				glm::vec3 edgeNormal = glm::cross(edge, normal) / length;
+				float edgeD = -glm::dot(edgeNormal, state.points[a]);
+				float weight = length * length * borderWeight;
+				for (uint32_t v : { a, b })
+				{
+					Quadric &q = state.quadrics[state.positionId[v]];
+					AddPlane(q, edgeNormal, edgeD, weight);
+					q.w += weight;
+				}
+			}
+
+			if (k == 0)
+				continue;
+
+			//Find each attribute's gradient across the face: g.e1 = a1 - a0, g.e2 = a2 - a0, and g lies in the plane
+			glm::vec3 e1 = p1 - p0, e2 = p2 - p0;
+			float d00 = glm::dot(e1, e1), d01 = glm::dot(e1, e2), d11 = glm::dot(e2, e2);
+			float denom = d00 * d11 - d01 * d01;
+			if (denom <= 0.0f)
+				continue;
+			float inv = 1.0f / denom;
+
+			const float *a0 = &state.attributes[size_t(tri[0]) * k];
+			const float *a1 = &state.attributes[size_t(tri[1]) * k];
+			const float *a2 = &state.attributes[size_t(tri[2]) * k];
+			Quadric face = {};
+			face.w = area;
+			for (uint32_t j = 0; j < k; ++j)
+			{
+				float da1 = a1[j] - a0[j], da2 = a2[j] - a0[j];
+				glm::vec3 g = e1 * ((da1 * d11 - da2 * d01) * inv) + e2 * ((da2 * d00 - da1 * d01) * inv);
+				float gd = a0[j] - glm::dot(g, p0);
+				AddPlane(face, g, gd, area);
+				for (int i = 0; i < 3; ++i)
+				{
+					Gradient &gradient = state.gradients[size_t(tri[i]) * k + j];
+					gradient.g += g * area;
+					gradient.d += gd * area;
+				}
+			}
+			for (int i = 0; i < 3; ++i)
+				AddQuadric(state.attributeQuadrics[tri[i]], face);
+		}
+	}
+
+	//Whether moving `from` onto `to` would flip or badly fold any triangle which survives the collapse
+	bool Flips(const State &state, const Adjacency &adjacency, const std::vector<uint32_t> &indices, const std::vector<uint32_t> &collapseRemap,
+		uint32_t from, uint32_t to)
+	{
+		const glm::vec3 &target = state.points[to];
+		uint32_t targetId = state.positionId[to];
+		uint32_t v = from;
+		do
+		{
+			for (uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i)
+			{
+				const uint32_t *tri = &indices[size_t(adjacency.triangles[i]) * 3];
+				uint32_t corner = (tri[0] == v) ? 0 : (tri[1] == v) ? 1 : 2;
+				uint32_t b = collapseRemap[tri[(corner + 1) % 3]], c = collapseRemap[tri[(corner + 2) % 3]];
+				if (state.positionId[b] == targetId || state.positionId[c] == targetId)
+					continue; //Collapses away
+
+				const glm::vec3 &pa = state.points[v], &pb = state.points[b], &pc = state.points[c];
+				glm::vec3 before = glm::cross(pb - pa, pc - pa), after = glm::cross(pb - target, pc - target);
+				float lengths = glm::length(before) * glm::length(after);
+				if (lengths > 0.0f && glm::dot(before, after) < minFlipCosine * lengths)
+					return true;
+				if (lengths == 0.0f && glm::dot(before, before) > 0.0f)
+					return true; //Would become degenerate without being removed
+			}
+			v = state.wedge[v];
+		} while (v != from && state.kind[from] == Seam);
+		return false;
+	}
+
+	void Merge(State &state, uint32_t from, uint32_t to)
+	{
+		if (state.attributeCount)
+		{
+			AddQuadric(state.attributeQuadrics[to], state.attributeQuadrics[from]);
+			Gradient *dst = &state.gradients[size_t(to) * state.attributeCount];
+			const Gradient *src = &state.gradients[size_t(from) * state.attributeCount];
+			for (uint32_t k = 0; k < state.attributeCount; ++k)
+			{
+				dst[k].g += src[k].g;
+				dst[k].d += src[k].d;
+			}
+		}
+
+		//Whatever was past `from` on the open loop is now past `to`
+		if (state.openOut[to] == from)
+			state.openOut[to] = state.openOut[from];
+		if (state.openIn[to] == from)
+			state.openIn[to] = state.openIn[from];
+	}
+}
+
+size_t Basilisk::SimplifyMesh(uint32_t *dst, const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount,
+	const float *attributes, uint32_t attributeStride, const float *attributeWeights, uint32_t attributeCount,
+	size_t targetIndexCount, float maxError, float *error)
+{
+	std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+	if (error)
+		*error = 0.0f;
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (uint32_t v : result)
+	{
+		boundsMin = glm::min(boundsMin, positions[v]);
+		boundsMax = glm::max(boundsMax, positions[v]);
+	}
+	glm::vec3 size = boundsMax - boundsMin;
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	if (result.size() <= targetIndexCount || !(extent > 0.0f))
+	{
+		std::copy(result.begin(), result.end(), dst);
+		return result.size();
+	}
+
+	State state;
+	state.vertexCount = vertexCount;
+	state.attributeCount = attributes ? std::min(attributeCount, maxSimplifyAttributes) : 0;
+	state.points.resize(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		state.points[v] = (positions[v] - boundsMin) / extent;
+	state.attributes.resize(size_t(vertexCount) * state.attributeCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		for (uint32_t k = 0; k < state.attributeCount; ++k)
+			state.attributes[size_t(v) * state.attributeCount + k] = attributes[size_t(v) * attributeStride + k] * attributeWeights[k];
+	}
+
+	Adjacency adjacency;
+	BuildAdjacency(adjacency, result, vertexCount);
+	BuildWedges(positions, vertexCount, state.positionId, state.wedge);
+	Classify(state, adjacency);
+	BuildQuadrics(state, result, adjacency);
+
+	float maxErrorSq = (maxError / extent) * (maxError / extent), worst = 0.0f;
+	size_t targetTriangles = targetIndexCount / 3;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> collapseRemap(vertexCount);
+	std::vector<uint8_t> locked(vertexCount);
+
+	while (result.size() / 3 > targetTriangles)
+	{
+		//Rank one collapse per edge, in whichever direction is cheaper
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			uint32_t a = result[i], b = result[i - i % 3 + (i + 1) % 3];
+			if (a > b && HasEdge(adjacency, b, a))
+				continue; //Interior edges are seen from both sides
+			bool ab = state.CanCollapse(a, b), ba = state.CanCollapse(b, a);
+			if (!ab && !ba)
+				continue;
+			float errorAB = ab ? state.CollapseError(a, b) : FLT_MAX;
+			float errorBA = ba ? state.CollapseError(b, a) : FLT_MAX;
+			collapses.push_back((errorAB <= errorBA) ? Collapse{ a, b, errorAB } : Collapse{ b, a, errorBA });
+		}
+		if (collapses.empty())
+			break;
+		SortCollapses(collapses, order);
+
+		//Each collapse removes about two triangles, so half as many collapses as triangles to go would reach the target.
+		//Stop the pass a little past the error that many would reach, so ones skipped for touching an earlier collapse don't let much pricier ones through.
+		//Collapses which flip a triangle never become valid by themselves, so they don't count.
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			collapseRemap[v] = v;
+		size_t goal = result.size() / 3 - targetTriangles, counted = 0;
+		float passLimit = collapses[order.back()].error;
+		for (uint32_t i : order)
+		{
+			if (collapses[i].error > maxErrorSq || Flips(state, adjacency, result, collapseRemap, collapses[i].from, collapses[i].to))
+				continue;
+			passLimit = collapses[i].error;
+			if (++counted > goal / 2)
+				break;
+		}
+		passLimit = std::min(passLimit * passSlack, maxErrorSq);
+
+		std::fill(locked.begin(), locked.end(), 0);
+		size_t removed = 0, applied = 0;
+		for (uint32_t i : order)
+		{
+			const Collapse &iter = collapses[i];
+			if (iter.error > passLimit || removed >= goal)
+				break;
+			uint32_t fromId = state.positionId[iter.from], toId = state.positionId[iter.to];
+			if (locked[fromId] || locked[toId] || Flips(state, adjacency, result, collapseRemap, iter.from, iter.to))
+				continue;
+
+			AddQuadric(state.quadrics[toId], state.quadrics[fromId]);
+			collapseRemap[iter.from] = iter.to;
+			Merge(state, iter.from, iter.to);
+			if (state.kind[iter.from] == Seam)
+			{
+				uint32_t twin = state.wedge[iter.from], twinTarget = state.SeamTarget(iter.from, iter.to);
+				collapseRemap[twin] = twinTarget;
+				Merge(state, twin, twinTarget);
+			}
+
+			locked[fromId] = locked[toId] = 1;
+			removed += (state.kind[iter.from] == Border) ? 1 : 2;
+			worst = std::max(worst, iter.error);
+			++applied;
+		}
+		if (applied == 0)
+			break;
+
+		//Apply the pass, dropping triangles which lost an edge
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = collapseRemap[result[i]], b = collapseRemap[result[i + 1]], c = collapseRemap[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			if (state.openOut[v] != none)
+				state.openOut[v] = collapseRemap[state.openOut[v]];
+			if (state.openIn[v] != none)
+				state.openIn[v] = collapseRemap[state.openIn[v]];
+		}
+		BuildAdjacency(adjacency, result, vertexCount);
+	}
+
+	if (error)
+		*error = sqrtf(worst) * extent;
+	std::copy(result.begin(), result.end(), dst);
+	return result.size();
+}
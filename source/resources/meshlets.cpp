@@ -0,0 +1,353 @@
+/**
+\file   meshlets.cpp
+\author Andrew Baxter
+\date   April 10, 2016
+
+Builds meshlets with their bounding spheres and normal cones, and culls them with SSE
+
+*/
+
+#include "resources/meshlets.h"
+#include <xmmintrin.h>
+#include <cmath>
+#include <cfloat>
+
+using namespace Basilisk;
+using namespace Basilisk::MeshFile;
+
+namespace
+{
+	constexpr uint32_t none = 0xFFFFFFFF;
+	constexpr float minConeSpread = 0.1f; //Cones wider than this, as the cosine of the angle between axis and sides, would hardly ever reject anything
+
+	//The triangles around each vertex, with the ones not yet in a meshlet kept at the front of each vertex's range
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> live;
+		std::vector<uint32_t> triangles;
+
+		Adjacency(const uint32_t *indices, size_t indexCount, uint32_t vertexCount) : offsets(vertexCount + 1, 0), live(vertexCount, 0), triangles(indexCount)
+		{
+			for (size_t i = 0; i < indexCount; ++i)
+				++live[indices[i]];
+			for (uint32_t v = 0; v < vertexCount; ++v)
+				offsets[v + 1] = offsets[v] + live[v];
+
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indexCount; ++i)
+				triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		void Remove(uint32_t vertex, uint32_t triangle)
+		{
+			uint32_t *begin = &triangles[offsets[vertex]];
+			uint32_t *last = begin + --live[vertex];
+			*std::find(begin, last, triangle) = *last;
+			*last = triangle;
+		}
+	};
+
+	glm::vec3 TriangleNormal(const glm::vec3 *positions, const uint32_t *triangle)
+	{
+		glm::vec3 n = glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+		float length = glm::length(n);
+		return (length > 0.0f) ? n / length : glm::vec3(0.0f);
+	}
+
+	/**
+	Fits a sphere around a meshlet's vertices, and a cone around its triangles' normals
+	The cone's apex sits far enough back along the axis that no triangle's plane passes in front of it, so an eye
+	outside the cone is behind the plane of every triangle.
+	*/
+	void ComputeBounds(Meshlet &meshlet, const glm::vec3 *positions, const uint32_t *vertices, const uint8_t *triangles, const glm::vec3 *normals)
+	{
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+		{
+			lo = glm::min(lo, positions[vertices[i]]);
+			hi = glm::max(hi, positions[vertices[i]]);
+		}
+		glm::vec3 center = (lo + hi) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			radius = std::max(radius, glm::length(positions[vertices[i]] - center));
+
+		glm::vec3 axis(0.0f);
+		for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+			axis += normals[i];
+		float length = glm::length(axis);
+		axis = (length > 0.0f) ? axis / length : glm::vec3(0.0f);
+
+		float minDot = (length > 0.0f) ? 1.0f : -1.0f;
+		for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+		{
+			if (normals[i] != glm::vec3(0.0f))
+				minDot = std::min(minDot, glm::dot(axis, normals[i]));
+		}
+
+		glm::vec3 apex = center;
+		float cutoff = 1.0f;
+		if (minDot > minConeSpread)
+		{
+			//Every triangle faces within acos(minDot) of the axis, so dividing by the cosine can't blow up
+			float back = 0.0f;
+			for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+			{
+				if (normals[i] == glm::vec3(0.0f))
+					continue;
+				glm::vec3 p = positions[vertices[triangles[i * 3]]];
+				back = std::max(back, glm::dot(center - p, normals[i]) / glm::dot(axis, normals[i]));
+			}
+			apex = center - axis * back;
+			cutoff = sqrtf(1.0f - minDot * minDot);
+		}
+		else
+			axis = glm::vec3(0.0f);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			meshlet.center[i] = center[i];
+			meshlet.coneApex[i] = apex[i];
+			meshlet.coneAxis[i] = axis[i];
+		}
+		meshlet.radius = radius;
+		meshlet.coneCutoff = cutoff;
+		meshlet.reserved = 0;
+	}
+
+	inline uint32_t CountLanes(int mask)
+	{
+		static const uint8_t counts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+		return counts[mask & 0xF];
+	}
+
+	//Planes broadcast across all four lanes
+	struct PlaneSet
+	{
+		__m128 x[6], y[6], z[6], w[6];
+
+		PlaneSet(const Frustum &frustum)
+		{
+			for (int i = 0; i < 6; ++i)
+			{
+				const glm::vec4 &p = frustum.planes[i];
+				x[i] = _mm_set1_ps(p.x);
+				y[i] = _mm_set1_ps(p.y);
+				z[i] = _mm_set1_ps(p.z);
+				w[i] = _mm_set1_ps(p.w);
+			}
+		}
+	};
+
+	/**
+	Tests four meshlets, transposing each group of four floats so every lane holds one meshlet
+	\param[out] backfacing Bit `i` is set if meshlet `i` faces entirely away from the eye
+	\return Bit `i` is set if meshlet `i` is entirely outside any plane
+	*/
+	inline int TestMeshlets(const PlaneSet &planes, const __m128 eye[3], const Meshlet *meshlets, int &backfacing)
+	{
+		__m128 cx = _mm_loadu_ps(meshlets[0].center), cy = _mm_loadu_ps(meshlets[1].center);
+		__m128 cz = _mm_loadu_ps(meshlets[2].center), radius = _mm_loadu_ps(meshlets[3].center);
+		_MM_TRANSPOSE4_PS(cx, cy, cz, radius);
+
+		__m128 zero = _mm_setzero_ps();
+		__m128 negRadius = _mm_sub_ps(zero, radius);
+		__m128 outMask = zero;
+		for (int i = 0; i < 6; ++i)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planes.x[i], cx), planes.w[i]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(planes.y[i], cy));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planes.z[i], cz));
+			outMask = _mm_or_ps(outMask, _mm_cmplt_ps(distance, negRadius));
+		}
+
+		__m128 ax = _mm_loadu_ps(meshlets[0].coneApex), ay = _mm_loadu_ps(meshlets[1].coneApex);
+		__m128 az = _mm_loadu_ps(meshlets[2].coneApex), cutoff = _mm_loadu_ps(meshlets[3].coneApex);
+		_MM_TRANSPOSE4_PS(ax, ay, az, cutoff);
+		__m128 nx = _mm_loadu_ps(meshlets[0].coneAxis), ny = _mm_loadu_ps(meshlets[1].coneAxis);
+		__m128 nz = _mm_loadu_ps(meshlets[2].coneAxis), unused = _mm_loadu_ps(meshlets[3].coneAxis);
+		_MM_TRANSPOSE4_PS(nx, ny, nz, unused);
+
+		//dot(normalize(apex - eye), axis) > cutoff, without the division
+		__m128 dx = _mm_sub_ps(ax, eye[0]), dy = _mm_sub_ps(ay, eye[1]), dz = _mm_sub_ps(az, eye[2]);
+		__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, nx), _mm_mul_ps(dy, ny)), _mm_mul_ps(dz, nz));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		backfacing = _mm_movemask_ps(_mm_cmpgt_ps(along, _mm_mul_ps(cutoff, length)));
+		return _mm_movemask_ps(outMask);
+	}
+}
+
+size_t Basilisk::BuildMeshlets(std::vector<Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles,
+	const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount,
+	uint32_t maxVertices, uint32_t maxTriangles, float coneWeight)
+{
+	maxVertices = std::max(3u, std::min(maxVertices, maxMeshletVertices));
+	maxTriangles = std::max(1u, maxTriangles);
+	size_t numTriangles = indexCount / 3;
+	size_t firstMeshlet = meshlets.size();
+
+	std::vector<glm::vec3> normals(numTriangles);
+	for (size_t i = 0; i < numTriangles; ++i)
+		normals[i] = TriangleNormal(positions, indices + i * 3);
+
+	Adjacency adjacency(indices, numTriangles * 3, vertexCount);
+	std::vector<bool> taken(numTriangles, false);
+	std::vector<uint32_t> slot(vertexCount, none); //Each vertex's index within the current meshlet
+
+	//The meshlet being grown
+	std::vector<uint32_t> vertices, triangles;
+	std::vector<uint8_t> local;
+	std::vector<glm::vec3> localNormals;
+	glm::vec3 normalSum(0.0f);
+
+	auto flush = [&] {
+		Meshlet meshlet = {};
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+		meshlet.vertexCount = static_cast<uint32_t>(vertices.size());
+		meshlet.triangleCount = static_cast<uint32_t>(triangles.size());
+		localNormals.clear();
+		for (uint32_t t : triangles)
+			localNormals.push_back(normals[t]);
+		ComputeBounds(meshlet, positions, vertices.data(), local.data(), localNormals.data());
+		meshlets.push_back(meshlet);
+
+		meshletVertices.insert(meshletVertices.end(), vertices.begin(), vertices.end());
+		meshletTriangles.insert(meshletTriangles.end(), local.begin(), local.end());
+		meshletTriangles.resize((meshletTriangles.size() + 3) & ~size_t(3), 0);
+
+		for (uint32_t v : vertices)
+			slot[v] = none;
+		vertices.clear();
+		triangles.clear();
+		local.clear();
+		normalSum = glm::vec3(0.0f);
+	};
+
+	auto newVertices = [&](uint32_t triangle) {
+		const uint32_t *tri = indices + triangle * 3;
+		return uint32_t(slot[tri[0]] == none) + uint32_t(slot[tri[1]] == none && tri[1] != tri[0]) +
+			uint32_t(slot[tri[2]] == none && tri[2] != tri[0] && tri[2] != tri[1]);
+	};
+
+	//The untaken triangle next to the current meshlet which adds the fewest vertices and bends the cone the least, if any still fit
+	auto bestNeighbour = [&] {
+		if (triangles.size() >= maxTriangles)
+			return none;
+		float length = glm::length(normalSum);
+		glm::vec3 axis = (length > 0.0f) ? normalSum / length : glm::vec3(0.0f);
+
+		uint32_t best = none;
+		float bestScore = FLT_MAX;
+		for (uint32_t v : vertices)
+		{
+			const uint32_t *around = &adjacency.triangles[adjacency.offsets[v]];
+			for (uint32_t i = 0; i < adjacency.live[v]; ++i)
+			{
+				uint32_t t = around[i];
+				uint32_t extra = newVertices(t);
+				if (vertices.size() + extra > maxVertices)
+					continue;
+				float score = float(extra) + coneWeight * (1.0f - glm::dot(normals[t], axis));
+				if (score < bestScore || (score == bestScore && t < best))
+				{
+					best = t;
+					bestScore = score;
+				}
+			}
+		}
+		return best;
+	};
+
+	size_t cursor = 0;
+	uint32_t next = none;
+	for (;;)
+	{
+		if (next == none)
+		{
+			//Nothing fits next to the current meshlet, so start a new one at the first triangle left
+			if (!triangles.empty())
+				flush();
+			while (cursor < numTriangles && taken[cursor])
+				++cursor;
+			if (cursor == numTriangles)
+				break;
+			next = static_cast<uint32_t>(cursor);
+		}
+
+		taken[next] = true;
+		triangles.push_back(next);
+		normalSum += normals[next];
+		const uint32_t *tri = indices + next * 3;
+		for (int k = 0; k < 3; ++k)
+		{
+			uint32_t v = tri[k];
+			if (slot[v] == none)
+			{
+				slot[v] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(v);
+			}
+			local.push_back(static_cast<uint8_t>(slot[v]));
+			adjacency.Remove(v, next); //Once per corner, as it was added, even if the triangle is degenerate
+		}
+
+		next = bestNeighbour();
+	}
+	return meshlets.size() - firstMeshlet;
+}
+
+void Basilisk::CullMeshlets(const Frustum &frustum, const glm::vec3 &eye, const Meshlet *meshlets, uint32_t count,
+	std::vector<uint32_t> &visible, MeshletCullStats *stats)
+{
+	PlaneSet planes(frustum);
+	__m128 eyes[3] = { _mm_set1_ps(eye.x), _mm_set1_ps(eye.y), _mm_set1_ps(eye.z) };
+	uint32_t outside = 0, backfacing = 0;
+
+	auto emit = [&](uint32_t first, const Meshlet *group, int lanes) {
+		int facing;
+		int out = TestMeshlets(planes, eyes, group, facing) & lanes;
+		facing &= lanes & ~out;
+		outside += CountLanes(out);
+		backfacing += CountLanes(facing);
+
+		for (int bits = lanes & ~(out | facing); bits; bits &= bits - 1)
+		{
+			int lane = 0;
+			while (!(bits & (1 << lane)))
+				++lane;
+			visible.push_back(first + lane);
+		}
+	};
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		emit(i, meshlets + i, 0xF);
+
+	//The last few are copied out so the loads stay inside the array, with the missing lanes masked off
+	if (i < count)
+	{
+		Meshlet padded[4] = {};
+		std::copy(meshlets + i, meshlets + count, padded);
+		emit(i, padded, (1 << (count - i)) - 1);
+	}
+
+	if (stats)
+	{
+		stats->outside += outside;
+		stats->backfacing += backfacing;
+	}
+}
+
+void Basilisk::ExpandMeshlets(const Meshlet *meshlets, const uint32_t *which, uint32_t count,
+	const uint32_t *meshletVertices, const uint8_t *meshletTriangles, std::vector<uint32_t> &indices)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const Meshlet &iter = meshlets[which[i]];
+		const uint32_t *vertices = meshletVertices + iter.vertexOffset;
+		const uint8_t *local = meshletTriangles + iter.triangleOffset;
+		for (uint32_t j = 0; j < iter.triangleCount * 3; ++j)
+			indices.push_back(vertices[local[j]]);
+	}
+}
@@ -0,0 +1,594 @@
+/**
+\file   scene.cpp
+\author Andrew Baxter
+\date   March 28, 2016
+
+Archetype-based entity and component storage, and reading and writing it as a scene file
+
+*/
+
+#include "scene.h"
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+using namespace Basilisk;
+
+namespace
+{
+	constexpr uint32_t indexBits = 24;
+	constexpr uint32_t indexMask = (1 << indexBits) - 1;
+
+	struct ComponentTypeInfo
+	{
+		size_t size;
+		size_t alignment;
+		char name[SceneFile::maxNameLength];
+	};
+
+	std::mutex typesLock;
+	std::array<ComponentTypeInfo, maxComponentTypes> types;
+	uint32_t numTypes = 0;
+
+	uint8_t *AlignedAlloc(size_t size)
+	{
+#ifdef _WIN32
+		return static_cast<uint8_t*>(_aligned_malloc(size, columnAlignment));
+#else
+		void *out = nullptr;
+		return posix_memalign(&out, columnAlignment, size) == 0 ? static_cast<uint8_t*>(out) : nullptr;
+#endif
+	}
+
+	void AlignedFree(uint8_t *ptr)
+	{
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+	inline Entity MakeEntity(uint32_t index, uint32_t generation)
+	{
+		return (generation << indexBits) | index;
+	}
+
+	inline uint64_t AlignBlob(uint64_t offset)
+	{
+		return (offset + SceneFile::blobAlignment - 1) & ~(SceneFile::blobAlignment - 1);
+	}
+}
+
+uint32_t Basilisk::RegisterComponentType(size_t size, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(typesLock);
+	if (numTypes == maxComponentTypes || alignment > columnAlignment)
+	{
+		BASILISK_ERROR("Basilisk::RegisterComponentType() could not register a component type");
+		return maxComponentTypes;
+	}
+
+	types[numTypes] = { size, alignment, "" };
+	return numTypes++;
+}
+
+bool Basilisk::NameComponentType(uint32_t type, const char *name)
+{
+	std::lock_guard<std::mutex> lock(typesLock);
+	size_t length = strlen(name);
+	if (type >= numTypes || length == 0 || length >= SceneFile::maxNameLength)
+	{
+		BASILISK_ERROR("Basilisk::NameComponentType() was given an invalid type or name");
+		return false;
+	}
+
+	for (uint32_t i = 0; i < numTypes; ++i)
+	{
+		if (i != type && strcmp(types[i].name, name) == 0)
+		{
+			BASILISK_ERROR("Basilisk::NameComponentType() was given a name which is already taken");
+			return false;
+		}
+	}
+	memcpy(types[type].name, name, length + 1);
+	return true;
+}
+
+const char *Basilisk::ComponentName(uint32_t type)
+{
+	std::lock_guard<std::mutex> lock(typesLock);
+	return type < numTypes && types[type].name[0] ? types[type].name : nullptr;
+}
+
+uint32_t Basilisk::FindComponentType(const char *name)
+{
+	std::lock_guard<std::mutex> lock(typesLock);
+	for (uint32_t i = 0; i < numTypes; ++i)
+	{
+		if (strcmp(types[i].name, name) == 0)
+			return i;
+	}
+	return maxComponentTypes;
+}
+
+size_t Basilisk::ComponentSize(uint32_t type)
+{
+	std::lock_guard<std::mutex> lock(typesLock);
+	return type < numTypes ? types[type].size : 0;
+}
+
+size_t Basilisk::ComponentAlignment(uint32_t type)
+{
+	std::lock_guard<std::mutex> lock(typesLock);
+	return type < numTypes ? types[type].alignment : 0;
+}
+
+Archetype::Archetype(ComponentMask mask) : m_mask(mask), m_entities(nullptr), m_size(0), m_capacity(0), m_borrowed(false)
+{
+	m_columnIndex.fill(-1);
+	for (uint32_t type = 0; type < maxComponentTypes; ++type)
+	{
+		if (mask & (ComponentMask(1) << type))
+		{
+			m_columnIndex[type] = static_cast<int8_t>(m_types.size());
+			m_types.push_back(type);
+			m_sizes.push_back(ComponentSize(type));
+			m_columns.push_back(nullptr);
+		}
+	}
+}
+
+Archetype::~Archetype()
+{
+	if (m_borrowed)
+		return;
+
+	for (auto &iter : m_columns)
+		AlignedFree(iter);
+	AlignedFree(reinterpret_cast<uint8_t*>(m_entities));
+}
+
+void *Archetype::Column(uint32_t type)
+{
+	if (type >= maxComponentTypes || m_columnIndex[type] < 0)
+		return nullptr;
+	return m_columns[m_columnIndex[type]];
+}
+
+bool Archetype::Reserve(uint32_t capacity)
+{
+	if (capacity <= m_capacity)
+		return true;
+
+	//Every array is allocated before any is replaced, so a failure leaves the archetype as it was
+	std::vector<uint8_t*> columns(m_types.size());
+	Entity *entities = reinterpret_cast<Entity*>(AlignedAlloc(sizeof(Entity) * capacity));
+	bool ok = (entities != nullptr);
+	for (size_t i = 0; ok && i < m_types.size(); ++i)
+	{
+		columns[i] = AlignedAlloc(m_sizes[i] * capacity);
+		ok = (columns[i] != nullptr);
+	}
+	if (!ok)
+	{
+		for (auto &iter : columns)
+			AlignedFree(iter);
+		AlignedFree(reinterpret_cast<uint8_t*>(entities));
+		BASILISK_ERROR("Basilisk::Archetype::Reserve() could not allocate memory");
+		return false;
+	}
+
+	//Borrowed arrays are copied out on first growth, and left to their owner
+	for (size_t i = 0; i < m_types.size(); ++i)
+	{
+		if (m_columns[i])
+		{
+			memcpy(columns[i], m_columns[i], m_sizes[i] * m_size);
+			if (!m_borrowed)
+				AlignedFree(m_columns[i]);
+		}
+		m_columns[i] = columns[i];
+	}
+
+	if (m_entities)
+	{
+		memcpy(entities, m_entities, sizeof(Entity) * m_size);
+		if (!m_borrowed)
+			AlignedFree(reinterpret_cast<uint8_t*>(m_entities));
+	}
+	m_entities = entities;
+	m_capacity = capacity;
+	m_borrowed = false;
+	return true;
+}
+
+void Archetype::Borrow(Entity *entities, const std::vector<uint8_t*> &columns, uint32_t size)
+{
+	m_entities = entities;
+	m_columns = columns;
+	m_size = size;
+	m_capacity = size;
+	m_borrowed = true;
+}
+
+bool Archetype::PushBack(Entity entity, uint32_t &row)
+{
+	row = Size();
+	if (row == m_capacity && !Reserve(std::max(64u, m_capacity * 2)))
+		return false;
+
+	for (size_t i = 0; i < m_types.size(); ++i)
+	{
+		size_t size = m_sizes[i];
+		memset(m_columns[i] + size * row, 0, size);
+	}
+	m_entities[row] = entity;
+	m_size++;
+	return true;
+}
+
+Entity Archetype::SwapRemove(uint32_t row)
+{
+	uint32_t last = Size() - 1;
+	Entity moved = invalidEntity;
+	if (row != last)
+	{
+		for (size_t i = 0; i < m_types.size(); ++i)
+		{
+			size_t size = m_sizes[i];
+			memcpy(m_columns[i] + size * row, m_columns[i] + size * last, size);
+		}
+		m_entities[row] = m_entities[last];
+		moved = m_entities[row];
+	}
+	m_size--;
+	return moved;
+}
+
+Scene::Scene() : m_borrowedRecords(nullptr), m_numBorrowedRecords(0), m_numEntities(0)
+{
+
+}
+
+Scene::~Scene()
+{
+	Clear();
+}
+
+bool Scene::Load(const std::string &filename, bool deep)
+{
+	using namespace SceneFile;
+	Clear();
+
+	std::shared_ptr<MappedFile> file = MappedFile::Open(filename);
+	if (!file || !Validate(file->Data(), file->Size(), deep))
+	{
+		BASILISK_ERROR("Basilisk::Scene::Load() could not load the scene");
+		return false;
+	}
+	uint8_t *data = file->Data();
+
+	//Component indices in the file become this process' type indices
+	const Section *components = FindSection(data, SectionType::Components);
+	const ComponentDesc *desc = reinterpret_cast<const ComponentDesc*>(data + components->offset);
+	std::array<uint32_t, maxComponentTypes> typeOf;
+	for (uint32_t i = 0; i < components->count; ++i)
+	{
+		typeOf[i] = FindComponentType(desc[i].name);
+		if (typeOf[i] == maxComponentTypes || ComponentSize(typeOf[i]) != desc[i].size)
+		{
+			BASILISK_ERROR("Basilisk::Scene::Load() found a component which is unknown, or has changed size");
+			return false;
+		}
+	}
+
+	const Section *archetypes = FindSection(data, SectionType::Archetypes);
+	const ArchetypeDesc *arch = reinterpret_cast<const ArchetypeDesc*>(data + archetypes->offset);
+	std::vector<uint8_t*> columns;
+	for (uint32_t i = 0; i < archetypes->count; ++i)
+	{
+		ComponentMask mask = 0;
+		for (uint32_t c = 0; c < components->count; ++c)
+		{
+			if (arch[i].components & (1ull << c))
+				mask |= ComponentMask(1) << typeOf[c];
+		}
+		if (m_archetypeLookup.count(mask))
+		{
+			BASILISK_ERROR("Basilisk::Scene::Load() found two archetypes with the same components");
+			Clear();
+			return false;
+		}
+
+		Archetype &dst = *m_archetypes[FindOrCreateArchetype(mask)];
+		columns.clear();
+		for (uint32_t type : dst.m_types)
+		{
+			uint32_t c = static_cast<uint32_t>(std::find(typeOf.begin(), typeOf.begin() + components->count, type) - typeOf.begin());
+			columns.push_back(data + FindSection(data, SectionType::Column, i, c)->offset);
+		}
+		dst.Borrow(reinterpret_cast<Entity*>(data + FindSection(data, SectionType::Entities, i)->offset), columns, arch[i].size);
+		m_numEntities += arch[i].size;
+	}
+
+	//Records are borrowed like the columns, and copied out when the scene first changes
+	const Section *records = FindSection(data, SectionType::Records);
+	m_borrowedRecords = reinterpret_cast<const Record*>(data + records->offset);
+	m_numBorrowedRecords = static_cast<uint32_t>(records->count);
+
+	const Section *freeRecords = FindSection(data, SectionType::FreeRecords);
+	const uint32_t *freeList = reinterpret_cast<const uint32_t*>(data + freeRecords->offset);
+	m_freeRecords.assign(freeList, freeList + freeRecords->count);
+
+	m_file = std::move(file);
+	return true;
+}
+
+bool Scene::Save(const std::string &filename) const
+{
+	using namespace SceneFile;
+
+	//Only the component types in use are written, in type order
+	ComponentMask used = 0;
+	for (const auto &iter : m_archetypes)
+		used |= iter->Mask();
+
+	std::vector<ComponentDesc> components;
+	std::array<uint32_t, maxComponentTypes> indexOf;
+	for (uint32_t type = 0; type < maxComponentTypes; ++type)
+	{
+		if (!(used & (ComponentMask(1) << type)))
+			continue;
+
+		const char *name = ComponentName(type);
+		if (!name)
+		{
+			BASILISK_ERROR("Basilisk::Scene::Save() found a component type with no name");
+			return false;
+		}
+		ComponentDesc desc = {};
+		strcpy(desc.name, name);
+		desc.size = static_cast<uint32_t>(ComponentSize(type));
+		desc.alignment = static_cast<uint32_t>(ComponentAlignment(type));
+		indexOf[type] = static_cast<uint32_t>(components.size());
+		components.push_back(desc);
+	}
+
+	std::vector<ArchetypeDesc> archetypes;
+	for (const auto &iter : m_archetypes)
+	{
+		ArchetypeDesc desc = {};
+		for (uint32_t type : iter->m_types)
+			desc.components |= 1ull << indexOf[type];
+		desc.size = iter->Size();
+		archetypes.push_back(desc);
+	}
+
+	//Lay out every blob, then the section table
+	std::vector<Section> sections;
+	std::vector<const void*> blobs;
+	uint64_t offset = sizeof(Header);
+	auto addSection = [&](SectionType type, uint32_t archetype, uint32_t component, uint32_t elementSize, const void *blob, uint64_t count) {
+		offset = AlignBlob(offset);
+		sections.push_back({ type, archetype, component, elementSize, offset, count });
+		blobs.push_back(blob);
+		offset += elementSize * count;
+	};
+
+	addSection(SectionType::Components, none, none, sizeof(ComponentDesc), components.data(), components.size());
+	addSection(SectionType::Archetypes, none, none, sizeof(ArchetypeDesc), archetypes.data(), archetypes.size());
+	addSection(SectionType::Records, none, none, sizeof(Record), Records(), NumRecords());
+	addSection(SectionType::FreeRecords, none, none, sizeof(uint32_t), m_freeRecords.data(), m_freeRecords.size());
+	for (uint32_t i = 0; i < m_archetypes.size(); ++i)
+	{
+		const Archetype &arch = *m_archetypes[i];
+		addSection(SectionType::Entities, i, none, sizeof(Entity), arch.m_entities, arch.Size());
+		for (size_t c = 0; c < arch.m_types.size(); ++c)
+		{
+			uint32_t type = arch.m_types[c];
+			addSection(SectionType::Column, i, indexOf[type], components[indexOf[type]].size, arch.m_columns[c], arch.Size());
+		}
+	}
+
+	Header header = {};
+	header.magic = magic;
+	header.versionMajor = versionMajor;
+	header.versionMinor = versionMinor;
+	header.numSections = static_cast<uint32_t>(sections.size());
+	header.sectionTableOffset = AlignBlob(offset);
+	header.fileSize = header.sectionTableOffset + sizeof(Section) * sections.size();
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file)
+	{
+		BASILISK_ERROR("Basilisk::Scene::Save() could not open the output file");
+		return false;
+	}
+
+	static const uint8_t zeroes[blobAlignment] = {};
+	uint64_t written = fwrite(&header, sizeof(Header), 1, file) * sizeof(Header);
+	for (size_t i = 0; i < sections.size(); ++i)
+	{
+		written += fwrite(zeroes, 1, static_cast<size_t>(sections[i].offset - written), file);
+		size_t bytes = static_cast<size_t>(sections[i].elementSize * sections[i].count);
+		if (bytes)
+			written += fwrite(blobs[i], 1, bytes, file);
+	}
+	written += fwrite(zeroes, 1, static_cast<size_t>(header.sectionTableOffset - written), file);
+	if (!sections.empty())
+		written += fwrite(sections.data(), sizeof(Section), sections.size(), file) * sizeof(Section);
+
+	bool ok = (written == header.fileSize && ferror(file) == 0);
+	fclose(file);
+	if (!ok)
+		BASILISK_ERROR("Basilisk::Scene::Save() could not write the output file");
+	return ok;
+}
+
+void Scene::Clear()
+{
+	m_archetypes.clear(); //Before the file, since they may borrow from it
+	m_archetypeLookup.clear();
+	m_records.clear();
+	m_borrowedRecords = nullptr;
+	m_numBorrowedRecords = 0;
+	m_freeRecords.clear();
+	m_numEntities = 0;
+	m_file.reset();
+}
+
+uint32_t Scene::FindOrCreateArchetype(ComponentMask mask)
+{
+	auto found = m_archetypeLookup.find(mask);
+	if (found != m_archetypeLookup.end())
+		return found->second;
+
+	uint32_t index = static_cast<uint32_t>(m_archetypes.size());
+	m_archetypes.emplace_back(new Archetype(mask));
+	m_archetypeLookup[mask] = index;
+	return index;
+}
+
+const Scene::EntityRecord *Scene::Find(Entity entity) const
+{
+	uint32_t index = entity & indexMask;
+	if (entity == invalidEntity || index >= NumRecords())
+		return nullptr;
+
+	//Records and entity tables from a file loaded without the deep check may disagree. Every index read from them
+	//is bounds-checked here and before a swap-remove, so they can never reach outside the scene, though such a file
+	//may still leave entities pointing at the wrong rows.
+	const EntityRecord &record = Records()[index];
+	if (record.archetype >= m_archetypes.size() || record.row >= m_archetypes[record.archetype]->Size() ||
+		record.generation != (entity >> indexBits))
+		return nullptr;
+	return &record;
+}
+
+bool Scene::IsAlive(Entity entity) const
+{
+	return Find(entity) != nullptr;
+}
+
+bool Scene::CanSwapRemove(const Archetype &arch) const
+{
+	return (arch.Entities()[arch.Size() - 1] & indexMask) < NumRecords();
+}
+
+void Scene::OwnRecords()
+{
+	if (!m_borrowedRecords)
+		return;
+
+	m_records.assign(m_borrowedRecords, m_borrowedRecords + m_numBorrowedRecords);
+	m_borrowedRecords = nullptr;
+	m_numBorrowedRecords = 0;
+}
+
+Entity Scene::Allocate(uint32_t archetype)
+{
+	OwnRecords();
+	bool reused = !m_freeRecords.empty();
+	uint32_t index;
+	if (reused)
+	{
+		index = m_freeRecords.back();
+		if (index >= m_records.size() || m_records[index].archetype != invalidArchetype)
+		{
+			BASILISK_ERROR("Basilisk::Scene::Create() found a free record which is in use");
+			return invalidEntity;
+		}
+	}
+	else
+	{
+		if (m_records.size() == indexMask)
+		{
+			BASILISK_ERROR("Basilisk::Scene::Create() could not create an entity, since the scene is full");
+			return invalidEntity;
+		}
+		index = static_cast<uint32_t>(m_records.size());
+	}
+
+	//Nothing is claimed until the archetype has room, so a failed allocation leaves the scene unchanged
+	Entity entity = MakeEntity(index, reused ? m_records[index].generation : 0);
+	uint32_t row;
+	if (!m_archetypes[archetype]->PushBack(entity, row))
+		return invalidEntity;
+
+	if (reused)
+		m_freeRecords.pop_back();
+	else
+		m_records.push_back({ invalidArchetype, 0, 0 });
+
+	EntityRecord &record = m_records[index];
+	record.archetype = archetype;
+	record.row = row;
+	++m_numEntities;
+	return entity;
+}
+
+Entity Scene::Create()
+{
+	return Allocate(FindOrCreateArchetype(0));
+}
+
+bool Scene::Destroy(Entity entity)
+{
+	if (!Find(entity))
+		return false;
+
+	OwnRecords();
+	EntityRecord &record = m_records[entity & indexMask];
+	if (!CanSwapRemove(*m_archetypes[record.archetype]))
+	{
+		BASILISK_ERROR("Basilisk::Scene::Destroy() found an entity with no record");
+		return false;
+	}
+	Entity moved = m_archetypes[record.archetype]->SwapRemove(record.row);
+	if (moved != invalidEntity)
+		m_records[moved & indexMask].row = record.row;
+
+	record.archetype = invalidArchetype;
+	record.generation = (record.generation + 1) & 0xFF;
+	m_freeRecords.push_back(entity & indexMask);
+	--m_numEntities;
+	return true;
+}
+
+bool Scene::MoveEntity(Entity entity, uint32_t target)
+{
+	OwnRecords();
+	EntityRecord &record = m_records[entity & indexMask];
+	Archetype &src = *m_archetypes[record.archetype];
+	Archetype &dst = *m_archetypes[target];
+	if (!CanSwapRemove(src))
+	{
+		BASILISK_ERROR("Basilisk::Scene::MoveEntity() found an entity with no record");
+		return false;
+	}
+
+	//Copy every component both archetypes share; any new ones stay zeroed
+	uint32_t row;
+	if (!dst.PushBack(entity, row))
+		return false;
+	for (size_t i = 0; i < dst.m_types.size(); ++i)
+	{
+		uint32_t type = dst.m_types[i];
+		int8_t column = src.m_columnIndex[type];
+		if (column >= 0)
+		{
+			size_t size = dst.m_sizes[i];
+			memcpy(dst.m_columns[i] + size * row, src.m_columns[column] + size * record.row, size);
+		}
+	}
+
+	Entity moved = src.SwapRemove(record.row);
+	if (moved != invalidEntity)
+		m_records[moved & indexMask].row = record.row;
+
+	record.archetype = target;
+	record.row = row;
+	return true;
+}
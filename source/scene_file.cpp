@@ -0,0 +1,314 @@
+/**
+\file   scene_file.cpp
+\author Andrew Baxter
+\date   March 30, 2016
+
+Validates binary scene files, and maps them into memory
+
+*/
+
+#include "scene_file.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Basilisk;
+using namespace Basilisk::SceneFile;
+
+namespace
+{
+	inline const Header &GetHeader(const uint8_t *data)
+	{
+		return *reinterpret_cast<const Header*>(data);
+	}
+
+	inline const Section *GetSections(const uint8_t *data)
+	{
+		return reinterpret_cast<const Section*>(data + GetHeader(data).sectionTableOffset);
+	}
+
+	template<typename T>
+	inline const T *Blob(const uint8_t *data, const Section *section)
+	{
+		return reinterpret_cast<const T*>(data + section->offset);
+	}
+
+	uint32_t PopCount(uint64_t bits)
+	{
+		uint32_t out = 0;
+		for (; bits; bits &= bits - 1)
+			++out;
+		return out;
+	}
+
+	//Every record must point at a row holding its own handle, and every row must be pointed at by exactly one record
+	bool ValidateRecords(const uint8_t *data)
+	{
+		const Section *archetypes = FindSection(data, SectionType::Archetypes);
+		const Section *records = FindSection(data, SectionType::Records);
+		const Section *freeRecords = FindSection(data, SectionType::FreeRecords);
+		const ArchetypeDesc *arch = Blob<ArchetypeDesc>(data, archetypes);
+		const Record *record = Blob<Record>(data, records);
+
+		std::vector<const uint32_t*> entities(static_cast<size_t>(archetypes->count));
+		uint64_t numEntities = 0;
+		for (uint32_t i = 0; i < archetypes->count; ++i)
+		{
+			entities[i] = Blob<uint32_t>(data, FindSection(data, SectionType::Entities, i));
+			numEntities += arch[i].size;
+		}
+
+		uint64_t numLive = 0;
+		for (uint64_t i = 0; i < records->count; ++i)
+		{
+			const Record &iter = record[i];
+			if (iter.archetype == freeRecord)
+				continue;
+			if (iter.archetype >= archetypes->count || iter.row >= arch[iter.archetype].size || iter.generation > 0xFF)
+			{
+				BASILISK_ERROR("Basilisk::SceneFile::Validate() found a record outside of its archetype");
+				return false;
+			}
+
+			uint32_t entity = entities[iter.archetype][iter.row];
+			if ((entity & 0xFFFFFF) != i || (entity >> 24) != iter.generation)
+			{
+				BASILISK_ERROR("Basilisk::SceneFile::Validate() found a record and entity which disagree");
+				return false;
+			}
+			++numLive;
+		}
+		if (numLive != numEntities)
+		{
+			BASILISK_ERROR("Basilisk::SceneFile::Validate() found entities with no record");
+			return false;
+		}
+
+		//A record listed twice would be handed out to two entities
+		const uint32_t *freeList = Blob<uint32_t>(data, freeRecords);
+		std::vector<bool> listed(static_cast<size_t>(records->count), false);
+		for (uint64_t i = 0; i < freeRecords->count; ++i)
+		{
+			if (freeList[i] >= records->count || record[freeList[i]].archetype != freeRecord || listed[freeList[i]])
+			{
+				BASILISK_ERROR("Basilisk::SceneFile::Validate() found a free list entry which is in use");
+				return false;
+			}
+			listed[freeList[i]] = true;
+		}
+		return true;
+	}
+}
+
+const Section *SceneFile::FindSection(const uint8_t *data, SectionType type, uint32_t archetype, uint32_t component)
+{
+	const Section *sections = GetSections(data);
+	for (uint32_t i = 0; i < GetHeader(data).numSections; ++i)
+	{
+		if (sections[i].type == type && sections[i].archetype == archetype && sections[i].component == component)
+			return &sections[i];
+	}
+	return nullptr;
+}
+
+bool SceneFile::Validate(const uint8_t *data, size_t size, bool deep)
+{
+	if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % 8 != 0)
+	{
+		BASILISK_ERROR("Basilisk::SceneFile::Validate() was given a buffer too small or misaligned to be a scene");
+		return false;
+	}
+
+	const Header &header = GetHeader(data);
+	if (header.magic != magic)
+	{
+		BASILISK_ERROR("Basilisk::SceneFile::Validate() was given a file which is not a scene");
+		return false;
+	}
+	if (header.versionMajor != versionMajor)
+	{
+		BASILISK_WARNING_DETAIL("Basilisk::SceneFile::Validate() cannot read scene format version %u", header.versionMajor);
+		return false;
+	}
+	if (header.fileSize != size || header.sectionTableOffset % 8 != 0 || header.sectionTableOffset > size ||
+		header.numSections > (size - header.sectionTableOffset) / sizeof(Section))
+	{
+		BASILISK_ERROR("Basilisk::SceneFile::Validate() found a truncated scene file");
+		return false;
+	}
+
+	//Every blob must lie within the file and have the element size its type demands
+	const Section *sections = GetSections(data);
+	for (uint32_t i = 0; i < header.numSections; ++i)
+	{
+		const Section &iter = sections[i];
+		uint32_t expected = 0;
+		switch (iter.type)
+		{
+		case SectionType::Components: expected = sizeof(ComponentDesc); break;
+		case SectionType::Archetypes: expected = sizeof(ArchetypeDesc); break;
+		case SectionType::Records: expected = sizeof(Record); break;
+		case SectionType::FreeRecords: expected = sizeof(uint32_t); break;
+		case SectionType::Entities: expected = sizeof(uint32_t); break;
+		case SectionType::Column: expected = iter.elementSize; break;
+		default:
+			continue; //Added by a later minor version
+		}
+
+		if (expected == 0 || iter.elementSize != expected || iter.offset % blobAlignment != 0 || iter.offset > size ||
+			iter.count > (size - iter.offset) / iter.elementSize)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::SceneFile::Validate() found an invalid section at index %u", i);
+			return false;
+		}
+	}
+
+	const Section *components = FindSection(data, SectionType::Components);
+	const Section *archetypes = FindSection(data, SectionType::Archetypes);
+	const Section *records = FindSection(data, SectionType::Records);
+	if (!components || !archetypes || !records || !FindSection(data, SectionType::FreeRecords))
+	{
+		BASILISK_ERROR("Basilisk::SceneFile::Validate() found a scene with a required section missing");
+		return false;
+	}
+	if (components->count > 64 || records->count > 0xFFFFFF)
+	{
+		BASILISK_ERROR("Basilisk::SceneFile::Validate() found a scene with too many components or entities");
+		return false;
+	}
+
+	const ComponentDesc *component = Blob<ComponentDesc>(data, components);
+	for (uint32_t i = 0; i < components->count; ++i)
+	{
+		if (component[i].name[0] == '\0' || memchr(component[i].name, '\0', maxNameLength) == nullptr || component[i].size == 0)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::SceneFile::Validate() found an invalid component description at index %u", i);
+			return false;
+		}
+		//Components are matched by name when loading, so two with the same name would share one type
+		for (uint32_t j = 0; j < i; ++j)
+		{
+			if (strcmp(component[i].name, component[j].name) == 0)
+			{
+				BASILISK_WARNING_DETAIL("Basilisk::SceneFile::Validate() found a repeated component name at index %u", i);
+				return false;
+			}
+		}
+	}
+
+	//Each archetype needs its entities and exactly the columns its mask names, all of the same length
+	uint64_t validBits = components->count == 64 ? ~0ull : (1ull << components->count) - 1;
+	const ArchetypeDesc *arch = Blob<ArchetypeDesc>(data, archetypes);
+	uint64_t numColumns = 0;
+	for (uint32_t i = 0; i < archetypes->count; ++i)
+	{
+		const Section *entities = FindSection(data, SectionType::Entities, i);
+		bool ok = (arch[i].components & ~validBits) == 0 && entities && entities->count == arch[i].size;
+		for (uint32_t c = 0; ok && c < components->count; ++c)
+		{
+			if (!(arch[i].components & (1ull << c)))
+				continue;
+			const Section *column = FindSection(data, SectionType::Column, i, c);
+			ok = column && column->count == arch[i].size && column->elementSize == component[c].size;
+		}
+		if (!ok)
+		{
+			BASILISK_WARNING_DETAIL("Basilisk::SceneFile::Validate() found an invalid archetype at index %u", i);
+			return false;
+		}
+		numColumns += PopCount(arch[i].components);
+	}
+
+	uint64_t numColumnSections = 0;
+	for (uint32_t i = 0; i < header.numSections; ++i)
+	{
+		if (sections[i].type == SectionType::Column)
+			++numColumnSections;
+	}
+	if (numColumnSections != numColumns)
+	{
+		BASILISK_ERROR("Basilisk::SceneFile::Validate() found columns which belong to no archetype");
+		return false;
+	}
+
+	return deep ? ValidateRecords(data) : true;
+}
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+	, m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+{
+
+}
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string &filename)
+{
+	std::shared_ptr<MappedFile> out(new MappedFile, [](MappedFile *ptr) { ptr->Release(); delete ptr; });
+
+#ifdef _WIN32
+	out->m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER size;
+	if (out->m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(out->m_file, &size) || size.QuadPart == 0)
+	{
+		BASILISK_ERROR("Basilisk::MappedFile::Open() could not open the file");
+		return nullptr;
+	}
+
+	out->m_mapping = CreateFileMappingA(out->m_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (out->m_mapping)
+		out->m_data = static_cast<uint8_t*>(MapViewOfFile(out->m_mapping, FILE_MAP_COPY, 0, 0, 0));
+	out->m_size = static_cast<size_t>(size.QuadPart);
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	struct stat info;
+	if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		if (file >= 0)
+			close(file);
+		BASILISK_ERROR("Basilisk::MappedFile::Open() could not open the file");
+		return nullptr;
+	}
+
+	void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file); //The mapping keeps its own reference
+	if (data != MAP_FAILED)
+	{
+		out->m_data = static_cast<uint8_t*>(data);
+		out->m_size = static_cast<size_t>(info.st_size);
+	}
+#endif
+
+	if (!out->m_data)
+	{
+		BASILISK_ERROR("Basilisk::MappedFile::Open() could not map the file");
+		return nullptr;
+	}
+	return out;
+}
+
+void MappedFile::Release()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_data)
+		munmap(m_data, m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}